@@ -32,7 +32,15 @@ SOURCES += src/attrmap.cpp \
     src/waiterbase.cpp  \
     src/proxy.cpp \
     src/pendingcontactrequest.cpp \
+    src/snapshot.cpp \
+    src/workerpool.cpp \
+    src/cacheloader.cpp \
+    src/bufferpool.cpp \
+    src/asyncdb.cpp \
+    src/searchindex.cpp \
+    src/nodeindex.cpp \
     src/crypto/cryptopp.cpp  \
+    src/crypto/aesni.cpp  \
     src/crypto/sodium.cpp  \
     src/db/sqlite.cpp  \
     src/gfx/qt.cpp \
@@ -143,7 +151,8 @@ win32 {
 unix {
 SOURCES += src/posix/net.cpp  \
     src/posix/fs.cpp  \
-    src/posix/waiter.cpp
+    src/posix/waiter.cpp  \
+    src/posix/iouring.cpp
 }
 
 HEADERS  += include/mega.h \
@@ -180,7 +189,15 @@ HEADERS  += include/mega.h \
             include/mega/waiter.h \
             include/mega/proxy.h \
             include/mega/pendingcontactrequest.h \
+            include/mega/snapshot.h \
+            include/mega/workerpool.h \
+            include/mega/cacheloader.h \
+            include/mega/bufferpool.h \
+            include/mega/asyncdb.h \
+            include/mega/searchindex.h \
+            include/mega/nodeindex.h \
             include/mega/crypto/cryptopp.h  \
+            include/mega/crypto/aesni.h  \
             include/mega/crypto/sodium.h  \
             include/mega/db/sqlite.h  \
             include/mega/gfx/qt.h \
@@ -220,6 +237,7 @@ unix {
             include/mega/posix/megasys.h  \
             include/mega/posix/megafs.h  \
             include/mega/posix/megawaiter.h \
+            include/mega/posix/megaiouring.h \
             include/mega/config.h
 }
 
@@ -835,7 +835,7 @@ void DemoApp::fetchnodes_result(error e)
         if (h != UNDEF)
         {
             Node *n = client->nodebyhandle(h);
-            if (n && (n->attrs.map.find('n') == n->attrs.map.end()))
+            if (n && (n->attrs().map.find('n') == n->attrs().map.end()))
             {
                 cout << "File/folder retrieval succeed, but encryption key is wrong." << endl;
             }
@@ -1701,7 +1701,7 @@ void TreeProcCopy::proc(MegaClient* client, Node* n)
 
         key.setkey((const byte*) t->nodekey.data(), n->type);
 
-        n->attrs.getjson(&attrstring);
+        n->attrs().getjson(&attrstring);
         t->attrstring = new string;
         client->makeattr(&key, t->attrstring, attrstring.c_str());
     }
@@ -2200,7 +2200,7 @@ static void process_line(char* l)
 
                                                 // rename
                                                 client->fsaccess->normalize(&newname);
-                                                n->attrs.map['n'] = newname;
+                                                n->attrs().map['n'] = newname;
 
                                                 if ((e = client->setattr(n)))
                                                 {
@@ -2229,7 +2229,7 @@ static void process_line(char* l)
                                                 }
 
                                                 // overwrite existing target file: rename source...
-                                                n->attrs.map['n'] = tn->attrs.map['n'];
+                                                n->attrs().map['n'] = tn->attrs().map['n'];
                                                 e = client->setattr(n);
 
                                                 if (e)
@@ -2373,8 +2373,8 @@ static void process_line(char* l)
                                 }
                                 else
                                 {
-                                    attr_map::iterator it = n->attrs.map.find('n');
-                                    if (it != n->attrs.map.end())
+                                    attr_map::iterator it = n->attrs().map.find('n');
+                                    if (it != n->attrs().map.end())
                                     {
                                         sname = it->second;
                                     }
@@ -2413,7 +2413,7 @@ static void process_line(char* l)
                                     // copy source attributes and rename
                                     AttrMap attrs;
 
-                                    attrs.map = n->attrs.map;
+                                    attrs.map = n->attrs().map;
                                     attrs.map['n'] = sname;
 
                                     key.setkey((const byte*) tc.nn->nodekey.data(), tc.nn->type);
@@ -2467,8 +2467,6 @@ static void process_line(char* l)
                     }
                     else if (words[0] == "du")
                     {
-                        TreeProcDU du;
-
                         if (words.size() > 1)
                         {
                             if (!(n = nodebypath(words[1].c_str())))
@@ -2485,11 +2483,12 @@ static void process_line(char* l)
 
                         if (n)
                         {
-                            client->proctree(n, &du);
+                            // previous versions are included, as with TreeProcDU
+                            NodeCounter nc = n->counter;
 
-                            cout << "Total storage used: " << (du.numbytes / 1048576) << " MB" << endl;
-                            cout << "Total # of files: " << du.numfiles << endl;
-                            cout << "Total # of folders: " << du.numfolders << endl;
+                            cout << "Total storage used: " << ((nc.storage + nc.versionstorage) / 1048576) << " MB" << endl;
+                            cout << "Total # of files: " << (nc.files + nc.versions) << endl;
+                            cout << "Total # of folders: " << nc.folders << endl;
                         }
 
                         return;
@@ -5414,7 +5413,7 @@ void DemoAppFolder::fetchnodes_result(error e)
         if (h != UNDEF)
         {
             Node *n = clientFolder->nodebyhandle(h);
-            if (n && (n->attrs.map.find('n') == n->attrs.map.end()))
+            if (n && (n->attrs().map.find('n') == n->attrs().map.end()))
             {
                 cout << "File/folder retrieval succeed, but encryption key is wrong." << endl;
             }
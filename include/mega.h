@@ -46,6 +46,7 @@
 #include "mega/file.h"
 #include "mega/filesystem.h"
 #include "mega/db.h"
+#include "mega/snapshot.h"
 #include "mega/json.h"
 #include "mega/pubkeyaction.h"
 #include "mega/request.h"
@@ -59,10 +60,13 @@
 #include "mega/logging.h"
 #include "mega/waiter.h"
 
+#include "mega/nodeindex.h"
+#include "mega/searchindex.h"
 #include "mega/node.h"
 #include "mega/sync.h"
 #include "mega/transfer.h"
 #include "mega/transferslot.h"
+#include "mega/bufferpool.h"
 #include "mega/megaapp.h"
 #include "mega/megaclient.h"
 
@@ -71,6 +75,9 @@
 #include "mega/thread/posixthread.h"
 #include "mega/thread/win32thread.h"
 #include "mega/thread/cppthread.h"
+#include "mega/workerpool.h"
+#include "mega/cacheloader.h"
+#include "mega/asyncdb.h"
 
 #include "megawaiter.h"
 #include "meganet.h"
@@ -80,6 +87,7 @@
 
 #include "mega/db/sqlite.h"
 #include "mega/db/bdb.h"
+#include "mega/db/lmdb.h"
 
 #include "mega/gfx/qt.h"
 #include "mega/gfx/freeimage.h"
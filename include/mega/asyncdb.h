@@ -0,0 +1,144 @@
+/**
+ * @file mega/asyncdb.h
+ * @brief DbTable writing to another table on a dedicated thread
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_ASYNCDB_H
+#define MEGA_ASYNCDB_H 1
+
+// requires the platform thread classes (include after mega/thread/*.h)
+#ifdef THREAD_CLASS
+
+#include "db.h"
+
+namespace mega {
+
+/**
+ * @brief DbTable handing its writes to a writer thread
+ *
+ * Writes, transaction boundaries and checkpoints are queued in order and
+ * applied to the underlying table by a dedicated thread, so that the
+ * caller does not wait for the database. The writer is woken up by each
+ * commit (or once enough data is queued) and applies everything queued so
+ * far: commits that end up in the same batch are merged into one, so
+ * commits are grouped while the writer lags behind, without ever being
+ * delayed past the batch that contains them. Transactions are never split,
+ * so the committed state always matches a commit of the caller.
+ *
+ * Reads first wait for the queue to be applied, and thus see all earlier
+ * writes. A failed write aborts the current transaction and makes all
+ * later writes fail.
+ */
+class MEGA_API AsyncDbTable : public DbTable
+{
+public:
+    void rewind();
+    bool next(uint32_t*, string*);
+    bool get(uint32_t, string*);
+    bool put(uint32_t, char*, unsigned);
+    bool del(uint32_t);
+    void truncate();
+    void begin();
+    void commit();
+    void abort();
+    void remove();
+    void checkpoint();
+    bool localpath(string*);
+    bool mapped();
+    bool nextmapped(uint32_t*, const char**, unsigned*);
+    void unmap();
+    bool hasnodeindex();
+    void createnodeindex();
+    bool indexnode(uint32_t, const DbNodeColumns*);
+    bool getnode(handle, uint32_t*);
+    bool getchildnodes(handle, handle_vector*);
+    bool getchildnodesbyname(handle, uint64_t, handle_vector*);
+    bool getnodesbyfingerprint(m_off_t, m_time_t, uint64_t, handle_vector*);
+
+    // wait until all queued operations have been applied
+    void flush();
+
+    // takes ownership of the table
+    AsyncDbTable(DbTable*);
+    ~AsyncDbTable();
+
+private:
+    // queued record data that wakes up the writer without a commit
+    static const size_t BATCHBYTES = 1 << 20;
+
+    // queued record data that blocks the caller until the writer caught up
+    static const size_t MAXQUEUEDBYTES = 32 << 20;
+
+    enum optype { OP_PUT, OP_DEL, OP_INDEXNODE, OP_TRUNCATE, OP_BEGIN, OP_COMMIT, OP_ABORT, OP_CHECKPOINT };
+
+    struct Op
+    {
+        optype type;
+        uint32_t id;
+        string data;
+        DbNodeColumns columns;
+    };
+
+    DbTable* table;
+
+    // protects the queue and the writer state
+    MUTEX_CLASS mutex;
+
+    // serializes the access to the underlying table
+    MUTEX_CLASS tablemutex;
+
+    // wakes up the writer
+    SEMAPHORE_CLASS work;
+
+    // released once the queue was applied after a flush request
+    SEMAPHORE_CLASS flushed;
+
+    THREAD_CLASS* thread;
+
+    vector<Op> queue;
+    size_t queuedbytes;
+
+    // the writer was woken up and has not taken the queue yet
+    bool signaled;
+
+    // the writer is applying a batch
+    bool busy;
+
+    bool flushrequested;
+    bool failed;
+    bool terminating;
+
+    // queue an operation (its data is taken) - returns false if writes fail
+    bool enqueue(Op*);
+
+    static void* threadentry(void*);
+    void loop();
+
+    // apply a batch of operations to the underlying table
+    bool apply(vector<Op>*);
+
+    AsyncDbTable(const AsyncDbTable&);
+    AsyncDbTable& operator=(const AsyncDbTable&);
+};
+
+} // namespace
+
+#endif
+
+#endif
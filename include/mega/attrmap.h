@@ -50,6 +50,13 @@ struct MEGA_API AttrMap
 
     // import raw binary serialize
     const char* unserialize(const char*, const char*);
+
+    // end of a raw binary serialize (NULL if malformed)
+    static const char* skip(const char*, const char*);
+
+    // look up a single attribute in a raw binary serialize, without
+    // importing the others
+    static bool find(const string*, nameid, string*);
 };
 } // namespace
 
@@ -0,0 +1,162 @@
+/**
+ * @file mega/bufferpool.h
+ * @brief Process-wide pool of transfer buffers with a memory budget
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_BUFFERPOOL_H
+#define MEGA_BUFFERPOOL_H 1
+
+#include "types.h"
+
+#include <new>
+
+namespace mega {
+
+/**
+ * @brief Reusable, aligned buffers for the data of transfer requests
+ *
+ * The pool is shared by all clients of the process. Its memory is bounded
+ * by a budget, which is split into equal shares between the transfer
+ * connections (including streaming reads) registered with
+ * addconnections(): the size of the download requests follows the share,
+ * and no buffer is handed out once the budget is exhausted. Upload chunks
+ * and the download reorder buffers are kept in the pool's buffers as well,
+ * streamed data is charged to the same budget. The buffers stay allocated
+ * while in use, so that they can be registered for file I/O (see
+ * PosixIoUring).
+ * Thread-safe if a thread class is available.
+ */
+class MEGA_API TransferBufferPool
+{
+public:
+    // alignment of the buffers
+    static const size_t ALIGNMENT = 4096;
+
+    // memory budget (0: default for the free memory of the system)
+    static void setbudget(m_off_t);
+    static m_off_t getbudget();
+
+    // connections sharing the budget are added/removed
+    static void addconnections(int);
+
+    // budget share of one connection
+    static m_off_t share();
+
+    // get a buffer of at least the given size, setting its actual size
+    // (NULL if the budget is exhausted, unless forced because the data is
+    // held already)
+    static byte* alloc(size_t, size_t*, bool = false);
+
+    // give a buffer back to the pool (NULL is ignored)
+    static void release(byte*);
+
+    // account for transfer data held outside of the pool - false (and
+    // nothing charged) if the budget is exhausted, unless forced because the
+    // data is held already
+    static bool charge(m_off_t, bool = false);
+    static void uncharge(m_off_t);
+
+    // bytes held, in use or idle, and charged
+    static m_off_t allocated();
+
+    // counter of the allocations and frees of buffers
+    static unsigned generation();
+
+    // get the buffers held, in use or idle, with their size - returns the
+    // generation they belong to
+    static unsigned buffers(vector<pair<byte*, size_t> >*);
+
+private:
+    static m_off_t configuredbudget;
+    static m_off_t currentbudget;
+    static m_off_t allocatedbytes;
+    static int connections;
+    static unsigned changes;
+
+    // idle buffers by size, and the size of every buffer
+    static multimap<size_t, byte*> idle;
+    static map<byte*, size_t> sizes;
+
+    // free idle buffers until at most the given number of bytes is held
+    static void trim(m_off_t);
+
+    // set the budget in use if it is not known yet
+    static void initbudget();
+
+    static m_off_t defaultbudget();
+};
+
+// allocator for strings of transfer data in the buffers of the
+// TransferBufferPool (beyond the budget rather than failing)
+template<class T>
+class TransferBufferAllocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<class U> struct rebind
+    {
+        typedef TransferBufferAllocator<U> other;
+    };
+
+    TransferBufferAllocator() { }
+    template<class U> TransferBufferAllocator(const TransferBufferAllocator<U>&) { }
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+
+    pointer allocate(size_type n, const void* = 0)
+    {
+        byte* p = TransferBufferPool::alloc(n * sizeof(T), NULL, true);
+
+        if (!p)
+        {
+            throw std::bad_alloc();
+        }
+
+        return (pointer)p;
+    }
+
+    void deallocate(pointer p, size_type)
+    {
+        TransferBufferPool::release((byte*)p);
+    }
+
+    size_type max_size() const { return (size_type)-1 / sizeof(T); }
+
+    void construct(pointer p, const T& value) { ::new((void*)p) T(value); }
+    void destroy(pointer p) { p->~T(); }
+};
+
+template<class T, class U>
+bool operator==(const TransferBufferAllocator<T>&, const TransferBufferAllocator<U>&) { return true; }
+
+template<class T, class U>
+bool operator!=(const TransferBufferAllocator<T>&, const TransferBufferAllocator<U>&) { return false; }
+
+typedef basic_string<char, char_traits<char>, TransferBufferAllocator<char> > pooled_string;
+} // namespace
+
+#endif
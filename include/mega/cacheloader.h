@@ -0,0 +1,132 @@
+/**
+ * @file mega/cacheloader.h
+ * @brief Parallel decoding of the local cache at startup
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_CACHELOADER_H
+#define MEGA_CACHELOADER_H 1
+
+// requires the platform thread classes (include after mega/thread/*.h)
+#ifdef THREAD_CLASS
+
+#include "types.h"
+
+namespace mega {
+
+/**
+ * @brief Reads and decodes the records of the local cache ahead of the
+ * engine thread
+ *
+ * A reader thread streams the records from the database in batches. The
+ * engine thread decrypts them and parses the node records on the client's
+ * WorkerPool, all batches read so far at once, and then merges them in
+ * cache order.
+ */
+class MEGA_API CacheLoader
+{
+public:
+    struct Record
+    {
+        uint32_t id;
+        string data;
+
+        // record still in the table's map (decrypted into data)
+        const char* mapped;
+        unsigned mappedlen;
+
+        // false if the record could not be decrypted
+        bool decrypted;
+
+        // parsed node record (NULL if not a node or not parseable)
+        NodeRecord* node;
+    };
+
+    struct Batch
+    {
+        vector<Record> records;
+
+        ~Batch();
+    };
+
+    // next decoded batch in cache order, or NULL after the last one - the
+    // caller takes ownership
+    Batch* next();
+
+    // true once all records have been read
+    bool readdone();
+
+    // true once all records have been read and decoded
+    bool decodedone();
+
+    CacheLoader(DbTable*, SymmCipher*, const FileSystemAccess*, WorkerPool*);
+    ~CacheLoader();
+
+private:
+    // records per batch
+    static const size_t BATCHSIZE = 256;
+
+    // batches read but not merged yet (limits memory use)
+    static const int MAXBATCHES = 64;
+
+    // records decoded by one worker pool job (sharing a key setup)
+    static const size_t JOBRECORDS = 16;
+
+    DbTable* table;
+    const byte* key;
+    const FileSystemAccess* fsaccess;
+    WorkerPool* pool;
+
+    // the records are read without a copy (see DbTable::mapped())
+    bool mapped;
+
+    MUTEX_CLASS mutex;
+
+    // batches read and not decoded yet, in cache order
+    deque<Batch*> batches;
+
+    // decoded batches not handed out yet (engine thread only)
+    deque<Batch*> decoded;
+
+    // records being decoded by the worker pool (engine thread only)
+    vector<Record*> decoding;
+
+    bool finished;
+    bool aborted;
+
+    // free batch slots for the reader
+    SEMAPHORE_CLASS slots;
+
+    // read batches (or end of input) for the engine thread
+    SEMAPHORE_CLASS ready;
+
+    THREAD_CLASS reader;
+
+    static void* readerentry(void*);
+    void read();
+
+    // decrypt and parse a slice of the records being decoded
+    static void decodejob(void*, size_t);
+    void decode(Record*, SymmCipher*);
+};
+
+} // namespace
+
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * @file mega/crypto/aesni.h
+ * @brief AES-128 CTR/CBC-MAC kernel using the AES-NI instructions
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_CRYPTO_AESNI_H
+#define MEGA_CRYPTO_AESNI_H 1
+
+// x86 compilers able to emit AES-NI code without global build flags - the
+// kernel is only entered if the CPU supports it (define NO_AESNI to leave
+// it out)
+#if !defined(NO_AESNI) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) \
+    && ((defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || defined(__clang__) || defined(_MSC_VER))
+#define USE_AESNI 1
+#endif
+
+namespace mega {
+// chunk of ctr_crypt_chunks(): en-/decrypted at its file position, with a
+// CBC-MAC of its own (mac is initialized from the IV if initmac is set)
+struct MEGA_API CtrChunk
+{
+    byte* data;
+    unsigned len;
+    m_off_t pos;
+    byte* mac;
+    bool initmac;
+};
+
+#ifdef USE_AESNI
+// AES-128 in CTR mode with the CBC-MAC of the plaintext, as used for the
+// file transfers (see SymmCipher::ctr_crypt()). The keystream is computed
+// eight blocks at a time, and the MACs of up to LANES chunks are advanced
+// together, so that the latency of the AES rounds of one CBC-MAC chain is
+// filled with independent work.
+class MEGA_API AesNi
+{
+public:
+    static const int ROUNDKEYSLENGTH = 11 * 16;
+
+    // CBC-MAC chains advanced together
+    static const unsigned LANES = 8;
+
+    // the CPU supports AES-NI
+    static bool available();
+
+    // expand an AES-128 key into its round keys
+    static void expandkey(const byte*, byte*);
+
+    // en-/decrypt one range (the data is padded to the block size - mac may be NULL)
+    static void ctr_crypt(const byte*, byte*, unsigned, m_off_t, uint64_t, byte*, bool, bool);
+
+    // en-/decrypt independent chunks
+    static void ctr_crypt(const byte*, CtrChunk*, unsigned, uint64_t, bool);
+};
+#endif
+} // namespace
+
+#endif
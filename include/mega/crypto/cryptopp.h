@@ -38,6 +38,8 @@
 #include <cryptopp/hmac.h>
 #include <cryptopp/pwdbased.h>
 
+#include "mega/crypto/aesni.h"
+
 namespace mega {
 using namespace std;
 
@@ -90,6 +92,12 @@ private:
     CryptoPP::GCM<CryptoPP::AES>::Encryption aesgcm_e;
     CryptoPP::GCM<CryptoPP::AES>::Decryption aesgcm_d;
 
+#ifdef USE_AESNI
+    // round keys for the AES-NI kernel, if the CPU supports it
+    byte aesnikeys[AesNi::ROUNDKEYSLENGTH];
+    bool aesni;
+#endif
+
 public:
     static byte zeroiv[CryptoPP::AES::BLOCKSIZE];
 
@@ -246,6 +254,20 @@ public:
 
     void ctr_crypt(byte *, unsigned, m_off_t, ctr_iv, byte *, bool, bool initmac = true);
 
+    /**
+     * @brief En-/decrypt several chunks in CTR mode, each with a CBC-MAC of its own
+     *
+     * Same result as ctr_crypt() on each chunk, but the MACs of the chunks
+     * are computed in parallel where supported.
+     *
+     * @param chunks Chunks to be processed (data, length, file position,
+     *     MAC and whether it is initialized from the IV).
+     * @param n Number of chunks.
+     * @param ctriv CTR IV.
+     * @param encrypt Encrypt (MAC of the input) or decrypt (MAC of the output).
+     */
+    void ctr_crypt_chunks(CtrChunk *, unsigned, ctr_iv, bool);
+
     static void setint64(int64_t, byte*);
 
     static void xorblock(const byte*, byte*);
@@ -253,7 +275,12 @@ public:
 
     static void incblock(byte*, unsigned = BLOCKSIZE);
 
-    SymmCipher() { }
+    SymmCipher()
+    {
+#ifdef USE_AESNI
+        aesni = false;
+#endif
+    }
     SymmCipher(const SymmCipher& ref);
     SymmCipher& operator=(const SymmCipher& ref);
     SymmCipher(const byte*);
@@ -25,6 +25,23 @@
 #include "filesystem.h"
 
 namespace mega {
+// indexed columns of a node record
+struct MEGA_API DbNodeColumns
+{
+    handle h;
+    handle ph;
+
+    // keyed hash of the name (0: no name, or not decrypted)
+    uint64_t namehash;
+
+    // file size (-1 for folders) and mtime
+    m_off_t size;
+    m_time_t mtime;
+
+    // digest of the sparse CRC (0: no valid fingerprint)
+    uint64_t fingerprint;
+};
+
 // generic host transactional database access interface
 class MEGA_API DbTable
 {
@@ -38,6 +55,20 @@ public:
     virtual bool next(uint32_t*, string*) = 0;
     bool next(uint32_t*, string*, SymmCipher*);
 
+    // get next record in sequence, still encrypted (see decrypt())
+    bool nextencrypted(uint32_t*, string*);
+    bool nextencrypted(uint32_t*, const char**, unsigned*);
+
+    // tables that keep their records mapped in memory return them without a
+    // copy: the data stays valid until unmap() or the next rewind(), also
+    // for other threads
+    virtual bool mapped() { return false; }
+    virtual bool nextmapped(uint32_t*, const char**, unsigned*) { return false; }
+    virtual void unmap() { }
+
+    // decrypt and unpad a record returned by nextencrypted()
+    static bool decrypt(uint32_t, string*, SymmCipher*);
+
     // get specific record by key
     virtual bool get(uint32_t, string*) = 0;
 
@@ -64,6 +95,36 @@ public:
     // permanantly remove all database info
     virtual void remove() = 0;
 
+    // the table holds a complete, consistent state (hint for tables that
+    // maintain a secondary representation)
+    virtual void checkpoint() { }
+
+    // local path of the file backing the table, if any
+    virtual bool localpath(string*) { return false; }
+
+    // optional counter kept beside the records, and updated in the same
+    // transaction (0 if never set)
+    virtual bool getgeneration(uint64_t*) { return false; }
+    virtual bool setgeneration(uint64_t) { return false; }
+
+    // optional index of node records by node handle, parent handle, name
+    // and fingerprint - the caller adds the entries (indexnode()), they are
+    // deleted along with their records
+    virtual bool hasnodeindex() { return false; }
+    virtual void createnodeindex() { }
+    virtual bool indexnode(uint32_t, const DbNodeColumns*) { return true; }
+
+    // record id of a node / handles of the children of a node
+    virtual bool getnode(handle, uint32_t*) { return false; }
+    virtual bool getchildnodes(handle, handle_vector*) { return false; }
+
+    // handles of the children of a node with a name hash, and of those
+    // indexed without a name hash (their name was not known)
+    virtual bool getchildnodesbyname(handle, uint64_t, handle_vector*) { return false; }
+
+    // handles of the file nodes with a size, mtime and fingerprint digest
+    virtual bool getnodesbyfingerprint(m_off_t, m_time_t, uint64_t, handle_vector*) { return false; }
+
     // autoincrement
     uint32_t nextid;
 
@@ -0,0 +1,127 @@
+/**
+ * @file lmdb.h
+ * @brief LMDB DB access layer
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifdef USE_LMDB
+#ifndef DBACCESS_CLASS
+#define DBACCESS_CLASS LmdbDbAccess
+
+#include <lmdb.h>
+
+namespace mega {
+class MEGA_API LmdbDbAccess : public DbAccess
+{
+    string dbpath;
+
+    // size of the memory map (upper limit of the database size)
+    static const size_t MAPSIZE = (size_t)1 << (sizeof(size_t) > 4 ? 34 : 28);
+
+public:
+    DbTable* open(FileSystemAccess*, string*, bool = false);
+
+    LmdbDbAccess(string* = NULL);
+    ~LmdbDbAccess();
+};
+
+// each table is a memory-mapped LMDB environment in a file of its own: the
+// records are a B+tree keyed by id, the node index lives in further trees
+// of the same environment. Reads never take locks, and the records returned
+// by nextmapped() point into the map. Writes outside begin()/commit() are
+// committed one by one.
+class MEGA_API LmdbDbTable : public DbTable
+{
+    MDB_env* env;
+    string dbfile;
+    FileSystemAccess* fsaccess;
+
+    MDB_dbi records;
+
+    // node index: columns by record id, record id by node handle, (name
+    // hash, handle) by parent handle, handles by fingerprint
+    MDB_dbi nodeids;
+    MDB_dbi nodehandles;
+    MDB_dbi children;
+    MDB_dbi fingerprints;
+    bool nodeindex;
+
+    // transaction between begin() and commit()/abort()
+    MDB_txn* txn;
+
+    // read transaction of get() and the index lookups, reset between uses
+    MDB_txn* readtxn;
+
+    // snapshot walked by rewind()/next(), kept until unmap() if records
+    // were returned mapped
+    MDB_txn* itertxn;
+    MDB_cursor* cursor;
+    bool iterating;
+    bool mappedrecords;
+
+    // advance the cursor
+    bool step(uint32_t*, const char**, unsigned*);
+
+    // the transaction of begin(), or a new one committed by endwrite()
+    MDB_txn* beginwrite();
+    bool endwrite(MDB_txn*, bool);
+
+    // the transaction of begin(), or the (renewed) read transaction
+    MDB_txn* beginread();
+    void endread(MDB_txn*);
+
+    bool opennodeindex(MDB_txn*, unsigned);
+
+    // remove the index entries of a record
+    bool deindexnode(MDB_txn*, uint32_t);
+
+    // collect the handles stored as duplicates of a key (from the given
+    // value prefix on, if any)
+    bool gethandles(MDB_dbi, MDB_val*, const void*, size_t, size_t, handle_vector*);
+
+    void close();
+
+public:
+    void rewind();
+    bool next(uint32_t*, string*);
+    bool get(uint32_t, string*);
+    bool put(uint32_t, char*, unsigned);
+    bool del(uint32_t);
+    void truncate();
+    void begin();
+    void commit();
+    void abort();
+    void remove();
+    bool mapped();
+    bool nextmapped(uint32_t*, const char**, unsigned*);
+    void unmap();
+    bool hasnodeindex();
+    void createnodeindex();
+    bool indexnode(uint32_t, const DbNodeColumns*);
+    bool getnode(handle, uint32_t*);
+    bool getchildnodes(handle, handle_vector*);
+    bool getchildnodesbyname(handle, uint64_t, handle_vector*);
+    bool getnodesbyfingerprint(m_off_t, m_time_t, uint64_t, handle_vector*);
+
+    LmdbDbTable(MDB_env*, FileSystemAccess*, string*);
+    ~LmdbDbTable();
+};
+} // namespace
+
+#endif
+#endif
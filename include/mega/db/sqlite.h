@@ -30,6 +30,9 @@ class MEGA_API SqliteDbAccess : public DbAccess
 {
     string dbpath;
 
+    // version of the node index schema (PRAGMA user_version)
+    static const int NODE_SCHEMA_VERSION = 1;
+
 public:
     DbTable* open(FileSystemAccess*, string*, bool = false);
 
@@ -44,6 +47,36 @@ class MEGA_API SqliteDbTable : public DbTable
     string dbfile;
     FileSystemAccess *fsaccess;
 
+    // the node index table exists
+    bool nodeindex;
+
+    // prepared statements, kept for the lifetime of the connection
+    enum
+    {
+        STMT_GET,
+        STMT_PUT,
+        STMT_DEL,
+        STMT_DELNODE,
+        STMT_INDEXNODE,
+        STMT_GETNODE,
+        STMT_GETCHILDNODES,
+        STMT_GETCHILDNODESBYNAME,
+        STMT_GETNODESBYFINGERPRINT,
+        STMT_GETGENERATION,
+        STMT_SETGENERATION,
+        NUMSTATEMENTS
+    };
+
+    sqlite3_stmt* stmts[NUMSTATEMENTS];
+
+    sqlite3_stmt* statement(int, const char*);
+    void finalizestatements();
+
+    bool deletebyid(int, const char*, uint32_t);
+
+    // collect the node handles returned by a query
+    bool gethandles(sqlite3_stmt*, handle_vector*);
+
 public:
     void rewind();
     bool next(uint32_t*, string*);
@@ -55,6 +88,16 @@ public:
     void commit();
     void abort();
     void remove();
+    bool localpath(string*);
+    bool getgeneration(uint64_t*);
+    bool setgeneration(uint64_t);
+    bool hasnodeindex();
+    void createnodeindex();
+    bool indexnode(uint32_t, const DbNodeColumns*);
+    bool getnode(handle, uint32_t*);
+    bool getchildnodes(handle, handle_vector*);
+    bool getchildnodesbyname(handle, uint64_t, handle_vector*);
+    bool getnodesbyfingerprint(m_off_t, m_time_t, uint64_t, handle_vector*);
 
     SqliteDbTable(sqlite3*, FileSystemAccess *fs, string *filepath);
     ~SqliteDbTable();
@@ -118,6 +118,10 @@ struct MEGA_API FileAccess
     // absolute position write
     virtual bool fwrite(const byte *, unsigned, m_off_t) = 0;
 
+    // reserve the disk space of a file being written up to the given size,
+    // without changing its size (false if not supported)
+    virtual bool preallocate(m_off_t) { return false; }
+
     // system-specific raw read/open/close
     virtual bool sysread(byte *, unsigned, m_off_t) = 0;
     virtual bool sysstat(m_time_t*, m_off_t*) = 0;
@@ -138,7 +142,10 @@ struct MEGA_API FileAccess
     AsyncIOContext *asyncfopen(string *, bool, bool, m_off_t = 0);
     virtual void asyncsysopen(AsyncIOContext*);
 
+    // asynchronous read, with NUL padding (into a string resized to fit,
+    // or a buffer of at least the size plus the padding)
     AsyncIOContext* asyncfread(string *, unsigned, unsigned, m_off_t);
+    AsyncIOContext* asyncfread(byte *, unsigned, unsigned, m_off_t);
     virtual void asyncsysread(AsyncIOContext*);
 
     AsyncIOContext* asyncfwrite(const byte *, unsigned, m_off_t);
@@ -313,6 +320,15 @@ struct MEGA_API FileSystemAccess : public EventTrigger
     // set whenever an operation fails because the target already exists
     bool target_exists;
 
+    // submit the asynchronous reads and writes started since the last call
+    // (backends that batch them), called once per engine loop iteration
+    virtual void flushasyncio() { }
+
+    // buffers that stay allocated and are used for asynchronous file I/O
+    // repeatedly can be registered with backends that support it
+    virtual bool registeriobuffer(byte*, size_t) { return false; }
+    virtual void unregisteriobuffer(byte*) { }
+
     // append local operating system version information to string
     virtual void osversion(string*) const { }
 
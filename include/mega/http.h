@@ -316,7 +316,27 @@ struct MEGA_API HttpReqXfer : public HttpReq
     virtual void prepare(const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t) = 0;
     virtual void finalize(Transfer*) { }
 
-    HttpReqXfer() : HttpReq(true), size(0) { }
+    // en-/decryption step of prepare()/finalize() - only touches the
+    // request, so that it can run on a worker thread
+    virtual void crypt() { }
+
+    // give the chunk data back to the TransferBufferPool
+    virtual void releasebuf() { }
+
+    HttpReqXfer() : HttpReq(true), size(0), ctriv(0), cipherkeyed(false) { }
+
+protected:
+    // private copy of the transfer key for crypt()
+    SymmCipher cipher;
+    uint64_t ctriv;
+
+    // key the private cipher, unless it has that key already - the request
+    // is reused for all chunks of its connection, and rebuilding the key
+    // schedules for every chunk is costly
+    void setcipherkey(const byte*);
+
+private:
+    bool cipherkeyed;
 };
 
 // file chunk upload
@@ -327,9 +347,37 @@ struct MEGA_API HttpReqUL : public HttpReqXfer
 
     void prepare(const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t);
 
+    // prepare() in steps: beginprepare(), crypt(), endprepare()
+    void beginprepare(const char*, SymmCipher*, uint64_t, m_off_t, m_off_t);
+    void crypt();
+    void endprepare(chunkmac_map*);
+
     m_off_t transferred(MegaClient*);
 
-    ~HttpReqUL() { }
+    // chunk data, read from the file into a buffer of the
+    // TransferBufferPool, encrypted in place and posted from there
+    byte* chunk;
+
+    // get a chunk buffer of at least the given size (false if the budget
+    // is exhausted)
+    bool allocbuf(size_t);
+    void releasebuf();
+
+    // post the chunk
+    void postchunk(MegaClient*);
+
+    HttpReqUL() : chunk(NULL), chunkcapacity(0), ulpos(0) { }
+    ~HttpReqUL();
+
+private:
+    // size of chunk, as allocated by the TransferBufferPool
+    size_t chunkcapacity;
+
+    // state between the steps of prepare()
+    string tempurl;
+    m_off_t ulpos;
+    byte mac[SymmCipher::BLOCKSIZE];
+    string crc;
 };
 
 // file chunk download
@@ -338,10 +386,27 @@ struct MEGA_API HttpReqDL : public HttpReqXfer
     m_off_t dlpos;
     chunkmac_map chunkmacs;
 
+    // the downloaded data has been decrypted
+    bool decrypted;
+
     void prepare(const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t);
     void finalize(Transfer *transfer);
 
-    ~HttpReqDL() { }
+    // finalize() in steps: beginfinalize(), crypt()
+    void beginfinalize(Transfer*);
+    void crypt();
+
+    void releasebuf();
+
+    HttpReqDL() : dlpos(0), decrypted(false), bufcapacity(0) { }
+    ~HttpReqDL();
+
+private:
+    // size of buf, as allocated by the TransferBufferPool
+    size_t bufcapacity;
+
+    // chunks to be decrypted by crypt()
+    vector<CtrChunk> cryptchunks;
 };
 
 // file attribute get
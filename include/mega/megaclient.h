@@ -36,6 +36,8 @@
 #include "pubkeyaction.h"
 #include "pendingcontactrequest.h"
 #include "mediafileattribute.h"
+#include "nodeindex.h"
+#include "searchindex.h"
 
 namespace mega {
 
@@ -71,6 +73,7 @@ public:
     int cache; // no-cache = 0, no-cache = 1
     int type; // Account = 0, Folder = 1
     dstime startTime; // startup time (ds)
+    int cacheWorkers; // threads decoding the local cache (0 = engine thread)
 
     /**
      * \brief Number of nodes in the cached filesystem
@@ -134,6 +137,15 @@ public:
      */
     dstime timeToLastByte;
 
+    /**
+     * @brief Time until the last record has been decrypted and parsed
+     *
+     * From DB: time until the last record read from the database has been
+     * decoded (by worker threads, in parallel with reading and merging)
+     * From API: this time is the same as timeToLastByte
+     */
+    dstime timeToDecoded;
+
     /**
      * @brief Time until the cached filesystem is ready
      *
@@ -185,9 +197,92 @@ public:
     // root nodes (files, incoming, rubbish)
     handle rootnodes[3];
 
-    // all nodes
+    // all nodes (resident nodes only if nodes are paged)
     node_map nodes;
 
+    // storage for all Node objects
+    SlabAllocator nodeslab;
+
+    // keep at most this many nodes in memory - the others are left in the
+    // local cache and loaded on demand by nodebyhandle(), loadchildren() and
+    // proctree() (0: all nodes resident, must be set before fetchnodes())
+    size_t maxresidentnodes;
+
+    // resident nodes, most recently used first (if maxresidentnodes is set)
+    node_list residentnodes;
+
+    // true if non-resident nodes can be loaded from the local cache
+    bool nodepaging;
+
+    // true while a node is loaded or evicted: its totals remain accounted
+    // for in its ancestors
+    bool pagingnode;
+
+    // fetch state serialize from local cache
+    bool fetchsc(DbTable*);
+
+    // load a non-resident node (and its ancestors) from the local cache
+    Node* loadnode(handle);
+
+    // make all children of a node resident
+    void loadchildren(Node*);
+
+    // evict least recently used nodes down to maxresidentnodes
+    void evictnodes();
+
+    // write a node record and its index entry to the local cache
+    bool cachenode(Node*);
+
+    // write the index entry of a node record
+    bool indexnode(Node*);
+
+    // keyed hash of a node name, as stored in the node index
+    uint64_t dbnamehash(const char*);
+
+    // digest of a fingerprint's sparse CRC, as stored in the node index
+    static uint64_t fingerprintdigest(const FileFingerprint*);
+
+    // load the non-resident nodes matching a fingerprint
+    void loadfingerprint(FileFingerprint*);
+
+    // substring index over node names
+    SearchIndex searchindex;
+
+    // resolved node paths (see MegaApiImpl::getNodeByPath() / getNodePath())
+    NodePathCache pathcache;
+
+    // secondary node indexes for attribute queries (size and mtime only
+    // cover file nodes, extension only covers named file nodes)
+    nodevalue_set nodesbysize;
+    nodevalue_set nodesbymtime;
+    nodevalue_set nodesbyctime;
+    nodestring_multimap nodesbyextension;
+
+    // true once nodesbysize, nodesbymtime and nodesbyctime have been built
+    // - until then, they are left empty to save memory
+    bool valuesindexed;
+
+    // build nodesbysize, nodesbymtime and nodesbyctime if not done yet
+    void indexvalues();
+
+    // move a node's entry in a value index (if built) to a new value
+    void reindexvalue(nodevalue_set*, Node*, int64_t, int64_t);
+
+    // true once searchindex and nodesbyextension have been built - until
+    // then, they are left empty to save time and memory while loading
+    bool namesindexed;
+
+    // build searchindex and nodesbyextension if not done yet
+    void indexnames();
+
+    // nodes with outgoing shares, pending outgoing shares and public links
+    handle_set outsharenodes;
+    handle_set pendingsharenodes;
+    handle_set publiclinknodes;
+
+    // refresh a node's membership in the above sets after a change
+    void updatesharednodes(Node*);
+
     // all users
     user_map users;
 
@@ -285,6 +380,14 @@ public:
     // fetchnodes stats
     FetchNodesStats fnstats;
 
+    // keep a binary snapshot of the local cache beside the database, to
+    // speed up loading it at startup (must be set before the cache is opened)
+    bool usesnapshots;
+
+    // write the local cache on a dedicated thread (requires THREAD_CLASS,
+    // must be set before the cache is opened)
+    bool asyncsc;
+
 #ifdef ENABLE_CHAT
     // load cryptographic keys: RSA, Ed25519, Cu25519 and their signatures
     void fetchkeys();    
@@ -587,7 +690,7 @@ public:
     // select the upload port automatically
     bool autoupport;
 
-    // finish downloaded chunks in order
+    // write downloaded data in file order
     bool orderdownloadedchunks;
 
     // disable public key pinning (for testing purposes)
@@ -623,6 +726,9 @@ public:
     // number of ongoing asynchronous fopen
     int asyncfopens;
 
+    // shared worker threads (NULL if unavailable)
+    WorkerPool* getworkerpool();
+
 private:
     BackoffTimer btcs;
     BackoffTimer btbadhost;
@@ -687,8 +793,22 @@ private:
     // a TransferSlot chunk failed
     bool chunkfailed;
     
-    // fetch state serialize from local cache
-    bool fetchsc(DbTable*);
+    // shared worker threads, created on first use (NULL if unavailable)
+    WorkerPool* workerpool;
+
+    // apply a node key right away or queue its decryption - returns false
+    // if no suitable key is available
+    bool preparekey(Node*, vector<NodeKeyJob>*);
+
+    // decrypt queued node keys on the worker pool and apply them
+    void applykeyjobs(vector<NodeKeyJob>*);
+
+    // merge one record of the local cache (node: record decoded in advance)
+    bool fetchscrecord(uint32_t, string*, NodeRecord*, node_vector*, bool paged);
+
+    // totals of the file nodes left in the local cache by fetchsc(), by
+    // parent handle
+    map<handle, pair<int, NodeCounter> > pagedchildren;
 
     // close the local transfer cache
     void closetc(bool remove = false);
@@ -806,7 +926,7 @@ public:
     pendinghttp_map pendinghttp;
 
     // record type indicator for sctable
-    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR, CACHEDTRANSFER, CACHEDFILE, CACHEDCHAT } sctablerectype;
+    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR, CACHEDTRANSFER, CACHEDFILE, CACHEDCHAT, CACHEDTRANSFERCHECKPOINT } sctablerectype;
 
     // open/create state cache database table
     void opensctable();
@@ -898,7 +1018,7 @@ public:
     transferslot_list::iterator slotit;
 
     // FileFingerprint to node mapping
-    fingerprint_set fingerprints;
+    FingerprintIndex fingerprints;
 
     // asymmetric to symmetric key rewriting
     handle_vector nodekeyrewrite;
@@ -937,9 +1057,17 @@ public:
     node_vector nodenotify;
     void notifynode(Node*);
 
-    // update transfer in the persistent cache
+    // update transfer in the persistent cache (folds in its checkpoints)
     void transfercacheadd(Transfer*);
 
+    // append the chunk MACs changed since the last checkpoint to the
+    // persistent cache - the transfer is rewritten in full once its
+    // checkpoints hold as many chunk MACs as the transfer itself
+    void transfercheckpoint(Transfer*);
+
+    // minimum number of checkpointed chunk MACs before a full rewrite
+    static const size_t MINCHECKPOINTMACS = 64;
+
     // remove a transfer from the persistent cache
     void transfercachedel(Transfer*);
 
@@ -1141,6 +1269,36 @@ public:
 
     Node* childnodebyname(Node*, const char*, bool = false);
 
+    // minimum number of children for a folder to get a name index
+    static const unsigned CHILDNAMEINDEXTHRESHOLD = 64;
+
+    // nodes whose names may contain a substring (still to be verified) -
+    // returns false if the query is too short to be served by the index
+    bool searchcandidates(const char*, node_vector*);
+
+    // children of a folder, stably sorted by a comparator - the sorted
+    // views of large folders are cached and kept up to date
+    void sortedchildren(Node*, nodecomparator, node_vector*);
+
+    // a page of the children of a folder, sorted by a comparator (or in
+    // their natural order if NULL): up to count children, skipping offset
+    // children after the given child (or from the start if NULL)
+    void childrenwindow(Node*, nodecomparator, Node*, size_t, size_t, node_vector*);
+
+    // minimum number of children for a folder to get cached sorted views
+    static const int CHILDVIEWTHRESHOLD = 256;
+
+    // cached sorted view of a large folder's children (created on first use)
+    node_vector* childview(Node*, nodecomparator);
+
+    // nodes whose indexed value lies within [min, max] - returns false if
+    // the index doesn't cover all nodes (node paging enabled)
+    bool nodesbyrange(nodevalue_set*, int64_t, int64_t, node_vector*);
+
+    // file nodes with the given extension (case-insensitive, without the
+    // dot) - returns false if the index doesn't cover all nodes
+    bool nodesbyext(const char*, node_vector*);
+
     // purge account state and abort server-client connection
     void purgenodesusersabortsc();
 
@@ -1193,8 +1351,12 @@ public:
     // binary session ID
     string sid;
 
-    // apply keys
+    // apply keys (to all nodes, or to the specified ones)
     int applykeys();
+    int applykeys(node_vector*);
+
+    // threads for CPU-bound work of the engine (see getworkerpool())
+    int workerthreads;
 
     // symmetric password challenge
     int checktsid(byte* sidbuf, unsigned len);
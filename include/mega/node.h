@@ -95,6 +95,99 @@ struct MEGA_API PublicLink
     bool isExpired();
 };
 
+// aggregated totals of a node subtree
+struct MEGA_API NodeCounter
+{
+    // bytes used by current file versions
+    m_off_t storage;
+
+    // bytes used by previous file versions
+    m_off_t versionstorage;
+
+    // number of current files
+    int files;
+
+    // number of folders (including the subtree root, if a folder)
+    int folders;
+
+    // number of previous file versions
+    int versions;
+
+    void operator+=(const NodeCounter&);
+    void operator-=(const NodeCounter&);
+
+    NodeCounter();
+};
+
+// a folder's children, sorted by a comparator
+struct MEGA_API ChildView
+{
+    nodecomparator comp;
+    node_vector nodes;
+};
+
+typedef list<ChildView> childview_list;
+
+// node record of the local cache, decoded without touching the client (see
+// Node::parse()) - can be produced on any thread
+struct MEGA_API NodeRecord
+{
+    handle h;
+    handle ph;
+    handle u;
+    nodetype_t type;
+    m_off_t size;
+    m_time_t ts;
+
+    // raw node key (empty for root nodes)
+    string key;
+
+    // file attribute string (files only)
+    string fa;
+
+    // inshare, outshares or pending shares (owned until merged)
+    newshare_list shares;
+
+    // attributes in raw binary serialize (see AttrMap::serialize())
+    string attrs;
+
+    // public link, if exported (owned until merged)
+    PublicLink* plink;
+
+    NodeRecord();
+    ~NodeRecord();
+
+private:
+    NodeRecord(const NodeRecord&);
+    NodeRecord& operator=(const NodeRecord&);
+};
+
+// symmetric node key decryption, prepared on the engine thread (see
+// MegaClient::preparekey()) and carried out on any thread (see decrypt())
+struct MEGA_API NodeKeyJob
+{
+    Node* node;
+
+    // base64-encoded encrypted node key (points into node->nodekey)
+    const char* encryptedkey;
+
+    // key the node key is encrypted with
+    byte cipherkey[SymmCipher::KEYLENGTH];
+
+    // outcome
+    bool keydecrypted;
+    byte key[FILENODEKEYLENGTH];
+
+    bool attrsdecrypted;
+
+    // attributes in raw binary serialize
+    string attrs;
+
+    // decrypt the node key and the attributes - only reads the node, which
+    // must not be modified meanwhile
+    void decrypt(const FileSystemAccess*);
+};
+
 // filesystem node
 struct MEGA_API Node : public NodeCore, FileFingerprint
 {
@@ -109,17 +202,43 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     // try to resolve node key string
     bool applykey();
 
+    // locate the key needed to decrypt the node key string - returns false
+    // if the key is already decrypted or not available yet
+    bool findkey(const char**, SymmCipher**);
+
+    // length of the decrypted node key
+    unsigned keylength() const;
+
     // set up nodekey in a static SymmCipher
     SymmCipher* nodecipher();
 
     // decrypt attribute string and set fileattrs
     void setattr();
 
+    // set attributes decrypted beforehand, in raw binary serialize (see
+    // NodeKeyJob)
+    void setattr(string*);
+
+    // decrypt and parse an attribute string (thread-safe)
+    static bool decodeattr(SymmCipher*, const string*, const FileSystemAccess*, attr_map*);
+    static bool decodeattr(SymmCipher*, const string*, const FileSystemAccess*, string*);
+
     // display name (UTF-8)
     const char* displayname() const;
 
-    // node attributes
-    AttrMap attrs;
+    // node attributes - kept serialized until first accessed, then decoded
+    // once (thread-safe)
+    AttrMap& attrs()
+    {
+        decodeattrs();
+
+        return attrmap;
+    }
+
+    const AttrMap& attrs() const
+    {
+        return const_cast<Node*>(this)->attrs();
+    }
 
     // owner
     handle owner;
@@ -183,8 +302,68 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     // own position in parent's children
     node_list::iterator child_it;
 
-    // own position in fingerprint set (only valid for file nodes)
-    fingerprint_set::iterator fingerprint_it;
+    // children by name hash (only built for large folders, NULL otherwise)
+    nodename_multimap* childnames;
+
+    // own position in parent's childnames (only valid if parent->childnames)
+    nodename_multimap::iterator childname_it;
+
+    // cached sorted copies of the children (NULL if none, see
+    // MegaClient::sortedchildren())
+    childview_list* childviews;
+
+    // build the children name index
+    void indexchildnames();
+
+    // refresh own entries in the parent's name index and in the client's
+    // search index after a name change
+    void updatenameindex();
+
+    // hash of the name under which the node is in the search index (0: not indexed)
+    uint64_t searchnamehash;
+
+    // drop cached paths that may resolve differently after a rename or
+    // move of this node: its own subtree and its same-named siblings
+    void invalidatepaths();
+
+    // hash of a node name, as used by the name index
+    static uint64_t namehash(const char*);
+
+    // totals of the subtree rooted at this node, including the node itself
+    // (maintained incrementally, no tree walk required)
+    NodeCounter counter;
+
+    // number of direct children that are files / folders
+    int numchildfiles;
+    int numchildfolders;
+
+    // false if children are left in the local cache (see
+    // MegaClient::loadchildren())
+    bool childrenloaded;
+
+    // account for children that are left in the local cache
+    void addpagedchildren(int, NodeCounter);
+
+    // position in the client's list of resident nodes (end() if nodes are
+    // not paged)
+    node_list::iterator resident_it;
+
+    // update the file size and all ancestors' totals accordingly
+    void setsize(m_off_t);
+
+    // links in the client's fingerprint index (fingerprintprev is NULL if
+    // the node is not indexed)
+    Node* fingerprintnext;
+    Node** fingerprintprev;
+
+    // own position in the client's extension index (end() if not indexed)
+    nodestring_multimap::iterator extension_it;
+
+    // update the creation time and its index entry
+    void setctime(m_time_t);
+
+    // lowercase extension of a file name (empty if none)
+    static void extension(const char*, string*);
 
 #ifdef ENABLE_SYNC
     // related synced item or NULL
@@ -218,8 +397,56 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     bool serialize(string*);
     static Node* unserialize(MegaClient*, string*, node_vector*);
 
+    // decode a serialized node (thread-safe)
+    static bool parse(const FileSystemAccess*, string*, NodeRecord*);
+
+    // create the node described by a decoded record
+    static Node* unserialize(MegaClient*, NodeRecord*, node_vector*);
+
+    // Node objects are allocated from the owning client's slab
+    // (use new (client) Node(client, ...))
+    static void* operator new(size_t, MegaClient*);
+    static void operator delete(void*, MegaClient*);
+    static void operator delete(void*);
+
     Node(MegaClient*, vector<Node*>*, handle, handle, nodetype_t, m_off_t, handle, const char*, m_time_t);
     ~Node();
+
+private:
+    // decoded attributes
+    AttrMap attrmap;
+
+    // attributes in raw binary serialize until they are decoded (NULL
+    // afterwards)
+    string* attrdata;
+
+    // decode attrdata into attrmap, unless another thread already did -
+    // attrdata is only checked under the lock, as the decoding thread's
+    // writes to attrmap are not visible otherwise
+    void decodeattrs();
+
+    // add a change of this node's subtree totals to all ancestors
+    void propagatecounter(NodeCounter);
+
+    // link into / unlink from the parent's child counts and totals
+    void attachcounter();
+    void detachcounter();
+
+    // insert into / remove from / reposition in the parent's sorted views
+    void addtoviews();
+    void removefromviews();
+    void resortinviews();
+
+    // prefix of every Node allocation, records the slab it belongs to
+    union AllocHeader
+    {
+        SlabAllocator* slab;
+        int64_t align;
+    };
+
+public:
+    // size of a Node allocation including its header
+    static const size_t ALLOCSIZE;
 };
 
 #ifdef ENABLE_SYNC
@@ -0,0 +1,282 @@
+/**
+ * @file mega/nodeindex.h
+ * @brief Node handle index, Node slab allocator, node path cache and
+ * fingerprint index
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_NODEINDEX_H
+#define MEGA_NODEINDEX_H 1
+
+#include "types.h"
+
+namespace mega {
+
+/**
+ * @brief Open-addressing hash table mapping node handles to Node pointers
+ *
+ * Node handles are 48-bit values, so the two topmost handle values are free
+ * to be used as markers for empty and deleted slots. Slots are probed
+ * linearly and deleted entries leave a tombstone behind, so erasing an
+ * element never moves other elements and iterators remain valid until the
+ * next insertion.
+ *
+ * The interface mimics the subset of std::map<handle, Node*> used by the SDK.
+ */
+class MEGA_API NodeIndex
+{
+public:
+    typedef pair<handle, Node*> value_type;
+
+    class MEGA_API iterator
+    {
+        value_type* slot;
+        value_type* last;
+
+        void skip();
+
+    public:
+        iterator() : slot(NULL), last(NULL) { }
+        iterator(value_type* s, value_type* l) : slot(s), last(l) { skip(); }
+
+        value_type& operator*() const { return *slot; }
+        value_type* operator->() const { return slot; }
+
+        iterator& operator++();
+        iterator operator++(int);
+
+        bool operator==(const iterator& other) const { return slot == other.slot; }
+        bool operator!=(const iterator& other) const { return slot != other.slot; }
+    };
+
+    iterator begin();
+    iterator end();
+
+    // locate node by handle, returns end() if not present
+    iterator find(handle);
+
+    // locate or create the entry for a handle
+    Node*& operator[](handle);
+
+    // remove the entry for a handle - returns the number of removed entries
+    size_t erase(handle);
+    void erase(iterator);
+
+    size_t size() const;
+    bool empty() const;
+
+    // remove all entries and release the table
+    void clear();
+
+    // preallocate the table for the given number of entries
+    void reserve(size_t);
+
+    NodeIndex();
+    ~NodeIndex();
+
+private:
+    // slot markers (never valid 48-bit node handles)
+    static const handle EMPTYSLOT = ~(handle)0;
+    static const handle DELETEDSLOT = ~(handle)1;
+
+    // initial number of slots (must be a power of two)
+    static const size_t MINCAPACITY = 64;
+
+    value_type* slots;
+
+    // number of slots (power of two)
+    size_t capacity;
+
+    // number of live entries
+    size_t count;
+
+    // number of live entries plus tombstones
+    size_t used;
+
+    static size_t hash(handle);
+
+    // position of the live entry for a handle or NULL
+    value_type* lookup(handle) const;
+
+    // rebuild the table with at least the specified number of slots
+    void rehash(size_t);
+
+    NodeIndex(const NodeIndex&);
+    NodeIndex& operator=(const NodeIndex&);
+};
+
+/**
+ * @brief Fixed-size block allocator with stable addresses
+ *
+ * Blocks are carved out of large slabs and recycled through a free list, so
+ * the per-object overhead of the system allocator is avoided. Addresses of
+ * allocated blocks never change. Slabs are only returned to the system when
+ * no block is in use anymore.
+ *
+ * Not thread-safe: each MegaClient owns its own allocator, which is only
+ * used from the thread running the client.
+ */
+class MEGA_API SlabAllocator
+{
+public:
+    // allocate one block
+    void* alloc();
+
+    // return a block obtained from alloc()
+    void release(void*);
+
+    // number of blocks currently in use
+    size_t inuse() const;
+
+    // total number of bytes reserved by slabs
+    size_t reserved() const;
+
+    SlabAllocator(size_t blocksize, size_t blocksperslab = 1024);
+    ~SlabAllocator();
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    size_t blocksize;
+    size_t blocksperslab;
+    size_t numinuse;
+
+    vector<char*> slabs;
+    FreeBlock* freelist;
+
+    void addslab();
+    void releaseslabs();
+
+    SlabAllocator(const SlabAllocator&);
+    SlabAllocator& operator=(const SlabAllocator&);
+};
+
+/**
+ * @brief Bounded cache of resolved node paths
+ *
+ * Maps path strings to the nodes they resolve to, and nodes to their path
+ * strings. The string format is up to the user of the cache. Entries are
+ * invalidated per node: invalidate() drops everything referring to a node
+ * or to any node below it, so it must be called whenever a node is renamed,
+ * moved or deleted. Once the cache is full, it is emptied and starts over.
+ */
+class MEGA_API NodePathCache
+{
+public:
+    // node previously stored for a path, or NULL
+    Node* getnode(const string&);
+    void putnode(const string&, Node*);
+
+    // path previously stored for a node - returns false if not cached
+    bool getpath(Node*, string*);
+    void putpath(Node*, const string&);
+
+    // drop all entries for a node and its subtree
+    void invalidate(Node*);
+
+    bool empty() const;
+    void clear();
+
+    NodePathCache(size_t maxentries = 4096);
+
+private:
+    typedef map<string, Node*> pathnode_map;
+    typedef multimap<Node*, pathnode_map::iterator> nodepath_multimap;
+    typedef map<Node*, string> nodestring_map;
+
+    // path -> node
+    pathnode_map nodes;
+
+    // node -> its entries in nodes
+    nodepath_multimap pathsbynode;
+
+    // node -> path
+    nodestring_map paths;
+
+    size_t maxentries;
+
+    void makeroom();
+    void erase(Node*);
+};
+
+/**
+ * @brief Hash index of file nodes by FileFingerprint
+ *
+ * Nodes are keyed on size, mtime and sparse CRC (the fields compared by
+ * FileFingerprintCmp) and chained through their own fingerprintnext /
+ * fingerprintprev members, so the index needs no allocation per node and
+ * a node can be removed in O(1). Nodes with equal fingerprints are kept in
+ * insertion order.
+ */
+class MEGA_API FingerprintIndex
+{
+public:
+    // add a node (must not be indexed yet)
+    void add(Node*);
+
+    // remove an indexed node
+    void remove(Node*);
+
+    // oldest indexed node with an equal fingerprint, or NULL
+    Node* find(const FileFingerprint*) const;
+
+    // all indexed nodes with an equal fingerprint, oldest first
+    void findall(const FileFingerprint*, node_vector*) const;
+
+    size_t size() const;
+
+    // unlink all nodes and release the table
+    void clear();
+
+    // preallocate the table for the given number of nodes
+    void reserve(size_t);
+
+    FingerprintIndex();
+    ~FingerprintIndex();
+
+private:
+    // initial number of buckets (must be a power of two)
+    static const size_t MINBUCKETS = 1024;
+
+    Node** buckets;
+
+    // number of buckets (power of two)
+    size_t numbuckets;
+
+    // number of indexed nodes
+    size_t count;
+
+    static size_t hash(const FileFingerprint*);
+    static bool equal(const FileFingerprint*, const FileFingerprint*);
+
+    // append a node to the end of a bucket chain
+    void link(Node**, Node*);
+
+    // rebuild the table with the specified number of buckets
+    void rehash(size_t);
+
+    FingerprintIndex(const FingerprintIndex&);
+    FingerprintIndex& operator=(const FingerprintIndex&);
+};
+
+} // namespace
+
+#endif
@@ -39,6 +39,7 @@
 #endif
 
 #include "mega.h"
+#include "megaiouring.h"
 
 #define DEBRISFOLDER ".debris"
 
@@ -106,6 +107,16 @@ public:
     void addevents(Waiter*, int);
     int checkevents(Waiter*);
 
+    void flushasyncio();
+    bool registeriobuffer(byte*, size_t);
+    void unregisteriobuffer(byte*);
+
+#ifdef HAVE_IO_URING
+    // ring for the asynchronous file I/O (set up on first use, NULL if
+    // not available)
+    PosixIoUring* getring();
+#endif
+
     void osversion(string*) const;
     void statsid(string*) const;
 
@@ -118,16 +129,36 @@ public:
 
     PosixFileSystemAccess(int = -1);
     ~PosixFileSystemAccess();
+
+#ifdef HAVE_IO_URING
+private:
+    PosixIoUring* ring;
+    bool ringfailed;
+#endif
 };
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_IO_URING)
 struct MEGA_API PosixAsyncIOContext : public AsyncIOContext
 {
     PosixAsyncIOContext();
     virtual ~PosixAsyncIOContext();
     virtual void finish();
 
+#ifdef HAVE_AIO_RT
     struct aiocb *aiocb;
+#endif
+
+#ifdef HAVE_IO_URING
+    // ring of the operation in progress
+    PosixIoUring *ring;
+    int fd;
+
+    // bytes transferred so far
+    unsigned done;
+
+    // submitted with a registered buffer
+    bool fixed;
+#endif
 };
 #endif
 
@@ -146,13 +177,14 @@ public:
     bool fread(string *, unsigned, unsigned, m_off_t);
     bool frawread(byte *, unsigned, m_off_t);
     bool fwrite(const byte *, unsigned, m_off_t);
+    bool preallocate(m_off_t);
 
     bool sysread(byte *, unsigned, m_off_t);
     bool sysstat(m_time_t*, m_off_t*);
     bool sysopen(bool async = false);
     void sysclose();
 
-    PosixFileAccess(Waiter *w, int defaultfilepermissions = 0600);
+    PosixFileAccess(Waiter *w, int defaultfilepermissions = 0600, PosixFileSystemAccess* = NULL);
 
     // async interface
     virtual bool asyncavailable();
@@ -162,11 +194,22 @@ public:
 
     ~PosixFileAccess();
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_IO_URING)
 protected:
     virtual AsyncIOContext* newasynccontext();
+#endif
+
+#ifdef HAVE_AIO_RT
     static void asyncopfinished(union sigval sigev_value);
 #endif
+
+#ifdef HAVE_IO_URING
+    // owner of the io_uring instance
+    PosixFileSystemAccess* fsaccess;
+
+    // queue a read or write on the ring (false if there is none)
+    bool ringio(PosixAsyncIOContext*);
+#endif
 };
 
 class MEGA_API PosixDirNotify : public DirNotify
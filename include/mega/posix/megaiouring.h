@@ -0,0 +1,132 @@
+/**
+ * @file mega/posix/megaiouring.h
+ * @brief io_uring based asynchronous file I/O (Linux)
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_POSIX_IOURING_H
+#define MEGA_POSIX_IOURING_H 1
+
+#ifdef HAVE_IO_URING
+
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+namespace mega {
+struct PosixAsyncIOContext;
+
+// io_uring instance performing the asynchronous reads and writes of a
+// PosixFileSystemAccess. Operations are queued as they are started and
+// submitted together, with one system call per engine loop iteration
+// (submit()). Completions are processed on the engine thread by reap(),
+// after the waiter returned because the ring descriptor became readable.
+// Operations on registered buffers use the fixed-buffer opcodes: the buffers
+// of the TransferBufferPool are registered along with those added by
+// registerbuffer(), and plain reads/writes are used if that fails.
+class MEGA_API PosixIoUring
+{
+public:
+    // ring descriptor (readable while completions are pending)
+    int fd;
+
+    // set up a ring (NULL if io_uring is not available)
+    static PosixIoUring* create();
+
+    // queue a read or write of the remaining part of the context (false if
+    // the ring is full)
+    bool queue(PosixAsyncIOContext*);
+
+    // submit the queued operations
+    void submit();
+
+    // complete the finished operations, return their number
+    int reap();
+
+    // submit and block until at least one operation has finished
+    void waitone();
+
+    // operations queued or in flight
+    bool busy() const;
+
+    // add/remove a buffer to/from the table of registered buffers (the
+    // buffer must stay allocated until removed)
+    bool registerbuffer(byte*, size_t);
+    void unregisterbuffer(byte*);
+
+    ~PosixIoUring();
+
+private:
+    // submission and completion queues
+    unsigned entries;
+
+    unsigned* sqhead;
+    unsigned* sqtail;
+    unsigned* sqarray;
+    unsigned sqmask;
+    struct io_uring_sqe* sqes;
+
+    unsigned* cqhead;
+    unsigned* cqtail;
+    unsigned cqmask;
+    unsigned cqentries;
+    struct io_uring_cqe* cqes;
+
+    void* sqring;
+    size_t sqringsize;
+    void* cqring;
+    size_t cqringsize;
+    size_t sqessize;
+
+    // entries queued but not submitted
+    unsigned pending;
+
+    // operations submitted but not completed
+    unsigned inflight;
+
+    // registered buffers - the kernel's table is only updated while no
+    // fixed-buffer operation is in flight, and not used until it is
+    vector<struct iovec> buffers;
+    bool buffersregistered;
+    bool buffersdirty;
+    unsigned inflightfixed;
+
+    // the kernel's table: buffers, then those of the TransferBufferPool
+    // (as of the given pool generation)
+    vector<struct iovec> table;
+    unsigned poolgeneration;
+
+    // the table is outdated once the pool has allocated or freed buffers
+    void checkpool();
+
+    void updatebuffers();
+    int findbuffer(const byte*, unsigned) const;
+
+    // process the result of an operation
+    void complete(PosixAsyncIOContext*, int);
+
+    int enter(unsigned, unsigned, unsigned);
+
+    PosixIoUring();
+    PosixIoUring(const PosixIoUring&);
+    PosixIoUring& operator=(const PosixIoUring&);
+};
+} // namespace
+
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * @file mega/searchindex.h
+ * @brief Node name search index
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_SEARCHINDEX_H
+#define MEGA_SEARCHINDEX_H 1
+
+#include "types.h"
+
+namespace mega {
+
+/**
+ * @brief Trigram index over case-folded node names
+ *
+ * Every name is split into its overlapping three-byte sequences (ASCII
+ * letters folded to lower case, same as strcasestr()), and the node handle
+ * is appended to the posting list of each of them. A substring query only
+ * has to intersect the posting lists of its own trigrams.
+ *
+ * Removals are lazy: the handle stays in the posting lists until the index
+ * is rebuilt, so candidates must always be verified against the current
+ * name of the node. Posting lists are sorted and deduplicated on demand.
+ */
+class MEGA_API SearchIndex
+{
+public:
+    // index a name under a node handle
+    void add(handle, const char*);
+
+    // forget the name of a node handle (the entries become stale)
+    void remove(handle);
+
+    // handles of the nodes whose names may contain the substring, sorted -
+    // returns false if the query is too short to be answered by the index
+    bool candidates(const char*, vector<handle>*);
+
+    // true if stale entries have grown enough to warrant a rebuild
+    bool needsrebuild() const;
+
+    // number of indexed names
+    size_t size() const;
+
+    // remove all entries
+    void clear();
+
+    SearchIndex();
+
+private:
+    // minimum number of removals before a rebuild is suggested
+    static const size_t MINSTALE = 4096;
+
+    struct PostingList
+    {
+        vector<handle> handles;
+
+        // number of leading entries known to be sorted and unique
+        size_t sorted;
+
+        PostingList() : sorted(0) { }
+
+        void normalize();
+    };
+
+    typedef map<uint32_t, PostingList> posting_map;
+    posting_map postings;
+
+    size_t live;
+    size_t removed;
+
+    // distinct trigrams of a name, sorted
+    static void trigrams(const char*, vector<uint32_t>*);
+};
+
+} // namespace
+
+#endif
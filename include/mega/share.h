@@ -40,6 +40,7 @@ struct MEGA_API Share
 
     void serialize(string*);
     static bool unserialize(MegaClient *, int, handle, const byte *, const char**, const char*);
+    static NewShare* unserialize(int, handle, const byte *, const char**, const char*);
 
     Share(User*, accesslevel_t, m_time_t, PendingContactRequest* = NULL);
 };
@@ -0,0 +1,158 @@
+/**
+ * @file mega/snapshot.h
+ * @brief Binary snapshot of a local cache table
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_SNAPSHOT_H
+#define MEGA_SNAPSHOT_H 1
+
+#include "db.h"
+
+namespace mega {
+
+/**
+ * @brief DbTable keeping a binary snapshot of another table beside it
+ *
+ * The snapshot is a flat file holding the records of the table exactly as
+ * stored (i.e. still encrypted): a header, the concatenated records and a
+ * table of fixed-size entries (id, length) sorted by id. A journal file
+ * lists the ids of the records changed by every transaction committed
+ * after the snapshot was taken.
+ *
+ * The snapshot only serves full sequential reads (rewind() / next()): they
+ * stream the snapshot and only fetch the journaled records from the
+ * underlying table. Lookups of single records and of the node index go to
+ * the underlying table.
+ *
+ * Each commit bumps the generation counter of the underlying table (see
+ * DbTable::getgeneration(), which the table must support); snapshot and
+ * journal are only used if they account for the current generation,
+ * otherwise they are discarded and the underlying table is read instead.
+ *
+ * A new snapshot is taken on commit after checkpoint() was called, if the
+ * journal has grown too large or there is no usable snapshot.
+ */
+class MEGA_API SnapshotDbTable : public DbTable
+{
+public:
+    void rewind();
+    bool next(uint32_t*, string*);
+    bool get(uint32_t, string*);
+    bool put(uint32_t, char*, unsigned);
+    bool del(uint32_t);
+    void truncate();
+    void begin();
+    void commit();
+    void abort();
+    void remove();
+    void checkpoint();
+    bool localpath(string*);
+    bool hasnodeindex();
+    void createnodeindex();
+    bool indexnode(uint32_t, const DbNodeColumns*);
+    bool getnode(handle, uint32_t*);
+    bool getchildnodes(handle, handle_vector*);
+    bool getchildnodesbyname(handle, uint64_t, handle_vector*);
+    bool getnodesbyfingerprint(m_off_t, m_time_t, uint64_t, handle_vector*);
+
+    // takes ownership of the table - localpath: base path of the snapshot
+    // and journal files
+    SnapshotDbTable(DbTable*, FileSystemAccess*, string* localpath);
+    ~SnapshotDbTable();
+
+private:
+    // minimum number of journaled changes before a new snapshot is taken
+    static const size_t MINJOURNAL = 10000;
+
+    // size of the read buffer used while streaming the snapshot
+    static const unsigned READCHUNK = 1 << 20;
+
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+
+    struct Entry
+    {
+        uint32_t id;
+        uint32_t length;
+    };
+
+    DbTable* table;
+    FileSystemAccess* fsaccess;
+
+    string snapshotpath;
+    string journalpath;
+    string tmppath;
+
+    // generation of the last committed transaction
+    uint64_t generation;
+
+    // true if snapshot and journal reflect the committed state of the table
+    bool usable;
+
+    // number of records in the snapshot and of ids in the journal
+    size_t snapshotrecords;
+    size_t journaled;
+
+    // ids written by the current transaction
+    set<uint32_t> dirty;
+
+    bool checkpointrequested;
+
+    // state of a sequential read from the snapshot
+    bool reading;
+    FileAccess* reader;
+    vector<Entry> entries;
+    size_t nextentry;
+    m_off_t nextoffset;
+    m_off_t heapend;
+    vector<uint32_t> changed;
+    size_t nextchanged;
+    string buffer;
+    m_off_t bufferoffset;
+
+    // check snapshot and journal against the current generation
+    bool validate();
+
+    // snapshot header: number of records, generation, end of records
+    static bool readheader(FileAccess*, uint32_t*, uint64_t*, m_off_t*);
+
+    // journaled ids (optional) and generation of the last entry (0 if the
+    // journal is empty) - returns false if the journal is corrupt
+    bool readjournal(vector<uint32_t>*, size_t*, uint64_t*);
+
+    // prepare a sequential read from the snapshot
+    bool load();
+
+    // read part of the snapshot through the read buffer
+    bool readsnapshot(m_off_t, unsigned, string*);
+
+    void markdirty(uint32_t);
+    bool appendjournal();
+    bool writesnapshot();
+
+    void endread();
+    void discard();
+
+    SnapshotDbTable(const SnapshotDbTable&);
+    SnapshotDbTable& operator=(const SnapshotDbTable&);
+};
+
+} // namespace
+
+#endif
@@ -67,6 +67,14 @@ struct MEGA_API Transfer : public FileFingerprint
 
     chunkmac_map chunkmacs;
 
+    // chunk MACs changed since the last checkpoint
+    vector<m_off_t> pendingmacs;
+
+    // checkpoints appended to the transfer cache since the Transfer was last
+    // cached in full, and the number of chunk MACs they hold
+    vector<uint32_t> checkpointids;
+    size_t checkpointmacs;
+
     // upload handle for file attribute attachment (only set if file attribute queued)
     handle uploadhandle;
 
@@ -137,13 +145,34 @@ struct MEGA_API Transfer : public FileFingerprint
     // serialize the Transfer object
     virtual bool serialize(string*);
 
-    // unserialize a Transfer and add it to the transfer map
-    static Transfer* unserialize(MegaClient *, string*, transfer_map *);
+    // unserialize a Transfer, replay its checkpoints (if any) and add it to
+    // the transfer map
+    static Transfer* unserialize(MegaClient *, string*, transfer_map *, string_vector* = NULL);
 
     // examine a file on disk for video/audio attributes to attach to the file, on upload/download
     void addAnyMissingMediaFileAttributes(Node* node, std::string& localpath);
 };
 
+// chunk MACs completed since a Transfer was cached in full - appended to the
+// transfer cache instead of rewriting the whole Transfer after each chunk
+struct MEGA_API TransferCheckpoint : public Cachable
+{
+    // dbid of the cached Transfer
+    uint32_t transferid;
+
+    chunkmac_map chunkmacs;
+
+    bool serialize(string*);
+
+    // read the Transfer dbid of a serialized checkpoint
+    static bool unserializeid(const string*, uint32_t*);
+
+    // apply a serialized checkpoint to the chunk MACs of a Transfer
+    static bool replay(const string*, chunkmac_map*);
+
+    TransferCheckpoint();
+};
+
 class MEGA_API TransferList
 {
 public:
@@ -195,6 +224,9 @@ struct MEGA_API DirectReadSlot
     DirectRead* dr;
     HttpReq* req;
 
+    // buffer of the received data, as charged to the TransferBufferPool
+    m_off_t charged;
+
     drs_list::iterator drs_it;
     SpeedController speedController;
     m_off_t speed;
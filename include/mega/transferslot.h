@@ -25,8 +25,58 @@
 #include "http.h"
 #include "node.h"
 #include "backofftimer.h"
+#include "bufferpool.h"
 
 namespace mega {
+// decrypted download data waiting to be written - adjacent ranges are
+// coalesced, so that the requests running in parallel are written with few
+// large sequential writes instead of one write per request
+struct MEGA_API DownloadReorderBuffer
+{
+    struct Range
+    {
+        // in the TransferBufferPool's buffers, so that it can be written
+        // from registered buffers
+        pooled_string data;
+        chunkmac_map chunkmacs;
+
+        // write in progress (the range is not extended anymore)
+        AsyncIOContext* asyncio;
+
+        Range() : asyncio(NULL) { }
+    };
+
+    typedef map<m_off_t, Range> range_map;
+
+    // ranges by file position
+    range_map ranges;
+
+    // bytes held
+    m_off_t size;
+
+    // max bytes held (more data is only taken while the buffer is empty)
+    // and size from which a range is written without waiting for more
+    m_off_t maxsize;
+    m_off_t writesize;
+
+    // add data with its chunk MACs (moved), extending adjacent ranges
+    void add(m_off_t, const byte*, unsigned, chunkmac_map*);
+
+    // no room for more data
+    bool full(unsigned len) const { return size && size + len > maxsize; }
+
+    static m_off_t end(range_map::iterator it) { return it->first + it->second.data.size(); }
+
+    // drop a range (after it has been written)
+    void erase(range_map::iterator);
+
+    // drop all ranges (waits for the writes in progress)
+    void clear();
+
+    DownloadReorderBuffer();
+    ~DownloadReorderBuffer();
+};
+
 // active transfer
 struct MEGA_API TransferSlot
 {
@@ -50,6 +100,13 @@ struct MEGA_API TransferSlot
     static const m_off_t MAX_DOWNLOAD_REQ_SIZE;
     m_off_t maxDownloadRequestSize;
 
+    // connections registered with the TransferBufferPool
+    int poolconnections;
+
+    // size download requests and the reorder buffer by the current share
+    // of the transfer memory budget
+    void updatebuffersizes();
+
     m_off_t progressreported;
 
     m_time_t lastprogressreport;
@@ -81,6 +138,12 @@ struct MEGA_API TransferSlot
     // async IO operations
     AsyncIOContext** asyncIO;
 
+    // downloaded data not written yet
+    DownloadReorderBuffer downloadbuffer;
+
+    // en-/decryption of requests on the worker threads (REQ_CRYPTO)
+    WorkerJob** cryptjobs;
+
     // handle I/O for this slot
     void doio(MegaClient*);
 
@@ -102,6 +165,9 @@ struct MEGA_API TransferSlot
 
     // transfer failure flag
     bool failure;
+
+    // the transfer was cached in full since the slot started
+    bool checkpointed;
     
     TransferSlot(Transfer*);
     ~TransferSlot();
@@ -109,6 +175,22 @@ struct MEGA_API TransferSlot
 protected:
     void toggleport(HttpReqXfer* req);
 
+    // hand the en-/decryption of a request to the worker threads, if any
+    bool queuecrypt(MegaClient*, int);
+
+    // encrypt an upload request (REQ_PREPARED or REQ_CRYPTO)
+    void prepareupload(MegaClient*, int, const char*, m_off_t, m_off_t);
+
+    // decrypt a completed download request (false if left in REQ_CRYPTO)
+    bool finalizedownload(MegaClient*, int);
+
+    // write the buffered download data that is ready, or all of it
+    // (false if the transfer completed or failed, deleting the slot)
+    bool writedownload(MegaClient*, bool, dstime*);
+
+    // a request is downloading, or will start, at a file position
+    bool pendingat(m_off_t);
+
 };
 } // namespace
 
@@ -46,6 +46,9 @@ public:
 class MEGA_API TreeProcApplyKey : public TreeProc
 {
 public:
+    // nodes with undecrypted attributes (for MegaClient::applykeys())
+    node_vector nodes;
+
     void proc(MegaClient*, Node*);
 };
 
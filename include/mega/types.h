@@ -83,10 +83,14 @@ class MegaClient;
 struct NewNode;
 struct Node;
 struct NodeCore;
+struct NodeRecord;
+struct NodeKeyJob;
 class PubKeyAction;
 class Request;
 struct Transfer;
 class TreeProc;
+class WorkerPool;
+struct WorkerJob;
 class LocalTreeProc;
 struct User;
 struct Waiter;
@@ -109,7 +113,7 @@ typedef uint32_t dstime;
 #define TOSTRING(x) STRINGIFY(x)
 
 // HttpReq states
-typedef enum { REQ_READY, REQ_PREPARED, REQ_INFLIGHT, REQ_SUCCESS, REQ_FAILURE, REQ_DONE, REQ_ASYNCIO } reqstatus_t;
+typedef enum { REQ_READY, REQ_PREPARED, REQ_INFLIGHT, REQ_SUCCESS, REQ_FAILURE, REQ_DONE, REQ_ASYNCIO, REQ_CRYPTO } reqstatus_t;
 
 typedef enum { USER_HANDLE, NODE_HANDLE } targettype_t;
 
@@ -130,8 +134,59 @@ struct ChunkMAC
     bool finished;
 };
 
-// file chunk macs
-typedef map<m_off_t, ChunkMAC> chunkmac_map;
+// file chunk macs, addressed by chunk index (chunk boundaries are fixed,
+// see ChunkedHash) - the stored chunks span a contiguous index range, so
+// that a transfer request only holds the chunks it covers
+class MEGA_API chunkmac_map
+{
+    // MACs of the index range, absent chunks are zeroed
+    vector<ChunkMAC> macs;
+
+    // chunks of the index range that are present
+    vector<bool> present;
+
+    // index of the first chunk of the range
+    size_t base;
+
+    // number of present chunks
+    size_t count;
+
+public:
+    // index of the chunk containing a position, and start of a chunk
+    static size_t chunkindex(m_off_t);
+    static m_off_t chunkpos(size_t);
+
+    // MAC of the chunk containing a position (added if absent)
+    ChunkMAC& operator[](m_off_t);
+
+    // MAC of the chunk containing a position, or NULL if absent
+    ChunkMAC* find(m_off_t);
+
+    // index range that may hold present chunks
+    size_t begin() const { return base; }
+    size_t end() const { return base + macs.size(); }
+
+    bool has(size_t i) const { return i >= base && i - base < present.size() && present[i - base]; }
+    ChunkMAC& at(size_t i) { return macs[i - base]; }
+
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+    void clear();
+
+    // add the present chunks of another map, recording their positions
+    void merge(chunkmac_map*, vector<m_off_t>* = NULL);
+
+    // resume position (end of the finished chunks at the start of the
+    // file), completed bytes and bytes of partial chunks
+    void calcprogress(m_off_t size, m_off_t* pos, m_off_t* progress, m_off_t* partial = NULL);
+
+    // serialized as one block - unserialize also accepts the former
+    // (position, MAC) pair list
+    void serialize(string*);
+    bool unserialize(const char**, const char*);
+
+    chunkmac_map();
+};
 
 /**
  * @brief Declaration of API error codes.
@@ -259,6 +314,19 @@ typedef set<Node*> node_set;
 // FIXME: switch to forward_list once C++11 becomes more widely available
 typedef list<Node*> node_list;
 
+// indexes a folder's children by the hash of their name
+typedef multimap<uint64_t, Node*> nodename_multimap;
+
+// indexes nodes by a numeric attribute (size, mtime, ctime) - the entry of
+// a node is found through the node's current value of the attribute
+typedef set<pair<int64_t, Node*> > nodevalue_set;
+
+// indexes nodes by a string attribute (file extension)
+typedef multimap<string, Node*> nodestring_multimap;
+
+// "less or equal" node ordering, as used for sorted listings
+typedef bool (*nodecomparator)(Node*, Node*);
+
 // undefined node handle
 const handle UNDEF = ~(handle)0;
 
@@ -286,8 +354,10 @@ typedef map<int, vector<string> > pendingfiles_map;
 // map an upload handle to the corresponding transer
 typedef map<handle, Transfer*> handletransfer_map;
 
-// maps node handles to Node pointers
-typedef map<handle, Node*> node_map;
+// maps node handles to Node pointers (see nodeindex.h)
+class NodeIndex;
+class SlabAllocator;
+typedef NodeIndex node_map;
 
 // maps node handles to Share pointers
 typedef map<handle, struct Share*> share_map;
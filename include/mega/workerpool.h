@@ -0,0 +1,144 @@
+/**
+ * @file mega/workerpool.h
+ * @brief Worker threads for CPU-bound engine tasks
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_WORKERPOOL_H
+#define MEGA_WORKERPOOL_H 1
+
+// requires the platform thread classes (include after mega/thread/*.h)
+#ifdef THREAD_CLASS
+
+#include "types.h"
+
+namespace mega {
+
+/**
+ * @brief Job processed in the background by a WorkerPool
+ *
+ * run() is called on a worker thread and must only touch data owned by the
+ * job until WorkerPool::finished() returns true for it.
+ */
+struct MEGA_API WorkerJob
+{
+    virtual void run() = 0;
+
+    WorkerJob();
+    virtual ~WorkerJob() { }
+
+private:
+    friend class WorkerPool;
+
+    // state and completion notification, owned by the pool
+    enum { JOB_IDLE, JOB_QUEUED, JOB_RUNNING, JOB_FINISHED } state;
+    Waiter* waiter;
+};
+
+/**
+ * @brief Fixed set of threads processing batches of independent jobs
+ *
+ * run() hands out slices of a range of job indexes to the worker threads
+ * and to the calling thread, and returns once all jobs have been processed.
+ * Jobs run concurrently, so they must only touch their own data; the engine
+ * state can be read while the engine thread is blocked in run().
+ *
+ * Only one run() may be in progress at a time.
+ *
+ * queue() hands single jobs to the workers without waiting for them: the
+ * engine thread is woken through its Waiter once a job has been processed
+ * and checks for it with finished(). All calls are made from the engine
+ * thread.
+ */
+class MEGA_API WorkerPool
+{
+public:
+    typedef void (*job_func)(void* context, size_t index);
+
+    // process jobs [0, count) and wait for them to complete
+    void run(job_func, void* context, size_t count);
+
+    // process a job in the background and notify the waiter once done
+    // (the job is run by the caller if there are no worker threads)
+    void queue(WorkerJob*, Waiter*);
+
+    // the job has been processed since it was queued
+    bool finished(WorkerJob*);
+
+    // drop a job that has not started yet, or wait for it to complete
+    void cancel(WorkerJob*);
+
+    // number of worker threads (not counting the caller)
+    int size() const;
+
+    WorkerPool(int numthreads);
+    ~WorkerPool();
+
+private:
+    // number of consecutive jobs handed out at once (smaller batches are
+    // processed by the caller alone)
+    static const size_t SLICE = 32;
+
+    MUTEX_CLASS mutex;
+
+    // one release per worker and batch, per queued job (or termination) -
+    // woken workers check for either kind of work
+    SEMAPHORE_CLASS work;
+
+    // released once the last worker left the batch that run() waits for
+    SEMAPHORE_CLASS done;
+
+    // released once the job that cancel() waits for has completed
+    SEMAPHORE_CLASS jobdone;
+
+    vector<THREAD_CLASS*> threads;
+
+    // current batch
+    job_func func;
+    void* context;
+    size_t count;
+    size_t next;
+
+    // workers processing slices of the current batch
+    int active;
+    bool runwaiting;
+
+    // background jobs not started yet
+    deque<WorkerJob*> jobs;
+    WorkerJob* cancelwaiting;
+
+    bool terminating;
+
+    static void* threadentry(void*);
+    void loop();
+
+    // process slices of the current batch until none are left
+    void process();
+
+    // process a queued job
+    void runjob(WorkerJob*);
+
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+};
+
+} // namespace
+
+#endif
+
+#endif
@@ -7702,6 +7702,21 @@ class MegaApi
          */
         void setMaxConnections(int connections, MegaRequestListener* listener = NULL);
 
+        /**
+         * @brief Set the memory budget for the data buffers of transfers
+         *
+         * The budget is shared by all transfers (and streaming reads) of all MegaApi
+         * instances in the process. The size of download requests is adapted to the
+         * budget and the number of active connections, and new requests wait while
+         * the budget is exhausted.
+         *
+         * By default, the budget is a quarter of the free memory, up to 256 MB
+         * (32 MB on mobile platforms).
+         *
+         * @param bytes Memory budget in bytes (0 to restore the default value)
+         */
+        static void setTransferMemoryBudget(long long bytes);
+
         /**
          * @brief Set the transfer method for downloads
          *
@@ -8615,6 +8630,42 @@ class MegaApi
 		 */
         MegaNodeList* getChildren(MegaNode *parent, int order = 1);
 
+        /**
+         * @brief Get a page of the children of a node
+         *
+         * Only the nodes of the requested page are copied, so the cost of this
+         * function depends on the page size instead of the number of children.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param parent Parent node
+         * @param order Order for the returned list (see MegaApi::getChildren)
+         * @param offset Number of children to skip from the start of the list
+         * @param limit Maximum number of children to return (negative for no limit)
+         *
+         * @return List with the requested page of child MegaNode objects
+         */
+        MegaNodeList* getChildren(MegaNode *parent, int order, int offset, int limit);
+
+        /**
+         * @brief Get the page of the children of a node that follows a given child
+         *
+         * The handle of the last node of a page is the cursor for the next one.
+         * If the cursor node isn't a child of the parent anymore, the returned
+         * list is empty.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param parent Parent node
+         * @param order Order for the returned list (see MegaApi::getChildren)
+         * @param cursor Handle of the last child of the previous page, or
+         * INVALID_HANDLE to get the first page
+         * @param limit Maximum number of children to return (negative for no limit)
+         *
+         * @return List with the requested page of child MegaNode objects
+         */
+        MegaNodeList* getChildrenAfter(MegaNode *parent, int order, MegaHandle cursor, int limit);
+
         /**
          * @brief Get all versions of a file
          * @param node Node to check
@@ -8833,6 +8884,33 @@ class MegaApi
          */
         MegaNodeList *getInShares();
 
+        /**
+         * @brief Get a page of the list of inbound shares
+         *
+         * You take the ownership of the returned value
+         *
+         * @param offset Number of shared nodes to skip from the start of the list
+         * @param limit Maximum number of shared nodes to return (negative for no limit)
+         * @return Requested page of the inbound shared folders
+         */
+        MegaNodeList *getInShares(int offset, int limit);
+
+        /**
+         * @brief Get the page of the list of inbound shares that follows a given node
+         *
+         * The handle of the last node of a page is the cursor for the next one.
+         * If the cursor node isn't an inbound share anymore, the returned list
+         * is empty.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param cursor Handle of the last node of the previous page, or
+         * INVALID_HANDLE to get the first page
+         * @param limit Maximum number of shared nodes to return (negative for no limit)
+         * @return Requested page of the inbound shared folders
+         */
+        MegaNodeList *getInSharesAfter(MegaHandle cursor, int limit);
+
         /**
          * @brief Get a list with all active inboud sharings
          *
@@ -9382,6 +9460,139 @@ class MegaApi
          */
         MegaNodeList* search(const char* searchString);
 
+        /**
+         * @brief Get a page of the nodes containing a search string in their name
+         *
+         * The search is performed as in MegaApi::search, but only the nodes
+         * of the requested page are copied.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param searchString Search string. The search is case-insensitive
+         * @param offset Number of results to skip from the start of the list
+         * @param limit Maximum number of results to return (negative for no limit)
+         *
+         * @return Requested page of the nodes that contain the desired string in their name
+         */
+        MegaNodeList* search(const char* searchString, int offset, int limit);
+
+        /**
+         * @brief Get the page of search results that follows a given node
+         *
+         * The handle of the last node of a page is the cursor for the next one.
+         * If the cursor node doesn't match the search anymore, the returned
+         * list is empty.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param searchString Search string. The search is case-insensitive
+         * @param cursor Handle of the last node of the previous page, or
+         * INVALID_HANDLE to get the first page
+         * @param limit Maximum number of results to return (negative for no limit)
+         *
+         * @return Requested page of the nodes that contain the desired string in their name
+         */
+        MegaNodeList* searchAfter(const char* searchString, MegaHandle cursor, int limit);
+
+        /**
+         * @brief Get the files whose size is within a range
+         *
+         * The query is served from an index, built on the first query, so it
+         * doesn't need to explore the whole node tree (except while only part
+         * of the nodes is kept in memory). Previous versions of files are not
+         * included. The nodes are returned in the same order as MegaApi::search
+         * returns them.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param node The parent node of the tree to explore, or NULL to consider
+         * every accessible node for the account (see MegaApi::search)
+         * @param minSize Minimum size (in bytes), inclusive
+         * @param maxSize Maximum size (in bytes), inclusive
+         *
+         * @return List of files within the size range
+         */
+        MegaNodeList* searchBySize(MegaNode* node, long long minSize, long long maxSize);
+
+        /**
+         * @brief Get the files whose modification time is within a range
+         *
+         * The query is served from an index, built on the first query, so it
+         * doesn't need to explore the whole node tree (except while only part
+         * of the nodes is kept in memory). Previous versions of files are not
+         * included. The nodes are returned in the same order as MegaApi::search
+         * returns them.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param node The parent node of the tree to explore, or NULL to consider
+         * every accessible node for the account (see MegaApi::search)
+         * @param from Minimum modification time (in seconds since the epoch), inclusive
+         * @param to Maximum modification time (in seconds since the epoch), inclusive
+         *
+         * @return List of files within the time range
+         */
+        MegaNodeList* searchByModificationTime(MegaNode* node, int64_t from, int64_t to);
+
+        /**
+         * @brief Get the nodes whose creation time is within a range
+         *
+         * The query is served from an index, built on the first query, so it
+         * doesn't need to explore the whole node tree (except while only part
+         * of the nodes is kept in memory). Previous versions of files are not
+         * included. The nodes are returned in the same order as MegaApi::search
+         * returns them.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param node The parent node of the tree to explore, or NULL to consider
+         * every accessible node for the account (see MegaApi::search)
+         * @param from Minimum creation time (in seconds since the epoch), inclusive
+         * @param to Maximum creation time (in seconds since the epoch), inclusive
+         *
+         * @return List of nodes within the time range
+         */
+        MegaNodeList* searchByCreationTime(MegaNode* node, int64_t from, int64_t to);
+
+        /**
+         * @brief Get the nodes of a type
+         *
+         * The query explores the whole node tree. Previous versions of files are
+         * not included. The nodes are returned in the same order as
+         * MegaApi::search returns them.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param node The parent node of the tree to explore, or NULL to consider
+         * every accessible node for the account (see MegaApi::search)
+         * @param type Node type (MegaNode::TYPE_FILE or MegaNode::TYPE_FOLDER)
+         *
+         * @return List of nodes of the type
+         */
+        MegaNodeList* searchByType(MegaNode* node, int type);
+
+        /**
+         * @brief Get the files with an extension
+         *
+         * The comparison is case-insensitive. The extension is the part of the
+         * name after the last dot, for example "mp4" or ".mp4" for "video.MP4".
+         *
+         * The query is served from an index, built on the first query, so it
+         * doesn't need to explore the whole node tree (except while only part
+         * of the nodes is kept in memory). Previous versions of files are not
+         * included. The nodes are returned in the same order as MegaApi::search
+         * returns them.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param node The parent node of the tree to explore, or NULL to consider
+         * every accessible node for the account (see MegaApi::search)
+         * @param extension File extension
+         *
+         * @return List of files with the extension
+         */
+        MegaNodeList* searchByExtension(MegaNode* node, const char* extension);
+
         /**
          * @brief Process a node tree using a MegaTreeProcessor implementation
          * @param node The parent node of the tree to explore
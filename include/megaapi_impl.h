@@ -1307,13 +1307,48 @@ class TreeProcessor
 class SearchTreeProcessor : public TreeProcessor
 {
     public:
-        SearchTreeProcessor(const char *search);
+        // only the matches from offset on, at most limit of them (negative for
+        // no limit)
+        SearchTreeProcessor(const char *search, int offset = 0, int limit = -1);
         virtual bool processNode(Node* node);
         virtual ~SearchTreeProcessor() {}
         vector<Node *> &getResults();
 
     protected:
         const char *search;
+        int offset;
+        int limit;
+        vector<Node *> results;
+};
+
+class NodeValueTreeProcessor : public TreeProcessor
+{
+    public:
+        // node attributes to filter by
+        enum { ATTR_SIZE, ATTR_MTIME, ATTR_CTIME, ATTR_TYPE };
+
+        NodeValueTreeProcessor(int attribute, int64_t min, int64_t max);
+        virtual bool processNode(Node* node);
+        virtual ~NodeValueTreeProcessor() {}
+        vector<Node *> &getResults();
+
+    protected:
+        int attribute;
+        int64_t min;
+        int64_t max;
+        vector<Node *> results;
+};
+
+class ExtensionTreeProcessor : public TreeProcessor
+{
+    public:
+        ExtensionTreeProcessor(const char *extension);
+        virtual bool processNode(Node* node);
+        virtual ~ExtensionTreeProcessor() {}
+        vector<Node *> &getResults();
+
+    protected:
+        string extension;
         vector<Node *> results;
 };
 
@@ -1596,6 +1631,7 @@ class MegaApiImpl : public MegaApp
         bool areTransfersPaused(int direction);
         void setUploadLimit(int bpslimit);
         void setMaxConnections(int direction, int connections, MegaRequestListener* listener = NULL);
+        static void setTransferMemoryBudget(long long bytes);
         void setDownloadMethod(int method);
         void setUploadMethod(int method);
         bool setMaxDownloadSpeed(m_off_t bpslimit);
@@ -1669,6 +1705,8 @@ class MegaApiImpl : public MegaApp
 		int getNumChildFiles(MegaNode* parent);
 		int getNumChildFolders(MegaNode* parent);
         MegaNodeList* getChildren(MegaNode *parent, int order=1);
+        MegaNodeList* getChildren(MegaNode *parent, int order, int offset, int limit);
+        MegaNodeList* getChildrenAfter(MegaNode *parent, int order, MegaHandle cursor, int limit);
         MegaNodeList* getVersions(MegaNode *node);
         int getNumVersions(MegaNode *node);
         bool hasVersions(MegaNode *node);
@@ -1685,6 +1723,8 @@ class MegaApiImpl : public MegaApp
         MegaUser* getContact(const char* uid);
         MegaNodeList *getInShares(MegaUser* user);
         MegaNodeList *getInShares();
+        MegaNodeList *getInShares(int offset, int limit);
+        MegaNodeList *getInSharesAfter(MegaHandle cursor, int limit);
         MegaShareList *getInSharesList();
         MegaUser *getUserFromInShare(MegaNode *node);
         bool isPendingShare(MegaNode *node);
@@ -1737,6 +1777,13 @@ class MegaApiImpl : public MegaApp
         MegaNodeList* search(MegaNode* node, const char* searchString, bool recursive = 1);
         bool processMegaTree(MegaNode* node, MegaTreeProcessor* processor, bool recursive = 1);
         MegaNodeList* search(const char* searchString);
+        MegaNodeList* search(const char* searchString, int offset, int limit);
+        MegaNodeList* searchAfter(const char* searchString, MegaHandle cursor, int limit);
+        MegaNodeList* searchBySize(MegaNode* node, long long minSize, long long maxSize);
+        MegaNodeList* searchByModificationTime(MegaNode* node, int64_t from, int64_t to);
+        MegaNodeList* searchByCreationTime(MegaNode* node, int64_t from, int64_t to);
+        MegaNodeList* searchByType(MegaNode* node, int type);
+        MegaNodeList* searchByExtension(MegaNode* node, const char* extension);
 
         MegaNode *createForeignFileNode(MegaHandle handle, const char *key, const char *name, m_off_t size, m_off_t mtime,
                                        MegaHandle parentHandle, const char *privateauth, const char *publicauth);
@@ -2175,6 +2222,16 @@ protected:
 
         bool processTree(Node* node, TreeProcessor* processor, bool recursive = 1);
         MegaNodeList* search(Node* node, const char* searchString, bool recursive = 1);
+        void searchTree(Node* parent, TreeProcessor* processor);
+        void searchScope(node_vector* nodes, Node* parent);
+        void treeOrder(node_vector* nodes, node_vector* tops);
+        void treeOrder(Node* node, set<Node*>* paths, set<Node*>* hits, node_vector* result);
+        void searchNodes(const char* searchString, node_vector* result, MegaHandle cursor = UNDEF, int offset = 0, int limit = -1);
+        bool processTreesAfter(node_vector* tops, Node* after, TreeProcessor* processor);
+        void getInSharesNodes(node_vector* result, MegaHandle cursor = UNDEF, int offset = 0, int limit = -1);
+        MegaNodeList* getChildrenWindow(MegaNode* parent, int order, MegaHandle cursor, int offset, int limit);
+        static nodecomparator getNodeComparator(int order);
+        MegaNodeList* searchIndex(MegaNode* node, int attribute, int64_t min, int64_t max);
         void getNodeAttribute(MegaNode* node, int type, const char *dstFilePath, MegaRequestListener *listener = NULL);
 		void cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestListener *listener = NULL);
         void setNodeAttribute(MegaNode* node, int type, const char *srcFilePath, MegaRequestListener *listener = NULL);
@@ -0,0 +1,495 @@
+/**
+ * @file asyncdb.cpp
+ * @brief DbTable writing to another table on a dedicated thread
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+
+#ifdef THREAD_CLASS
+
+namespace mega {
+const size_t AsyncDbTable::BATCHBYTES;
+const size_t AsyncDbTable::MAXQUEUEDBYTES;
+
+AsyncDbTable::AsyncDbTable(DbTable* t)
+{
+    table = t;
+    queuedbytes = 0;
+    signaled = false;
+    busy = false;
+    flushrequested = false;
+    failed = false;
+    terminating = false;
+
+    mutex.init(false);
+    tablemutex.init(false);
+
+    thread = new THREAD_CLASS();
+    thread->start(threadentry, this);
+}
+
+AsyncDbTable::~AsyncDbTable()
+{
+    // the queue is applied before the writer terminates
+    mutex.lock();
+    terminating = true;
+    mutex.unlock();
+
+    work.release();
+
+    thread->join();
+    delete thread;
+
+    delete table;
+}
+
+void* AsyncDbTable::threadentry(void* param)
+{
+    ((AsyncDbTable*)param)->loop();
+    return NULL;
+}
+
+void AsyncDbTable::loop()
+{
+    vector<Op> batch;
+
+    for (;;)
+    {
+        work.wait();
+
+        mutex.lock();
+        batch.swap(queue);
+        queuedbytes = 0;
+        signaled = false;
+        busy = true;
+        bool skip = failed;
+        mutex.unlock();
+
+        bool ok = skip || apply(&batch);
+        batch.clear();
+
+        mutex.lock();
+        busy = false;
+
+        if (!ok)
+        {
+            failed = true;
+        }
+
+        if (flushrequested && queue.empty())
+        {
+            flushrequested = false;
+            flushed.release();
+        }
+
+        bool stop = terminating && queue.empty();
+        mutex.unlock();
+
+        if (stop)
+        {
+            return;
+        }
+    }
+}
+
+bool AsyncDbTable::apply(vector<Op>* ops)
+{
+    // all commits of the batch are merged into its last one - unless the
+    // batch aborts a transaction, which must not take earlier ones along
+    size_t last = ops->size();
+    bool aborts = false;
+
+    for (size_t i = 0; i < ops->size(); i++)
+    {
+        if ((*ops)[i].type == OP_COMMIT)
+        {
+            last = i;
+        }
+        else if ((*ops)[i].type == OP_ABORT)
+        {
+            aborts = true;
+        }
+    }
+
+    bool skipbegin = false;
+    bool ok = true;
+
+    tablemutex.lock();
+
+    for (size_t i = 0; ok && i < ops->size(); i++)
+    {
+        Op* op = &(*ops)[i];
+
+        switch (op->type)
+        {
+            case OP_PUT:
+                ok = table->put(op->id, (char*)op->data.data(), op->data.size());
+                break;
+
+            case OP_DEL:
+                ok = table->del(op->id);
+                break;
+
+            case OP_INDEXNODE:
+                ok = table->indexnode(op->id, &op->columns);
+                break;
+
+            case OP_TRUNCATE:
+                table->truncate();
+                break;
+
+            case OP_CHECKPOINT:
+                table->checkpoint();
+                break;
+
+            case OP_BEGIN:
+                // the transaction of a merged commit continues
+                if (skipbegin)
+                {
+                    skipbegin = false;
+                }
+                else
+                {
+                    table->begin();
+                }
+                break;
+
+            case OP_COMMIT:
+                if (aborts || i == last)
+                {
+                    table->commit();
+                }
+                else
+                {
+                    skipbegin = true;
+                }
+                break;
+
+            case OP_ABORT:
+                table->abort();
+                break;
+        }
+    }
+
+    if (!ok)
+    {
+        LOG_err << "Asynchronous DB write failed";
+        table->abort();
+    }
+
+    tablemutex.unlock();
+
+    return ok;
+}
+
+bool AsyncDbTable::enqueue(Op* op)
+{
+    bool wake, full;
+
+    mutex.lock();
+
+    if (failed)
+    {
+        mutex.unlock();
+        return false;
+    }
+
+    queue.push_back(Op());
+
+    Op* queued = &queue.back();
+    queued->type = op->type;
+    queued->id = op->id;
+    queued->data.swap(op->data);
+
+    if (op->type == OP_INDEXNODE)
+    {
+        queued->columns = op->columns;
+    }
+
+    queuedbytes += queued->data.size();
+
+    // wake up the writer for each commit, or if enough data is queued
+    wake = !signaled && (op->type == OP_COMMIT || op->type == OP_ABORT || queuedbytes >= BATCHBYTES);
+    full = queuedbytes >= MAXQUEUEDBYTES;
+
+    if (wake)
+    {
+        signaled = true;
+    }
+
+    mutex.unlock();
+
+    if (wake)
+    {
+        work.release();
+    }
+
+    if (full)
+    {
+        flush();
+    }
+
+    return true;
+}
+
+void AsyncDbTable::flush()
+{
+    bool wake;
+
+    mutex.lock();
+
+    if (!busy && queue.empty())
+    {
+        mutex.unlock();
+        return;
+    }
+
+    flushrequested = true;
+    wake = !signaled;
+    signaled = true;
+
+    mutex.unlock();
+
+    if (wake)
+    {
+        work.release();
+    }
+
+    flushed.wait();
+}
+
+void AsyncDbTable::rewind()
+{
+    flush();
+
+    tablemutex.lock();
+    table->rewind();
+    tablemutex.unlock();
+}
+
+bool AsyncDbTable::next(uint32_t* id, string* data)
+{
+    flush();
+
+    tablemutex.lock();
+    bool result = table->next(id, data);
+    tablemutex.unlock();
+
+    return result;
+}
+
+bool AsyncDbTable::get(uint32_t id, string* data)
+{
+    flush();
+
+    tablemutex.lock();
+    bool result = table->get(id, data);
+    tablemutex.unlock();
+
+    return result;
+}
+
+bool AsyncDbTable::put(uint32_t id, char* data, unsigned len)
+{
+    Op op;
+
+    op.type = OP_PUT;
+    op.id = id;
+    op.data.assign(data, len);
+
+    return enqueue(&op);
+}
+
+bool AsyncDbTable::del(uint32_t id)
+{
+    Op op;
+
+    op.type = OP_DEL;
+    op.id = id;
+
+    return enqueue(&op);
+}
+
+void AsyncDbTable::truncate()
+{
+    Op op;
+
+    op.type = OP_TRUNCATE;
+    op.id = 0;
+
+    enqueue(&op);
+}
+
+void AsyncDbTable::begin()
+{
+    Op op;
+
+    op.type = OP_BEGIN;
+    op.id = 0;
+
+    enqueue(&op);
+}
+
+void AsyncDbTable::commit()
+{
+    Op op;
+
+    op.type = OP_COMMIT;
+    op.id = 0;
+
+    enqueue(&op);
+}
+
+void AsyncDbTable::abort()
+{
+    Op op;
+
+    op.type = OP_ABORT;
+    op.id = 0;
+
+    enqueue(&op);
+}
+
+void AsyncDbTable::checkpoint()
+{
+    Op op;
+
+    op.type = OP_CHECKPOINT;
+    op.id = 0;
+
+    enqueue(&op);
+}
+
+void AsyncDbTable::remove()
+{
+    flush();
+
+    tablemutex.lock();
+    table->remove();
+    tablemutex.unlock();
+}
+
+bool AsyncDbTable::localpath(string* path)
+{
+    return table->localpath(path);
+}
+
+bool AsyncDbTable::mapped()
+{
+    return table->mapped();
+}
+
+// mapped records stay valid while the writer applies later writes
+bool AsyncDbTable::nextmapped(uint32_t* id, const char** data, unsigned* len)
+{
+    flush();
+
+    tablemutex.lock();
+    bool result = table->nextmapped(id, data, len);
+    tablemutex.unlock();
+
+    return result;
+}
+
+void AsyncDbTable::unmap()
+{
+    tablemutex.lock();
+    table->unmap();
+    tablemutex.unlock();
+}
+
+bool AsyncDbTable::hasnodeindex()
+{
+    flush();
+
+    tablemutex.lock();
+    bool result = table->hasnodeindex();
+    tablemutex.unlock();
+
+    return result;
+}
+
+// schema change: applied in order with the queued writes, but synchronously
+void AsyncDbTable::createnodeindex()
+{
+    flush();
+
+    tablemutex.lock();
+    table->createnodeindex();
+    tablemutex.unlock();
+}
+
+bool AsyncDbTable::indexnode(uint32_t id, const DbNodeColumns* columns)
+{
+    Op op;
+
+    op.type = OP_INDEXNODE;
+    op.id = id;
+    op.columns = *columns;
+
+    return enqueue(&op);
+}
+
+bool AsyncDbTable::getnode(handle h, uint32_t* id)
+{
+    flush();
+
+    tablemutex.lock();
+    bool result = table->getnode(h, id);
+    tablemutex.unlock();
+
+    return result;
+}
+
+bool AsyncDbTable::getchildnodes(handle ph, handle_vector* handles)
+{
+    flush();
+
+    tablemutex.lock();
+    bool result = table->getchildnodes(ph, handles);
+    tablemutex.unlock();
+
+    return result;
+}
+
+bool AsyncDbTable::getchildnodesbyname(handle ph, uint64_t namehash, handle_vector* handles)
+{
+    flush();
+
+    tablemutex.lock();
+    bool result = table->getchildnodesbyname(ph, namehash, handles);
+    tablemutex.unlock();
+
+    return result;
+}
+
+bool AsyncDbTable::getnodesbyfingerprint(m_off_t size, m_time_t mtime, uint64_t fingerprint, handle_vector* handles)
+{
+    flush();
+
+    tablemutex.lock();
+    bool result = table->getnodesbyfingerprint(size, mtime, fingerprint, handles);
+    tablemutex.unlock();
+
+    return result;
+}
+
+} // namespace
+
+#endif
@@ -147,6 +147,75 @@ const char* AttrMap::unserialize(const char* ptr , const char *end)
     return ptr;
 }
 
+const char* AttrMap::skip(const char* ptr, const char* end)
+{
+    unsigned char l;
+    unsigned short ll;
+
+    while ((ptr < end) && (l = *ptr++))
+    {
+        if (ptr + l + sizeof ll > end)
+        {
+            return NULL;
+        }
+
+        ptr += l;
+        ll = MemAccess::get<short>(ptr);
+        ptr += sizeof ll;
+
+        if (ptr + ll > end)
+        {
+            return NULL;
+        }
+
+        ptr += ll;
+    }
+
+    return ptr;
+}
+
+bool AttrMap::find(const string* d, nameid name, string* value)
+{
+    const char* ptr = d->data();
+    const char* end = ptr + d->size();
+    unsigned char l;
+    unsigned short ll;
+    nameid id;
+
+    while ((ptr < end) && (l = *ptr++))
+    {
+        id = 0;
+
+        if (ptr + l + sizeof ll > end)
+        {
+            return false;
+        }
+
+        while (l--)
+        {
+            id = (id << 8) + (unsigned char)*ptr++;
+        }
+
+        ll = MemAccess::get<short>(ptr);
+        ptr += sizeof ll;
+
+        if (ptr + ll > end)
+        {
+            return false;
+        }
+
+        if (id == name)
+        {
+            value->assign(ptr, ll);
+            return true;
+        }
+
+        ptr += ll;
+    }
+
+    return false;
+}
+
 // generate JSON object containing attr_map
 void AttrMap::getjson(string* s) const
 {
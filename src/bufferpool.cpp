@@ -0,0 +1,338 @@
+/**
+ * @file bufferpool.cpp
+ * @brief Process-wide pool of transfer buffers with a memory budget
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+namespace mega {
+const size_t TransferBufferPool::ALIGNMENT;
+
+m_off_t TransferBufferPool::configuredbudget = 0;
+m_off_t TransferBufferPool::currentbudget = 0;
+m_off_t TransferBufferPool::allocatedbytes = 0;
+int TransferBufferPool::connections = 0;
+unsigned TransferBufferPool::changes = 0;
+multimap<size_t, byte*> TransferBufferPool::idle;
+map<byte*, size_t> TransferBufferPool::sizes;
+
+#ifdef THREAD_CLASS
+static MUTEX_CLASS poolmutex(false);
+
+#define POOL_LOCK poolmutex.lock()
+#define POOL_UNLOCK poolmutex.unlock()
+#else
+#define POOL_LOCK
+#define POOL_UNLOCK
+#endif
+
+// buffer sizes are rounded up to limit fragmentation and improve reuse
+static size_t granule(size_t size)
+{
+    size_t g = size < 1048576 ? 131072 : 1048576;
+
+    return (size + g - 1) / g * g;
+}
+
+static byte* alignedalloc(size_t size)
+{
+#ifdef _WIN32
+    return (byte*)_aligned_malloc(size, TransferBufferPool::ALIGNMENT);
+#else
+    void* p;
+
+    if (posix_memalign(&p, TransferBufferPool::ALIGNMENT, size))
+    {
+        return NULL;
+    }
+
+    return (byte*)p;
+#endif
+}
+
+static void alignedfree(byte* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// a quarter of the free memory, between 8 MB and 32 MB (mobile) or
+// 256 MB (desktop)
+m_off_t TransferBufferPool::defaultbudget()
+{
+#if defined(__ANDROID__) || defined(USE_IOS) || defined(WINDOWS_PHONE)
+    m_off_t budget = 32 * 1048576;
+#else
+    m_off_t budget = 256 * 1048576;
+#endif
+    m_off_t freemem = 0;
+
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+    MEMORYSTATUSEX statex;
+    memset(&statex, 0, sizeof (statex));
+    statex.dwLength = sizeof (statex);
+    if (GlobalMemoryStatusEx(&statex))
+    {
+        freemem = statex.ullAvailPhys;
+    }
+#elif defined(_SC_AVPHYS_PAGES)
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    long pagesize = sysconf(_SC_PAGESIZE);
+
+    if (pages > 0 && pagesize > 0)
+    {
+        freemem = (m_off_t)pages * pagesize;
+    }
+#endif
+
+    if (freemem)
+    {
+        LOG_debug << "Free memory for transfer buffers: " << freemem;
+
+        if (budget > freemem / 4)
+        {
+            budget = freemem / 4;
+        }
+    }
+
+    if (budget < 8 * 1048576)
+    {
+        budget = 8 * 1048576;
+    }
+
+    return budget;
+}
+
+void TransferBufferPool::initbudget()
+{
+    if (!currentbudget)
+    {
+        currentbudget = configuredbudget ? configuredbudget : defaultbudget();
+        LOG_debug << "Transfer memory budget: " << currentbudget;
+    }
+}
+
+void TransferBufferPool::setbudget(m_off_t budget)
+{
+    POOL_LOCK;
+
+    configuredbudget = budget > 0 ? budget : 0;
+    currentbudget = 0;
+    initbudget();
+
+    // buffers in use are returned to the pool as usual and freed then
+    trim(currentbudget);
+
+    POOL_UNLOCK;
+}
+
+m_off_t TransferBufferPool::getbudget()
+{
+    POOL_LOCK;
+    initbudget();
+    m_off_t budget = currentbudget;
+    POOL_UNLOCK;
+
+    return budget;
+}
+
+void TransferBufferPool::addconnections(int count)
+{
+    POOL_LOCK;
+
+    if (!connections && count > 0 && !configuredbudget)
+    {
+        // the free memory is checked again when transfers resume
+        currentbudget = 0;
+    }
+
+    connections += count;
+
+    if (connections <= 0)
+    {
+        connections = 0;
+        trim(0);
+    }
+
+    POOL_UNLOCK;
+}
+
+m_off_t TransferBufferPool::share()
+{
+    POOL_LOCK;
+    initbudget();
+    m_off_t s = currentbudget / (connections > 1 ? connections : 1);
+    POOL_UNLOCK;
+
+    return s;
+}
+
+byte* TransferBufferPool::alloc(size_t size, size_t* actual, bool force)
+{
+    byte* buf = NULL;
+    size_t bufsize = granule(size ? size : 1);
+
+    POOL_LOCK;
+    initbudget();
+
+    // reuse the smallest idle buffer that is large enough, unless it would
+    // waste more than the requested size
+    multimap<size_t, byte*>::iterator it = idle.lower_bound(bufsize);
+
+    if (it != idle.end() && it->first / 2 <= bufsize)
+    {
+        buf = it->second;
+        bufsize = it->first;
+        idle.erase(it);
+    }
+    else
+    {
+        trim(currentbudget - (m_off_t)bufsize);
+
+        // a single buffer is always allowed so that transfers progress
+        if (force || !allocatedbytes || allocatedbytes + (m_off_t)bufsize <= currentbudget)
+        {
+            if ((buf = alignedalloc(bufsize)))
+            {
+                sizes[buf] = bufsize;
+                allocatedbytes += bufsize;
+                changes++;
+            }
+        }
+    }
+
+    POOL_UNLOCK;
+
+    if (buf && actual)
+    {
+        *actual = bufsize;
+    }
+
+    return buf;
+}
+
+void TransferBufferPool::release(byte* buf)
+{
+    if (!buf)
+    {
+        return;
+    }
+
+    POOL_LOCK;
+
+    map<byte*, size_t>::iterator it = sizes.find(buf);
+
+    if (it != sizes.end())
+    {
+        idle.insert(pair<size_t, byte*>(it->second, buf));
+
+        // without active connections or above a reduced budget, keep nothing
+        trim(connections ? currentbudget : 0);
+    }
+    else
+    {
+        LOG_err << "Unknown transfer buffer released";
+    }
+
+    POOL_UNLOCK;
+}
+
+bool TransferBufferPool::charge(m_off_t bytes, bool force)
+{
+    bool charged = false;
+
+    POOL_LOCK;
+    initbudget();
+    trim(currentbudget - bytes);
+
+    // as for buffers, the first charge is always granted
+    if (force || !allocatedbytes || allocatedbytes + bytes <= currentbudget)
+    {
+        allocatedbytes += bytes;
+        charged = true;
+    }
+
+    POOL_UNLOCK;
+
+    return charged;
+}
+
+void TransferBufferPool::uncharge(m_off_t bytes)
+{
+    POOL_LOCK;
+    allocatedbytes -= bytes;
+    POOL_UNLOCK;
+}
+
+m_off_t TransferBufferPool::allocated()
+{
+    POOL_LOCK;
+    m_off_t a = allocatedbytes;
+    POOL_UNLOCK;
+
+    return a;
+}
+
+unsigned TransferBufferPool::generation()
+{
+    POOL_LOCK;
+    unsigned g = changes;
+    POOL_UNLOCK;
+
+    return g;
+}
+
+unsigned TransferBufferPool::buffers(vector<pair<byte*, size_t> >* result)
+{
+    POOL_LOCK;
+
+    result->assign(sizes.begin(), sizes.end());
+    unsigned g = changes;
+
+    POOL_UNLOCK;
+
+    return g;
+}
+
+// largest idle buffers go first
+void TransferBufferPool::trim(m_off_t limit)
+{
+    while (allocatedbytes > limit && !idle.empty())
+    {
+        multimap<size_t, byte*>::iterator it = idle.end();
+        it--;
+
+        sizes.erase(it->second);
+        allocatedbytes -= it->first;
+        alignedfree(it->second);
+        idle.erase(it);
+        changes++;
+    }
+}
+} // namespace
@@ -0,0 +1,272 @@
+/**
+ * @file cacheloader.cpp
+ * @brief Parallel decoding of the local cache at startup
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+
+#ifdef THREAD_CLASS
+
+namespace mega {
+const size_t CacheLoader::BATCHSIZE;
+const int CacheLoader::MAXBATCHES;
+const size_t CacheLoader::JOBRECORDS;
+
+CacheLoader::Batch::~Batch()
+{
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        delete records[i].node;
+    }
+}
+
+CacheLoader::CacheLoader(DbTable* ctable, SymmCipher* ckey, const FileSystemAccess* cfsaccess, WorkerPool* cpool)
+{
+    table = ctable;
+    key = ckey->key;
+    fsaccess = cfsaccess;
+    pool = cpool;
+    mapped = table->mapped();
+    finished = false;
+    aborted = false;
+
+    mutex.init(false);
+
+    for (int i = MAXBATCHES; i--; )
+    {
+        slots.release();
+    }
+
+    reader.start(readerentry, this);
+}
+
+CacheLoader::~CacheLoader()
+{
+    mutex.lock();
+    aborted = true;
+    mutex.unlock();
+
+    // the reader may be waiting for a free slot
+    slots.release();
+    reader.join();
+
+    for (deque<Batch*>::iterator it = batches.begin(); it != batches.end(); it++)
+    {
+        delete *it;
+    }
+
+    for (deque<Batch*>::iterator it = decoded.begin(); it != decoded.end(); it++)
+    {
+        delete *it;
+    }
+
+    if (mapped)
+    {
+        table->unmap();
+    }
+}
+
+void* CacheLoader::readerentry(void* param)
+{
+    ((CacheLoader*)param)->read();
+    return NULL;
+}
+
+void CacheLoader::read()
+{
+    Batch* batch = NULL;
+    bool more = true;
+
+    while (more)
+    {
+        if (!batch)
+        {
+            slots.wait();
+
+            mutex.lock();
+            more = !aborted;
+            mutex.unlock();
+
+            if (!more)
+            {
+                break;
+            }
+
+            batch = new Batch;
+            batch->records.reserve(BATCHSIZE);
+        }
+
+        batch->records.resize(batch->records.size() + 1);
+        Record& r = batch->records.back();
+
+        // mapped records are copied by the decoder, straight into the
+        // buffer it decrypts
+        r.mapped = NULL;
+
+        if ((more = mapped ? table->nextencrypted(&r.id, &r.mapped, &r.mappedlen)
+                           : table->nextencrypted(&r.id, &r.data)))
+        {
+            r.decrypted = false;
+            r.node = NULL;
+        }
+        else
+        {
+            batch->records.pop_back();
+        }
+
+        if (batch->records.size() == BATCHSIZE || (!more && batch->records.size()))
+        {
+            mutex.lock();
+            batches.push_back(batch);
+            mutex.unlock();
+
+            ready.release();
+            batch = NULL;
+        }
+    }
+
+    delete batch;
+
+    mutex.lock();
+    finished = true;
+    mutex.unlock();
+
+    // the engine thread may be waiting for more batches
+    ready.release();
+}
+
+void CacheLoader::decodejob(void* context, size_t index)
+{
+    CacheLoader* loader = (CacheLoader*)context;
+    size_t end = (index + 1) * JOBRECORDS;
+    SymmCipher cipher;
+
+    cipher.setkey(loader->key);
+
+    if (end > loader->decoding.size())
+    {
+        end = loader->decoding.size();
+    }
+
+    for (size_t i = index * JOBRECORDS; i < end; i++)
+    {
+        loader->decode(loader->decoding[i], &cipher);
+    }
+}
+
+void CacheLoader::decode(Record* r, SymmCipher* cipher)
+{
+    if (r->mapped)
+    {
+        r->data.assign(r->mapped, r->mappedlen);
+    }
+
+    if ((r->decrypted = DbTable::decrypt(r->id, &r->data, cipher))
+            && (r->id & 15) == MegaClient::CACHEDNODE)
+    {
+        r->node = new NodeRecord;
+
+        if (!Node::parse(fsaccess, &r->data, r->node))
+        {
+            // leave the error handling to the engine thread
+            delete r->node;
+            r->node = NULL;
+        }
+    }
+}
+
+CacheLoader::Batch* CacheLoader::next()
+{
+    if (decoded.empty())
+    {
+        // wait for the reader, then decode all batches read so far
+        for (;;)
+        {
+            mutex.lock();
+            decoded.swap(batches);
+            bool done = finished;
+            mutex.unlock();
+
+            if (decoded.size())
+            {
+                break;
+            }
+
+            if (done)
+            {
+                return NULL;
+            }
+
+            ready.wait();
+        }
+
+        for (deque<Batch*>::iterator it = decoded.begin(); it != decoded.end(); it++)
+        {
+            for (size_t i = 0; i < (*it)->records.size(); i++)
+            {
+                decoding.push_back(&(*it)->records[i]);
+            }
+        }
+
+        size_t jobs = (decoding.size() + JOBRECORDS - 1) / JOBRECORDS;
+
+        if (pool)
+        {
+            // the batches are only touched by the jobs until run() returns
+            pool->run(decodejob, this, jobs);
+        }
+        else
+        {
+            for (size_t i = 0; i < jobs; i++)
+            {
+                decodejob(this, i);
+            }
+        }
+
+        decoding.clear();
+    }
+
+    Batch* batch = decoded.front();
+    decoded.pop_front();
+    slots.release();
+
+    return batch;
+}
+
+bool CacheLoader::readdone()
+{
+    mutex.lock();
+    bool done = finished;
+    mutex.unlock();
+
+    return done;
+}
+
+bool CacheLoader::decodedone()
+{
+    // batches are decoded as soon as the engine thread takes them over
+    mutex.lock();
+    bool done = finished && batches.empty();
+    mutex.unlock();
+
+    return done;
+}
+} // namespace
+
+#endif
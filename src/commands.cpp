@@ -89,10 +89,10 @@ void HttpReqCommandPutFA::procresult()
                 Base64::btoa((const byte*)&client->me, MegaClient::USERHANDLE, me64);
 
                 if (n && client->checkaccess(n, FULL) &&
-                        (n->attrs.map.find('f') == n->attrs.map.end() || n->attrs.map['f'] != me64) )
+                        (n->attrs().map.find('f') == n->attrs().map.end() || n->attrs().map['f'] != me64) )
                 {
                     LOG_debug << "Restoration of file attributes is not allowed for current user (" << me64 << ").";
-                    n->attrs.map['f'] = me64;
+                    n->attrs().map['f'] = me64;
 
                     int creqtag = client->reqtag;
                     client->reqtag = 0;
@@ -688,7 +688,7 @@ void CommandGetFile::procresult()
                                                 Node *n = client->nodebyhandle(ph);
                                                 if (n)
                                                 {
-                                                    n->size = s;
+                                                    n->setsize(s);
                                                     client->notifynode(n);
                                                 }
                                             }
@@ -778,7 +778,7 @@ CommandSetAttr::CommandSetAttr(MegaClient* client, Node* n, SymmCipher* cipher,
 
     string at;
 
-    n->attrs.getjson(&at);
+    n->attrs().getjson(&at);
     client->makeattr(cipher, &at, at.c_str(), at.size());
 
     arg("n", (byte*)&n->nodehandle, MegaClient::NODEHANDLE);
@@ -3872,6 +3872,7 @@ void CommandFetchNodes::procresult()
 {
     WAIT_CLASS::bumpds();
     client->fnstats.timeToLastByte = Waiter::ds - client->fnstats.startTime;
+    client->fnstats.timeToDecoded = client->fnstats.timeToLastByte;
 
     client->purgenodesusersabortsc();
 
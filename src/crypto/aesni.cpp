@@ -0,0 +1,485 @@
+/**
+ * @file aesni.cpp
+ * @brief AES-128 CTR/CBC-MAC kernel using the AES-NI instructions
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+
+#ifdef USE_AESNI
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AESNI_TARGET
+#else
+#include <cpuid.h>
+#define AESNI_TARGET __attribute__((target("aes,ssse3")))
+#endif
+
+namespace mega {
+const int AesNi::ROUNDKEYSLENGTH;
+const unsigned AesNi::LANES;
+
+static const int ROUNDS = 10;
+
+// keystream blocks computed together
+static const unsigned CTRBLOCKS = 8;
+
+// blocks of each lane processed by a pass of ctr_crypt(CtrChunk*) (the
+// window of all lanes fits into the L1 cache)
+static const unsigned WINDOWBLOCKS = 128;
+
+// AES-NI and SSSE3 (the byte shuffle of the counter blocks)
+bool AesNi::available()
+{
+    // concurrent first calls compute the same result
+    static int aesni = -1;
+
+    if (aesni < 0)
+    {
+#ifdef _MSC_VER
+        int info[4];
+
+        __cpuid(info, 1);
+        aesni = (info[2] >> 25) & (info[2] >> 9) & 1;
+#else
+        unsigned a, b, c, d;
+
+        aesni = __get_cpuid(1, &a, &b, &c, &d) && (c & bit_AES) && (c & bit_SSSE3);
+#endif
+    }
+
+    return aesni > 0;
+}
+
+template<int rcon>
+static inline AESNI_TARGET __m128i expandround(__m128i k)
+{
+    __m128i t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k, rcon), 0xff);
+
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+
+    return _mm_xor_si128(k, t);
+}
+
+AESNI_TARGET void AesNi::expandkey(const byte* key, byte* roundkeys)
+{
+    __m128i rk[ROUNDS + 1];
+
+    rk[0] = _mm_loadu_si128((const __m128i*)key);
+    rk[1] = expandround<0x01>(rk[0]);
+    rk[2] = expandround<0x02>(rk[1]);
+    rk[3] = expandround<0x04>(rk[2]);
+    rk[4] = expandround<0x08>(rk[3]);
+    rk[5] = expandround<0x10>(rk[4]);
+    rk[6] = expandround<0x20>(rk[5]);
+    rk[7] = expandround<0x40>(rk[6]);
+    rk[8] = expandround<0x80>(rk[7]);
+    rk[9] = expandround<0x1b>(rk[8]);
+    rk[10] = expandround<0x36>(rk[9]);
+
+    for (int i = 0; i <= ROUNDS; i++)
+    {
+        _mm_storeu_si128((__m128i*)(roundkeys + i * 16), rk[i]);
+    }
+}
+
+// encrypt N (up to 8) independent blocks, round by round - the blocks
+// are kept in registers (also used with the MAC chains of maclanes())
+#define AESNI_ROUND(op, k) \
+    x0 = op(x0, k); \
+    if (N > 1) x1 = op(x1, k); \
+    if (N > 2) x2 = op(x2, k); \
+    if (N > 3) x3 = op(x3, k); \
+    if (N > 4) x4 = op(x4, k); \
+    if (N > 5) x5 = op(x5, k); \
+    if (N > 6) x6 = op(x6, k); \
+    if (N > 7) x7 = op(x7, k);
+
+template<unsigned N>
+static inline AESNI_TARGET void encryptblocks(const __m128i* rk, __m128i* b)
+{
+    __m128i x0 = b[0];
+    __m128i x1 = N > 1 ? b[1 % N] : x0;
+    __m128i x2 = N > 2 ? b[2 % N] : x0;
+    __m128i x3 = N > 3 ? b[3 % N] : x0;
+    __m128i x4 = N > 4 ? b[4 % N] : x0;
+    __m128i x5 = N > 5 ? b[5 % N] : x0;
+    __m128i x6 = N > 6 ? b[6 % N] : x0;
+    __m128i x7 = N > 7 ? b[7 % N] : x0;
+
+    AESNI_ROUND(_mm_xor_si128, rk[0]);
+
+    for (int r = 1; r < ROUNDS; r++)
+    {
+        AESNI_ROUND(_mm_aesenc_si128, rk[r]);
+    }
+
+    AESNI_ROUND(_mm_aesenclast_si128, rk[ROUNDS]);
+
+    b[0] = x0;
+    if (N > 1) b[1 % N] = x1;
+    if (N > 2) b[2 % N] = x2;
+    if (N > 3) b[3 % N] = x3;
+    if (N > 4) b[4 % N] = x4;
+    if (N > 5) b[5 % N] = x5;
+    if (N > 6) b[6 % N] = x6;
+    if (N > 7) b[7 % N] = x7;
+}
+
+static inline AESNI_TARGET void encryptblocks(const __m128i* rk, __m128i* b, unsigned n)
+{
+    switch (n)
+    {
+        case 1: encryptblocks<1>(rk, b); break;
+        case 2: encryptblocks<2>(rk, b); break;
+        case 3: encryptblocks<3>(rk, b); break;
+        case 4: encryptblocks<4>(rk, b); break;
+        case 5: encryptblocks<5>(rk, b); break;
+        case 6: encryptblocks<6>(rk, b); break;
+        case 7: encryptblocks<7>(rk, b); break;
+        case 8: encryptblocks<8>(rk, b); break;
+    }
+}
+
+static inline AESNI_TARGET __m128i encryptblock(const __m128i* rk, __m128i b)
+{
+    encryptblocks<1>(rk, &b);
+    return b;
+}
+
+// counters are kept as the IV and the block index, in native byte order
+static inline AESNI_TARGET __m128i counter(uint64_t ctriv, uint64_t index)
+{
+    return _mm_set_epi32((int)(index >> 32), (int)index, (int)(ctriv >> 32), (int)ctriv);
+}
+
+static inline AESNI_TARGET __m128i nextcounter(__m128i ctr)
+{
+    return _mm_add_epi64(ctr, _mm_set_epi32(0, 1, 0, 0));
+}
+
+// counter block: the IV, followed by the big-endian block index
+static inline AESNI_TARGET __m128i ctrblock(__m128i ctr)
+{
+    return _mm_shuffle_epi8(ctr, _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+// the initial MAC: the IV, twice
+static inline AESNI_TARGET __m128i initialmac(uint64_t ctriv)
+{
+    return _mm_set_epi32((int)(ctriv >> 32), (int)ctriv, (int)(ctriv >> 32), (int)ctriv);
+}
+
+// MAC input of a decrypted block (zero-padded if partial)
+static inline AESNI_TARGET __m128i macblock(const byte* data, unsigned len)
+{
+    if (len >= 16)
+    {
+        return _mm_loadu_si128((const __m128i*)data);
+    }
+
+    byte block[16] = { 0 };
+
+    memcpy(block, data, len);
+
+    return _mm_loadu_si128((const __m128i*)block);
+}
+
+// en-/decrypt a range, advancing the MAC (if any) - whole blocks are
+// written, as with SymmCipher::ctr_crypt()
+static AESNI_TARGET void cryptrange(const __m128i* rk, byte* data, unsigned len, __m128i ctr,
+                                    __m128i* mac, bool encrypt)
+{
+    __m128i ks[CTRBLOCKS];
+    __m128i m = _mm_setzero_si128();
+
+    if (mac)
+    {
+        m = *mac;
+    }
+
+    // the keystream blocks are independent of each other and of the MAC
+    // chain, which runs alongside
+    while (len >= CTRBLOCKS * 16)
+    {
+        for (unsigned i = 0; i < CTRBLOCKS; i++)
+        {
+            ks[i] = ctrblock(ctr);
+            ctr = nextcounter(ctr);
+        }
+
+        encryptblocks<CTRBLOCKS>(rk, ks);
+
+        for (unsigned i = 0; i < CTRBLOCKS; i++)
+        {
+            __m128i* block = (__m128i*)(data + i * 16);
+            __m128i d = _mm_loadu_si128(block);
+
+            if (mac && encrypt)
+            {
+                m = encryptblock(rk, _mm_xor_si128(m, d));
+            }
+
+            d = _mm_xor_si128(d, ks[i]);
+            _mm_storeu_si128(block, d);
+
+            if (mac && !encrypt)
+            {
+                m = encryptblock(rk, _mm_xor_si128(m, d));
+            }
+        }
+
+        data += CTRBLOCKS * 16;
+        len -= CTRBLOCKS * 16;
+    }
+
+    while (len)
+    {
+        unsigned blocklen = len < 16 ? len : 16;
+        __m128i* block = (__m128i*)data;
+        __m128i d = _mm_loadu_si128(block);
+
+        if (mac && encrypt)
+        {
+            m = encryptblock(rk, _mm_xor_si128(m, d));
+        }
+
+        d = _mm_xor_si128(d, encryptblock(rk, ctrblock(ctr)));
+        _mm_storeu_si128(block, d);
+
+        if (mac && !encrypt)
+        {
+            m = encryptblock(rk, _mm_xor_si128(m, macblock(data, blocklen)));
+        }
+
+        data += 16;
+        len -= blocklen;
+        ctr = nextcounter(ctr);
+    }
+
+    if (mac)
+    {
+        *mac = m;
+    }
+}
+
+static inline AESNI_TARGET void loadroundkeys(const byte* roundkeys, __m128i* rk)
+{
+    for (int i = 0; i <= ROUNDS; i++)
+    {
+        rk[i] = _mm_loadu_si128((const __m128i*)(roundkeys + i * 16));
+    }
+}
+
+AESNI_TARGET void AesNi::ctr_crypt(const byte* roundkeys, byte* data, unsigned len, m_off_t pos,
+                                   uint64_t ctriv, byte* mac, bool encrypt, bool initmac)
+{
+    __m128i rk[ROUNDS + 1];
+    __m128i m = _mm_setzero_si128();
+
+    loadroundkeys(roundkeys, rk);
+
+    if (mac)
+    {
+        m = initmac ? initialmac(ctriv) : _mm_loadu_si128((const __m128i*)mac);
+    }
+
+    cryptrange(rk, data, len, counter(ctriv, pos / 16), mac ? &m : NULL, encrypt);
+
+    if (mac)
+    {
+        _mm_storeu_si128((__m128i*)mac, m);
+    }
+}
+
+// advance L CBC-MAC chains by the given number of blocks, interleaved
+// round by round
+template<unsigned L>
+static inline AESNI_TARGET void maclanes(const __m128i* rk, byte* const* data, __m128i* m, unsigned blocks)
+{
+    const unsigned N = L;
+    __m128i x0 = m[0];
+    __m128i x1 = L > 1 ? m[1 % L] : x0;
+    __m128i x2 = L > 2 ? m[2 % L] : x0;
+    __m128i x3 = L > 3 ? m[3 % L] : x0;
+    __m128i x4 = L > 4 ? m[4 % L] : x0;
+    __m128i x5 = L > 5 ? m[5 % L] : x0;
+    __m128i x6 = L > 6 ? m[6 % L] : x0;
+    __m128i x7 = L > 7 ? m[7 % L] : x0;
+
+#define AESNI_INPUT(l) _mm_loadu_si128((const __m128i*)(data[(l) % L] + i))
+    for (unsigned i = 0; i < blocks * 16; i += 16)
+    {
+        x0 = _mm_xor_si128(x0, AESNI_INPUT(0));
+        if (L > 1) x1 = _mm_xor_si128(x1, AESNI_INPUT(1));
+        if (L > 2) x2 = _mm_xor_si128(x2, AESNI_INPUT(2));
+        if (L > 3) x3 = _mm_xor_si128(x3, AESNI_INPUT(3));
+        if (L > 4) x4 = _mm_xor_si128(x4, AESNI_INPUT(4));
+        if (L > 5) x5 = _mm_xor_si128(x5, AESNI_INPUT(5));
+        if (L > 6) x6 = _mm_xor_si128(x6, AESNI_INPUT(6));
+        if (L > 7) x7 = _mm_xor_si128(x7, AESNI_INPUT(7));
+
+        AESNI_ROUND(_mm_xor_si128, rk[0]);
+
+        for (int r = 1; r < ROUNDS; r++)
+        {
+            AESNI_ROUND(_mm_aesenc_si128, rk[r]);
+        }
+
+        AESNI_ROUND(_mm_aesenclast_si128, rk[ROUNDS]);
+    }
+#undef AESNI_INPUT
+
+    m[0] = x0;
+    if (L > 1) m[1 % L] = x1;
+    if (L > 2) m[2 % L] = x2;
+    if (L > 3) m[3 % L] = x3;
+    if (L > 4) m[4 % L] = x4;
+    if (L > 5) m[5 % L] = x5;
+    if (L > 6) m[6 % L] = x6;
+    if (L > 7) m[7 % L] = x7;
+}
+
+static inline AESNI_TARGET void maclanes(const __m128i* rk, byte* const* data, __m128i* m, unsigned blocks, unsigned n)
+{
+    switch (n)
+    {
+        case 1: maclanes<1>(rk, data, m, blocks); break;
+        case 2: maclanes<2>(rk, data, m, blocks); break;
+        case 3: maclanes<3>(rk, data, m, blocks); break;
+        case 4: maclanes<4>(rk, data, m, blocks); break;
+        case 5: maclanes<5>(rk, data, m, blocks); break;
+        case 6: maclanes<6>(rk, data, m, blocks); break;
+        case 7: maclanes<7>(rk, data, m, blocks); break;
+        case 8: maclanes<8>(rk, data, m, blocks); break;
+    }
+}
+
+// the chunks are taken LANES at a time and processed a window of blocks
+// after the other: the keystream of each lane is applied eight blocks at a
+// time, and the MACs of all lanes are advanced together (before the
+// encryption or after the decryption, while the window is still cached).
+// A lane left with less than a block is finished on its own and replaced
+// by the next chunk. The last chunk of all runs through cryptrange().
+AESNI_TARGET void AesNi::ctr_crypt(const byte* roundkeys, CtrChunk* chunks, unsigned n,
+                                   uint64_t ctriv, bool encrypt)
+{
+    struct Lane
+    {
+        unsigned len;
+        __m128i ctr;
+        CtrChunk* chunk;
+    };
+
+    __m128i rk[ROUNDS + 1];
+    __m128i m[LANES];
+    byte* data[LANES];
+    Lane lanes[LANES];
+    unsigned active = 0;
+    unsigned next = 0;
+
+    loadroundkeys(roundkeys, rk);
+
+    for (;;)
+    {
+        while (active < LANES && next < n)
+        {
+            CtrChunk* c = chunks + next++;
+
+            data[active] = c->data;
+            lanes[active].len = c->len;
+            lanes[active].ctr = counter(ctriv, c->pos / 16);
+            lanes[active].chunk = c;
+            m[active] = c->initmac ? initialmac(ctriv) : _mm_loadu_si128((const __m128i*)c->mac);
+            active++;
+        }
+
+        if (!active)
+        {
+            break;
+        }
+
+        if (active == 1 && next == n)
+        {
+            cryptrange(rk, data[0], lanes[0].len, lanes[0].ctr, m, encrypt);
+            _mm_storeu_si128((__m128i*)lanes[0].chunk->mac, m[0]);
+            break;
+        }
+
+        // whole blocks left in every lane
+        unsigned blocks = WINDOWBLOCKS;
+
+        for (unsigned l = 0; l < active; l++)
+        {
+            if (lanes[l].len / 16 < blocks)
+            {
+                blocks = lanes[l].len / 16;
+            }
+        }
+
+        if (blocks)
+        {
+            if (encrypt)
+            {
+                maclanes(rk, data, m, blocks, active);
+            }
+
+            for (unsigned l = 0; l < active; l++)
+            {
+                cryptrange(rk, data[l], blocks * 16, lanes[l].ctr, NULL, encrypt);
+            }
+
+            if (!encrypt)
+            {
+                maclanes(rk, data, m, blocks, active);
+            }
+
+            for (unsigned l = 0; l < active; l++)
+            {
+                data[l] += blocks * 16;
+                lanes[l].len -= blocks * 16;
+                lanes[l].ctr = _mm_add_epi64(lanes[l].ctr, _mm_set_epi32(0, (int)blocks, 0, 0));
+            }
+        }
+
+        // finish the lanes without a whole block left
+        for (unsigned l = active; l--; )
+        {
+            if (lanes[l].len < 16)
+            {
+                cryptrange(rk, data[l], lanes[l].len, lanes[l].ctr, m + l, encrypt);
+                _mm_storeu_si128((__m128i*)lanes[l].chunk->mac, m[l]);
+
+                active--;
+                data[l] = data[active];
+                lanes[l] = lanes[active];
+                m[l] = m[active];
+            }
+        }
+    }
+}
+} // namespace
+
+#endif
@@ -76,6 +76,13 @@ void SymmCipher::setkey(const byte* newkey, int type)
 
     aesgcm_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
     aesgcm_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+
+#ifdef USE_AESNI
+    if ((aesni = AesNi::available()))
+    {
+        AesNi::expandkey(key, aesnikeys);
+    }
+#endif
 }
 
 bool SymmCipher::setkey(const string* key)
@@ -268,6 +275,14 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
 {
     assert(!(pos & (KEYLENGTH - 1)));
 
+#ifdef USE_AESNI
+    if (aesni)
+    {
+        AesNi::ctr_crypt(aesnikeys, data, len, pos, ctriv, mac, encrypt, initmac);
+        return;
+    }
+#endif
+
     byte ctr[BLOCKSIZE], tmp[BLOCKSIZE];
 
     MemAccess::set<int64_t>(ctr,ctriv);
@@ -319,6 +334,22 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
     }
 }
 
+void SymmCipher::ctr_crypt_chunks(CtrChunk* chunks, unsigned n, ctr_iv ctriv, bool encrypt)
+{
+#ifdef USE_AESNI
+    if (aesni)
+    {
+        AesNi::ctr_crypt(aesnikeys, chunks, n, ctriv, encrypt);
+        return;
+    }
+#endif
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        ctr_crypt(chunks[i].data, chunks[i].len, chunks[i].pos, ctriv, chunks[i].mac, encrypt, chunks[i].initmac);
+    }
+}
+
 static void rsaencrypt(Integer* key, Integer* m)
 {
     *m = a_exp_b_mod_c(*m, key[AsymmCipher::PUB_E], key[AsymmCipher::PUB_PQ]);
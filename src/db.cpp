@@ -60,25 +60,51 @@ bool DbTable::put(uint32_t type, Cachable* record, SymmCipher* key)
 
 // get next record, decrypt and unpad
 bool DbTable::next(uint32_t* type, string* data, SymmCipher* key)
+{
+    return nextencrypted(type, data) && decrypt(*type, data, key);
+}
+
+// get next record and keep track of the highest id in use
+bool DbTable::nextencrypted(uint32_t* type, string* data)
 {
     if (next(type, data))
     {
-        if (!*type)
+        if (*type > nextid)
         {
-            return true;
+            nextid = *type & - IDSPACING;
         }
 
+        return true;
+    }
+
+    return false;
+}
+
+bool DbTable::nextencrypted(uint32_t* type, const char** data, unsigned* len)
+{
+    if (nextmapped(type, data, len))
+    {
         if (*type > nextid)
         {
             nextid = *type & - IDSPACING;
         }
 
-        return PaddedCBC::decrypt(data, key);
+        return true;
     }
 
     return false;
 }
 
+bool DbTable::decrypt(uint32_t type, string* data, SymmCipher* key)
+{
+    if (!type)
+    {
+        return true;
+    }
+
+    return PaddedCBC::decrypt(data, key);
+}
+
 DbAccess::DbAccess()
 {
     currentDbVersion = LEGACY_DB_VERSION;
@@ -0,0 +1,752 @@
+/**
+ * @file lmdb.cpp
+ * @brief LMDB DB access layer
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+
+#ifdef USE_LMDB
+namespace mega {
+LmdbDbAccess::LmdbDbAccess(string* path)
+{
+    if (path)
+    {
+        dbpath = *path;
+    }
+}
+
+LmdbDbAccess::~LmdbDbAccess()
+{
+}
+
+DbTable* LmdbDbAccess::open(FileSystemAccess* fsaccess, string* name, bool)
+{
+    ostringstream oss;
+    oss << dbpath;
+    oss << "megaclient_statecache";
+    oss << DB_VERSION;
+    oss << "_" << *name << ".lmdb";
+    string dbfile = oss.str();
+
+    currentDbVersion = DB_VERSION;
+
+    MDB_env* env;
+    int rc;
+
+    if ((rc = mdb_env_create(&env)))
+    {
+        LOG_err << "Unable to create LMDB environment: " << mdb_strerror(rc);
+        return NULL;
+    }
+
+    // one file per table, and transactions that are not bound to a thread
+    // (the cache loader walks the records on a thread of its own)
+    if ((rc = mdb_env_set_maxdbs(env, 5))
+            || (rc = mdb_env_set_mapsize(env, MAPSIZE))
+            || (rc = mdb_env_open(env, dbfile.c_str(), MDB_NOSUBDIR | MDB_NOTLS, 0600)))
+    {
+        LOG_err << "Unable to open " << dbfile << ": " << mdb_strerror(rc);
+        mdb_env_close(env);
+        return NULL;
+    }
+
+    // release the reader slots of processes that did not exit cleanly
+    int dead;
+    mdb_reader_check(env, &dead);
+
+    return new LmdbDbTable(env, fsaccess, &dbfile);
+}
+
+LmdbDbTable::LmdbDbTable(MDB_env* cenv, FileSystemAccess* fs, string* filepath)
+{
+    env = cenv;
+    fsaccess = fs;
+    dbfile = *filepath;
+
+    txn = NULL;
+    readtxn = NULL;
+    itertxn = NULL;
+    cursor = NULL;
+    iterating = false;
+    mappedrecords = false;
+    nodeindex = false;
+
+    MDB_txn* t;
+
+    if (mdb_txn_begin(env, NULL, 0, &t))
+    {
+        close();
+        return;
+    }
+
+    if (mdb_dbi_open(t, "statecache", MDB_CREATE | MDB_INTEGERKEY, &records))
+    {
+        mdb_txn_abort(t);
+        close();
+        return;
+    }
+
+    nodeindex = opennodeindex(t, 0);
+
+    if (mdb_txn_commit(t))
+    {
+        nodeindex = false;
+        close();
+    }
+}
+
+LmdbDbTable::~LmdbDbTable()
+{
+    close();
+}
+
+void LmdbDbTable::close()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    unmap();
+    abort();
+
+    if (readtxn)
+    {
+        mdb_txn_abort(readtxn);
+        readtxn = NULL;
+    }
+
+    mdb_env_close(env);
+    env = NULL;
+    LOG_debug << "Database closed " << dbfile;
+}
+
+bool LmdbDbTable::opennodeindex(MDB_txn* t, unsigned flags)
+{
+    return !mdb_dbi_open(t, "nodeids", flags | MDB_INTEGERKEY, &nodeids)
+        && !mdb_dbi_open(t, "nodehandles", flags, &nodehandles)
+        && !mdb_dbi_open(t, "children", flags | MDB_DUPSORT | MDB_DUPFIXED, &children)
+        && !mdb_dbi_open(t, "fingerprints", flags | MDB_DUPSORT | MDB_DUPFIXED, &fingerprints);
+}
+
+MDB_txn* LmdbDbTable::beginwrite()
+{
+    MDB_txn* t;
+
+    if (txn)
+    {
+        return txn;
+    }
+
+    if (mdb_txn_begin(env, NULL, 0, &t))
+    {
+        return NULL;
+    }
+
+    return t;
+}
+
+bool LmdbDbTable::endwrite(MDB_txn* t, bool ok)
+{
+    if (t != txn)
+    {
+        if (ok)
+        {
+            ok = !mdb_txn_commit(t);
+        }
+        else
+        {
+            mdb_txn_abort(t);
+        }
+    }
+
+    return ok;
+}
+
+// reads within begin()/commit() see the pending writes
+MDB_txn* LmdbDbTable::beginread()
+{
+    if (txn)
+    {
+        return txn;
+    }
+
+    if (readtxn)
+    {
+        if (mdb_txn_renew(readtxn))
+        {
+            return NULL;
+        }
+    }
+    else if (mdb_txn_begin(env, NULL, MDB_RDONLY, &readtxn))
+    {
+        readtxn = NULL;
+        return NULL;
+    }
+
+    return readtxn;
+}
+
+void LmdbDbTable::endread(MDB_txn* t)
+{
+    if (t == readtxn)
+    {
+        mdb_txn_reset(readtxn);
+    }
+}
+
+// walk a snapshot of the committed records
+void LmdbDbTable::rewind()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    unmap();
+
+    if (mdb_txn_begin(env, NULL, MDB_RDONLY, &itertxn))
+    {
+        itertxn = NULL;
+        return;
+    }
+
+    if (mdb_cursor_open(itertxn, records, &cursor))
+    {
+        cursor = NULL;
+        unmap();
+        return;
+    }
+
+    iterating = false;
+}
+
+// retrieve next record through cursor
+bool LmdbDbTable::next(uint32_t* index, string* data)
+{
+    const char* ptr;
+    unsigned len;
+
+    if (!step(index, &ptr, &len))
+    {
+        return false;
+    }
+
+    data->assign(ptr, len);
+
+    return true;
+}
+
+bool LmdbDbTable::mapped()
+{
+    return true;
+}
+
+// retrieve next record through cursor, pointing into the map
+bool LmdbDbTable::nextmapped(uint32_t* index, const char** data, unsigned* len)
+{
+    if (!step(index, data, len))
+    {
+        return false;
+    }
+
+    mappedrecords = true;
+
+    return true;
+}
+
+bool LmdbDbTable::step(uint32_t* index, const char** data, unsigned* len)
+{
+    if (!cursor)
+    {
+        return false;
+    }
+
+    MDB_val key, value;
+
+    if (mdb_cursor_get(cursor, &key, &value, iterating ? MDB_NEXT : MDB_FIRST)
+            || key.mv_size != sizeof(*index))
+    {
+        // the snapshot is released unless records were handed out mapped
+        if (!mappedrecords)
+        {
+            unmap();
+        }
+
+        return false;
+    }
+
+    iterating = true;
+
+    memcpy(index, key.mv_data, sizeof(*index));
+    *data = (const char*)value.mv_data;
+    *len = (unsigned)value.mv_size;
+
+    return true;
+}
+
+void LmdbDbTable::unmap()
+{
+    if (cursor)
+    {
+        mdb_cursor_close(cursor);
+        cursor = NULL;
+    }
+
+    if (itertxn)
+    {
+        mdb_txn_abort(itertxn);
+        itertxn = NULL;
+    }
+
+    iterating = false;
+    mappedrecords = false;
+}
+
+// retrieve record by index
+bool LmdbDbTable::get(uint32_t index, string* data)
+{
+    if (!env)
+    {
+        return false;
+    }
+
+    MDB_txn* t = beginread();
+
+    if (!t)
+    {
+        return false;
+    }
+
+    MDB_val key = { sizeof index, &index };
+    MDB_val value;
+    bool result = false;
+
+    if (!mdb_get(t, records, &key, &value))
+    {
+        data->assign((const char*)value.mv_data, value.mv_size);
+        result = true;
+    }
+
+    endread(t);
+
+    return result;
+}
+
+// add/update record by index
+bool LmdbDbTable::put(uint32_t index, char* data, unsigned len)
+{
+    if (!env)
+    {
+        return false;
+    }
+
+    MDB_txn* t = beginwrite();
+
+    if (!t)
+    {
+        return false;
+    }
+
+    MDB_val key = { sizeof index, &index };
+    MDB_val value = { len, data };
+
+    return endwrite(t, !mdb_put(t, records, &key, &value, 0));
+}
+
+// delete record by index
+bool LmdbDbTable::del(uint32_t index)
+{
+    if (!env)
+    {
+        return false;
+    }
+
+    MDB_txn* t = beginwrite();
+
+    if (!t)
+    {
+        return false;
+    }
+
+    MDB_val key = { sizeof index, &index };
+    int rc = mdb_del(t, records, &key, NULL);
+
+    return endwrite(t, (!rc || rc == MDB_NOTFOUND) && (!nodeindex || deindexnode(t, index)));
+}
+
+// truncate table
+void LmdbDbTable::truncate()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    MDB_txn* t = beginwrite();
+
+    if (!t)
+    {
+        return;
+    }
+
+    bool ok = !mdb_drop(t, records, 0);
+
+    if (ok && nodeindex)
+    {
+        ok = !mdb_drop(t, nodeids, 0)
+          && !mdb_drop(t, nodehandles, 0)
+          && !mdb_drop(t, children, 0)
+          && !mdb_drop(t, fingerprints, 0);
+    }
+
+    endwrite(t, ok);
+}
+
+// begin transaction
+void LmdbDbTable::begin()
+{
+    if (!env || txn)
+    {
+        return;
+    }
+
+    LOG_debug << "DB transaction BEGIN " << dbfile;
+
+    if (mdb_txn_begin(env, NULL, 0, &txn))
+    {
+        LOG_err << "Unable to begin transaction " << dbfile;
+        txn = NULL;
+    }
+}
+
+// commit transaction
+void LmdbDbTable::commit()
+{
+    if (!txn)
+    {
+        return;
+    }
+
+    LOG_debug << "DB transaction COMMIT " << dbfile;
+
+    int rc = mdb_txn_commit(txn);
+    txn = NULL;
+
+    if (rc)
+    {
+        LOG_err << "Unable to commit transaction " << dbfile << ": " << mdb_strerror(rc);
+    }
+}
+
+// abort transaction
+void LmdbDbTable::abort()
+{
+    if (!txn)
+    {
+        return;
+    }
+
+    LOG_debug << "DB transaction ROLLBACK " << dbfile;
+
+    mdb_txn_abort(txn);
+    txn = NULL;
+}
+
+void LmdbDbTable::remove()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    close();
+
+    string localpath;
+    fsaccess->path2local(&dbfile, &localpath);
+    fsaccess->unlinklocal(&localpath);
+
+    string lockfile = dbfile + "-lock";
+    fsaccess->path2local(&lockfile, &localpath);
+    fsaccess->unlinklocal(&localpath);
+}
+
+bool LmdbDbTable::hasnodeindex()
+{
+    return nodeindex;
+}
+
+// create the (empty) node index
+void LmdbDbTable::createnodeindex()
+{
+    if (!env || nodeindex)
+    {
+        return;
+    }
+
+    MDB_txn* t = beginwrite();
+
+    if (t)
+    {
+        nodeindex = endwrite(t, opennodeindex(t, MDB_CREATE));
+    }
+}
+
+bool LmdbDbTable::deindexnode(MDB_txn* t, uint32_t index)
+{
+    MDB_val key = { sizeof index, &index };
+    MDB_val value;
+    DbNodeColumns columns;
+
+    int rc = mdb_get(t, nodeids, &key, &value);
+
+    if (rc)
+    {
+        return rc == MDB_NOTFOUND;
+    }
+
+    if (value.mv_size != sizeof columns)
+    {
+        return !mdb_del(t, nodeids, &key, NULL);
+    }
+
+    memcpy(&columns, value.mv_data, sizeof columns);
+
+    // the handle may have been indexed again under another record
+    MDB_val hkey = { sizeof columns.h, &columns.h };
+
+    if (!mdb_get(t, nodehandles, &hkey, &value)
+            && value.mv_size == sizeof index
+            && !memcmp(value.mv_data, &index, sizeof index))
+    {
+        mdb_del(t, nodehandles, &hkey, NULL);
+    }
+
+    char child[sizeof columns.namehash + sizeof columns.h];
+    memcpy(child, &columns.namehash, sizeof columns.namehash);
+    memcpy(child + sizeof columns.namehash, &columns.h, sizeof columns.h);
+
+    MDB_val pkey = { sizeof columns.ph, &columns.ph };
+    MDB_val childval = { sizeof child, child };
+    mdb_del(t, children, &pkey, &childval);
+
+    if (columns.fingerprint)
+    {
+        char fp[sizeof columns.fingerprint + sizeof columns.size + sizeof columns.mtime];
+        memcpy(fp, &columns.fingerprint, sizeof columns.fingerprint);
+        memcpy(fp + sizeof columns.fingerprint, &columns.size, sizeof columns.size);
+        memcpy(fp + sizeof columns.fingerprint + sizeof columns.size, &columns.mtime, sizeof columns.mtime);
+
+        MDB_val fpkey = { sizeof fp, fp };
+        MDB_val fpval = { sizeof columns.h, &columns.h };
+        mdb_del(t, fingerprints, &fpkey, &fpval);
+    }
+
+    return !mdb_del(t, nodeids, &key, NULL);
+}
+
+// add/update the index entry of a node record
+bool LmdbDbTable::indexnode(uint32_t index, const DbNodeColumns* columns)
+{
+    if (!env)
+    {
+        return false;
+    }
+
+    if (!nodeindex)
+    {
+        return true;
+    }
+
+    MDB_txn* t = beginwrite();
+
+    if (!t)
+    {
+        return false;
+    }
+
+    DbNodeColumns c = *columns;
+
+    MDB_val key = { sizeof index, &index };
+    MDB_val value = { sizeof c, &c };
+
+    MDB_val hkey = { sizeof c.h, &c.h };
+    MDB_val hval = { sizeof index, &index };
+
+    char child[sizeof c.namehash + sizeof c.h];
+    memcpy(child, &c.namehash, sizeof c.namehash);
+    memcpy(child + sizeof c.namehash, &c.h, sizeof c.h);
+
+    MDB_val pkey = { sizeof c.ph, &c.ph };
+    MDB_val childval = { sizeof child, child };
+
+    bool ok = deindexnode(t, index)
+           && !mdb_put(t, nodeids, &key, &value, 0)
+           && !mdb_put(t, nodehandles, &hkey, &hval, 0)
+           && !mdb_put(t, children, &pkey, &childval, 0);
+
+    if (ok && c.fingerprint)
+    {
+        char fp[sizeof c.fingerprint + sizeof c.size + sizeof c.mtime];
+        memcpy(fp, &c.fingerprint, sizeof c.fingerprint);
+        memcpy(fp + sizeof c.fingerprint, &c.size, sizeof c.size);
+        memcpy(fp + sizeof c.fingerprint + sizeof c.size, &c.mtime, sizeof c.mtime);
+
+        MDB_val fpkey = { sizeof fp, fp };
+        MDB_val fpval = { sizeof c.h, &c.h };
+        ok = !mdb_put(t, fingerprints, &fpkey, &fpval, 0);
+    }
+
+    return endwrite(t, ok);
+}
+
+// retrieve the record id of a node
+bool LmdbDbTable::getnode(handle h, uint32_t* index)
+{
+    if (!env || !nodeindex)
+    {
+        return false;
+    }
+
+    MDB_txn* t = beginread();
+
+    if (!t)
+    {
+        return false;
+    }
+
+    MDB_val key = { sizeof h, &h };
+    MDB_val value;
+    bool result = false;
+
+    if (!mdb_get(t, nodehandles, &key, &value) && value.mv_size == sizeof(*index))
+    {
+        memcpy(index, value.mv_data, sizeof(*index));
+        result = true;
+    }
+
+    endread(t);
+
+    return result;
+}
+
+// retrieve the handles of the children of a node
+bool LmdbDbTable::getchildnodes(handle ph, handle_vector* handles)
+{
+    if (!env || !nodeindex)
+    {
+        return false;
+    }
+
+    MDB_val key = { sizeof ph, &ph };
+
+    return gethandles(children, &key, NULL, 0, sizeof(uint64_t), handles);
+}
+
+// retrieve the handles of the children of a node with a name hash
+bool LmdbDbTable::getchildnodesbyname(handle ph, uint64_t namehash, handle_vector* handles)
+{
+    if (!env || !nodeindex)
+    {
+        return false;
+    }
+
+    // the cursor points the keys at the database pages
+    MDB_val key = { sizeof ph, &ph };
+    MDB_val nonamekey = { sizeof ph, &ph };
+    uint64_t nonamehash = 0;
+
+    return gethandles(children, &key, &namehash, sizeof namehash, sizeof namehash, handles)
+        && gethandles(children, &nonamekey, &nonamehash, sizeof nonamehash, sizeof nonamehash, handles);
+}
+
+// retrieve the handles of the file nodes with a fingerprint
+bool LmdbDbTable::getnodesbyfingerprint(m_off_t size, m_time_t mtime, uint64_t fingerprint, handle_vector* handles)
+{
+    if (!env || !nodeindex)
+    {
+        return false;
+    }
+
+    char fp[sizeof fingerprint + sizeof size + sizeof mtime];
+    memcpy(fp, &fingerprint, sizeof fingerprint);
+    memcpy(fp + sizeof fingerprint, &size, sizeof size);
+    memcpy(fp + sizeof fingerprint + sizeof size, &mtime, sizeof mtime);
+
+    MDB_val key = { sizeof fp, fp };
+
+    return gethandles(fingerprints, &key, NULL, 0, 0, handles);
+}
+
+// collect the handles stored at an offset of the duplicates of a key
+bool LmdbDbTable::gethandles(MDB_dbi dbi, MDB_val* key, const void* prefix, size_t prefixlen, size_t offset, handle_vector* handles)
+{
+    MDB_txn* t = beginread();
+
+    if (!t)
+    {
+        return false;
+    }
+
+    MDB_cursor* c;
+
+    if (mdb_cursor_open(t, dbi, &c))
+    {
+        endread(t);
+        return false;
+    }
+
+    string first(offset + sizeof(handle), '\0');
+    MDB_val value = { first.size(), (void*)first.data() };
+    int rc;
+
+    if (prefix)
+    {
+        // position at the first duplicate with the prefix
+        memcpy((char*)first.data(), prefix, prefixlen);
+        rc = mdb_cursor_get(c, key, &value, MDB_GET_BOTH_RANGE);
+    }
+    else
+    {
+        rc = mdb_cursor_get(c, key, &value, MDB_SET_KEY);
+    }
+
+    while (!rc)
+    {
+        if (value.mv_size != offset + sizeof(handle)
+                || (prefix && memcmp(value.mv_data, prefix, prefixlen)))
+        {
+            break;
+        }
+
+        handle h;
+        memcpy(&h, (const char*)value.mv_data + offset, sizeof h);
+        handles->push_back(h);
+
+        rc = mdb_cursor_get(c, key, &value, MDB_NEXT_DUP);
+    }
+
+    mdb_cursor_close(c);
+    endread(t);
+
+    return !rc || rc == MDB_NOTFOUND;
+}
+} // namespace
+
+#endif
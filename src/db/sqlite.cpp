@@ -23,6 +23,8 @@
 
 #ifdef USE_SQLITE
 namespace mega {
+const int SqliteDbAccess::NODE_SCHEMA_VERSION;
+
 SqliteDbAccess::SqliteDbAccess(string* path)
 {
     if (path)
@@ -134,6 +136,44 @@ DbTable* SqliteDbAccess::open(FileSystemAccess* fsaccess, string* name, bool rec
         return NULL;
     }
 
+    // single row holding the generation counter (see getgeneration())
+    sql = "CREATE TABLE IF NOT EXISTS generation (id INTEGER PRIMARY KEY NOT NULL, value INTEGER NOT NULL)";
+
+    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+
+    if (rc)
+    {
+        return NULL;
+    }
+
+    // migrate the node index: the columns of older schemas cannot be filled
+    // without decrypting the node records, so the index is dropped here and
+    // rebuilt by the client once the records are loaded
+    sqlite3_stmt *stmt;
+    int schema = 0;
+
+    if (sqlite3_prepare(db, "PRAGMA user_version", -1, &stmt, NULL) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        schema = sqlite3_column_int(stmt, 0);
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (schema < NODE_SCHEMA_VERSION)
+    {
+        ostringstream oss;
+        oss << "PRAGMA user_version = " << NODE_SCHEMA_VERSION;
+
+        LOG_debug << "Migrating node index from schema " << schema << " to " << NODE_SCHEMA_VERSION;
+
+        if (sqlite3_exec(db, "DROP TABLE IF EXISTS nodes", NULL, NULL, NULL)
+                || sqlite3_exec(db, oss.str().c_str(), NULL, NULL, NULL))
+        {
+            return NULL;
+        }
+    }
+
     return new SqliteDbTable(db, fsaccess, &dbfile);
 }
 
@@ -143,6 +183,18 @@ SqliteDbTable::SqliteDbTable(sqlite3* cdb, FileSystemAccess *fs, string *filepat
     pStmt = NULL;
     fsaccess = fs;
     dbfile = *filepath;
+
+    memset(stmts, 0, sizeof stmts);
+
+    sqlite3_stmt *stmt;
+    nodeindex = false;
+
+    if (sqlite3_prepare(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'nodes'", -1, &stmt, NULL) == SQLITE_OK)
+    {
+        nodeindex = sqlite3_step(stmt) == SQLITE_ROW;
+    }
+
+    sqlite3_finalize(stmt);
 }
 
 SqliteDbTable::~SqliteDbTable()
@@ -156,11 +208,37 @@ SqliteDbTable::~SqliteDbTable()
     {
         sqlite3_finalize(pStmt);
     }
+    finalizestatements();
     abort();
     sqlite3_close(db);
     LOG_debug << "Database closed " << dbfile;
 }
 
+// cached prepared statement, reset and ready to be bound (NULL on error)
+sqlite3_stmt* SqliteDbTable::statement(int which, const char* sql)
+{
+    if (stmts[which])
+    {
+        sqlite3_reset(stmts[which]);
+    }
+    else if (sqlite3_prepare_v2(db, sql, -1, &stmts[which], NULL) != SQLITE_OK)
+    {
+        sqlite3_finalize(stmts[which]);
+        stmts[which] = NULL;
+    }
+
+    return stmts[which];
+}
+
+void SqliteDbTable::finalizestatements()
+{
+    for (int i = 0; i < NUMSTATEMENTS; i++)
+    {
+        sqlite3_finalize(stmts[i]);
+        stmts[i] = NULL;
+    }
+}
+
 // set cursor to first record
 void SqliteDbTable::rewind()
 {
@@ -219,7 +297,7 @@ bool SqliteDbTable::get(uint32_t index, string* data)
     sqlite3_stmt *stmt;
     bool result = false;
 
-    if (sqlite3_prepare(db, "SELECT content FROM statecache WHERE id = ?", -1, &stmt, NULL) == SQLITE_OK)
+    if ((stmt = statement(STMT_GET, "SELECT content FROM statecache WHERE id = ?")))
     {
         if (sqlite3_bind_int(stmt, 1, index) == SQLITE_OK)
         {
@@ -230,9 +308,10 @@ bool SqliteDbTable::get(uint32_t index, string* data)
                 result = true;
             }
         }
+
+        sqlite3_reset(stmt);
     }
 
-    sqlite3_finalize(stmt);
     return result;
 }
 
@@ -247,7 +326,7 @@ bool SqliteDbTable::put(uint32_t index, char* data, unsigned len)
     sqlite3_stmt *stmt;
     bool result = false;
 
-    if (sqlite3_prepare(db, "INSERT OR REPLACE INTO statecache (id, content) VALUES (?, ?)", -1, &stmt, NULL) == SQLITE_OK)
+    if ((stmt = statement(STMT_PUT, "INSERT OR REPLACE INTO statecache (id, content) VALUES (?, ?)")))
     {
         if (sqlite3_bind_int(stmt, 1, index) == SQLITE_OK)
         {
@@ -259,9 +338,12 @@ bool SqliteDbTable::put(uint32_t index, char* data, unsigned len)
                 }
             }
         }
+
+        // the blob is not ours to keep
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
     }
 
-    sqlite3_finalize(stmt);
     return result;
 }
 
@@ -273,11 +355,35 @@ bool SqliteDbTable::del(uint32_t index)
         return false;
     }
 
-    char buf[64];
+    if (!deletebyid(STMT_DEL, "DELETE FROM statecache WHERE id = ?", index))
+    {
+        return false;
+    }
 
-    sprintf(buf, "DELETE FROM statecache WHERE id = %" PRIu32, index);
+    if (nodeindex)
+    {
+        return deletebyid(STMT_DELNODE, "DELETE FROM nodes WHERE id = ?", index);
+    }
 
-    return !sqlite3_exec(db, buf, 0, 0, NULL);
+    return true;
+}
+
+bool SqliteDbTable::deletebyid(int which, const char* sql, uint32_t index)
+{
+    sqlite3_stmt *stmt;
+    bool result = false;
+
+    if ((stmt = statement(which, sql)))
+    {
+        if (sqlite3_bind_int(stmt, 1, index) == SQLITE_OK)
+        {
+            result = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    return result;
 }
 
 // truncate table
@@ -289,6 +395,11 @@ void SqliteDbTable::truncate()
     }
 
     sqlite3_exec(db, "DELETE FROM statecache", 0, 0, NULL);
+
+    if (nodeindex)
+    {
+        sqlite3_exec(db, "DELETE FROM nodes", 0, 0, NULL);
+    }
 }
 
 // begin transaction
@@ -338,6 +449,7 @@ void SqliteDbTable::remove()
     {
         sqlite3_finalize(pStmt);
     }
+    finalizestatements();
     abort();
     sqlite3_close(db);
 
@@ -347,6 +459,242 @@ void SqliteDbTable::remove()
     fsaccess->path2local(&dbfile, &localpath);
     fsaccess->unlinklocal(&localpath);
 }
+
+bool SqliteDbTable::localpath(string* path)
+{
+    fsaccess->path2local(&dbfile, path);
+    return true;
+}
+
+bool SqliteDbTable::getgeneration(uint64_t* generation)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    sqlite3_stmt *stmt;
+    bool result = false;
+
+    if ((stmt = statement(STMT_GETGENERATION, "SELECT value FROM generation WHERE id = 0")))
+    {
+        int rc = sqlite3_step(stmt);
+
+        if (rc == SQLITE_ROW)
+        {
+            *generation = (uint64_t)sqlite3_column_int64(stmt, 0);
+            result = true;
+        }
+        else if (rc == SQLITE_DONE)
+        {
+            *generation = 0;
+            result = true;
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    return result;
+}
+
+bool SqliteDbTable::setgeneration(uint64_t generation)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    sqlite3_stmt *stmt;
+    bool result = false;
+
+    if ((stmt = statement(STMT_SETGENERATION, "INSERT OR REPLACE INTO generation (id, value) VALUES (0, ?)")))
+    {
+        if (sqlite3_bind_int64(stmt, 1, (sqlite3_int64)generation) == SQLITE_OK)
+        {
+            result = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    return result;
+}
+
+bool SqliteDbTable::hasnodeindex()
+{
+    return nodeindex;
+}
+
+// create the (empty) node index
+void SqliteDbTable::createnodeindex()
+{
+    if (!db || nodeindex)
+    {
+        return;
+    }
+
+    nodeindex = !sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS nodes (id INTEGER PRIMARY KEY ASC NOT NULL, nodehandle INTEGER NOT NULL, parenthandle INTEGER NOT NULL, namehash INTEGER, size INTEGER NOT NULL, mtime INTEGER NOT NULL, fingerprint INTEGER)", NULL, NULL, NULL)
+             && !sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS nodes_nodehandle ON nodes (nodehandle)", NULL, NULL, NULL)
+             && !sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS nodes_parenthandle ON nodes (parenthandle, namehash)", NULL, NULL, NULL)
+             && !sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS nodes_fingerprint ON nodes (fingerprint)", NULL, NULL, NULL);
+}
+
+// add/update the index entry of a node record
+bool SqliteDbTable::indexnode(uint32_t index, const DbNodeColumns* columns)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    if (!nodeindex)
+    {
+        return true;
+    }
+
+    sqlite3_stmt *stmt;
+    bool result = false;
+
+    if ((stmt = statement(STMT_INDEXNODE, "INSERT OR REPLACE INTO nodes (id, nodehandle, parenthandle, namehash, size, mtime, fingerprint) VALUES (?, ?, ?, ?, ?, ?, ?)")))
+    {
+        if (sqlite3_bind_int(stmt, 1, index) == SQLITE_OK
+         && sqlite3_bind_int64(stmt, 2, (sqlite3_int64)columns->h) == SQLITE_OK
+         && sqlite3_bind_int64(stmt, 3, (sqlite3_int64)columns->ph) == SQLITE_OK
+         && (columns->namehash ? sqlite3_bind_int64(stmt, 4, (sqlite3_int64)columns->namehash)
+                               : sqlite3_bind_null(stmt, 4)) == SQLITE_OK
+         && sqlite3_bind_int64(stmt, 5, (sqlite3_int64)columns->size) == SQLITE_OK
+         && sqlite3_bind_int64(stmt, 6, (sqlite3_int64)columns->mtime) == SQLITE_OK
+         && (columns->fingerprint ? sqlite3_bind_int64(stmt, 7, (sqlite3_int64)columns->fingerprint)
+                                  : sqlite3_bind_null(stmt, 7)) == SQLITE_OK)
+        {
+            if (sqlite3_step(stmt) == SQLITE_DONE)
+            {
+                result = true;
+            }
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    return result;
+}
+
+// retrieve the record id of a node
+bool SqliteDbTable::getnode(handle h, uint32_t* index)
+{
+    if (!db || !nodeindex)
+    {
+        return false;
+    }
+
+    sqlite3_stmt *stmt;
+    bool result = false;
+
+    if ((stmt = statement(STMT_GETNODE, "SELECT id FROM nodes WHERE nodehandle = ?")))
+    {
+        if (sqlite3_bind_int64(stmt, 1, (sqlite3_int64)h) == SQLITE_OK)
+        {
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                *index = sqlite3_column_int(stmt, 0);
+
+                result = true;
+            }
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    return result;
+}
+
+// retrieve the handles of the children of a node
+bool SqliteDbTable::getchildnodes(handle ph, handle_vector* handles)
+{
+    if (!db || !nodeindex)
+    {
+        return false;
+    }
+
+    sqlite3_stmt *stmt;
+    bool result = false;
+
+    if ((stmt = statement(STMT_GETCHILDNODES, "SELECT nodehandle FROM nodes WHERE parenthandle = ?")))
+    {
+        if (sqlite3_bind_int64(stmt, 1, (sqlite3_int64)ph) == SQLITE_OK)
+        {
+            result = gethandles(stmt, handles);
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    return result;
+}
+
+// retrieve the handles of the children of a node with a name hash
+bool SqliteDbTable::getchildnodesbyname(handle ph, uint64_t namehash, handle_vector* handles)
+{
+    if (!db || !nodeindex)
+    {
+        return false;
+    }
+
+    sqlite3_stmt *stmt;
+    bool result = false;
+
+    if ((stmt = statement(STMT_GETCHILDNODESBYNAME, "SELECT nodehandle FROM nodes WHERE parenthandle = ?1 AND namehash = ?2 UNION ALL SELECT nodehandle FROM nodes WHERE parenthandle = ?1 AND namehash IS NULL")))
+    {
+        if (sqlite3_bind_int64(stmt, 1, (sqlite3_int64)ph) == SQLITE_OK
+         && sqlite3_bind_int64(stmt, 2, (sqlite3_int64)namehash) == SQLITE_OK)
+        {
+            result = gethandles(stmt, handles);
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    return result;
+}
+
+// retrieve the handles of the file nodes with a fingerprint
+bool SqliteDbTable::getnodesbyfingerprint(m_off_t size, m_time_t mtime, uint64_t fingerprint, handle_vector* handles)
+{
+    if (!db || !nodeindex)
+    {
+        return false;
+    }
+
+    sqlite3_stmt *stmt;
+    bool result = false;
+
+    if ((stmt = statement(STMT_GETNODESBYFINGERPRINT, "SELECT nodehandle FROM nodes WHERE fingerprint = ? AND size = ? AND mtime = ?")))
+    {
+        if (sqlite3_bind_int64(stmt, 1, (sqlite3_int64)fingerprint) == SQLITE_OK
+         && sqlite3_bind_int64(stmt, 2, (sqlite3_int64)size) == SQLITE_OK
+         && sqlite3_bind_int64(stmt, 3, (sqlite3_int64)mtime) == SQLITE_OK)
+        {
+            result = gethandles(stmt, handles);
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    return result;
+}
+
+// collect the node handles returned by a query
+bool SqliteDbTable::gethandles(sqlite3_stmt* stmt, handle_vector* handles)
+{
+    int rc;
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        handles->push_back((handle)sqlite3_column_int64(stmt, 0));
+    }
+
+    return rc == SQLITE_DONE;
+}
 } // namespace
 
 #endif
@@ -521,7 +521,7 @@ void SyncFileGet::updatelocalname()
 {
     attr_map::iterator ait;
 
-    if ((ait = n->attrs.map.find('n')) != n->attrs.map.end())
+    if ((ait = n->attrs().map.find('n')) != n->attrs().map.end())
     {
         if (n->parent && n->parent->localnode)
         {
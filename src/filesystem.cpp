@@ -97,6 +97,19 @@ void FileSystemAccess::normalize(string* filename) const
     size_t fnsize = filename->size();
     string result;
 
+    // NFC leaves pure ASCII untouched, which is the common case
+    size_t pos = 0;
+
+    while (pos < fnsize && !(cfilename[pos] & 0x80))
+    {
+        pos++;
+    }
+
+    if (pos == fnsize)
+    {
+        return;
+    }
+
     for (size_t i = 0; i < fnsize; )
     {
         // allow NUL bytes between valid UTF-8 sequences
@@ -189,7 +202,7 @@ void DirNotify::notify(notifyqueue q, LocalNode* l, const char* localpath, size_
         if ((!ll && !success && !fa->retry) // deleted file
             || (ll && success && ll->node && ll->node->localnode == ll
                 && (ll->type != FILENODE || (*(FileFingerprint *)ll) == (*(FileFingerprint *)ll->node))
-                && (ait = ll->node->attrs.map.find('n')) != ll->node->attrs.map.end()
+                && (ait = ll->node->attrs().map.find('n')) != ll->node->attrs().map.end()
                 && ait->second == ll->name
                 && fa->fsidvalid && fa->fsid == ll->fsid && fa->type == ll->type
                 && (ll->type != FILENODE || (ll->mtime == fa->mtime && ll->size == fa->size))))
@@ -412,15 +425,21 @@ void FileAccess::asyncsysopen(AsyncIOContext *context)
 
 AsyncIOContext *FileAccess::asyncfread(string *dst, unsigned len, unsigned pad, m_off_t pos)
 {
-    LOG_verbose << "Async read start";
     dst->resize(len + pad);
 
+    return asyncfread((byte *)dst->data(), len, pad, pos);
+}
+
+AsyncIOContext *FileAccess::asyncfread(byte *dst, unsigned len, unsigned pad, m_off_t pos)
+{
+    LOG_verbose << "Async read start";
+
     AsyncIOContext *context = newasynccontext();
     context->op = AsyncIOContext::READ;
     context->pos = pos;
     context->len = len;
     context->pad = pad;
-    context->buffer = (byte *)dst->data();
+    context->buffer = dst;
     context->waiter = waiter;
     context->userCallback = asyncopfinished;
     context->userData = waiter;
@@ -20,6 +20,7 @@
  */
 
 #include "mega/http.h"
+#include "mega/bufferpool.h"
 #include "mega/megaclient.h"
 #include "mega/logging.h"
 #include "mega/proxy.h"
@@ -555,6 +556,15 @@ m_off_t HttpReq::transferred(MegaClient*)
     }
 }
 
+void HttpReqXfer::setcipherkey(const byte* key)
+{
+    if (!cipherkeyed || memcmp(cipher.key, key, SymmCipher::KEYLENGTH))
+    {
+        cipher.setkey(key);
+        cipherkeyed = true;
+    }
+}
+
 // prepare file chunk download
 void HttpReqDL::prepare(const char* tempurl, SymmCipher* /*key*/,
                         chunkmac_map* /*macs*/, uint64_t /*ctriv*/, m_off_t pos,
@@ -567,26 +577,49 @@ void HttpReqDL::prepare(const char* tempurl, SymmCipher* /*key*/,
 
     dlpos = pos;
     size = (unsigned)(npos - pos);
+    decrypted = false;
+
+    size_t bufsize = (size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE;
 
-    if (!buf || buflen != size)
+    if (!buf || bufcapacity < bufsize || bufcapacity / 2 > bufsize)
     {
-        // (re)allocate buffer
-        if (buf)
-        {
-            delete[] buf;
-            buf = NULL;
-        }
+        // (re)allocate buffer from the pool, also when the request size has
+        // shrunk with the budget share - stays NULL if the budget is
+        // exhausted
+        releasebuf();
 
         if (size)
         {
-            buf = new byte[(size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE];
+            buf = TransferBufferPool::alloc(bufsize, &bufcapacity);
         }
-        buflen = size;
     }
+
+    buflen = size;
+}
+
+void HttpReqDL::releasebuf()
+{
+    TransferBufferPool::release(buf);
+    buf = NULL;
+    bufcapacity = 0;
+}
+
+HttpReqDL::~HttpReqDL()
+{
+    // the pooled buffer must not be written by a pending request
+    disconnect();
+    releasebuf();
 }
 
 // decrypt, mac and write downloaded chunk
 void HttpReqDL::finalize(Transfer *transfer)
+{
+    beginfinalize(transfer);
+    crypt();
+}
+
+// update the chunk MAC bookkeeping and collect the chunks to decrypt
+void HttpReqDL::beginfinalize(Transfer *transfer)
 {
     byte *chunkstart = buf;
     m_off_t startpos = dlpos;
@@ -600,7 +633,9 @@ void HttpReqDL::finalize(Transfer *transfer)
 
     m_off_t endpos = ChunkedHash::chunkceil(startpos, finalpos);
     m_off_t chunksize = endpos - startpos;
-    SymmCipher *cipher = transfer->transfercipher();
+    vector<m_off_t> chunkids;
+
+    cryptchunks.clear();
     while (chunksize)
     {
         m_off_t chunkid = ChunkedHash::chunkfloor(startpos);
@@ -608,8 +643,16 @@ void HttpReqDL::finalize(Transfer *transfer)
         if (!chunkmac.finished)
         {
             chunkmac = transfer->chunkmacs[chunkid];
-            cipher->ctr_crypt(chunkstart, chunksize, startpos, transfer->ctriv,
-                                    chunkmac.mac, false, !chunkmac.finished && !chunkmac.offset);
+
+            // decrypted by crypt(), all chunks at once
+            CtrChunk chunk;
+            chunk.data = chunkstart;
+            chunk.len = (unsigned)chunksize;
+            chunk.pos = startpos;
+            chunk.initmac = !chunkmac.finished && !chunkmac.offset;
+            cryptchunks.push_back(chunk);
+            chunkids.push_back(chunkid);
+
             if (endpos == ChunkedHash::chunkceil(chunkid, transfer->size))
             {
                 LOG_debug << "Finished chunk: " << startpos << " - " << endpos << "   Size: " << chunksize;
@@ -628,6 +671,30 @@ void HttpReqDL::finalize(Transfer *transfer)
         endpos = ChunkedHash::chunkceil(startpos, finalpos);
         chunksize = endpos - startpos;
     }
+
+    // the MACs are only addressed once no more chunks are added
+    for (size_t i = 0; i < cryptchunks.size(); i++)
+    {
+        cryptchunks[i].mac = chunkmacs[chunkids[i]].mac;
+    }
+
+    if (cryptchunks.size())
+    {
+        setcipherkey(transfer->transferkey);
+        ctriv = transfer->ctriv;
+    }
+}
+
+// decrypt and mac the chunks collected by beginfinalize()
+void HttpReqDL::crypt()
+{
+    if (cryptchunks.size())
+    {
+        cipher.ctr_crypt_chunks(&cryptchunks[0], (unsigned)cryptchunks.size(), ctriv, false);
+        cryptchunks.clear();
+    }
+
+    decrypted = true;
 }
 
 // prepare chunk for uploading: mac and encrypt
@@ -635,19 +702,31 @@ void HttpReqUL::prepare(const char* tempurl, SymmCipher* key,
                         chunkmac_map* macs, uint64_t ctriv, m_off_t pos,
                         m_off_t npos)
 {
-    size = (unsigned)(npos - pos);
+    beginprepare(tempurl, key, ctriv, pos, npos);
+    crypt();
+    endprepare(macs);
+}
 
-    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+void HttpReqUL::beginprepare(const char* url, SymmCipher* key, uint64_t iv,
+                             m_off_t pos, m_off_t npos)
+{
+    size = (unsigned)(npos - pos);
 
-    key->ctr_crypt((byte*)out->data(), size, pos, ctriv, mac, 1);
+    tempurl = url;
+    ulpos = pos;
+    setcipherkey(key->key);
+    ctriv = iv;
+}
 
-    memcpy((*macs)[pos].mac, mac, sizeof mac);
-    (*macs)[pos].finished = false;
+// encrypt and mac the chunk, compute its CRC
+void HttpReqUL::crypt()
+{
+    memset(mac, 0, sizeof mac);
 
-    // unpad for POSTing
-    out->resize(size);
+    cipher.ctr_crypt(chunk, size, ulpos, ctriv, mac, 1);
 
-    const char *data = out->data();
+    // only size bytes are posted (without the padding)
+    const char *data = (const char*)chunk;
     byte c[CRCSIZE];
     memset(c, 0, CRCSIZE);
 
@@ -675,13 +754,52 @@ void HttpReqUL::prepare(const char* tempurl, SymmCipher* key,
         }
     }
 
-    char crc[32];
+    crc.assign((const char*)c, CRCSIZE);
+}
+
+// record the chunk MAC and set the POST URL
+void HttpReqUL::endprepare(chunkmac_map* macs)
+{
+    memcpy((*macs)[ulpos].mac, mac, sizeof mac);
+    (*macs)[ulpos].finished = false;
+
+    char crcb64[32];
     char buf[256];
-    Base64::btoa(c, CRCSIZE, crc);
-    snprintf(buf, sizeof buf, "%s/%" PRIu64 "?c=%s", tempurl, pos, crc);
+    Base64::btoa((const byte*)crc.data(), CRCSIZE, crcb64);
+    snprintf(buf, sizeof buf, "%s/%" PRIu64 "?c=%s", tempurl.c_str(), ulpos, crcb64);
     setreq(buf, REQ_BINARY);
 }
 
+bool HttpReqUL::allocbuf(size_t len)
+{
+    if (!chunk || chunkcapacity < len || chunkcapacity / 2 > len)
+    {
+        releasebuf();
+        chunk = TransferBufferPool::alloc(len, &chunkcapacity);
+    }
+
+    return chunk != NULL;
+}
+
+void HttpReqUL::releasebuf()
+{
+    TransferBufferPool::release(chunk);
+    chunk = NULL;
+    chunkcapacity = 0;
+}
+
+void HttpReqUL::postchunk(MegaClient* client)
+{
+    post(client, (const char*)chunk, size);
+}
+
+HttpReqUL::~HttpReqUL()
+{
+    // the chunk must not be read by a pending request
+    disconnect();
+    releasebuf();
+}
+
 // number of bytes sent in this request
 m_off_t HttpReqUL::transferred(MegaClient* client)
 {
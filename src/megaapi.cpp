@@ -2007,6 +2007,11 @@ void MegaApi::setMaxConnections(int connections, MegaRequestListener *listener)
     pImpl->setMaxConnections(-1,  connections, listener);
 }
 
+void MegaApi::setTransferMemoryBudget(long long bytes)
+{
+    MegaApiImpl::setTransferMemoryBudget(bytes);
+}
+
 void MegaApi::setDownloadMethod(int method)
 {
     pImpl->setDownloadMethod(method);
@@ -2485,6 +2490,16 @@ MegaNodeList* MegaApi::getInShares()
     return pImpl->getInShares();
 }
 
+MegaNodeList* MegaApi::getInShares(int offset, int limit)
+{
+    return pImpl->getInShares(offset, limit);
+}
+
+MegaNodeList* MegaApi::getInSharesAfter(MegaHandle cursor, int limit)
+{
+    return pImpl->getInSharesAfter(cursor, limit);
+}
+
 MegaShareList* MegaApi::getInSharesList()
 {
     return pImpl->getInSharesList();
@@ -2733,6 +2748,41 @@ MegaNodeList *MegaApi::search(const char *searchString)
     return pImpl->search(searchString);
 }
 
+MegaNodeList *MegaApi::search(const char *searchString, int offset, int limit)
+{
+    return pImpl->search(searchString, offset, limit);
+}
+
+MegaNodeList *MegaApi::searchAfter(const char *searchString, MegaHandle cursor, int limit)
+{
+    return pImpl->searchAfter(searchString, cursor, limit);
+}
+
+MegaNodeList *MegaApi::searchBySize(MegaNode *node, long long minSize, long long maxSize)
+{
+    return pImpl->searchBySize(node, minSize, maxSize);
+}
+
+MegaNodeList *MegaApi::searchByModificationTime(MegaNode *node, int64_t from, int64_t to)
+{
+    return pImpl->searchByModificationTime(node, from, to);
+}
+
+MegaNodeList *MegaApi::searchByCreationTime(MegaNode *node, int64_t from, int64_t to)
+{
+    return pImpl->searchByCreationTime(node, from, to);
+}
+
+MegaNodeList *MegaApi::searchByType(MegaNode *node, int type)
+{
+    return pImpl->searchByType(node, type);
+}
+
+MegaNodeList *MegaApi::searchByExtension(MegaNode *node, const char *extension)
+{
+    return pImpl->searchByExtension(node, extension);
+}
+
 long long MegaApi::getSize(MegaNode *n)
 {
     return pImpl->getSize(n);
@@ -2910,6 +2960,16 @@ MegaNodeList *MegaApi::getChildren(MegaNode* p, int order)
     return pImpl->getChildren(p, order);
 }
 
+MegaNodeList *MegaApi::getChildren(MegaNode *parent, int order, int offset, int limit)
+{
+    return pImpl->getChildren(parent, order, offset, limit);
+}
+
+MegaNodeList *MegaApi::getChildrenAfter(MegaNode *parent, int order, MegaHandle cursor, int limit)
+{
+    return pImpl->getChildrenAfter(parent, order, cursor, limit);
+}
+
 MegaNodeList *MegaApi::getVersions(MegaNode *node)
 {
     return pImpl->getVersions(node);
@@ -224,9 +224,9 @@ MegaNodePrivate::MegaNodePrivate(Node *node)
     this->customAttrs = NULL;
 
     char buf[10];
-    for (attr_map::iterator it = node->attrs.map.begin(); it != node->attrs.map.end(); it++)
+    for (attr_map::iterator it = node->attrs().map.begin(); it != node->attrs().map.end(); it++)
     {
-        int attrlen = node->attrs.nameid2string(it->first, buf);
+        int attrlen = AttrMap::nameid2string(it->first, buf);
         buf[attrlen] = '\0';
         if (buf[0] == '_')
         {
@@ -5717,6 +5717,11 @@ void MegaApiImpl::setMaxConnections(int direction, int connections, MegaRequestL
     waiter->notify();
 }
 
+void MegaApiImpl::setTransferMemoryBudget(long long bytes)
+{
+    TransferBufferPool::setbudget(bytes);
+}
+
 void MegaApiImpl::setDownloadMethod(int method)
 {
     switch(method)
@@ -7435,22 +7440,98 @@ MegaNodeList* MegaApiImpl::getInShares()
     sdkMutex.lock();
 
     vector<Node*> vNodes;
-    for (user_map::iterator it = client->users.begin(); it != client->users.end(); it++)
+    getInSharesNodes(&vNodes);
+
+    MegaNodeList *nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
+    sdkMutex.unlock();
+    return nodeList;
+}
+
+MegaNodeList* MegaApiImpl::getInShares(int offset, int limit)
+{
+    sdkMutex.lock();
+
+    vector<Node*> vNodes;
+    getInSharesNodes(&vNodes, UNDEF, offset, limit);
+
+    MegaNodeList *nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
+    sdkMutex.unlock();
+    return nodeList;
+}
+
+MegaNodeList* MegaApiImpl::getInSharesAfter(MegaHandle cursor, int limit)
+{
+    sdkMutex.lock();
+
+    vector<Node*> vNodes;
+    getInSharesNodes(&vNodes, cursor, 0, limit);
+
+    MegaNodeList *nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
+    sdkMutex.unlock();
+    return nodeList;
+}
+
+// inbound shares by user and handle - only a page of them if a cursor (the
+// last node of the previous page), an offset or a limit are given
+void MegaApiImpl::getInSharesNodes(node_vector *result, MegaHandle cursor, int offset, int limit)
+{
+    user_map::iterator it = client->users.begin();
+    handle_set::iterator sit;
+    bool resume = false;
+
+    if (cursor != UNDEF)
+    {
+        // resume right after the cursor, which must still be an inbound share
+        Node *n = client->nodebyhandle(cursor);
+        uh_map::iterator uit;
+
+        if (!n || n->parent || !n->inshare || !n->inshare->user
+                || (uit = client->uhindex.find(n->inshare->user->userhandle)) == client->uhindex.end()
+                || (it = client->users.find(uit->second)) == client->users.end()
+                || (sit = it->second.sharing.find(cursor)) == it->second.sharing.end())
+        {
+            return;
+        }
+
+        sit++;
+        resume = true;
+    }
+
+    for (; it != client->users.end(); it++)
     {
         Node *n;
         User *user = &(it->second);
-        for (handle_set::iterator sit = user->sharing.begin(); sit != user->sharing.end(); sit++)
+
+        if (!resume)
+        {
+            sit = user->sharing.begin();
+        }
+        resume = false;
+
+        for (; sit != user->sharing.end(); sit++)
         {
             if ((n = client->nodebyhandle(*sit)) && !n->parent)
             {
-                vNodes.push_back(n);
+                if (offset > 0)
+                {
+                    offset--;
+                    continue;
+                }
+
+                if (!limit)
+                {
+                    return;
+                }
+
+                result->push_back(n);
+
+                if (limit > 0)
+                {
+                    limit--;
+                }
             }
         }
     }
-
-    MegaNodeList *nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
-    sdkMutex.unlock();
-    return nodeList;
 }
 
 MegaShareList* MegaApiImpl::getInSharesList()
@@ -7524,7 +7605,22 @@ MegaShareList *MegaApiImpl::getOutShares()
     sdkMutex.lock();
 
     OutShareProcessor shareProcessor;
-    processTree(client->nodebyhandle(client->rootnodes[0]), &shareProcessor, true);
+    node_vector nodes, root(1, client->nodebyhandle(client->rootnodes[0]));
+    for (handle_set::iterator it = client->outsharenodes.begin(); it != client->outsharenodes.end(); it++)
+    {
+        Node *node = client->nodebyhandle(*it);
+        if (node)
+        {
+            nodes.push_back(node);
+        }
+    }
+
+    // in the order of a tree walk of the cloud drive
+    treeOrder(&nodes, &root);
+    for (node_vector::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        shareProcessor.processNode(*it);
+    }
     MegaShareList *shareList = new MegaShareListPrivate(shareProcessor.getShares().data(), shareProcessor.getHandles().data(), shareProcessor.getShares().size());
 
 	sdkMutex.unlock();
@@ -7572,7 +7668,22 @@ MegaShareList *MegaApiImpl::getPendingOutShares()
     sdkMutex.lock();
 
     PendingOutShareProcessor shareProcessor;
-    processTree(client->nodebyhandle(client->rootnodes[0]), &shareProcessor, true);
+    node_vector nodes, root(1, client->nodebyhandle(client->rootnodes[0]));
+    for (handle_set::iterator it = client->pendingsharenodes.begin(); it != client->pendingsharenodes.end(); it++)
+    {
+        Node *node = client->nodebyhandle(*it);
+        if (node)
+        {
+            nodes.push_back(node);
+        }
+    }
+
+    // in the order of a tree walk of the cloud drive
+    treeOrder(&nodes, &root);
+    for (node_vector::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        shareProcessor.processNode(*it);
+    }
     MegaShareList *shareList = new MegaShareListPrivate(shareProcessor.getShares().data(), shareProcessor.getHandles().data(), shareProcessor.getShares().size());
 
     sdkMutex.unlock();
@@ -7613,7 +7724,22 @@ MegaNodeList *MegaApiImpl::getPublicLinks()
     sdkMutex.lock();
 
     PublicLinkProcessor linkProcessor;
-    processTree(client->nodebyhandle(client->rootnodes[0]), &linkProcessor, true);
+    node_vector nodes, root(1, client->nodebyhandle(client->rootnodes[0]));
+    for (handle_set::iterator it = client->publiclinknodes.begin(); it != client->publiclinknodes.end(); it++)
+    {
+        Node *node = client->nodebyhandle(*it);
+        if (node)
+        {
+            nodes.push_back(node);
+        }
+    }
+
+    // in the order of a tree walk of the cloud drive
+    treeOrder(&nodes, &root);
+    for (node_vector::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        linkProcessor.processNode(*it);
+    }
     MegaNodeList *nodeList = new MegaNodeListPrivate(linkProcessor.getNodes().data(), linkProcessor.getNodes().size());
 
     sdkMutex.unlock();
@@ -7755,6 +7881,7 @@ bool MegaApiImpl::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, boo
 
     if (node->type != FILENODE)
     {
+        client->loadchildren(node);
         for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
         {
             MegaNode *megaNode = MegaNodePrivate::fromNode(*it++);
@@ -7794,36 +7921,368 @@ MegaNodeList *MegaApiImpl::search(const char *searchString)
     sdkMutex.lock();
 
     node_vector result;
-    Node *node;
+    searchNodes(searchString, &result);
+
+    MegaNodeList *nodeList = new MegaNodeListPrivate(result.data(), result.size());
+    
+    sdkMutex.unlock();
+
+    return nodeList;
+}
+
+MegaNodeList *MegaApiImpl::search(const char *searchString, int offset, int limit)
+{
+    if(!searchString)
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    sdkMutex.lock();
+
+    node_vector result;
+    searchNodes(searchString, &result, UNDEF, offset, limit);
+
+    MegaNodeList *nodeList = new MegaNodeListPrivate(result.data(), result.size());
+
+    sdkMutex.unlock();
+
+    return nodeList;
+}
+
+MegaNodeList *MegaApiImpl::searchAfter(const char *searchString, MegaHandle cursor, int limit)
+{
+    if(!searchString)
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    sdkMutex.lock();
+
+    node_vector result;
+    searchNodes(searchString, &result, cursor, 0, limit);
+
+    MegaNodeList *nodeList = new MegaNodeListPrivate(result.data(), result.size());
+
+    sdkMutex.unlock();
+
+    return nodeList;
+}
+
+// nodes containing a search string in their name, in the order of a walk
+// over the root nodes and the inbound shares (see processTree()) - only a
+// page of them if a cursor (the last node of the previous page), an offset
+// or a limit are given. The walk stops once the page is full.
+void MegaApiImpl::searchNodes(const char *searchString, node_vector *result, MegaHandle cursor, int offset, int limit)
+{
+    SearchTreeProcessor searchProcessor(searchString, offset, limit);
+    node_vector candidates;
+    Node *after = NULL;
+
+    if (cursor != UNDEF)
+    {
+        SearchTreeProcessor match(searchString);
+        after = client->nodebyhandle(cursor);
+        match.processNode(after);
+
+        // the cursor node doesn't match the search anymore
+        if (match.getResults().empty())
+        {
+            return;
+        }
+    }
+
+    if (client->searchcandidates(searchString, &candidates))
+    {
+        // the index has found the candidates already - the page is picked
+        // from them
+        searchScope(&candidates, NULL);
+
+        node_vector::iterator it = candidates.begin();
+        if (after)
+        {
+            it = std::find(candidates.begin(), candidates.end(), after);
+            if (it == candidates.end())
+            {
+                return;
+            }
+            it++;
+        }
+
+        while (it != candidates.end() && searchProcessor.processNode(*it++));
+    }
+    else
+    {
+        node_vector tops;
+
+        for (unsigned int i = 0; i < (sizeof client->rootnodes / sizeof *client->rootnodes); i++)
+        {
+            tops.push_back(client->nodebyhandle(client->rootnodes[i]));
+        }
+
+        getInSharesNodes(&tops);
+        processTreesAfter(&tops, after, &searchProcessor);
+    }
+
+    node_vector& vNodes = searchProcessor.getResults();
+    result->insert(result->end(), vNodes.begin(), vNodes.end());
+}
+
+// walk the trees of the given top nodes in the order of processTree(),
+// resuming right after the given node (if any) - false if that node isn't
+// visited by the walk. Stops when the processor returns false.
+bool MegaApiImpl::processTreesAfter(node_vector *tops, Node *after, TreeProcessor *processor)
+{
+    node_vector::iterator top = tops->begin();
+
+    if (after)
+    {
+        // file versions are not walked
+        Node *n = after;
+        while (n->parent)
+        {
+            if (n->parent->type == FILENODE)
+            {
+                return false;
+            }
+            n = n->parent;
+        }
+
+        if ((top = std::find(tops->begin(), tops->end(), n)) == tops->end())
+        {
+            return false;
+        }
+
+        // the rest of the subtrees on the path up to the top node, which
+        // follow their children
+        for (n = after; n != *top; n = n->parent)
+        {
+            Node *p = n->parent;
+            node_list::iterator it = n->child_it;
+
+            client->loadchildren(p);
+            for (it++; it != p->children.end(); )
+            {
+                if (!processTree(*it++, processor))
+                {
+                    return true;
+                }
+            }
+
+            if (!processor->processNode(p))
+            {
+                return true;
+            }
+        }
+
+        top++;
+    }
+
+    for (; top != tops->end(); top++)
+    {
+        if (!processTree(*top, processor))
+        {
+            break;
+        }
+    }
+
+    return true;
+}
+
+// walk the search scope: the subtree of a folder, or all root nodes and
+// inshares
+void MegaApiImpl::searchTree(Node *parent, TreeProcessor *processor)
+{
+    if (parent)
+    {
+        if (parent->type != FILENODE)
+        {
+            client->loadchildren(parent);
+            for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
+            {
+                processTree(*it++, processor);
+            }
+        }
+
+        return;
+    }
 
-    // rootnodes
     for (unsigned int i = 0; i < (sizeof client->rootnodes / sizeof *client->rootnodes); i++)
     {
-        node = client->nodebyhandle(client->rootnodes[i]);
+        processTree(client->nodebyhandle(client->rootnodes[i]), processor);
+    }
+
+    node_vector shares;
+    getInSharesNodes(&shares);
+    for (node_vector::iterator it = shares.begin(); it != shares.end(); it++)
+    {
+        processTree(*it, processor);
+    }
+}
+
+// keep the nodes found through an index that a tree walk over the search
+// scope would visit, in the order it would visit them (see treeOrder())
+void MegaApiImpl::searchScope(node_vector *nodes, Node *parent)
+{
+    node_vector tops;
+
+    if (parent)
+    {
+        if (parent->type != FILENODE)
+        {
+            tops.assign(parent->children.begin(), parent->children.end());
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < (sizeof client->rootnodes / sizeof *client->rootnodes); i++)
+        {
+            tops.push_back(client->nodebyhandle(client->rootnodes[i]));
+        }
 
-        SearchTreeProcessor searchProcessor(searchString);
-        processTree(node, &searchProcessor);
-        node_vector& vNodes = searchProcessor.getResults();
+        getInSharesNodes(&tops);
+    }
 
-        result.insert(result.end(), vNodes.begin(), vNodes.end());
+    treeOrder(nodes, &tops);
+}
+
+// keep the nodes that a tree walk (see processTree()) of the given subtrees
+// would visit, in the order it would visit them: children before their
+// parent, previous versions of files excluded. Only the folders on the
+// paths to the nodes are walked.
+void MegaApiImpl::treeOrder(node_vector *nodes, node_vector *tops)
+{
+    set<Node*> hits(nodes->begin(), nodes->end());
+    set<Node*> paths;
+
+    for (node_vector::iterator it = nodes->begin(); it != nodes->end(); it++)
+    {
+        for (Node *n = *it; n && paths.insert(n).second; n = n->parent);
     }
 
-    // inshares
-    MegaShareList *shares = getInSharesList();
-    for (int i = 0; i < shares->size(); i++)
+    nodes->clear();
+
+    for (node_vector::iterator it = tops->begin(); it != tops->end(); it++)
     {
-        node = client->nodebyhandle(shares->get(i)->getNodeHandle());
+        treeOrder(*it, &paths, &hits, nodes);
+    }
+}
 
-        SearchTreeProcessor searchProcessor(searchString);
-        processTree(node, &searchProcessor);
-        vector<Node *>& vNodes  = searchProcessor.getResults();
+void MegaApiImpl::treeOrder(Node *node, set<Node*> *paths, set<Node*> *hits, node_vector *result)
+{
+    if (!node || !paths->count(node))
+    {
+        return;
+    }
+
+    if (node->type != FILENODE)
+    {
+        for (node_list::iterator it = node->children.begin(); it != node->children.end(); it++)
+        {
+            treeOrder(*it, paths, hits, result);
+        }
+    }
 
-        result.insert(result.end(), vNodes.begin(), vNodes.end());
+    if (hits->count(node))
+    {
+        result->push_back(node);
+    }
+}
+
+MegaNodeList *MegaApiImpl::searchIndex(MegaNode *n, int attribute, int64_t min, int64_t max)
+{
+    sdkMutex.lock();
+
+    Node *parent = NULL;
+    if (n && !(parent = client->nodebyhandle(n->getHandle())))
+    {
+        sdkMutex.unlock();
+        return new MegaNodeListPrivate();
+    }
+
+    // there are too few node types for an index to pay off
+    nodevalue_set *index = NULL;
+    switch (attribute)
+    {
+        case NodeValueTreeProcessor::ATTR_SIZE:
+            index = &client->nodesbysize;
+            break;
+        case NodeValueTreeProcessor::ATTR_MTIME:
+            index = &client->nodesbymtime;
+            break;
+        case NodeValueTreeProcessor::ATTR_CTIME:
+            index = &client->nodesbyctime;
+            break;
+    }
+
+    node_vector result;
+    if (index && client->nodesbyrange(index, min, max, &result))
+    {
+        searchScope(&result, parent);
+    }
+    else
+    {
+        NodeValueTreeProcessor processor(attribute, min, max);
+        searchTree(parent, &processor);
+        result.swap(processor.getResults());
     }
-    delete shares;
 
     MegaNodeList *nodeList = new MegaNodeListPrivate(result.data(), result.size());
-    
+
+    sdkMutex.unlock();
+
+    return nodeList;
+}
+
+MegaNodeList *MegaApiImpl::searchBySize(MegaNode *node, long long minSize, long long maxSize)
+{
+    return searchIndex(node, NodeValueTreeProcessor::ATTR_SIZE, minSize, maxSize);
+}
+
+MegaNodeList *MegaApiImpl::searchByModificationTime(MegaNode *node, int64_t from, int64_t to)
+{
+    return searchIndex(node, NodeValueTreeProcessor::ATTR_MTIME, from, to);
+}
+
+MegaNodeList *MegaApiImpl::searchByCreationTime(MegaNode *node, int64_t from, int64_t to)
+{
+    return searchIndex(node, NodeValueTreeProcessor::ATTR_CTIME, from, to);
+}
+
+MegaNodeList *MegaApiImpl::searchByType(MegaNode *node, int type)
+{
+    return searchIndex(node, NodeValueTreeProcessor::ATTR_TYPE, type, type);
+}
+
+MegaNodeList *MegaApiImpl::searchByExtension(MegaNode *n, const char *extension)
+{
+    if (!extension)
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    sdkMutex.lock();
+
+    Node *parent = NULL;
+    if (n && !(parent = client->nodebyhandle(n->getHandle())))
+    {
+        sdkMutex.unlock();
+        return new MegaNodeListPrivate();
+    }
+
+    node_vector result;
+    if (client->nodesbyext(extension, &result))
+    {
+        searchScope(&result, parent);
+    }
+    else
+    {
+        ExtensionTreeProcessor processor(extension);
+        searchTree(parent, &processor);
+        result.swap(processor.getResults());
+    }
+
+    MegaNodeList *nodeList = new MegaNodeListPrivate(result.data(), result.size());
+
     sdkMutex.unlock();
 
     return nodeList;
@@ -8196,6 +8655,7 @@ bool MegaApiImpl::processTree(Node* node, TreeProcessor* processor, bool recursi
 
 	if (node->type != FILENODE)
 	{
+		client->loadchildren(node);
 		for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
 		{
 			if(recursive)
@@ -8238,9 +8698,23 @@ MegaNodeList* MegaApiImpl::search(MegaNode* n, const char* searchString, bool re
     }
 
     SearchTreeProcessor searchProcessor(searchString);
-    for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
+    node_vector candidates;
+
+    if (recursive && node->type != FILENODE && client->searchcandidates(searchString, &candidates))
     {
-        processTree(*it++, &searchProcessor, recursive);
+        searchScope(&candidates, node);
+        for (node_vector::iterator it = candidates.begin(); it != candidates.end(); it++)
+        {
+            searchProcessor.processNode(*it);
+        }
+    }
+    else
+    {
+        client->loadchildren(node);
+        for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
+        {
+            processTree(*it++, &searchProcessor, recursive);
+        }
     }
     vector<Node *>& vNodes = searchProcessor.getResults();
 
@@ -8274,9 +8748,7 @@ long long MegaApiImpl::getSize(MegaNode *n)
         sdkMutex.unlock();
         return 0;
     }
-    SizeProcessor sizeProcessor;
-    processTree(node, &sizeProcessor);
-    long long result = sizeProcessor.getTotalBytes();
+    long long result = node->counter.storage;
     sdkMutex.unlock();
 
     return result;
@@ -8557,6 +9029,7 @@ MegaNode *MegaApiImpl::getNodeByCRC(const char *crc, MegaNode *parent)
     byte binarycrc[sizeof(node->crc)];
     Base64::atob(crc, binarycrc, sizeof(binarycrc));
 
+    client->loadchildren(node);
     for (node_list::iterator it = node->children.begin(); it != node->children.end(); it++)
     {
         Node *child = (*it);
@@ -8572,7 +9045,12 @@ MegaNode *MegaApiImpl::getNodeByCRC(const char *crc, MegaNode *parent)
     return NULL;
 }
 
-SearchTreeProcessor::SearchTreeProcessor(const char *search) { this->search = search; }
+SearchTreeProcessor::SearchTreeProcessor(const char *search, int offset, int limit)
+{
+    this->search = search;
+    this->offset = offset;
+    this->limit = limit;
+}
 
 #if defined(_WIN32) || defined(__APPLE__)
 
@@ -8614,10 +9092,18 @@ bool SearchTreeProcessor::processNode(Node* node)
 
     if (strcasestr(node->displayname(), search)!=NULL)
     {
-        results.push_back(node);
+        if (offset > 0)
+        {
+            offset--;
+        }
+        else
+        {
+            results.push_back(node);
+        }
     }
 
-    return true;
+    // stop the walk once the page is full
+    return limit < 0 || results.size() < (size_t)limit;
 }
 
 vector<Node *> &SearchTreeProcessor::getResults()
@@ -8625,6 +9111,107 @@ vector<Node *> &SearchTreeProcessor::getResults()
 	return results;
 }
 
+NodeValueTreeProcessor::NodeValueTreeProcessor(int attribute, int64_t min, int64_t max)
+{
+    this->attribute = attribute;
+    this->min = min;
+    this->max = max;
+}
+
+bool NodeValueTreeProcessor::processNode(Node *node)
+{
+    if (!node)
+    {
+        return true;
+    }
+
+    int64_t value;
+    switch (attribute)
+    {
+        case ATTR_SIZE:
+            if (node->type != FILENODE)
+            {
+                return true;
+            }
+            value = node->size;
+            break;
+        case ATTR_MTIME:
+            // the mtime is known once the fingerprint was set
+            if (node->type != FILENODE || node->nodekey.size() < sizeof node->crc)
+            {
+                return true;
+            }
+            value = node->mtime;
+            break;
+        case ATTR_CTIME:
+            value = node->ctime;
+            break;
+        case ATTR_TYPE:
+            value = node->type;
+            break;
+        default:
+            return false;
+    }
+
+    if (value >= min && value <= max)
+    {
+        results.push_back(node);
+    }
+
+    return true;
+}
+
+vector<Node *> &NodeValueTreeProcessor::getResults()
+{
+    return results;
+}
+
+ExtensionTreeProcessor::ExtensionTreeProcessor(const char *extension)
+{
+    // case-insensitive, with or without the dot
+    if (*extension == '.')
+    {
+        extension++;
+    }
+
+    for (; *extension; extension++)
+    {
+        this->extension.push_back((*extension >= 'A' && *extension <= 'Z') ? *extension + ('a' - 'A') : *extension);
+    }
+}
+
+bool ExtensionTreeProcessor::processNode(Node *node)
+{
+    if (!node)
+    {
+        return true;
+    }
+
+    if (node->type == FILENODE && !node->attrstring)
+    {
+        attr_map::iterator it = node->attrs().map.find('n');
+
+        if (it != node->attrs().map.end())
+        {
+            string ext;
+
+            Node::extension(it->second.c_str(), &ext);
+
+            if (ext.size() && ext == extension)
+            {
+                results.push_back(node);
+            }
+        }
+    }
+
+    return true;
+}
+
+vector<Node *> &ExtensionTreeProcessor::getResults()
+{
+    return results;
+}
+
 SizeProcessor::SizeProcessor()
 {
     totalBytes=0;
@@ -9956,7 +10543,7 @@ void MegaApiImpl::fetchnodes_result(error e)
             if (h != UNDEF)
             {
                 Node *n = client->nodebyhandle(h);
-                if (n && (n->attrs.map.find('n') == n->attrs.map.end()))
+                if (n && (n->attrs().map.find('n') == n->attrs().map.end()))
                 {
                     request->setFlag(true);
                 }
@@ -12573,7 +13160,7 @@ int MegaApiImpl::getNumChildren(MegaNode* p)
 		return 0;
 	}
 
-	int numChildren = parent->children.size();
+	int numChildren = parent->numchildfiles + parent->numchildfolders;
 	sdkMutex.unlock();
 
 	return numChildren;
@@ -12594,12 +13181,7 @@ int MegaApiImpl::getNumChildFiles(MegaNode* p)
 		return 0;
 	}
 
-	int numFiles = 0;
-	for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
-	{
-		if ((*it)->type == FILENODE)
-			numFiles++;
-	}
+	int numFiles = parent->numchildfiles;
 	sdkMutex.unlock();
 
 	return numFiles;
@@ -12620,12 +13202,7 @@ int MegaApiImpl::getNumChildFolders(MegaNode* p)
 		return 0;
 	}
 
-	int numFolders = 0;
-	for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
-	{
-		if ((*it)->type != FILENODE)
-			numFolders++;
-	}
+	int numFolders = parent->numchildfolders;
 	sdkMutex.unlock();
 
 	return numFolders;
@@ -12651,6 +13228,7 @@ MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order)
 
     if(!order || order> MegaApi::ORDER_ALPHABETICAL_DESC)
 	{
+		client->loadchildren(parent);
 		for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
             childrenNodes.push_back(*it++);
 	}
@@ -12672,13 +13250,7 @@ MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order)
         default: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
 		}
 
-		for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
-		{
-            Node *n = *it++;
-            vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
-					childrenNodes.end(), n, comp);
-            childrenNodes.insert(i, n);
-		}
+        client->sortedchildren(parent, comp, &childrenNodes);
 	}
 
     MegaNodeListPrivate *result = NULL;
@@ -12694,6 +13266,74 @@ MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order)
     return result;
 }
 
+MegaNodeList *MegaApiImpl::getChildren(MegaNode *parent, int order, int offset, int limit)
+{
+    return getChildrenWindow(parent, order, UNDEF, offset, limit);
+}
+
+MegaNodeList *MegaApiImpl::getChildrenAfter(MegaNode *parent, int order, MegaHandle cursor, int limit)
+{
+    return getChildrenWindow(parent, order, cursor, 0, limit);
+}
+
+MegaNodeList *MegaApiImpl::getChildrenWindow(MegaNode *p, int order, MegaHandle cursor, int offset, int limit)
+{
+    if (!p || p->getType() == MegaNode::TYPE_FILE)
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    sdkMutex.lock();
+    Node *parent = client->nodebyhandle(p->getHandle());
+    if (!parent || parent->type == FILENODE)
+    {
+        sdkMutex.unlock();
+        return new MegaNodeListPrivate();
+    }
+
+    Node *after = NULL;
+    if (cursor != UNDEF && !(after = client->nodebyhandle(cursor)))
+    {
+        sdkMutex.unlock();
+        return new MegaNodeListPrivate();
+    }
+
+    vector<Node *> childrenNodes;
+    client->childrenwindow(parent, getNodeComparator(order), after,
+                           (offset > 0) ? offset : 0, (limit >= 0) ? limit : (size_t)-1,
+                           &childrenNodes);
+
+    MegaNodeListPrivate *result = NULL;
+    if (childrenNodes.size())
+    {
+        result = new MegaNodeListPrivate(childrenNodes.data(), childrenNodes.size());
+    }
+    else
+    {
+        result = new MegaNodeListPrivate();
+    }
+    sdkMutex.unlock();
+    return result;
+}
+
+nodecomparator MegaApiImpl::getNodeComparator(int order)
+{
+    switch(order)
+    {
+        case MegaApi::ORDER_DEFAULT_ASC: return MegaApiImpl::nodeComparatorDefaultASC;
+        case MegaApi::ORDER_DEFAULT_DESC: return MegaApiImpl::nodeComparatorDefaultDESC;
+        case MegaApi::ORDER_SIZE_ASC: return MegaApiImpl::nodeComparatorSizeASC;
+        case MegaApi::ORDER_SIZE_DESC: return MegaApiImpl::nodeComparatorSizeDESC;
+        case MegaApi::ORDER_CREATION_ASC: return MegaApiImpl::nodeComparatorCreationASC;
+        case MegaApi::ORDER_CREATION_DESC: return MegaApiImpl::nodeComparatorCreationDESC;
+        case MegaApi::ORDER_MODIFICATION_ASC: return MegaApiImpl::nodeComparatorModificationASC;
+        case MegaApi::ORDER_MODIFICATION_DESC: return MegaApiImpl::nodeComparatorModificationDESC;
+        case MegaApi::ORDER_ALPHABETICAL_ASC: return MegaApiImpl::nodeComparatorAlphabeticalASC;
+        case MegaApi::ORDER_ALPHABETICAL_DESC: return MegaApiImpl::nodeComparatorAlphabeticalDESC;
+        default: return NULL;
+    }
+}
+
 MegaNodeList *MegaApiImpl::getVersions(MegaNode *node)
 {
     if (!node || node->getType() != MegaNode::TYPE_FILE)
@@ -12711,12 +13351,14 @@ MegaNodeList *MegaApiImpl::getVersions(MegaNode *node)
 
     vector<Node*> versions;
     versions.push_back(current);
+    client->loadchildren(current);
     while (current->children.size())
     {
         assert(current->children.back()->parent == current);
         current = current->children.back();
         assert(current->type == FILENODE);
         versions.push_back(current);
+        client->loadchildren(current);
     }
 
     MegaNodeListPrivate *result = new MegaNodeListPrivate(versions.data(), versions.size());
@@ -12740,12 +13382,14 @@ int MegaApiImpl::getNumVersions(MegaNode *node)
     }
 
     int numVersions = 1;
+    client->loadchildren(current);
     while (current->children.size())
     {
         assert(current->children.back()->parent == current);
         current = current->children.back();
         assert(current->type == FILENODE);
         numVersions++;
+        client->loadchildren(current);
     }
     sdkMutex.unlock();
     return numVersions;
@@ -12766,6 +13410,7 @@ bool MegaApiImpl::hasVersions(MegaNode *node)
         return false;
     }
 
+    client->loadchildren(current);
     assert(!current->children.size()
            || (current->children.back()->parent == current
                && current->children.back()->type == FILENODE));
@@ -12795,6 +13440,7 @@ MegaChildrenLists *MegaApiImpl::getFileFolderChildren(MegaNode *p, int order)
 
     if(!order || order> MegaApi::ORDER_ALPHABETICAL_DESC)
     {
+        client->loadchildren(parent);
         for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
         {
             Node *n = *it++;
@@ -12826,18 +13472,19 @@ MegaChildrenLists *MegaApiImpl::getFileFolderChildren(MegaNode *p, int order)
         default: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
         }
 
-        for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
+        vector<Node *> childrenNodes;
+        client->sortedchildren(parent, comp, &childrenNodes);
+
+        for (vector<Node *>::iterator it = childrenNodes.begin(); it != childrenNodes.end(); it++)
         {
-            Node *n = *it++;
+            Node *n = *it;
             if (n->type == FILENODE)
             {
-                vector<Node *>::iterator i = std::lower_bound(files.begin(), files.end(), n, comp);
-                files.insert(i, n);
+                files.push_back(n);
             }
             else // if (n->type == FOLDERNODE)
             {
-                vector<Node *>::iterator i = std::lower_bound(folders.begin(), folders.end(), n, comp);
-                folders.insert(i, n);
+                folders.push_back(n);
             }
         }
     }
@@ -12881,6 +13528,7 @@ bool MegaApiImpl::hasChildren(MegaNode *parent)
         return false;
     }
 
+    client->loadchildren(p);
     bool ret = p->children.size();
     sdkMutex.unlock();
 
@@ -12933,13 +13581,7 @@ int MegaApiImpl::getIndex(MegaNode *n, int order)
     }
 
     vector<Node *> childrenNodes;
-    for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
-    {
-        Node *temp = *it++;
-        vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
-                childrenNodes.end(), temp, comp);
-        childrenNodes.insert(i, temp);
-    }
+    client->sortedchildren(parent, comp, &childrenNodes);
 
     vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
             childrenNodes.end(), node, comp);
@@ -13090,6 +13732,12 @@ char* MegaApiImpl::getNodePath(MegaNode *node)
 	}
 
 	string path;
+    if (client->pathcache.getpath(n, &path))
+    {
+        sdkMutex.unlock();
+        return stringToArray(path);
+    }
+
 	if (n->nodehandle == client->rootnodes[0])
 	{
 		path = "/";
@@ -13097,7 +13745,9 @@ char* MegaApiImpl::getNodePath(MegaNode *node)
         return stringToArray(path);
 	}
 
-	while (n)
+    Node *target = n;
+    bool done = false;
+	while (n && !done)
 	{
 		switch (n->type)
 		{
@@ -13109,24 +13759,24 @@ char* MegaApiImpl::getNodePath(MegaNode *node)
 				path.insert(0,":");
 				if (n->inshare->user) path.insert(0,n->inshare->user->email);
 				else path.insert(0,"UNKNOWN");
-                sdkMutex.unlock();
-                return stringToArray(path);
+                done = true;
+                continue;
 			}
 			break;
 
 		case INCOMINGNODE:
 			path.insert(0,"//in");
-            sdkMutex.unlock();
-            return stringToArray(path);
+            done = true;
+            continue;
 
 		case ROOTNODE:
-            sdkMutex.unlock();
-            return stringToArray(path);
+            done = true;
+            continue;
 
 		case RUBBISHNODE:
 			path.insert(0,"//bin");
-            sdkMutex.unlock();
-            return stringToArray(path);
+            done = true;
+            continue;
 
 		case TYPE_UNKNOWN:
 		case FILENODE:
@@ -13137,6 +13787,8 @@ char* MegaApiImpl::getNodePath(MegaNode *node)
 
         n = n->parent;
 	}
+
+    client->pathcache.putpath(target, path);
     sdkMutex.unlock();
     return stringToArray(path);
 }
@@ -13146,6 +13798,17 @@ MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
     if(!path) return NULL;
 
     sdkMutex.lock();
+
+    // only absolute paths are cached, so the current folder doesn't matter
+    string fullpath = path;
+    Node *cached = client->pathcache.getnode(fullpath);
+    if (cached)
+    {
+        MegaNode *result = MegaNodePrivate::fromNode(cached);
+        sdkMutex.unlock();
+        return result;
+    }
+
     Node *cwd = NULL;
     if(node) cwd = client->nodebyhandle(node->getHandle());
 
@@ -13345,6 +14008,26 @@ MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
 		l++;
 	}
 
+    // cache absolute paths whose resolution only depends on the names of
+    // the result and its ancestors (no "." or ".." components)
+    if (n && !remote && c.size() > 1 && !c[0].size())
+    {
+        bool cacheable = true;
+        for (unsigned i = 0; i < c.size(); i++)
+        {
+            if (c[i] == "." || c[i] == "..")
+            {
+                cacheable = false;
+                break;
+            }
+        }
+
+        if (cacheable)
+        {
+            client->pathcache.putnode(fullpath, n);
+        }
+    }
+
     MegaNode *result = MegaNodePrivate::fromNode(n);
     sdkMutex.unlock();
     return result;
@@ -13470,7 +14153,7 @@ void MegaApiImpl::sendPendingTransfers()
                         AttrMap attrs;
                         string attrstring;
                         key.setkey((const byte*)tc.nn[0].nodekey.data(), samenode->type);
-                        attrs = samenode->attrs;
+                        attrs = samenode->attrs();
                         string sname = fileName;
                         fsAccess->normalize(&sname);
                         attrs.map['n'] = sname;
@@ -13592,8 +14275,8 @@ void MegaApiImpl::sendPendingTransfers()
                     {
                         if (!fileName)
                         {
-                            attr_map::iterator ait = node->attrs.map.find('n');
-                            if (ait == node->attrs.map.end())
+                            attr_map::iterator ait = node->attrs().map.find('n');
+                            if (ait == node->attrs().map.end())
                             {
                                 name = "CRYPTO_ERROR";
                             }
@@ -14020,8 +14703,8 @@ void MegaApiImpl::sendPendingRequests()
 
                 if (node->type == FILENODE)
                 {
-                    attr_map::iterator it = node->attrs.map.find('n');
-                    if (it != node->attrs.map.end())
+                    attr_map::iterator it = node->attrs().map.find('n');
+                    if (it != node->attrs().map.end())
                     {
                         Node *ovn = client->childnodebyname(newParent, it->second.c_str(), true);
                         if (ovn)
@@ -14192,8 +14875,8 @@ void MegaApiImpl::sendPendingRequests()
                 }
                 else
                 {
-                    attr_map::iterator it = node->attrs.map.find('n');
-                    if (it != node->attrs.map.end())
+                    attr_map::iterator it = node->attrs().map.find('n');
+                    if (it != node->attrs().map.end())
                     {
                         sname = it->second;
                     }
@@ -14234,7 +14917,7 @@ void MegaApiImpl::sendPendingRequests()
                     string attrstring;
 
                     key.setkey((const byte*)tc.nn->nodekey.data(), node->type);
-                    attrs = node->attrs;
+                    attrs = node->attrs();
 
                     attrs.map['n'] = sname;
 
@@ -14294,7 +14977,7 @@ void MegaApiImpl::sendPendingRequests()
             if (newnode->nodekey.size())
             {
                 key.setkey((const byte*)version->nodekey.data(), version->type);
-                version->attrs.getjson(&attrstring);
+                version->attrs().getjson(&attrstring);
                 client->makeattr(&key, newnode->attrstring, attrstring.c_str());
             }
 
@@ -14311,7 +14994,7 @@ void MegaApiImpl::sendPendingRequests()
 
             string sname = newName;
             fsAccess->normalize(&sname);
-            node->attrs.map['n'] = sname;
+            node->attrs().map['n'] = sname;
             e = client->setattr(node);
             break;
         }
@@ -14876,7 +15559,7 @@ void MegaApiImpl::sendPendingRequests()
 
                     if (secs == MegaNode::INVALID_DURATION)
                     {
-                        node->attrs.map.erase('d');
+                        node->attrs().map.erase('d');
                     }
                     else
                     {
@@ -14884,7 +15567,7 @@ void MegaApiImpl::sendPendingRequests()
                         Base64::itoa(secs, &attrVal);
                         if (attrVal.size())
                         {
-                            node->attrs.map['d'] = attrVal;
+                            node->attrs().map['d'] = attrVal;
                         }
                     }
                 }
@@ -14902,7 +15585,7 @@ void MegaApiImpl::sendPendingRequests()
 
                     if (longitude == MegaNode::INVALID_COORDINATE && latitude == MegaNode::INVALID_COORDINATE)
                     {
-                        node->attrs.map.erase(coordsName);
+                        node->attrs().map.erase(coordsName);
                     }
                     else
                     {
@@ -14922,7 +15605,7 @@ void MegaApiImpl::sendPendingRequests()
                         lonValue.resize(Base64::btoa((const byte*) &longitude, 3, (char*)lonValue.data()));
 
                         string coordsValue = latValue + lonValue;
-                        node->attrs.map[coordsName] = coordsValue;
+                        node->attrs().map[coordsName] = coordsValue;
                     }
                 }
                 else
@@ -14951,11 +15634,11 @@ void MegaApiImpl::sendPendingRequests()
                 {
                     string svalue = attrValue;
                     fsAccess->normalize(&svalue);
-                    node->attrs.map[attr] = svalue;
+                    node->attrs().map[attr] = svalue;
                 }
                 else
                 {
-                    node->attrs.map.erase(attr);
+                    node->attrs().map.erase(attr);
                 }
             }
 
@@ -16498,7 +17181,7 @@ void TreeProcCopy::proc(MegaClient* client, Node* n)
 		{
 			key.setkey((const byte*)t->nodekey.data(),n->type);
 
-			n->attrs.getjson(&attrstring);
+			n->attrs().getjson(&attrstring);
 			client->makeattr(&key,t->attrstring,attrstring.c_str());
 		}
 	}
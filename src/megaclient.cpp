@@ -139,6 +139,36 @@ bool MegaClient::decryptkey(const char* sk, byte* tk, int tl, SymmCipher* sc, in
     return true;
 }
 
+void MegaClient::updatesharednodes(Node* n)
+{
+    if (n->outshares)
+    {
+        outsharenodes.insert(n->nodehandle);
+    }
+    else
+    {
+        outsharenodes.erase(n->nodehandle);
+    }
+
+    if (n->pendingshares)
+    {
+        pendingsharenodes.insert(n->nodehandle);
+    }
+    else
+    {
+        pendingsharenodes.erase(n->nodehandle);
+    }
+
+    if (n->plink)
+    {
+        publiclinknodes.insert(n->nodehandle);
+    }
+    else
+    {
+        publiclinknodes.erase(n->nodehandle);
+    }
+}
+
 // apply queued new shares
 void MegaClient::mergenewshares(bool notify)
 {
@@ -284,6 +314,7 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
                         n->inshare->user->sharing.erase(n->nodehandle);
                         notifyuser(n->inshare->user);
                         n->inshare = NULL;
+                        pathcache.invalidate(n);
                     }
                 }
             }
@@ -408,6 +439,7 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
                             {
                                 n->inshare = new Share(finduser(s->peer, 1), s->access, s->ts, NULL);
                                 n->inshare->user->sharing.insert(n->nodehandle);
+                                pathcache.invalidate(n);
                             }
 
                             if (notify)
@@ -432,10 +464,23 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
                     {
                         TreeProcApplyKey td;
                         proctree(n, &td);
+                        applykeys(&td.nodes);
+
+                        for (node_vector::iterator it = td.nodes.begin(); it != td.nodes.end(); it++)
+                        {
+                            if (!(*it)->attrstring)
+                            {
+                                (*it)->changed.attrs = true;
+                                notifynode(*it);
+                            }
+                        }
                     }
                 }
             }
         }
+
+        updatesharednodes(n);
+
 #ifdef ENABLE_SYNC
         if (n->inshare && s->access != FULL)
         {
@@ -735,6 +780,57 @@ Node* MegaClient::childnodebyname(Node* p, const char* name, bool skipfolders)
 
     fsaccess->normalize(&nname);
 
+    if (nodepaging && !p->childrenloaded)
+    {
+        // only load the children with a matching name hash (or none, if
+        // their name was not decrypted when indexed) - resident children
+        // are matched by their current name below
+        handle_vector handles;
+
+        if (sctable && sctable->getchildnodesbyname(p->nodehandle, dbnamehash(nname.c_str()), &handles))
+        {
+            for (handle_vector::iterator it = handles.begin(); it != handles.end(); it++)
+            {
+                nodebyhandle(*it);
+            }
+        }
+        else
+        {
+            loadchildren(p);
+        }
+    }
+
+    if (!p->childnames && p->children.size() >= CHILDNAMEINDEXTHRESHOLD)
+    {
+        p->indexchildnames();
+    }
+
+    if (p->childnames)
+    {
+        pair<nodename_multimap::iterator, nodename_multimap::iterator> range;
+
+        range = p->childnames->equal_range(Node::namehash(nname.c_str()));
+
+        for (nodename_multimap::iterator it = range.first; it != range.second; it++)
+        {
+            if (!strcmp(nname.c_str(), it->second->displayname()))
+            {
+                if (it->second->type != FILENODE && !skipfolders)
+                {
+                    return it->second;
+                }
+
+                found = it->second;
+                if (skipfolders)
+                {
+                    return found;
+                }
+            }
+        }
+
+        return found;
+    }
+
     for (node_list::iterator it = p->children.begin(); it != p->children.end(); it++)
     {
         if (!strcmp(nname.c_str(), (*it)->displayname()))
@@ -755,6 +851,340 @@ Node* MegaClient::childnodebyname(Node* p, const char* name, bool skipfolders)
     return found;
 }
 
+// build the search and extension indexes, which are left empty while the
+// node tree is loaded until the first query that needs them
+void MegaClient::indexnames()
+{
+    if (namesindexed)
+    {
+        return;
+    }
+
+    searchindex.clear();
+    nodesbyextension.clear();
+
+    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        Node* n = it->second;
+
+        // this decodes the attributes of all nodes
+        if (!n->attrstring)
+        {
+            attr_map::iterator ait = n->attrs().map.find('n');
+
+            if (ait != n->attrs().map.end() && ait->second.size())
+            {
+                n->searchnamehash = Node::namehash(ait->second.c_str());
+                searchindex.add(n->nodehandle, ait->second.c_str());
+
+                if (n->type == FILENODE)
+                {
+                    string ext;
+
+                    Node::extension(ait->second.c_str(), &ext);
+
+                    if (ext.size())
+                    {
+                        n->extension_it = nodesbyextension.insert(pair<string, Node*>(ext, n));
+                    }
+                }
+            }
+        }
+    }
+
+    namesindexed = true;
+
+    LOG_debug << "Name indexes built with " << searchindex.size() << " names";
+}
+
+bool MegaClient::searchcandidates(const char* query, node_vector* result)
+{
+    // the index would only cover resident nodes
+    if (nodepaging)
+    {
+        return false;
+    }
+
+    if (!namesindexed)
+    {
+        indexnames();
+    }
+    else if (searchindex.needsrebuild())
+    {
+        // get rid of the entries left behind by removed and renamed nodes
+        searchindex.clear();
+
+        for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+        {
+            Node* n = it->second;
+
+            if (n->searchnamehash)
+            {
+                attr_map::iterator ait = n->attrs().map.find('n');
+
+                if (ait != n->attrs().map.end())
+                {
+                    searchindex.add(n->nodehandle, ait->second.c_str());
+                }
+            }
+        }
+
+        LOG_debug << "Search index rebuilt with " << searchindex.size() << " names";
+    }
+
+    handle_vector handles;
+
+    if (!searchindex.candidates(query, &handles))
+    {
+        return false;
+    }
+
+    for (handle_vector::iterator it = handles.begin(); it != handles.end(); it++)
+    {
+        Node* n = nodebyhandle(*it);
+
+        // skip stale entries
+        if (n && n->searchnamehash)
+        {
+            result->push_back(n);
+        }
+    }
+
+    return true;
+}
+
+// strict weak ordering derived from a "less or equal" comparator
+struct NodeComparatorLess
+{
+    nodecomparator comp;
+
+    NodeComparatorLess(nodecomparator c) : comp(c) { }
+
+    bool operator()(Node* a, Node* b) const
+    {
+        return !comp(b, a);
+    }
+};
+
+node_vector* MegaClient::childview(Node* p, nodecomparator comp)
+{
+    loadchildren(p);
+
+    if (!p->childviews)
+    {
+        p->childviews = new childview_list;
+    }
+
+    for (childview_list::iterator it = p->childviews->begin(); it != p->childviews->end(); it++)
+    {
+        if (it->comp == comp)
+        {
+            return &it->nodes;
+        }
+    }
+
+    // first listing in this order: sort once, later changes are applied
+    // incrementally by the children
+    childview_list::iterator it = p->childviews->insert(p->childviews->end(), ChildView());
+    it->comp = comp;
+    it->nodes.assign(p->children.begin(), p->children.end());
+    stable_sort(it->nodes.begin(), it->nodes.end(), NodeComparatorLess(comp));
+
+    return &it->nodes;
+}
+
+void MegaClient::sortedchildren(Node* p, nodecomparator comp, node_vector* result)
+{
+    loadchildren(p);
+
+    if (p->numchildfiles + p->numchildfolders < CHILDVIEWTHRESHOLD)
+    {
+        result->assign(p->children.begin(), p->children.end());
+        stable_sort(result->begin(), result->end(), NodeComparatorLess(comp));
+    }
+    else
+    {
+        *result = *childview(p, comp);
+    }
+}
+
+void MegaClient::childrenwindow(Node* p, nodecomparator comp, Node* after, size_t offset, size_t count, node_vector* result)
+{
+    // the previous page ended with a node that has left the folder since
+    if (after && after->parent != p)
+    {
+        return;
+    }
+
+    loadchildren(p);
+
+    if (!comp)
+    {
+        node_list::iterator it = p->children.begin();
+
+        if (after)
+        {
+            it = after->child_it;
+            it++;
+        }
+
+        for (; it != p->children.end() && offset; it++, offset--);
+
+        for (; it != p->children.end() && count; it++, count--)
+        {
+            result->push_back(*it);
+        }
+
+        return;
+    }
+
+    node_vector sorted;
+    node_vector* nodes;
+
+    if (p->numchildfiles + p->numchildfolders < CHILDVIEWTHRESHOLD)
+    {
+        sortedchildren(p, comp, &sorted);
+        nodes = &sorted;
+    }
+    else
+    {
+        nodes = childview(p, comp);
+    }
+
+    node_vector::iterator it = nodes->begin();
+
+    if (after)
+    {
+        // binary search to the first equivalent node, then look for the node itself
+        it = lower_bound(nodes->begin(), nodes->end(), after, NodeComparatorLess(comp));
+
+        while (it != nodes->end() && *it != after)
+        {
+            it++;
+        }
+
+        if (it == nodes->end())
+        {
+            return;
+        }
+
+        it++;
+    }
+
+    size_t available = nodes->end() - it;
+
+    if (offset >= available)
+    {
+        return;
+    }
+
+    it += offset;
+    available -= offset;
+
+    result->insert(result->end(), it, it + ((count < available) ? count : available));
+}
+
+// build the value indexes, which are left empty until the first query
+// that needs them
+void MegaClient::indexvalues()
+{
+    if (valuesindexed)
+    {
+        return;
+    }
+
+    nodesbysize.clear();
+    nodesbymtime.clear();
+    nodesbyctime.clear();
+
+    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        Node* n = it->second;
+
+        if (n->type == FILENODE)
+        {
+            nodesbysize.insert(pair<int64_t, Node*>(n->size, n));
+
+            // the mtime is known once the fingerprint was set
+            if (n->nodekey.size() >= sizeof n->crc)
+            {
+                nodesbymtime.insert(pair<int64_t, Node*>(n->mtime, n));
+            }
+        }
+
+        nodesbyctime.insert(pair<int64_t, Node*>(n->ctime, n));
+    }
+
+    valuesindexed = true;
+
+    LOG_debug << "Value indexes built with " << nodesbyctime.size() << " nodes";
+}
+
+void MegaClient::reindexvalue(nodevalue_set* index, Node* n, int64_t oldvalue, int64_t newvalue)
+{
+    if (valuesindexed)
+    {
+        index->erase(pair<int64_t, Node*>(oldvalue, n));
+        index->insert(pair<int64_t, Node*>(newvalue, n));
+    }
+}
+
+bool MegaClient::nodesbyrange(nodevalue_set* index, int64_t min, int64_t max, node_vector* result)
+{
+    // the index would only cover resident nodes
+    if (nodepaging)
+    {
+        return false;
+    }
+
+    if (min > max)
+    {
+        return true;
+    }
+
+    indexvalues();
+
+    nodevalue_set::iterator it = index->lower_bound(pair<int64_t, Node*>(min, (Node*)NULL));
+
+    for (; it != index->end() && it->first <= max; it++)
+    {
+        result->push_back(it->second);
+    }
+
+    return true;
+}
+
+bool MegaClient::nodesbyext(const char* ext, node_vector* result)
+{
+    string key;
+
+    if (nodepaging)
+    {
+        return false;
+    }
+
+    if (*ext == '.')
+    {
+        ext++;
+    }
+
+    for (; *ext; ext++)
+    {
+        key.push_back((*ext >= 'A' && *ext <= 'Z') ? *ext + ('a' - 'A') : *ext);
+    }
+
+    indexnames();
+
+    pair<nodestring_multimap::iterator, nodestring_multimap::iterator> range = nodesbyextension.equal_range(key);
+
+    for (nodestring_multimap::iterator it = range.first; it != range.second; it++)
+    {
+        result->push_back(it->second);
+    }
+
+    return true;
+}
+
 void MegaClient::init()
 {
     warned = false;
@@ -808,6 +1238,7 @@ void MegaClient::init()
 }
 
 MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, DbAccess* d, GfxProc* g, const char* k, const char* u)
+    : nodeslab(Node::ALLOCSIZE)
 {
     sctable = NULL;
     pendingsccommit = false;
@@ -822,6 +1253,20 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
     scpaused = false;
     asyncfopens = 0;
     achievements_enabled = false;
+    namesindexed = false;
+    valuesindexed = false;
+    usesnapshots = false;
+    asyncsc = false;
+    maxresidentnodes = 0;
+    nodepaging = false;
+    pagingnode = false;
+
+#ifdef THREAD_CLASS
+    workerthreads = 4;
+#else
+    workerthreads = 0;
+#endif
+    workerpool = NULL;
     tsLogin = false;
     versions_disabled = false;
 
@@ -944,6 +1389,10 @@ MegaClient::~MegaClient()
     delete sctable;
     delete tctable;
     delete dbaccess;
+
+#ifdef THREAD_CLASS
+    delete workerpool;
+#endif
 }
 
 // nonblocking state machine executing all operations currently in progress
@@ -1741,6 +2190,9 @@ void MegaClient::exec()
             }
         }
 
+        // submit the file reads/writes of all slots at once
+        fsaccess->flushasyncio();
+
 #ifdef ENABLE_SYNC
         // verify filesystem fingerprints, disable deviating syncs
         // (this covers mountovers, some device removals and some failures)
@@ -2268,6 +2720,7 @@ void MegaClient::exec()
 #endif
 
         notifypurge();
+        evictnodes();
 
         if (!badhostcs && badhosts.size() && btbadhost.armed())
         {
@@ -2796,27 +3249,8 @@ bool MegaClient::dispatch(direction_t d)
                     m_off_t p = 0;
 
                     // resume at the end of the last contiguous completed block
-                    for (chunkmac_map::iterator it = nexttransfer->chunkmacs.begin();
-                         it != nexttransfer->chunkmacs.end(); it++)
-                    {
-                        m_off_t chunkceil = ChunkedHash::chunkceil(it->first, nexttransfer->size);
-
-                        if (nexttransfer->pos == it->first && it->second.finished)
-                        {
-                            nexttransfer->pos = chunkceil;
-                            nexttransfer->progresscompleted = chunkceil;
-                        }
-                        else if (it->second.finished)
-                        {
-                            m_off_t chunksize = chunkceil - ChunkedHash::chunkfloor(it->first);
-                            nexttransfer->progresscompleted += chunksize;
-                        }
-                        else
-                        {
-                            nexttransfer->progresscompleted += it->second.offset;
-                            p += it->second.offset;
-                        }
-                    }
+                    nexttransfer->chunkmacs.calcprogress(nexttransfer->size, &nexttransfer->pos,
+                                                         &nexttransfer->progresscompleted, &p);
 
                     if (nexttransfer->progresscompleted > nexttransfer->size)
                     {
@@ -2860,6 +3294,13 @@ bool MegaClient::dispatch(direction_t d)
                 }
                 else
                 {
+                    // reserve the space of the whole file, so that the ranges
+                    // written by the parallel requests don't fragment it
+                    if (nexttransfer->size && !ts->fa->preallocate(nexttransfer->size))
+                    {
+                        LOG_verbose << "Unable to preallocate the download file";
+                    }
+
                     for (file_list::iterator it = nexttransfer->files.begin();
                          it != nexttransfer->files.end(); it++)
                     {
@@ -3704,6 +4145,9 @@ void MegaClient::initsc()
         sctable->begin();
         sctable->truncate();
 
+        // all nodes are resident: a complete index can be written
+        sctable->createnodeindex();
+
         // 1. write current scsn
         handle tscsn;
         Base64::atob(scsn, (byte*)&tscsn, sizeof tscsn);
@@ -3726,7 +4170,7 @@ void MegaClient::initsc()
             // 3. write new or modified nodes, purge deleted nodes
             for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDNODE, it->second, &key)))
+                if (!(complete = cachenode(it->second)))
                 {
                     break;
                 }
@@ -3763,6 +4207,8 @@ void MegaClient::initsc()
         LOG_debug << "Saving SCSN " << scsn << " with " << nodes.size() << " nodes and " << users.size() << " users and " << pcrindex.size() << " pcrs to local cache (" << complete << ")";
  #endif
         finalizesc(complete);
+
+        nodepaging = complete && maxresidentnodes && sctable->hasnodeindex();
     }
 }
 
@@ -3771,16 +4217,10 @@ void MegaClient::updatesc()
 {
     if (sctable)
     {
-        string t;
-
-        sctable->get(CACHEDSCSN, &t);
-
-        if (t.size() != sizeof cachedscsn)
+        // nothing to update before initsc() or fetchsc() (checked in memory,
+        // so that the update does not wait for earlier writes to the table)
+        if (ISUNDEF(cachedscsn))
         {
-            if (t.size())
-            {
-                LOG_err << "Invalid scsn size";
-            }
             return;
         }
 
@@ -3839,7 +4279,7 @@ void MegaClient::updatesc()
                 else
                 {
                     LOG_verbose << "Adding node to database: " << (Base64::btoa((byte*)&((*it)->nodehandle),MegaClient::NODEHANDLE,base64) ? base64 : "");
-                    if (!(complete = sctable->put(CACHEDNODE, *it, &key)))
+                    if (!(complete = cachenode(*it)))
                     {
                         break;
                     }
@@ -3903,6 +4343,7 @@ void MegaClient::finalizesc(bool complete)
     if (complete)
     {
         Base64::atob(scsn, (byte*)&cachedscsn, sizeof cachedscsn);
+        sctable->checkpoint();
     }
     else
     {
@@ -3913,6 +4354,13 @@ void MegaClient::finalizesc(bool complete)
         delete sctable;
         sctable = NULL;
         pendingsccommit = false;
+
+        if (nodepaging)
+        {
+            // the non-resident nodes are gone with the cache
+            nodepaging = false;
+            app->reload("Local cache write error");
+        }
     }
 }
 
@@ -4178,7 +4626,7 @@ void MegaClient::sc_updatenode()
 
                         if (ts + 1)
                         {
-                            n->ctime = ts;
+                            n->setctime(ts);
                             n->changed.ctime = true;
                         }
 
@@ -5053,6 +5501,7 @@ void MegaClient::sc_ph()
                     {
                         delete n->plink;
                         n->plink = NULL;
+                        updatesharednodes(n);
                     }
                 }
                 else
@@ -5580,12 +6029,235 @@ Node* MegaClient::nodebyhandle(handle h)
 
     if ((it = nodes.find(h)) != nodes.end())
     {
-        return it->second;
+        Node* n = it->second;
+
+        if (n->resident_it != residentnodes.end())
+        {
+            residentnodes.splice(residentnodes.begin(), residentnodes, n->resident_it);
+        }
+
+        return n;
+    }
+
+    if (nodepaging && !ISUNDEF(h))
+    {
+        return loadnode(h);
     }
 
     return NULL;
 }
 
+Node* MegaClient::loadnode(handle h)
+{
+    uint32_t id;
+    string data;
+    NodeRecord r;
+    node_vector dp;
+
+    if (!sctable || !sctable->getnode(h, &id))
+    {
+        return NULL;
+    }
+
+    if (!sctable->get(id, &data) || !DbTable::decrypt(id, &data, &key)
+            || !Node::parse(fsaccess, &data, &r))
+    {
+        LOG_err << "Unable to load node record " << id;
+        return NULL;
+    }
+
+    // the parent (and in turn its ancestors) is loaded by the constructor
+    bool paging = pagingnode;
+    pagingnode = true;
+
+    Node* n = Node::unserialize(this, &r, &dp);
+
+    pagingnode = paging;
+
+    n->dbid = id;
+
+    return n;
+}
+
+void MegaClient::loadchildren(Node* p)
+{
+    if (p->childrenloaded || !nodepaging)
+    {
+        return;
+    }
+
+    handle_vector handles;
+
+    if (!sctable || !sctable->getchildnodes(p->nodehandle, &handles))
+    {
+        LOG_err << "Unable to load the children of a node";
+        return;
+    }
+
+    // children that are loaded link to p, which has them all after that
+    p->childrenloaded = true;
+
+    for (handle_vector::iterator it = handles.begin(); it != handles.end(); it++)
+    {
+        if (nodes.find(*it) == nodes.end())
+        {
+            loadnode(*it);
+        }
+    }
+
+    LOG_verbose << "Loaded " << handles.size() << " children - " << nodes.size() << " resident nodes";
+}
+
+// a node may only be evicted if it can be loaded back unchanged: it has no
+// children (so that its totals are its own), it is not referenced from
+// outside of the node tree and its record is up to date
+static bool evictable(MegaClient* client, Node* n)
+{
+    if (!n->children.empty() || !n->childrenloaded || !n->dbid || n->notified
+            || (n->type != FILENODE && n->type != FOLDERNODE)
+            || n->attrstring || n->inshare || n->outshares || n->pendingshares
+            || n->sharekey || n->plink)
+    {
+        return false;
+    }
+
+    for (int i = sizeof client->rootnodes / sizeof *client->rootnodes; i--; )
+    {
+        if (client->rootnodes[i] == n->nodehandle)
+        {
+            return false;
+        }
+    }
+
+#ifdef ENABLE_SYNC
+    if (n->localnode || n->syncget || n->syncdeleted != SYNCDEL_NONE
+            || n->todebris_it != client->todebris.end()
+            || n->tounlink_it != client->tounlink.end())
+    {
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+void MegaClient::evictnodes()
+{
+    if (!nodepaging || nodes.size() <= maxresidentnodes)
+    {
+        return;
+    }
+
+    size_t evicted = 0;
+
+    // look at every node at most once, least recently used first
+    for (size_t n = residentnodes.size(); n-- && nodes.size() > maxresidentnodes; )
+    {
+        Node* node = residentnodes.back();
+
+        if (!evictable(this, node))
+        {
+            residentnodes.splice(residentnodes.begin(), residentnodes, node->resident_it);
+            continue;
+        }
+
+        Node* parent = node->parent;
+
+        pagingnode = true;
+        nodes.erase(node->nodehandle);
+        delete node;
+        pagingnode = false;
+
+        if (parent)
+        {
+            parent->childrenloaded = false;
+        }
+
+        evicted++;
+    }
+
+    LOG_debug << "Evicted " << evicted << " nodes - " << nodes.size() << " resident nodes";
+}
+
+bool MegaClient::cachenode(Node* n)
+{
+    return sctable->put(CACHEDNODE, n, &key) && indexnode(n);
+}
+
+bool MegaClient::indexnode(Node* n)
+{
+    DbNodeColumns columns;
+
+    // no record was written (see Node::serialize())
+    if (!n->dbid)
+    {
+        return true;
+    }
+
+    columns.h = n->nodehandle;
+    columns.ph = n->parent ? n->parent->nodehandle : UNDEF;
+    columns.namehash = 0;
+    columns.size = (n->type == FILENODE) ? n->size : -1;
+    columns.mtime = n->mtime;
+    columns.fingerprint = (n->type == FILENODE && n->isvalid) ? fingerprintdigest(n) : 0;
+
+    if (!n->attrstring)
+    {
+        attr_map::iterator it = n->attrs().map.find('n');
+
+        if (it != n->attrs().map.end() && it->second.size())
+        {
+            columns.namehash = dbnamehash(it->second.c_str());
+        }
+    }
+
+    return sctable->indexnode(n->dbid, &columns);
+}
+
+// truncated HMAC of the name under the master key, so that the database
+// does not reveal names
+uint64_t MegaClient::dbnamehash(const char* name)
+{
+    byte hash[32];
+    uint64_t h;
+
+    HMACSHA256 hmac(key.key, SymmCipher::KEYLENGTH);
+    hmac.add((const byte*)name, strlen(name));
+    hmac.get(hash);
+
+    memcpy(&h, hash, sizeof h);
+
+    // 0 stands for "no name"
+    return h ? h : 1;
+}
+
+// sparse CRC folded to 64 bits (size and mtime are stored separately)
+uint64_t MegaClient::fingerprintdigest(const FileFingerprint* fp)
+{
+    uint64_t d = ((uint64_t)(uint32_t)(fp->crc[0] ^ fp->crc[2]) << 32)
+               | (uint32_t)(fp->crc[1] ^ fp->crc[3]);
+
+    // 0 stands for "no fingerprint"
+    return d ? d : 1;
+}
+
+void MegaClient::loadfingerprint(FileFingerprint* fp)
+{
+    handle_vector handles;
+
+    if (!nodepaging || !fp->isvalid || !sctable
+            || !sctable->getnodesbyfingerprint(fp->size, fp->mtime, fingerprintdigest(fp), &handles))
+    {
+        return;
+    }
+
+    // the candidates join the fingerprint index when they are loaded
+    for (handle_vector::iterator it = handles.begin(); it != handles.end(); it++)
+    {
+        nodebyhandle(*it);
+    }
+}
+
 // server-client deletion
 Node* MegaClient::sc_deltree()
 {
@@ -5671,6 +6343,9 @@ error MegaClient::setattr(Node* n, const char *prevattr)
         return API_EKEY;
     }
 
+    // the name may have changed
+    n->updatenameindex();
+
     n->changed.attrs = true;
     n->tag = reqtag;
     notifynode(n);
@@ -5838,6 +6513,7 @@ error MegaClient::unlink(Node* n, bool keepversions)
     if (kv)
     {
         Node *newerversion = n->parent;
+        loadchildren(n);
         if (n->children.size())
         {
             Node *olderversion = n->children.back();
@@ -6258,7 +6934,7 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn,
                     sts = ts;
                 }
 
-                n = new Node(this, &dp, h, ph, t, s, u, fas.c_str(), ts);
+                n = new (this) Node(this, &dp, h, ph, t, s, u, fas.c_str(), ts);
 
                 n->tag = tag;
 
@@ -6734,17 +7410,20 @@ void MegaClient::procph(JSON *j)
 int MegaClient::applykeys()
 {
     int t = 0;
+    vector<NodeKeyJob> jobs;
 
     // FIXME: rather than iterating through the whole node set, maintain subset
     // with missing keys
     for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
     {
-        if (it->second->applykey())
+        if (preparekey(it->second, &jobs))
         {
             t++;
         }
     }
 
+    applykeyjobs(&jobs);
+
     if (sharekeyrewrite.size())
     {
         reqs.add(new CommandShareKeyUpdate(this, &sharekeyrewrite));
@@ -6753,11 +7432,135 @@ int MegaClient::applykeys()
 
     if (nodekeyrewrite.size())
     {
-        reqs.add(new CommandNodeKeyUpdate(this, &nodekeyrewrite));
-        nodekeyrewrite.clear();
+        reqs.add(new CommandNodeKeyUpdate(this, &nodekeyrewrite));
+        nodekeyrewrite.clear();
+    }
+
+    return t;
+}
+
+int MegaClient::applykeys(node_vector* v)
+{
+    int t = 0;
+    vector<NodeKeyJob> jobs;
+
+    for (node_vector::iterator it = v->begin(); it != v->end(); it++)
+    {
+        if (preparekey(*it, &jobs))
+        {
+            t++;
+        }
+    }
+
+    applykeyjobs(&jobs);
+
+    return t;
+}
+
+bool MegaClient::preparekey(Node* n, vector<NodeKeyJob>* jobs)
+{
+    const char* k;
+    SymmCipher* sc;
+
+    if (!n->findkey(&k, &sc))
+    {
+        return false;
+    }
+
+    // RSA-encrypted keys (see decryptkey()) are rare and need the private
+    // key and the key rewrite queues: apply them right away
+    const char* ptr = k;
+
+    while (*ptr && *ptr != '"' && *ptr != '/')
+    {
+        ptr++;
+    }
+
+    if (ptr - k > 4 * FILENODEKEYLENGTH / 3 + 1)
+    {
+        return n->applykey();
+    }
+
+    jobs->resize(jobs->size() + 1);
+
+    NodeKeyJob& job = jobs->back();
+
+    job.node = n;
+    job.encryptedkey = k;
+    memcpy(job.cipherkey, sc->key, sizeof job.cipherkey);
+
+    return true;
+}
+
+struct NodeKeyJobs
+{
+    vector<NodeKeyJob>* jobs;
+    const FileSystemAccess* fsaccess;
+
+    static void decrypt(void* context, size_t i)
+    {
+        NodeKeyJobs* k = (NodeKeyJobs*)context;
+        (*k->jobs)[i].decrypt(k->fsaccess);
+    }
+};
+
+void MegaClient::applykeyjobs(vector<NodeKeyJob>* jobs)
+{
+    if (jobs->empty())
+    {
+        return;
+    }
+
+    NodeKeyJobs context;
+
+    context.jobs = jobs;
+    context.fsaccess = fsaccess;
+
+#ifdef THREAD_CLASS
+    WorkerPool* pool = getworkerpool();
+
+    if (pool)
+    {
+        // the nodes are only read by the workers, and the engine thread
+        // waits for them to finish
+        pool->run(NodeKeyJobs::decrypt, &context, jobs->size());
+    }
+    else
+#endif
+    {
+        for (size_t i = 0; i < jobs->size(); i++)
+        {
+            NodeKeyJobs::decrypt(&context, i);
+        }
+    }
+
+    for (vector<NodeKeyJob>::iterator it = jobs->begin(); it != jobs->end(); it++)
+    {
+        if (!it->keydecrypted)
+        {
+            LOG_warn << "Corrupt or invalid symmetric node key";
+            continue;
+        }
+
+        it->node->nodekey.assign((const char*)it->key, it->node->keylength());
+
+        if (it->attrsdecrypted)
+        {
+            it->node->setattr(&it->attrs);
+        }
+    }
+}
+
+WorkerPool* MegaClient::getworkerpool()
+{
+#ifdef THREAD_CLASS
+    if (!workerpool && workerthreads > 0)
+    {
+        workerpool = new WorkerPool(workerthreads);
     }
+#endif
 
-    return t;
+    return workerpool;
 }
 
 // user/contact list
@@ -7119,6 +7922,24 @@ void MegaClient::opensctable()
         {
             sctable = dbaccess->open(fsaccess, &dbname);
             pendingsccommit = false;
+
+            string localpath;
+            uint64_t generation;
+
+            // the snapshot files are kept beside the database, and checked
+            // against its generation counter
+            if (sctable && usesnapshots && sctable->localpath(&localpath)
+                    && sctable->getgeneration(&generation))
+            {
+                sctable = new SnapshotDbTable(sctable, fsaccess, &localpath);
+            }
+
+#ifdef THREAD_CLASS
+            if (sctable && asyncsc)
+            {
+                sctable = new AsyncDbTable(sctable);
+            }
+#endif
         }
     }
 }
@@ -7448,6 +8269,8 @@ void MegaClient::proctree(Node* n, TreeProc* tp, bool skipinshares, bool skipver
 {
     if (!skipversions || n->type != FILENODE)
     {
+        loadchildren(n);
+
         for (node_list::iterator it = n->children.begin(); it != n->children.end(); )
         {
             Node *child = *it++;
@@ -8007,11 +8830,76 @@ void MegaClient::notifynode(Node* n)
 
 void MegaClient::transfercacheadd(Transfer *transfer)
 {
+    transfer->pendingmacs.clear();
+
     if (tctable)
     {
+        // checkpoints go first: a stale checkpoint must never be replayed
+        // onto a newer record (e.g. after an upload restarted from scratch)
+        for (unsigned i = 0; i < transfer->checkpointids.size(); i++)
+        {
+            tctable->del(transfer->checkpointids[i]);
+        }
+
         LOG_debug << "Caching transfer";
         tctable->put(MegaClient::CACHEDTRANSFER, transfer, &tckey);
     }
+
+    transfer->checkpointids.clear();
+    transfer->checkpointmacs = 0;
+}
+
+void MegaClient::transfercheckpoint(Transfer *transfer)
+{
+    if (!tctable)
+    {
+        transfer->pendingmacs.clear();
+        return;
+    }
+
+    // the first checkpoint of a slot also records its temp URL, and the log
+    // is folded in once it is as large as the transfer record itself
+    size_t logged = transfer->checkpointmacs + transfer->pendingmacs.size();
+
+    if (!transfer->dbid || !transfer->slot || !transfer->slot->checkpointed
+            || (logged >= MINCHECKPOINTMACS && logged >= transfer->chunkmacs.size()))
+    {
+        if (transfer->slot)
+        {
+            transfer->slot->checkpointed = true;
+        }
+
+        transfercacheadd(transfer);
+        return;
+    }
+
+    if (transfer->pendingmacs.empty())
+    {
+        return;
+    }
+
+    TransferCheckpoint checkpoint;
+    checkpoint.transferid = transfer->dbid;
+
+    for (unsigned i = 0; i < transfer->pendingmacs.size(); i++)
+    {
+        ChunkMAC* chunkmac = transfer->chunkmacs.find(transfer->pendingmacs[i]);
+        if (chunkmac)
+        {
+            checkpoint.chunkmacs[transfer->pendingmacs[i]] = *chunkmac;
+        }
+    }
+
+    transfer->pendingmacs.clear();
+
+    LOG_debug << "Checkpointing transfer: " << checkpoint.chunkmacs.size();
+    tctable->put(MegaClient::CACHEDTRANSFERCHECKPOINT, &checkpoint, &tckey);
+
+    if (checkpoint.dbid)
+    {
+        transfer->checkpointids.push_back(checkpoint.dbid);
+        transfer->checkpointmacs += checkpoint.chunkmacs.size();
+    }
 }
 
 void MegaClient::transfercachedel(Transfer *transfer)
@@ -8020,7 +8908,15 @@ void MegaClient::transfercachedel(Transfer *transfer)
     {
         LOG_debug << "Removing cached transfer";
         tctable->del(transfer->dbid);
+
+        for (unsigned i = 0; i < transfer->checkpointids.size(); i++)
+        {
+            tctable->del(transfer->checkpointids[i]);
+        }
     }
+
+    transfer->checkpointids.clear();
+    transfer->checkpointmacs = 0;
 }
 
 void MegaClient::filecacheadd(File *file)
@@ -9090,87 +9986,115 @@ bool MegaClient::fetchsc(DbTable* sctable)
     uint32_t id;
     string data;
     Node* n;
-    User* u;
-    PendingContactRequest* pcr;
     node_vector dp;
 
+    // with a node index, file nodes can be left in the cache
+    bool paged = maxresidentnodes && sctable->hasnodeindex();
+
     LOG_info << "Loading session from local cache";
 
+    nodepaging = false;
+    pagedchildren.clear();
+
     sctable->rewind();
 
-    bool hasNext = sctable->next(&id, &data, &key);
-    WAIT_CLASS::bumpds();
-    fnstats.timeToFirstByte = Waiter::ds - fnstats.startTime;
+#ifdef THREAD_CLASS
+    WorkerPool* pool = getworkerpool();
 
-    while (hasNext)
+    if (pool)
     {
-        switch (id & 15)
+        CacheLoader loader(sctable, &key, fsaccess, pool);
+        CacheLoader::Batch* batch;
+        bool decrypted = true;
+
+        fnstats.cacheWorkers = pool->size();
+
+        while (decrypted && (batch = loader.next()))
         {
-            case CACHEDSCSN:
-                if (data.size() != sizeof cachedscsn)
-                {
-                    return false;
-                }
-                break;
+            WAIT_CLASS::bumpds();
 
-            case CACHEDNODE:
-                if ((n = Node::unserialize(this, &data, &dp)))
-                {
-                    n->dbid = id;
-                }
-                else
-                {
-                    LOG_err << "Failed - node record read error";
-                    return false;
-                }
-                break;
+            if (fnstats.timeToFirstByte == NEVER)
+            {
+                fnstats.timeToFirstByte = Waiter::ds - fnstats.startTime;
+            }
 
-            case CACHEDPCR:
-                if ((pcr = PendingContactRequest::unserialize(this, &data)))
-                {
-                    pcr->dbid = id;
-                }
-                else
-                {
-                    LOG_err << "Failed - pcr record read error";
-                    return false;
-                }
-                break;
+            // the reader only reports through the engine thread, so stage
+            // timings have a resolution of one batch
+            if (fnstats.timeToLastByte == NEVER && loader.readdone())
+            {
+                fnstats.timeToLastByte = Waiter::ds - fnstats.startTime;
+            }
+
+            if (fnstats.timeToDecoded == NEVER && loader.decodedone())
+            {
+                fnstats.timeToDecoded = Waiter::ds - fnstats.startTime;
+            }
 
-            case CACHEDUSER:
-                if ((u = User::unserialize(this, &data)))
+            for (size_t i = 0; i < batch->records.size(); i++)
+            {
+                CacheLoader::Record& r = batch->records[i];
+
+                // an undecryptable record ends the cache, like in next()
+                if (!(decrypted = r.decrypted))
                 {
-                    u->dbid = id;
+                    break;
                 }
-                else
+
+                if (!fetchscrecord(r.id, &r.data, r.node, &dp, paged))
                 {
-                    LOG_err << "Failed - user record read error";
+                    delete batch;
                     return false;
                 }
-                break;
+            }
 
-            case CACHEDCHAT:
-#ifdef ENABLE_CHAT
-                {
-                    TextChat *chat;
-                    if ((chat = TextChat::unserialize(this, &data)))
-                    {
-                        chat->dbid = id;
-                    }
-                    else
-                    {
-                        LOG_err << "Failed - chat record read error";
-                        return false;
-                    }
-                }
+            delete batch;
+        }
+
+        WAIT_CLASS::bumpds();
+
+        if (fnstats.timeToFirstByte == NEVER)
+        {
+            fnstats.timeToFirstByte = Waiter::ds - fnstats.startTime;
+        }
+
+        if (fnstats.timeToLastByte == NEVER)
+        {
+            fnstats.timeToLastByte = Waiter::ds - fnstats.startTime;
+        }
+
+        if (fnstats.timeToDecoded == NEVER)
+        {
+            fnstats.timeToDecoded = Waiter::ds - fnstats.startTime;
+        }
+    }
+    else
 #endif
-                break;
+    {
+        bool hasNext = sctable->next(&id, &data, &key);
+        WAIT_CLASS::bumpds();
+        fnstats.timeToFirstByte = Waiter::ds - fnstats.startTime;
+
+        while (hasNext)
+        {
+            if (!fetchscrecord(id, &data, NULL, &dp, paged))
+            {
+                return false;
+            }
+
+            hasNext = sctable->next(&id, &data, &key);
         }
-        hasNext = sctable->next(&id, &data, &key);
+
+        WAIT_CLASS::bumpds();
+        fnstats.timeToLastByte = Waiter::ds - fnstats.startTime;
+        fnstats.timeToDecoded = fnstats.timeToLastByte;
     }
 
-    WAIT_CLASS::bumpds();
-    fnstats.timeToLastByte = Waiter::ds - fnstats.startTime;
+    LOG_debug << "Loaded " << nodes.size() << " nodes (" << nodeslab.reserved() << " bytes of node storage)"
+              << " - read: " << fnstats.timeToLastByte << " ds, decoded: " << fnstats.timeToDecoded
+              << " ds (" << fnstats.cacheWorkers << " workers)";
+
+    // from now on, parents left in the cache are loaded on demand
+    nodepaging = paged;
 
     // any child nodes arrived before their parents?
     for (int i = dp.size(); i--; )
@@ -9181,11 +10105,119 @@ bool MegaClient::fetchsc(DbTable* sctable)
         }
     }
 
+    if (paged)
+    {
+        // parents of files left in the cache are files with versions
+        // themselves if they are not resident yet
+        for (map<handle, pair<int, NodeCounter> >::iterator it = pagedchildren.begin(); it != pagedchildren.end(); it++)
+        {
+            if ((n = nodebyhandle(it->first)))
+            {
+                n->addpagedchildren(it->second.first, it->second.second);
+            }
+        }
+
+        LOG_debug << "Loaded " << nodes.size() << " resident nodes, " << pagedchildren.size() << " folders with paged files";
+
+        pagedchildren.clear();
+    }
+
     mergenewshares(0);
 
     return true;
 }
 
+bool MegaClient::fetchscrecord(uint32_t id, string* data, NodeRecord* record, node_vector* dp, bool paged)
+{
+    Node* n;
+    User* u;
+    PendingContactRequest* pcr;
+
+    switch (id & 15)
+    {
+        case CACHEDSCSN:
+            if (data->size() != sizeof cachedscsn)
+            {
+                return false;
+            }
+            break;
+
+        case CACHEDNODE:
+        {
+            NodeRecord r;
+
+            if (!record)
+            {
+                if (!Node::parse(fsaccess, data, &r))
+                {
+                    LOG_err << "Failed - node record read error";
+                    return false;
+                }
+
+                record = &r;
+            }
+
+            // plain files stay in the cache, only their totals are needed
+            if (paged && record->type == FILENODE && record->shares.empty() && !record->plink)
+            {
+                pair<int, NodeCounter>& c = pagedchildren[record->ph];
+
+                c.first++;
+                c.second.files++;
+                c.second.storage += (record->size > 0) ? record->size : 0;
+                break;
+            }
+
+            n = Node::unserialize(this, record, dp);
+            n->dbid = id;
+            break;
+        }
+
+        case CACHEDPCR:
+            if ((pcr = PendingContactRequest::unserialize(this, data)))
+            {
+                pcr->dbid = id;
+            }
+            else
+            {
+                LOG_err << "Failed - pcr record read error";
+                return false;
+            }
+            break;
+
+        case CACHEDUSER:
+            if ((u = User::unserialize(this, data)))
+            {
+                u->dbid = id;
+            }
+            else
+            {
+                LOG_err << "Failed - user record read error";
+                return false;
+            }
+            break;
+
+        case CACHEDCHAT:
+#ifdef ENABLE_CHAT
+            {
+                TextChat *chat;
+                if ((chat = TextChat::unserialize(this, data)))
+                {
+                    chat->dbid = id;
+                }
+                else
+                {
+                    LOG_err << "Failed - chat record read error";
+                    return false;
+                }
+            }
+#endif
+            break;
+    }
+
+    return true;
+}
+
 void MegaClient::closetc(bool remove)
 {
     bool purgeOrphanTransfers = statecurrent;
@@ -9283,6 +10315,10 @@ void MegaClient::enabletransferresumption(const char *loggedoutid)
     string data;
     Transfer* t;
 
+    // transfers are unserialized once all their checkpoints are known
+    map<uint32_t, string> transferrecords;
+    map<uint32_t, map<uint32_t, string> > checkpoints;
+
     LOG_info << "Loading transfers from local cache";
     tctable->rewind();
     while (tctable->next(&id, &data, &tckey))
@@ -9290,21 +10326,22 @@ void MegaClient::enabletransferresumption(const char *loggedoutid)
         switch (id & 15)
         {
             case CACHEDTRANSFER:
-                if ((t = Transfer::unserialize(this, &data, cachedtransfers)))
+                transferrecords[id].swap(data);
+                break;
+            case CACHEDTRANSFERCHECKPOINT:
+            {
+                uint32_t transferid;
+                if (TransferCheckpoint::unserializeid(&data, &transferid))
                 {
-                    t->dbid = id;
-                    if (t->priority > transferlist.currentpriority)
-                    {
-                        transferlist.currentpriority = t->priority;
-                    }
-                    LOG_debug << "Cached transfer loaded";
+                    checkpoints[transferid][id].swap(data);
                 }
                 else
                 {
                     tctable->del(id);
-                    LOG_err << "Failed - transfer record read error";
+                    LOG_err << "Failed - transfer checkpoint read error";
                 }
                 break;
+            }
             case CACHEDFILE:
                 cachedfiles.push_back(data);
                 cachedfilesdbids.push_back(id);
@@ -9313,6 +10350,55 @@ void MegaClient::enabletransferresumption(const char *loggedoutid)
         }
     }
 
+    for (map<uint32_t, string>::iterator it = transferrecords.begin(); it != transferrecords.end(); it++)
+    {
+        id = it->first;
+
+        // replayed in the order they were appended
+        string_vector log;
+        vector<uint32_t> logids;
+        map<uint32_t, map<uint32_t, string> >::iterator cit = checkpoints.find(id);
+        if (cit != checkpoints.end())
+        {
+            for (map<uint32_t, string>::iterator lit = cit->second.begin(); lit != cit->second.end(); lit++)
+            {
+                logids.push_back(lit->first);
+                log.push_back(string());
+                log.back().swap(lit->second);
+            }
+            checkpoints.erase(cit);
+        }
+
+        if ((t = Transfer::unserialize(this, &it->second, cachedtransfers, &log)))
+        {
+            t->dbid = id;
+            t->checkpointids.swap(logids);
+            if (t->priority > transferlist.currentpriority)
+            {
+                transferlist.currentpriority = t->priority;
+            }
+            LOG_debug << "Cached transfer loaded";
+        }
+        else
+        {
+            tctable->del(id);
+            for (unsigned i = 0; i < logids.size(); i++)
+            {
+                tctable->del(logids[i]);
+            }
+            LOG_err << "Failed - transfer record read error";
+        }
+    }
+
+    // checkpoints of transfers that are gone
+    for (map<uint32_t, map<uint32_t, string> >::iterator cit = checkpoints.begin(); cit != checkpoints.end(); cit++)
+    {
+        for (map<uint32_t, string>::iterator lit = cit->second.begin(); lit != cit->second.end(); lit++)
+        {
+            tctable->del(lit->first);
+        }
+    }
+
     // if we are logged in but the filesystem is not current yet
     // postpone the resumption until the filesystem is updated
     if ((!sid.size() && publichandle == UNDEF) || statecurrent)
@@ -9417,6 +10503,34 @@ void MegaClient::fetchnodes(bool nocache)
         sctable->begin();
         pendingsccommit = false;
 
+        if (!sctable->hasnodeindex())
+        {
+            // cache written without a node index (or with an outdated one):
+            // index it now that all nodes are resident (committed along with
+            // the next update)
+            sctable->createnodeindex();
+
+            if (sctable->hasnodeindex())
+            {
+                bool complete = true;
+
+                for (node_map::iterator it = nodes.begin(); complete && it != nodes.end(); it++)
+                {
+                    complete = indexnode(it->second);
+                }
+
+                if (complete)
+                {
+                    LOG_debug << "Node index created";
+                    nodepaging = maxresidentnodes != 0;
+                }
+                else
+                {
+                    finalizesc(false);
+                }
+            }
+        }
+
         Base64::btoa((byte*)&cachedscsn, sizeof cachedscsn, scsn);
         LOG_info << "Session loaded from local cache. SCSN: " << scsn;
 
@@ -9785,12 +10899,27 @@ void MegaClient::purgenodesusersabortsc()
     syncs.clear();
 #endif
 
+    // no need to invalidate cached paths one node at a time
+    pathcache.clear();
+
     for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
     {
         delete it->second;
     }
 
     nodes.clear();
+    nodepaging = false;
+    pagedchildren.clear();
+    searchindex.clear();
+    namesindexed = false;
+    valuesindexed = false;
+    nodesbysize.clear();
+    nodesbymtime.clear();
+    nodesbyctime.clear();
+    nodesbyextension.clear();
+    outsharenodes.clear();
+    pendingsharenodes.clear();
+    publiclinknodes.clear();
 
 #ifdef ENABLE_SYNC
     todebris.clear();
@@ -10283,6 +11412,8 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
     string localname;
 
     // build child hash - nameclash resolution: use newest/largest version
+    loadchildren(l->node);
+
     for (node_list::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
     {
         attr_map::iterator ait;        
@@ -10291,7 +11422,7 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
         // be considered - also, prevent clashes with the local debris folder
         if (((*it)->syncdeleted == SYNCDEL_NONE
              && !(*it)->attrstring
-             && (ait = (*it)->attrs.map.find('n')) != (*it)->attrs.map.end()
+             && (ait = (*it)->attrs().map.find('n')) != (*it)->attrs().map.end()
              && ait->second.size())
          && (l->parent || l->sync->debris != ait->second))
         {
@@ -10470,7 +11601,7 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
     {
         size_t t = localpath->size();
 
-        localname = rit->second->attrs.map.find('n')->second;
+        localname = rit->second->attrs().map.find('n')->second;
 
         fsaccess->name2local(&localname);
         localpath->append(fsaccess->localseparator);
@@ -10629,6 +11760,8 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
     {
         // corresponding remote node present: build child hash - nameclash
         // resolution: use newest version
+        loadchildren(l->node);
+
         for (node_list::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
         {
             // node must be alive
@@ -10665,7 +11798,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
                 }
 
                 // ...or a node name attribute missing
-                if ((ait = (*it)->attrs.map.find('n')) == (*it)->attrs.map.end())
+                if ((ait = (*it)->attrs().map.find('n')) == (*it)->attrs().map.end())
                 {
                     LOG_warn << "Node name missing, not syncing subtree: " << l->name.c_str();
 
@@ -10806,7 +11939,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
                                     {
                                         char me64[12];
                                         Base64::btoa((const byte*)&me, MegaClient::USERHANDLE, me64);
-                                        if (ll->node->attrs.map.find('f') == ll->node->attrs.map.end() || ll->node->attrs.map['f'] != me64)
+                                        if (ll->node->attrs().map.find('f') == ll->node->attrs().map.end() || ll->node->attrs().map['f'] != me64)
                                         {
                                             LOG_debug << "Restoring missing attributes: " << ll->name;
                                             string localpath;
@@ -10969,6 +12102,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
                             }
 
                             recentVersions++;
+                            loadchildren(version);
                             if (!version->children.size())
                             {
                                 break;
@@ -11083,7 +12217,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
                 {
                     int namelen;
 
-                    if ((ait = ll->node->attrs.map.find('n')) != ll->node->attrs.map.end())
+                    if ((ait = ll->node->attrs().map.find('n')) != ll->node->attrs().map.end())
                     {
                         namelen = ait->second.size();
                     }
@@ -11206,7 +12340,7 @@ void MegaClient::syncupdate()
                     // FIXME: move instead of creating a copy if it is in
                     // rubbish to reduce node creation load
                     nnp->nodekey = n->nodekey;
-                    tattrs.map = n->attrs.map;
+                    tattrs.map = n->attrs().map;
 
                     app->syncupdate_remote_copy(l->sync, l->name.c_str());
                 }
@@ -11280,10 +12414,9 @@ void MegaClient::putnodes_sync_result(error e, NewNode* nn, int nni)
         {
             if ((n = nodebyhandle(nn[nni].nodehandle)))
             {
-                if (n->fingerprint_it != fingerprints.end())
+                if (n->fingerprintprev)
                 {
-                    fingerprints.erase(n->fingerprint_it);
-                    n->fingerprint_it = fingerprints.end();
+                    fingerprints.remove(n);
                 }
             }
         }
@@ -11849,24 +12982,16 @@ void MegaClient::setmaxconnections(direction_t d, int num)
 
 Node* MegaClient::nodebyfingerprint(FileFingerprint* fingerprint)
 {
-    fingerprint_set::iterator it;
-
-    if ((it = fingerprints.find(fingerprint)) != fingerprints.end())
-    {
-        return (Node*)*it;
-    }
-
-    return NULL;
+    loadfingerprint(fingerprint);
+    return fingerprints.find(fingerprint);
 }
 
 node_vector *MegaClient::nodesbyfingerprint(FileFingerprint* fingerprint)
 {
+    loadfingerprint(fingerprint);
+
     node_vector *nodes = new node_vector();
-    pair<fingerprint_set::iterator, fingerprint_set::iterator> p = fingerprints.equal_range(fingerprint);
-    for (fingerprint_set::iterator it = p.first; it != p.second; it++)
-    {
-        nodes->push_back((Node*)*it);
-    }
+    fingerprints.findall(fingerprint, nodes);
     return nodes;
 }
 
@@ -12124,8 +13249,10 @@ void FetchNodesStats::init()
     eOthersCount = 0;
 
     startTime = Waiter::ds;
+    cacheWorkers = 0;
     timeToFirstByte = NEVER;
     timeToLastByte = NEVER;
+    timeToDecoded = NEVER;
     timeToCached = NEVER;
     timeToResult = NEVER;
     timeToSyncsResumed = NEVER;
@@ -12147,7 +13274,8 @@ void FetchNodesStats::toJsonArray(string *json)
         << timeToFirstByte << "," << timeToLastByte << ","
         << timeToCached << "," << timeToResult << ","
         << timeToSyncsResumed << "," << timeToCurrent << ","
-        << timeToTransfersResumed << "," << cache << "]";
+        << timeToTransfersResumed << "," << cache << ","
+        << timeToDecoded << "," << cacheWorkers << "]";
     json->append(oss.str());
 }
 
@@ -19,6 +19,7 @@
  * program.
  */
 
+#include "mega.h"
 #include "mega/node.h"
 #include "mega/megaclient.h"
 #include "mega/megaapp.h"
@@ -31,6 +32,140 @@
 #include "mega/logging.h"
 
 namespace mega {
+#ifdef THREAD_CLASS
+// serializes the one-time decoding of node attributes
+static MUTEX_CLASS attrmutex(false);
+#endif
+
+// key of a node in its parent's name index: the hash of displayname(),
+// obtained without the logging of special names
+static uint64_t nameindexkey(const Node* n)
+{
+    if (n->attrstring)
+    {
+        return Node::namehash("NO_KEY");
+    }
+
+    const attr_map& attrs = n->attrs().map;
+    attr_map::const_iterator it = attrs.find('n');
+
+    if (it == attrs.end())
+    {
+        return Node::namehash("CRYPTO_ERROR");
+    }
+
+    return Node::namehash(it->second.size() ? it->second.c_str() : "BLANK");
+}
+
+// FNV-1a over the UTF-8 name
+uint64_t Node::namehash(const char* name)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (*name)
+    {
+        h ^= (unsigned char)*name++;
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+NodeCounter::NodeCounter()
+{
+    storage = 0;
+    versionstorage = 0;
+    files = 0;
+    folders = 0;
+    versions = 0;
+}
+
+void NodeCounter::operator+=(const NodeCounter& other)
+{
+    storage += other.storage;
+    versionstorage += other.versionstorage;
+    files += other.files;
+    folders += other.folders;
+    versions += other.versions;
+}
+
+void NodeCounter::operator-=(const NodeCounter& other)
+{
+    storage -= other.storage;
+    versionstorage -= other.versionstorage;
+    files -= other.files;
+    folders -= other.folders;
+    versions -= other.versions;
+}
+
+NodeRecord::NodeRecord()
+{
+    h = UNDEF;
+    ph = UNDEF;
+    u = UNDEF;
+    type = TYPE_UNKNOWN;
+    size = 0;
+    ts = 0;
+    plink = NULL;
+}
+
+NodeRecord::~NodeRecord()
+{
+    for (newshare_list::iterator it = shares.begin(); it != shares.end(); it++)
+    {
+        delete *it;
+    }
+
+    delete plink;
+}
+
+const size_t Node::ALLOCSIZE = sizeof(Node::AllocHeader) + sizeof(Node);
+
+void* Node::operator new(size_t size, MegaClient* client)
+{
+    assert(size == sizeof(Node));
+
+    AllocHeader* header;
+
+    if (client)
+    {
+        header = (AllocHeader*)client->nodeslab.alloc();
+        header->slab = &client->nodeslab;
+    }
+    else
+    {
+        header = (AllocHeader*)::operator new(sizeof(AllocHeader) + size);
+        header->slab = NULL;
+    }
+
+    return header + 1;
+}
+
+// only called if the constructor throws
+void Node::operator delete(void* p, MegaClient*)
+{
+    Node::operator delete(p);
+}
+
+void Node::operator delete(void* p)
+{
+    if (!p)
+    {
+        return;
+    }
+
+    AllocHeader* header = (AllocHeader*)p - 1;
+
+    if (header->slab)
+    {
+        header->slab->release(header);
+    }
+    else
+    {
+        ::operator delete(header);
+    }
+}
+
 Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
            nodetype_t t, m_off_t s, handle u, const char* fa, m_time_t ts)
 {
@@ -44,6 +179,13 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
     parenthandle = ph;
 
     parent = NULL;
+    childnames = NULL;
+    childviews = NULL;
+    searchnamehash = 0;
+    attrdata = NULL;
+
+    fingerprintnext = NULL;
+    fingerprintprev = NULL;
 
 #ifdef ENABLE_SYNC
     localnode = NULL;
@@ -59,6 +201,21 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
     size = s;
     owner = u;
 
+    // a new node has no children yet
+    numchildfiles = 0;
+    numchildfolders = 0;
+    childrenloaded = true;
+
+    if (type == FILENODE)
+    {
+        counter.files = 1;
+        counter.storage = (size > 0) ? size : 0;
+    }
+    else
+    {
+        counter.folders = 1;
+    }
+
     copystring(&fileattrstring, fa);
 
     ctime = ts;
@@ -78,6 +235,10 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
 
         client->nodes[h] = this;
 
+        resident_it = client->maxresidentnodes
+                    ? client->residentnodes.insert(client->residentnodes.begin(), this)
+                    : client->residentnodes.end();
+
         // folder link access: first returned record defines root node and
         // identity
         if (ISUNDEF(*client->rootnodes))
@@ -101,22 +262,40 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
             dp->push_back(this);
         }
 
-        if (type == FILENODE)
+        // mtime is only known once the fingerprint is set, the extension
+        // once the name has been decrypted
+        extension_it = client->nodesbyextension.end();
+
+        if (client->valuesindexed)
         {
-            fingerprint_it = client->fingerprints.end();
+            if (type == FILENODE)
+            {
+                client->nodesbysize.insert(pair<int64_t, Node*>(size, this));
+            }
+
+            client->nodesbyctime.insert(pair<int64_t, Node*>(ctime, this));
         }
     }
 }
 
 Node::~Node()
 {
-    // abort pending direct reads
-    client->preadabort(this);
+    // abort pending direct reads (they continue by handle if the node is
+    // only evicted)
+    if (!client->pagingnode)
+    {
+        client->preadabort(this);
+    }
+
+    if (resident_it != client->residentnodes.end())
+    {
+        client->residentnodes.erase(resident_it);
+    }
 
     // remove node's fingerprint from hash
-    if (type == FILENODE && fingerprint_it != client->fingerprints.end())
+    if (fingerprintprev)
     {
-        client->fingerprints.erase(fingerprint_it);
+        client->fingerprints.remove(this);
     }
 
 #ifdef ENABLE_SYNC
@@ -153,13 +332,52 @@ Node::~Node()
         delete pendingshares;
     }
 
+    delete attrdata;
+
+    client->pathcache.invalidate(this);
+
+    if (searchnamehash && client->namesindexed)
+    {
+        client->searchindex.remove(nodehandle);
+    }
+
+    if (outshares || pendingshares || plink)
+    {
+        client->outsharenodes.erase(nodehandle);
+        client->pendingsharenodes.erase(nodehandle);
+        client->publiclinknodes.erase(nodehandle);
+    }
+
+    // remove from attribute indexes
+    if (client->valuesindexed)
+    {
+        client->nodesbysize.erase(pair<int64_t, Node*>(size, this));
+        client->nodesbymtime.erase(pair<int64_t, Node*>(mtime, this));
+        client->nodesbyctime.erase(pair<int64_t, Node*>(ctime, this));
+    }
+
+    if (extension_it != client->nodesbyextension.end())
+    {
+        client->nodesbyextension.erase(extension_it);
+    }
 
     // remove from parent's children
     if (parent)
     {
+        detachcounter();
+        removefromviews();
+
+        if (parent->childnames)
+        {
+            parent->childnames->erase(childname_it);
+        }
+
         parent->children.erase(child_it);
     }
 
+    delete childnames;
+    delete childviews;
+
     // delete child-parent associations (normally not used, as nodes are
     // deleted bottom-up)
     for (node_list::iterator it = children.begin(); it != children.end(); it++)
@@ -199,24 +417,33 @@ void Node::setkey(const byte* newkey)
 // mismatch vector
 Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
 {
-    handle h, ph;
+    NodeRecord r;
+
+    if (!parse(client->fsaccess, d, &r))
+    {
+        return NULL;
+    }
+
+    return unserialize(client, &r, dp);
+}
+
+// decode serialized node - does not access any client state, so that the
+// local cache can be decoded in parallel
+bool Node::parse(const FileSystemAccess* fsaccess, string* d, NodeRecord* r)
+{
     nodetype_t t;
     m_off_t s;
-    handle u;
-    const byte* k = NULL;
-    const char* fa;
     m_time_t ts;
     const byte* skey;
     const char* ptr = d->data();
     const char* end = ptr + d->size();
     unsigned short ll;
-    Node* n;
     int i;
     char isExported = '\0';
 
     if (ptr + sizeof s + 2 * MegaClient::NODEHANDLE + MegaClient::USERHANDLE + 2 * sizeof ts + sizeof ll > end)
     {
-        return NULL;
+        return false;
     }
 
     s = MemAccess::get<m_off_t>(ptr);
@@ -231,20 +458,23 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
         t = FILENODE;
     }
 
-    h = 0;
-    memcpy((char*)&h, ptr, MegaClient::NODEHANDLE);
+    r->type = t;
+    r->size = s;
+
+    r->h = 0;
+    memcpy((char*)&r->h, ptr, MegaClient::NODEHANDLE);
     ptr += MegaClient::NODEHANDLE;
 
-    ph = 0;
-    memcpy((char*)&ph, ptr, MegaClient::NODEHANDLE);
+    r->ph = 0;
+    memcpy((char*)&r->ph, ptr, MegaClient::NODEHANDLE);
     ptr += MegaClient::NODEHANDLE;
 
-    if (!ph)
+    if (!r->ph)
     {
-        ph = UNDEF;
+        r->ph = UNDEF;
     }
 
-    memcpy((char*)&u, ptr, MegaClient::USERHANDLE);
+    memcpy((char*)&r->u, ptr, MegaClient::USERHANDLE);
     ptr += MegaClient::USERHANDLE;
 
     // FIME: use m_time_t / Serialize64 instead
@@ -253,16 +483,18 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
     ts = (uint32_t)MemAccess::get<time_t>(ptr);
     ptr += sizeof(time_t);
 
+    r->ts = ts;
+
     if ((t == FILENODE) || (t == FOLDERNODE))
     {
         int keylen = ((t == FILENODE) ? FILENODEKEYLENGTH + 0 : FOLDERNODEKEYLENGTH + 0);
 
         if (ptr + keylen + 8 + sizeof(short) > end)
         {
-            return NULL;
+            return false;
         }
 
-        k = (const byte*)ptr;
+        r->key.assign(ptr, keylen);
         ptr += keylen;
     }
 
@@ -273,16 +505,12 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
 
         if ((ptr + ll > end) || ptr[ll + 1])
         {
-            return NULL;
+            return false;
         }
 
-        fa = ptr;
+        copystring(&r->fa, ptr);
         ptr += ll;
     }
-    else
-    {
-        fa = NULL;
-    }
 
     isExported = MemAccess::get<char>(ptr);
     ptr += sizeof(isExported);
@@ -302,58 +530,48 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
     {
         if (ptr + SymmCipher::KEYLENGTH > end)
         {
-            return NULL;
+            return false;
         }
 
         skey = (const byte*)ptr;
         ptr += SymmCipher::KEYLENGTH;
-    }
-    else
-    {
-        skey = NULL;
-    }
 
-    n = new Node(client, dp, h, ph, t, s, u, fa, ts);
+        // read inshare, outshares, or pending shares
+        NewShare* share;
 
-    if (k)
-    {
-        n->setkey(k);
-    }
+        while ((share = Share::unserialize((numshares > 0) ? -1 : 0,
+                                           r->h, skey, &ptr, end)))
+        {
+            r->shares.push_back(share);
 
-    if (numshares)
-    {
-        // read inshare, outshares, or pending shares
-        while (Share::unserialize(client,
-                                  (numshares > 0) ? -1 : 0,
-                                  h, skey, &ptr, end)
-               && numshares > 0
-               && --numshares);
+            if (numshares <= 0 || !--numshares)
+            {
+                break;
+            }
+        }
     }
 
-    ptr = n->attrs.unserialize(ptr, end);
+    // the attributes are kept serialized until they are accessed
+    const char* attrs = ptr;
+
+    ptr = AttrMap::skip(ptr, end);
     if (!ptr)
     {
-        delete n;
-        return NULL;
+        return false;
     }
 
-    // It's needed to re-normalize node names because
-    // the updated version of utf8proc doesn't provide
-    // exactly the same output as the previous one that
-    // we were using
-    attr_map::iterator it = n->attrs.map.find('n');
-    if (it != n->attrs.map.end())
+    r->attrs.assign(attrs, ptr - attrs);
+
+    if (!r->attrs.size() || r->attrs[r->attrs.size() - 1])
     {
-        client->fsaccess->normalize(&(it->second));
+        r->attrs.append("", 1);
     }
 
-    PublicLink *plink = NULL;
     if (isExported)
     {
         if (ptr + MegaClient::NODEHANDLE + sizeof(m_time_t) + sizeof(bool) > end)
         {
-            delete n;
-            return NULL;
+            return false;
         }
 
         handle ph = MemAccess::get<handle>(ptr);
@@ -363,21 +581,39 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
         bool takendown = MemAccess::get<bool>(ptr);
         ptr += sizeof(takendown);
 
-        plink = new PublicLink(ph, ets, takendown);
+        r->plink = new PublicLink(ph, ets, takendown);
     }
-    n->plink = plink;
 
-    n->setfingerprint();
+    return ptr == end;
+}
+
+Node* Node::unserialize(MegaClient* client, NodeRecord* r, node_vector* dp)
+{
+    Node* n = new (client) Node(client, dp, r->h, r->ph, r->type, r->size, r->u,
+                                (r->type == FILENODE) ? r->fa.c_str() : NULL, r->ts);
 
-    if (ptr == end)
+    if (r->key.size())
     {
-        return n;
+        n->setkey((const byte*)r->key.data());
     }
-    else
+
+    client->newshares.splice(client->newshares.end(), r->shares);
+
+    if (r->attrs.size() > 1)
     {
-        delete n;
-        return NULL;
+        n->attrdata = new string;
+        n->attrdata->swap(r->attrs);
     }
+
+    n->updatenameindex();
+
+    n->plink = r->plink;
+    r->plink = NULL;
+    client->updatesharednodes(n);
+
+    n->setfingerprint();
+
+    return n;
 }
 
 // serialize node - nodes with pending or RSA keys are unsupported
@@ -509,7 +745,14 @@ bool Node::serialize(string* d)
         }
     }
 
-    attrs.serialize(d);
+    if (attrdata)
+    {
+        d->append(*attrdata);
+    }
+    else
+    {
+        attrmap.serialize(d);
+    }
 
     if (isExported)
     {
@@ -583,33 +826,133 @@ SymmCipher* Node::nodecipher()
 // decrypt attributes and build attribute hash
 void Node::setattr()
 {
-    byte* buf;
     SymmCipher* cipher;
+    string decoded;
+
+    if (attrstring && (cipher = nodecipher()) && decodeattr(cipher, attrstring, client->fsaccess, &decoded))
+    {
+        setattr(&decoded);
+    }
+}
+
+// merge attributes decoded by decodeattr() - a node without attributes
+// keeps them serialized until they are accessed
+void Node::setattr(string* decoded)
+{
+    if (attrdata || attrmap.map.size())
+    {
+        attrs().unserialize(decoded->data(), decoded->data() + decoded->size());
+    }
+    else if (decoded->size() > 1)
+    {
+        attrdata = new string;
+        attrdata->swap(*decoded);
+    }
+
+    setfingerprint();
+
+    delete attrstring;
+    attrstring = NULL;
+
+    updatenameindex();
+}
 
-    if (attrstring && (cipher = nodecipher()) && (buf = decryptattr(cipher, attrstring->c_str(), attrstring->size())))
+// decrypt attribute string and add its attributes to the map
+bool Node::decodeattr(SymmCipher* cipher, const string* attrstring, const FileSystemAccess* fsaccess, attr_map* attrs)
+{
+    byte* buf;
+
+    if (!(buf = decryptattr(cipher, attrstring->c_str(), attrstring->size())))
     {
-        JSON json;
-        nameid name;
-        string* t;
+        return false;
+    }
+
+    JSON json;
+    nameid name;
+    string* t;
 
-        json.begin((char*)buf + 5);
+    json.begin((char*)buf + 5);
+
+    while ((name = json.getnameid()) != EOO && json.storeobject((t = &(*attrs)[name])))
+    {
+        JSON::unescape(t);
 
-        while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
+        if (name == 'n')
         {
-            JSON::unescape(t);
+            fsaccess->normalize(t);
+        }
+    }
 
-            if (name == 'n')
-            {
-                client->fsaccess->normalize(t);
-            }
+    delete[] buf;
+
+    return true;
+}
+
+bool Node::decodeattr(SymmCipher* cipher, const string* attrstring, const FileSystemAccess* fsaccess, string* serialized)
+{
+    AttrMap attrs;
+
+    if (!decodeattr(cipher, attrstring, fsaccess, &attrs.map))
+    {
+        return false;
+    }
+
+    attrs.serialize(serialized);
+
+    return true;
+}
+
+void Node::decodeattrs()
+{
+#ifdef THREAD_CLASS
+    attrmutex.lock();
+#endif
+
+    if (attrdata)
+    {
+        attrmap.unserialize(attrdata->data(), attrdata->data() + attrdata->size());
+
+        // names are normalized again as the output of utf8proc has changed
+        // between versions
+        attr_map::iterator it = attrmap.map.find('n');
+
+        if (it != attrmap.map.end())
+        {
+            client->fsaccess->normalize(&it->second);
         }
 
-        setfingerprint();
+        delete attrdata;
+        attrdata = NULL;
+    }
 
-        delete[] buf;
+#ifdef THREAD_CLASS
+    attrmutex.unlock();
+#endif
+}
 
-        delete attrstring;
-        attrstring = NULL;
+void NodeKeyJob::decrypt(const FileSystemAccess* fsaccess)
+{
+    unsigned keylength = node->keylength();
+    SymmCipher cipher;
+
+    attrsdecrypted = false;
+
+    if (!(keydecrypted = (Base64::atob(encryptedkey, key, keylength) == (int)keylength)))
+    {
+        return;
+    }
+
+    cipher.setkey(cipherkey);
+    cipher.ecb_decrypt(key, keylength);
+
+    if (node->attrstring)
+    {
+        string k((const char*)key, keylength);
+
+        if (cipher.setkey(&k))
+        {
+            attrsdecrypted = Node::decodeattr(&cipher, node->attrstring, fsaccess, &attrs);
+        }
     }
 }
 
@@ -619,21 +962,36 @@ void Node::setfingerprint()
 {
     if (type == FILENODE && nodekey.size() >= sizeof crc)
     {
-        if (fingerprint_it != client->fingerprints.end())
+        m_time_t oldmtime = mtime;
+
+        if (fingerprintprev)
         {
-            client->fingerprints.erase(fingerprint_it);
+            client->fingerprints.remove(this);
         }
 
-        attr_map::iterator it = attrs.map.find('c');
+        // looked up without decoding the other attributes
+        string fingerprint;
+        bool found;
 
-        if (it != attrs.map.end())
+        if (attrdata)
+        {
+            found = AttrMap::find(attrdata, 'c', &fingerprint);
+        }
+        else
         {
-            if (!unserializefingerprint(&it->second))
+            attr_map::iterator it = attrmap.map.find('c');
+
+            if ((found = (it != attrmap.map.end())))
             {
-                LOG_warn << "Invalid fingerprint";
+                fingerprint = it->second;
             }
         }
 
+        if (found && !unserializefingerprint(&fingerprint))
+        {
+            LOG_warn << "Invalid fingerprint";
+        }
+
         // if we lack a valid FileFingerprint for this file, use file's key,
         // size and client timestamp instead
         if (!isvalid)
@@ -642,7 +1000,9 @@ void Node::setfingerprint()
             mtime = ctime;
         }
 
-        fingerprint_it = client->fingerprints.insert((FileFingerprint*)this);
+        client->fingerprints.add(this);
+        client->reindexvalue(&client->nodesbymtime, this, oldmtime, mtime);
+        resortinviews();
     }
 }
 
@@ -664,9 +1024,9 @@ const char* Node::displayname() const
 
     attr_map::const_iterator it;
 
-    it = attrs.map.find('n');
+    it = attrs().map.find('n');
 
-    if (it == attrs.map.end())
+    if (it == attrs().map.end())
     {
         if (type < ROOTNODE || type > RUBBISHNODE)
         {
@@ -711,11 +1071,36 @@ int Node::hasfileattribute(const string *fileattrstring, fatype t)
 }
 
 // attempt to apply node key - sets nodekey to a raw key if successful
+unsigned Node::keylength() const
+{
+    return (type == FILENODE) ? FILENODEKEYLENGTH + 0 : FOLDERNODEKEYLENGTH + 0;
+}
+
 bool Node::applykey()
 {
-    unsigned int keylength = (type == FILENODE)
-                   ? FILENODEKEYLENGTH + 0
-                   : FOLDERNODEKEYLENGTH + 0;
+    const char* k;
+    SymmCipher* sc;
+
+    if (!findkey(&k, &sc))
+    {
+        return false;
+    }
+
+    unsigned int keylength = this->keylength();
+    byte key[FILENODEKEYLENGTH];
+
+    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
+    {
+        nodekey.assign((const char*)key, keylength);
+        setattr();
+    }
+
+    return true;
+}
+
+bool Node::findkey(const char** keyptr, SymmCipher** keycipher)
+{
+    unsigned int keylength = this->keylength();
 
     if (type > FOLDERNODE)
     {
@@ -791,13 +1176,8 @@ bool Node::applykey()
         }
     }
 
-    byte key[FILENODEKEYLENGTH];
-
-    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
-    {
-        nodekey.assign((const char*)key, keylength);
-        setattr();
-    }
+    *keyptr = k;
+    *keycipher = sc;
 
     return true;
 }
@@ -810,8 +1190,18 @@ bool Node::setparent(Node* p)
         return false;
     }
 
+    invalidatepaths();
+
     if (parent)
     {
+        detachcounter();
+        removefromviews();
+
+        if (parent->childnames)
+        {
+            parent->childnames->erase(childname_it);
+        }
+
         parent->children.erase(child_it);
     }
 
@@ -824,8 +1214,18 @@ bool Node::setparent(Node* p)
     if (parent)
     {
         child_it = parent->children.insert(parent->children.end(), this);
+
+        if (parent->childnames)
+        {
+            childname_it = parent->childnames->insert(pair<uint64_t, Node*>(nameindexkey(this), this));
+        }
+
+        attachcounter();
+        addtoviews();
     }
 
+    invalidatepaths();
+
 #ifdef ENABLE_SYNC
     // if we are moving an entire sync, don't cancel GET transfers
     if (!localnode || localnode->parent)
@@ -857,6 +1257,288 @@ bool Node::setparent(Node* p)
     return true;
 }
 
+void Node::indexchildnames()
+{
+    if (childnames)
+    {
+        return;
+    }
+
+    childnames = new nodename_multimap;
+
+    for (node_list::iterator it = children.begin(); it != children.end(); it++)
+    {
+        (*it)->childname_it = childnames->insert(pair<uint64_t, Node*>(nameindexkey(*it), *it));
+    }
+}
+
+void Node::updatenameindex()
+{
+    invalidatepaths();
+    resortinviews();
+
+    if (parent && parent->childnames)
+    {
+        parent->childnames->erase(childname_it);
+        childname_it = parent->childnames->insert(pair<uint64_t, Node*>(nameindexkey(this), this));
+    }
+
+    // the name-derived indexes are only maintained once they have been
+    // requested (see MegaClient::indexnames()), so that the attributes are
+    // not decoded until then
+    if (!client || !client->namesindexed)
+    {
+        return;
+    }
+
+    // only actual names are searchable (not the placeholders of undecryptable nodes)
+    const char* name = NULL;
+
+    if (!attrstring)
+    {
+        attr_map::const_iterator it = attrs().map.find('n');
+
+        if (it != attrs().map.end() && it->second.size())
+        {
+            name = it->second.c_str();
+        }
+    }
+
+    uint64_t h = name ? namehash(name) : 0;
+
+    if (type == FILENODE)
+    {
+        string ext;
+
+        if (name)
+        {
+            extension(name, &ext);
+        }
+
+        if (extension_it == client->nodesbyextension.end() || extension_it->first != ext)
+        {
+            if (extension_it != client->nodesbyextension.end())
+            {
+                client->nodesbyextension.erase(extension_it);
+                extension_it = client->nodesbyextension.end();
+            }
+
+            if (ext.size())
+            {
+                extension_it = client->nodesbyextension.insert(pair<string, Node*>(ext, this));
+            }
+        }
+    }
+
+    if (h != searchnamehash)
+    {
+        if (searchnamehash)
+        {
+            client->searchindex.remove(nodehandle);
+        }
+
+        if (name)
+        {
+            client->searchindex.add(nodehandle, name);
+        }
+
+        searchnamehash = h;
+    }
+}
+
+void Node::propagatecounter(NodeCounter delta)
+{
+    for (Node* n = parent; n; n = n->parent)
+    {
+        // files below a file node are previous versions of it
+        if (n->type == FILENODE)
+        {
+            delta.versions += delta.files;
+            delta.versionstorage += delta.storage;
+            delta.files = 0;
+            delta.storage = 0;
+        }
+
+        n->counter += delta;
+    }
+}
+
+void Node::attachcounter()
+{
+    if (client->pagingnode)
+    {
+        return;
+    }
+
+    if (type == FILENODE)
+    {
+        parent->numchildfiles++;
+    }
+    else
+    {
+        parent->numchildfolders++;
+    }
+
+    propagatecounter(counter);
+}
+
+void Node::detachcounter()
+{
+    if (client->pagingnode)
+    {
+        return;
+    }
+
+    if (type == FILENODE)
+    {
+        parent->numchildfiles--;
+    }
+    else
+    {
+        parent->numchildfolders--;
+    }
+
+    NodeCounter delta;
+    delta -= counter;
+    propagatecounter(delta);
+}
+
+void Node::addpagedchildren(int numfiles, NodeCounter delta)
+{
+    numchildfiles += numfiles;
+    childrenloaded = false;
+
+    // same as attachcounter() for each of the children
+    if (type == FILENODE)
+    {
+        delta.versions += delta.files;
+        delta.versionstorage += delta.storage;
+        delta.files = 0;
+        delta.storage = 0;
+    }
+
+    counter += delta;
+    propagatecounter(delta);
+}
+
+void Node::setsize(m_off_t s)
+{
+    if (type == FILENODE)
+    {
+        NodeCounter delta;
+        delta.storage = ((s > 0) ? s : 0) - ((size > 0) ? size : 0);
+
+        counter += delta;
+        propagatecounter(delta);
+
+        client->reindexvalue(&client->nodesbysize, this, size, s);
+    }
+
+    size = s;
+    resortinviews();
+}
+
+void Node::setctime(m_time_t ts)
+{
+    client->reindexvalue(&client->nodesbyctime, this, ctime, ts);
+    ctime = ts;
+    resortinviews();
+}
+
+void Node::addtoviews()
+{
+    if (parent && parent->childviews)
+    {
+        for (childview_list::iterator it = parent->childviews->begin(); it != parent->childviews->end(); it++)
+        {
+            // after all equal elements, as a stable sort would do
+            it->nodes.insert(lower_bound(it->nodes.begin(), it->nodes.end(), this, it->comp), this);
+        }
+    }
+}
+
+void Node::removefromviews()
+{
+    if (parent && parent->childviews)
+    {
+        for (childview_list::iterator it = parent->childviews->begin(); it != parent->childviews->end(); it++)
+        {
+            node_vector::iterator nit = find(it->nodes.begin(), it->nodes.end(), this);
+
+            if (nit != it->nodes.end())
+            {
+                it->nodes.erase(nit);
+            }
+        }
+    }
+}
+
+// a sort key of this node has changed
+void Node::resortinviews()
+{
+    if (parent && parent->childviews)
+    {
+        removefromviews();
+        addtoviews();
+    }
+}
+
+void Node::extension(const char* name, string* ext)
+{
+    const char* dot = strrchr(name, '.');
+
+    ext->clear();
+
+    // a leading dot denotes a hidden file, not an extension
+    if (dot && dot != name)
+    {
+        for (dot++; *dot; dot++)
+        {
+            ext->push_back((*dot >= 'A' && *dot <= 'Z') ? *dot + ('a' - 'A') : *dot);
+        }
+    }
+}
+
+void Node::invalidatepaths()
+{
+    if (!client || client->pathcache.empty())
+    {
+        return;
+    }
+
+    client->pathcache.invalidate(this);
+
+    if (!parent)
+    {
+        return;
+    }
+
+    uint64_t key = nameindexkey(this);
+
+    if (parent->childnames)
+    {
+        pair<nodename_multimap::iterator, nodename_multimap::iterator> range = parent->childnames->equal_range(key);
+
+        for (nodename_multimap::iterator it = range.first; it != range.second; it++)
+        {
+            if (it->second != this)
+            {
+                client->pathcache.invalidate(it->second);
+            }
+        }
+    }
+    else
+    {
+        for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
+        {
+            if (*it != this && nameindexkey(*it) == key)
+            {
+                client->pathcache.invalidate(*it);
+            }
+        }
+    }
+}
+
 // returns 1 if n is under p, 0 otherwise
 bool Node::isbelow(Node* p) const
 {
@@ -890,6 +1572,8 @@ void Node::setpubliclink(handle ph, m_time_t ets, bool takendown)
         plink->ets = ets;
         plink->takendown = takendown;
     }
+
+    client->updatesharednodes(this);
 }
 
 NodeCore::NodeCore()
@@ -973,7 +1657,7 @@ void LocalNode::setnameparent(LocalNode* newparent, string* newlocalpath)
 
             if (node)
             {
-                if (name != node->attrs.map['n'])
+                if (name != node->attrs().map['n'])
                 {
                     if (node->type == FILENODE)
                     {
@@ -984,11 +1668,11 @@ void LocalNode::setnameparent(LocalNode* newparent, string* newlocalpath)
                         sync->client->app->syncupdate_treestate(this);
                     }
 
-                    string prevname = node->attrs.map['n'];
+                    string prevname = node->attrs().map['n'];
                     int creqtag = sync->client->reqtag;
 
                     // set new name
-                    node->attrs.map['n'] = name;
+                    node->attrs().map['n'] = name;
                     sync->client->reqtag = sync->tag;
                     sync->client->setattr(node, prevname.c_str());
                     sync->client->reqtag = creqtag;
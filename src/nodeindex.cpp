@@ -0,0 +1,655 @@
+/**
+ * @file nodeindex.cpp
+ * @brief Node handle index, Node slab allocator, node path cache and
+ * fingerprint index
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/nodeindex.h"
+#include "mega/node.h"
+#include "mega/logging.h"
+
+namespace mega {
+const handle NodeIndex::EMPTYSLOT;
+const handle NodeIndex::DELETEDSLOT;
+const size_t NodeIndex::MINCAPACITY;
+const size_t FingerprintIndex::MINBUCKETS;
+
+NodeIndex::NodeIndex()
+{
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+    used = 0;
+}
+
+NodeIndex::~NodeIndex()
+{
+    delete[] slots;
+}
+
+// 64-bit finalizer mix - handles are mostly random, but this also spreads
+// sequential handles evenly across the table
+size_t NodeIndex::hash(handle h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+
+    return (size_t)h;
+}
+
+NodeIndex::value_type* NodeIndex::lookup(handle h) const
+{
+    if (!count || h == EMPTYSLOT || h == DELETEDSLOT)
+    {
+        return NULL;
+    }
+
+    size_t mask = capacity - 1;
+
+    for (size_t i = hash(h) & mask; ; i = (i + 1) & mask)
+    {
+        if (slots[i].first == h)
+        {
+            return slots + i;
+        }
+
+        if (slots[i].first == EMPTYSLOT)
+        {
+            return NULL;
+        }
+    }
+}
+
+void NodeIndex::rehash(size_t newcapacity)
+{
+    size_t c = MINCAPACITY;
+
+    while (c < newcapacity)
+    {
+        c <<= 1;
+    }
+
+    value_type* oldslots = slots;
+    size_t oldcapacity = capacity;
+
+    slots = new value_type[c];
+    capacity = c;
+    used = count;
+
+    for (size_t i = c; i--; )
+    {
+        slots[i].first = EMPTYSLOT;
+        slots[i].second = NULL;
+    }
+
+    size_t mask = capacity - 1;
+
+    for (size_t i = 0; i < oldcapacity; i++)
+    {
+        if (oldslots[i].first != EMPTYSLOT && oldslots[i].first != DELETEDSLOT)
+        {
+            size_t j = hash(oldslots[i].first) & mask;
+
+            while (slots[j].first != EMPTYSLOT)
+            {
+                j = (j + 1) & mask;
+            }
+
+            slots[j] = oldslots[i];
+        }
+    }
+
+    delete[] oldslots;
+}
+
+Node*& NodeIndex::operator[](handle h)
+{
+    value_type* v = lookup(h);
+
+    if (v)
+    {
+        return v->second;
+    }
+
+    assert(h != EMPTYSLOT && h != DELETEDSLOT);
+
+    // keep the load factor (tombstones included) below 70%
+    if ((used + 1) * 10 > capacity * 7)
+    {
+        rehash((count + 1) * 2);
+    }
+
+    size_t mask = capacity - 1;
+    size_t i = hash(h) & mask;
+
+    // the handle is not present, so the first free slot can be reused
+    while (slots[i].first != EMPTYSLOT && slots[i].first != DELETEDSLOT)
+    {
+        i = (i + 1) & mask;
+    }
+
+    if (slots[i].first == EMPTYSLOT)
+    {
+        used++;
+    }
+
+    count++;
+    slots[i].first = h;
+    slots[i].second = NULL;
+
+    return slots[i].second;
+}
+
+NodeIndex::iterator NodeIndex::find(handle h)
+{
+    value_type* v = lookup(h);
+
+    return v ? iterator(v, slots + capacity) : end();
+}
+
+size_t NodeIndex::erase(handle h)
+{
+    value_type* v = lookup(h);
+
+    if (!v)
+    {
+        return 0;
+    }
+
+    v->first = DELETEDSLOT;
+    v->second = NULL;
+    count--;
+
+    if (!count)
+    {
+        // no live entries left: all slots can be recycled at once
+        for (size_t i = capacity; i--; )
+        {
+            slots[i].first = EMPTYSLOT;
+        }
+
+        used = 0;
+    }
+
+    return 1;
+}
+
+void NodeIndex::erase(iterator it)
+{
+    if (it != end())
+    {
+        erase(it->first);
+    }
+}
+
+size_t NodeIndex::size() const
+{
+    return count;
+}
+
+bool NodeIndex::empty() const
+{
+    return !count;
+}
+
+void NodeIndex::clear()
+{
+    delete[] slots;
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+    used = 0;
+}
+
+void NodeIndex::reserve(size_t n)
+{
+    if (n * 10 > capacity * 7)
+    {
+        rehash(n * 10 / 7 + 1);
+    }
+}
+
+NodeIndex::iterator NodeIndex::begin()
+{
+    return iterator(slots, slots + capacity);
+}
+
+NodeIndex::iterator NodeIndex::end()
+{
+    return iterator(slots + capacity, slots + capacity);
+}
+
+void NodeIndex::iterator::skip()
+{
+    while (slot != last && (slot->first == EMPTYSLOT || slot->first == DELETEDSLOT))
+    {
+        slot++;
+    }
+}
+
+NodeIndex::iterator& NodeIndex::iterator::operator++()
+{
+    slot++;
+    skip();
+    return *this;
+}
+
+NodeIndex::iterator NodeIndex::iterator::operator++(int)
+{
+    iterator it = *this;
+    ++*this;
+    return it;
+}
+
+SlabAllocator::SlabAllocator(size_t size, size_t count)
+{
+    // blocks must be able to hold a free list link and keep the alignment
+    // of the largest scalar type
+    const size_t align = sizeof(void*) > sizeof(int64_t) ? sizeof(void*) : sizeof(int64_t);
+
+    if (size < sizeof(FreeBlock))
+    {
+        size = sizeof(FreeBlock);
+    }
+
+    blocksize = (size + align - 1) & ~(align - 1);
+    blocksperslab = count ? count : 1;
+    numinuse = 0;
+    freelist = NULL;
+}
+
+SlabAllocator::~SlabAllocator()
+{
+    if (numinuse)
+    {
+        LOG_warn << "Destroying slab allocator with " << numinuse << " blocks in use";
+    }
+
+    releaseslabs();
+}
+
+void SlabAllocator::addslab()
+{
+    char* slab = new char[blocksize * blocksperslab];
+
+    slabs.push_back(slab);
+
+    // chain the new blocks in address order
+    for (size_t i = blocksperslab; i--; )
+    {
+        FreeBlock* b = (FreeBlock*)(slab + i * blocksize);
+        b->next = freelist;
+        freelist = b;
+    }
+}
+
+void SlabAllocator::releaseslabs()
+{
+    for (vector<char*>::iterator it = slabs.begin(); it != slabs.end(); it++)
+    {
+        delete[] *it;
+    }
+
+    slabs.clear();
+    freelist = NULL;
+}
+
+void* SlabAllocator::alloc()
+{
+    if (!freelist)
+    {
+        addslab();
+    }
+
+    FreeBlock* b = freelist;
+    freelist = b->next;
+    numinuse++;
+
+    return b;
+}
+
+void SlabAllocator::release(void* p)
+{
+    if (!p)
+    {
+        return;
+    }
+
+    FreeBlock* b = (FreeBlock*)p;
+    b->next = freelist;
+    freelist = b;
+
+    // return all memory to the system once the last block is gone
+    if (!--numinuse)
+    {
+        releaseslabs();
+    }
+}
+
+size_t SlabAllocator::inuse() const
+{
+    return numinuse;
+}
+
+size_t SlabAllocator::reserved() const
+{
+    return slabs.size() * blocksize * blocksperslab;
+}
+
+NodePathCache::NodePathCache(size_t max)
+{
+    maxentries = max;
+}
+
+Node* NodePathCache::getnode(const string& path)
+{
+    pathnode_map::iterator it = nodes.find(path);
+
+    return (it == nodes.end()) ? NULL : it->second;
+}
+
+void NodePathCache::putnode(const string& path, Node* n)
+{
+    if (nodes.find(path) != nodes.end())
+    {
+        return;
+    }
+
+    makeroom();
+
+    pathnode_map::iterator it = nodes.insert(pair<string, Node*>(path, n)).first;
+    pathsbynode.insert(pair<Node*, pathnode_map::iterator>(n, it));
+}
+
+bool NodePathCache::getpath(Node* n, string* path)
+{
+    nodestring_map::iterator it = paths.find(n);
+
+    if (it == paths.end())
+    {
+        return false;
+    }
+
+    *path = it->second;
+    return true;
+}
+
+void NodePathCache::putpath(Node* n, const string& path)
+{
+    makeroom();
+
+    paths[n] = path;
+}
+
+// a full cache is simply emptied - the working set is rebuilt quickly
+void NodePathCache::makeroom()
+{
+    if (nodes.size() + paths.size() >= maxentries)
+    {
+        clear();
+    }
+}
+
+void NodePathCache::erase(Node* n)
+{
+    pair<nodepath_multimap::iterator, nodepath_multimap::iterator> range = pathsbynode.equal_range(n);
+
+    for (nodepath_multimap::iterator it = range.first; it != range.second; it++)
+    {
+        nodes.erase(it->second);
+    }
+
+    pathsbynode.erase(range.first, range.second);
+    paths.erase(n);
+}
+
+void NodePathCache::invalidate(Node* n)
+{
+    if (empty())
+    {
+        return;
+    }
+
+    erase(n);
+
+    if (n->children.empty())
+    {
+        return;
+    }
+
+    // the paths of all nodes below n have changed as well
+    vector<Node*> below;
+
+    for (nodepath_multimap::iterator it = pathsbynode.begin(); it != pathsbynode.end(); it++)
+    {
+        if (it->first->isbelow(n))
+        {
+            below.push_back(it->first);
+        }
+    }
+
+    for (nodestring_map::iterator it = paths.begin(); it != paths.end(); it++)
+    {
+        if (it->first->isbelow(n))
+        {
+            below.push_back(it->first);
+        }
+    }
+
+    for (vector<Node*>::iterator it = below.begin(); it != below.end(); it++)
+    {
+        erase(*it);
+    }
+}
+
+bool NodePathCache::empty() const
+{
+    return nodes.empty() && paths.empty();
+}
+
+void NodePathCache::clear()
+{
+    nodes.clear();
+    pathsbynode.clear();
+    paths.clear();
+}
+
+FingerprintIndex::FingerprintIndex()
+{
+    buckets = NULL;
+    numbuckets = 0;
+    count = 0;
+}
+
+FingerprintIndex::~FingerprintIndex()
+{
+    clear();
+}
+
+size_t FingerprintIndex::hash(const FileFingerprint* fp)
+{
+    uint64_t h = (uint64_t)fp->size * 0x9e3779b97f4a7c15ULL;
+
+    h ^= (uint64_t)fp->mtime + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+
+    for (int i = 0; i < 4; i++)
+    {
+        h ^= (uint32_t)fp->crc[i] + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+
+    return (size_t)h;
+}
+
+bool FingerprintIndex::equal(const FileFingerprint* a, const FileFingerprint* b)
+{
+    return a->size == b->size
+        && a->mtime == b->mtime
+        && !memcmp(a->crc, b->crc, sizeof a->crc);
+}
+
+void FingerprintIndex::link(Node** bucket, Node* n)
+{
+    Node** pp = bucket;
+
+    while (*pp)
+    {
+        pp = &(*pp)->fingerprintnext;
+    }
+
+    *pp = n;
+    n->fingerprintprev = pp;
+    n->fingerprintnext = NULL;
+}
+
+void FingerprintIndex::rehash(size_t n)
+{
+    size_t c = MINBUCKETS;
+
+    while (c < n)
+    {
+        c <<= 1;
+    }
+
+    Node** oldbuckets = buckets;
+    size_t oldnumbuckets = numbuckets;
+
+    buckets = new Node*[c];
+    numbuckets = c;
+    memset(buckets, 0, c * sizeof *buckets);
+
+    // chains are moved in order, so equal fingerprints keep their order
+    for (size_t i = 0; i < oldnumbuckets; i++)
+    {
+        Node* next;
+
+        for (Node* node = oldbuckets[i]; node; node = next)
+        {
+            next = node->fingerprintnext;
+            link(buckets + (hash(node) & (numbuckets - 1)), node);
+        }
+    }
+
+    delete[] oldbuckets;
+}
+
+void FingerprintIndex::add(Node* n)
+{
+    assert(!n->fingerprintprev);
+
+    // keep the load factor at or below 1
+    if (count >= numbuckets)
+    {
+        rehash(numbuckets * 2);
+    }
+
+    link(buckets + (hash(n) & (numbuckets - 1)), n);
+    count++;
+}
+
+void FingerprintIndex::remove(Node* n)
+{
+    if (!n->fingerprintprev)
+    {
+        return;
+    }
+
+    *n->fingerprintprev = n->fingerprintnext;
+
+    if (n->fingerprintnext)
+    {
+        n->fingerprintnext->fingerprintprev = n->fingerprintprev;
+    }
+
+    n->fingerprintnext = NULL;
+    n->fingerprintprev = NULL;
+    count--;
+}
+
+Node* FingerprintIndex::find(const FileFingerprint* fp) const
+{
+    if (!count)
+    {
+        return NULL;
+    }
+
+    for (Node* n = buckets[hash(fp) & (numbuckets - 1)]; n; n = n->fingerprintnext)
+    {
+        if (equal(n, fp))
+        {
+            return n;
+        }
+    }
+
+    return NULL;
+}
+
+void FingerprintIndex::findall(const FileFingerprint* fp, node_vector* result) const
+{
+    if (!count)
+    {
+        return;
+    }
+
+    for (Node* n = buckets[hash(fp) & (numbuckets - 1)]; n; n = n->fingerprintnext)
+    {
+        if (equal(n, fp))
+        {
+            result->push_back(n);
+        }
+    }
+}
+
+size_t FingerprintIndex::size() const
+{
+    return count;
+}
+
+void FingerprintIndex::clear()
+{
+    for (size_t i = 0; i < numbuckets; i++)
+    {
+        Node* next;
+
+        for (Node* n = buckets[i]; n; n = next)
+        {
+            next = n->fingerprintnext;
+            n->fingerprintnext = NULL;
+            n->fingerprintprev = NULL;
+        }
+    }
+
+    delete[] buckets;
+    buckets = NULL;
+    numbuckets = 0;
+    count = 0;
+}
+
+void FingerprintIndex::reserve(size_t n)
+{
+    if (n > numbuckets)
+    {
+        rehash(n);
+    }
+}
+} // namespace
@@ -45,10 +45,18 @@ namespace mega {
     char* PosixFileSystemAccess::appbasepath = NULL;
 #endif
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_IO_URING)
 PosixAsyncIOContext::PosixAsyncIOContext() : AsyncIOContext()
 {
+#ifdef HAVE_AIO_RT
     aiocb = NULL;
+#endif
+#ifdef HAVE_IO_URING
+    ring = NULL;
+    fd = -1;
+    done = 0;
+    fixed = false;
+#endif
 }
 
 PosixAsyncIOContext::~PosixAsyncIOContext()
@@ -59,6 +67,18 @@ PosixAsyncIOContext::~PosixAsyncIOContext()
 
 void PosixAsyncIOContext::finish()
 {
+#ifdef HAVE_IO_URING
+    if (ring)
+    {
+        LOG_debug << "Synchronously waiting for async operation";
+        while (!finished)
+        {
+            ring->waitone();
+        }
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
     if (aiocb)
     {
         if (!finished)
@@ -69,15 +89,20 @@ void PosixAsyncIOContext::finish()
         delete aiocb;
         aiocb = NULL;
     }
+#endif
     assert(finished);
 }
 #endif
 
-PosixFileAccess::PosixFileAccess(Waiter *w, int defaultfilepermissions) : FileAccess(w)
+PosixFileAccess::PosixFileAccess(Waiter *w, int defaultfilepermissions, PosixFileSystemAccess* fs) : FileAccess(w)
 {
     fd = -1;
     this->defaultfilepermissions = defaultfilepermissions;
 
+#ifdef HAVE_IO_URING
+    fsaccess = fs;
+#endif
+
 #ifndef HAVE_FDOPENDIR
     dp = NULL;
 #endif
@@ -168,6 +193,13 @@ void PosixFileAccess::sysclose()
 
 bool PosixFileAccess::asyncavailable()
 {
+#ifdef HAVE_IO_URING
+    if (fsaccess && fsaccess->getring())
+    {
+        return true;
+    }
+#endif
+
 #ifdef HAVE_AIO_RT
     #ifdef __APPLE__
         return false;
@@ -179,11 +211,44 @@ bool PosixFileAccess::asyncavailable()
 #endif
 }
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_IO_URING)
 AsyncIOContext *PosixFileAccess::newasynccontext()
 {
     return new PosixAsyncIOContext();
 }
+#endif
+
+#ifdef HAVE_IO_URING
+bool PosixFileAccess::ringio(PosixAsyncIOContext *context)
+{
+    PosixIoUring *ring = fsaccess ? fsaccess->getring() : NULL;
+
+    if (!ring)
+    {
+        return false;
+    }
+
+    context->fd = fd;
+    context->done = 0;
+
+    if (!ring->queue(context))
+    {
+        context->retry = true;
+        context->failed = true;
+        context->finished = true;
+
+        LOG_warn << "io_uring full, async operation not started";
+        if (context->userCallback)
+        {
+            context->userCallback(context->userData);
+        }
+    }
+
+    return true;
+}
+#endif
+
+#ifdef HAVE_AIO_RT
 
 void PosixFileAccess::asyncopfinished(sigval sigev_value)
 {
@@ -222,7 +287,7 @@ void PosixFileAccess::asyncopfinished(sigval sigev_value)
 
 void PosixFileAccess::asyncsysopen(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_IO_URING)
     string path;
     path.assign((char *)context->buffer, context->len);
     context->failed = !fopen(&path, context->access & AsyncIOContext::ACCESS_READ,
@@ -238,7 +303,7 @@ void PosixFileAccess::asyncsysopen(AsyncIOContext *context)
 
 void PosixFileAccess::asyncsysread(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_IO_URING)
     if (!context)
     {
         return;
@@ -257,6 +322,14 @@ void PosixFileAccess::asyncsysread(AsyncIOContext *context)
         return;
     }
 
+#ifdef HAVE_IO_URING
+    if (ringio(posixContext))
+    {
+        return;
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
     struct aiocb *aiocbp = new struct aiocb;
     memset(aiocbp, 0, sizeof (struct aiocb));
 
@@ -282,12 +355,21 @@ void PosixFileAccess::asyncsysread(AsyncIOContext *context)
             posixContext->userCallback(posixContext->userData);
         }
     }
+#else
+    posixContext->failed = true;
+    posixContext->retry = false;
+    posixContext->finished = true;
+    if (posixContext->userCallback)
+    {
+        posixContext->userCallback(posixContext->userData);
+    }
+#endif
 #endif
 }
 
 void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(HAVE_IO_URING)
     if (!context)
     {
         return;
@@ -306,6 +388,14 @@ void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
         return;
     }
 
+#ifdef HAVE_IO_URING
+    if (ringio(posixContext))
+    {
+        return;
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
     struct aiocb *aiocbp = new struct aiocb;
     memset(aiocbp, 0, sizeof (struct aiocb));
 
@@ -332,6 +422,15 @@ void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
             posixContext->userCallback(posixContext->userData);
         }
     }
+#else
+    posixContext->failed = true;
+    posixContext->retry = false;
+    posixContext->finished = true;
+    if (posixContext->userCallback)
+    {
+        posixContext->userCallback(posixContext->userData);
+    }
+#endif
 #endif
 }
 
@@ -366,6 +465,37 @@ bool PosixFileAccess::fwrite(const byte* data, unsigned len, m_off_t pos)
 #endif
 }
 
+bool PosixFileAccess::preallocate(m_off_t size)
+{
+#if defined(__linux__) && !defined(__ANDROID__) && defined(FALLOC_FL_KEEP_SIZE)
+    return !fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size);
+#elif defined(__MACH__) && defined(F_PREALLOCATE)
+    struct stat statbuf;
+
+    if (fstat(fd, &statbuf) || statbuf.st_size >= size)
+    {
+        return false;
+    }
+
+    // allocated from the end of the file - contiguous space if possible
+    fstore_t store;
+    memset(&store, 0, sizeof store);
+    store.fst_flags = F_ALLOCATECONTIG;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_length = size - statbuf.st_size;
+
+    if (fcntl(fd, F_PREALLOCATE, &store) < 0)
+    {
+        store.fst_flags = F_ALLOCATEALL;
+        return fcntl(fd, F_PREALLOCATE, &store) >= 0;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 bool PosixFileAccess::fopen(string* f, bool read, bool write)
 {
 #ifdef USE_IOS
@@ -509,6 +639,11 @@ PosixFileSystemAccess::PosixFileSystemAccess(int fseventsfd)
     notifyfailed = true;
     notifyfd = -1;
 
+#ifdef HAVE_IO_URING
+    ring = NULL;
+    ringfailed = false;
+#endif
+
     defaultfilepermissions = 0600;
     defaultfolderpermissions = 0700;
 
@@ -612,6 +747,56 @@ PosixFileSystemAccess::~PosixFileSystemAccess()
     {
         close(notifyfd);
     }
+
+#ifdef HAVE_IO_URING
+    delete ring;
+#endif
+}
+
+#ifdef HAVE_IO_URING
+PosixIoUring* PosixFileSystemAccess::getring()
+{
+    if (!ring && !ringfailed)
+    {
+        ring = PosixIoUring::create();
+        ringfailed = !ring;
+    }
+
+    return ring;
+}
+#endif
+
+void PosixFileSystemAccess::flushasyncio()
+{
+#ifdef HAVE_IO_URING
+    if (ring)
+    {
+        ring->reap();
+        ring->submit();
+    }
+#endif
+}
+
+bool PosixFileSystemAccess::registeriobuffer(byte* data, size_t len)
+{
+#ifdef HAVE_IO_URING
+    if (getring())
+    {
+        return ring->registerbuffer(data, len);
+    }
+#endif
+
+    return false;
+}
+
+void PosixFileSystemAccess::unregisteriobuffer(byte* data)
+{
+#ifdef HAVE_IO_URING
+    if (ring)
+    {
+        ring->unregisterbuffer(data);
+    }
+#endif
 }
 
 // wake up from filesystem updates
@@ -626,12 +811,35 @@ void PosixFileSystemAccess::addevents(Waiter* w, int flags)
 
         pw->bumpmaxfd(notifyfd);
     }
+
+#ifdef HAVE_IO_URING
+    if (ring)
+    {
+        PosixWaiter* pw = (PosixWaiter*)w;
+
+        // nothing is left unsubmitted while waiting - the ring becomes
+        // readable once operations have completed
+        ring->submit();
+
+        FD_SET(ring->fd, &pw->rfds);
+        pw->bumpmaxfd(ring->fd);
+    }
+#endif
 }
 
 // read all pending inotify events and queue them for processing
 int PosixFileSystemAccess::checkevents(Waiter* w)
 {
     int r = 0;
+
+#ifdef HAVE_IO_URING
+    // complete the finished asynchronous reads/writes
+    if (ring && ring->reap())
+    {
+        r |= Waiter::NEEDEXEC;
+    }
+#endif
+
     if (notifyfd < 0)
     {
         return r;
@@ -1741,7 +1949,7 @@ fsfp_t PosixDirNotify::fsfingerprint()
 
 FileAccess* PosixFileSystemAccess::newfileaccess()
 {
-    return new PosixFileAccess(waiter, defaultfilepermissions);
+    return new PosixFileAccess(waiter, defaultfilepermissions, this);
 }
 
 DirAccess* PosixFileSystemAccess::newdiraccess()
@@ -0,0 +1,492 @@
+/**
+ * @file posix/iouring.cpp
+ * @brief io_uring based asynchronous file I/O (Linux)
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+
+#ifdef HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+namespace mega {
+// submission queue entries (the completion queue is twice as large)
+static const unsigned RINGENTRIES = 64;
+
+// registered buffers (UIO_MAXIOV, the limit of older kernels)
+static const size_t MAXBUFFERS = 1024;
+
+// the kernel updates the ring heads/tails concurrently
+#define RING_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+PosixIoUring::PosixIoUring()
+{
+    fd = -1;
+    entries = 0;
+    sqhead = sqtail = sqarray = NULL;
+    sqmask = 0;
+    sqes = NULL;
+    cqhead = cqtail = NULL;
+    cqmask = cqentries = 0;
+    cqes = NULL;
+    sqring = cqring = MAP_FAILED;
+    sqringsize = cqringsize = sqessize = 0;
+    pending = 0;
+    inflight = 0;
+    buffersregistered = false;
+    buffersdirty = false;
+    inflightfixed = 0;
+    poolgeneration = 0;
+}
+
+PosixIoUring::~PosixIoUring()
+{
+    // the contexts finish their operations before they are deleted
+    assert(!busy());
+
+    if (sqes && sqes != MAP_FAILED)
+    {
+        munmap(sqes, sqessize);
+    }
+
+    if (cqring != MAP_FAILED && cqring != sqring)
+    {
+        munmap(cqring, cqringsize);
+    }
+
+    if (sqring != MAP_FAILED)
+    {
+        munmap(sqring, sqringsize);
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+PosixIoUring* PosixIoUring::create()
+{
+    struct io_uring_params params;
+    PosixIoUring* ring = new PosixIoUring();
+
+    memset(&params, 0, sizeof params);
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, RINGENTRIES, &params);
+
+    if (ring->fd < 0)
+    {
+        LOG_info << "io_uring not available: " << errno;
+        delete ring;
+        return NULL;
+    }
+
+    fcntl(ring->fd, F_SETFD, FD_CLOEXEC);
+
+    // plain reads and writes need Linux 5.6
+    size_t probesize = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = (struct io_uring_probe*)calloc(1, probesize);
+    bool supported = probe
+            && syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) >= 0
+            && probe->last_op >= IORING_OP_WRITE
+            && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)
+            && (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+
+    free(probe);
+
+    if (!supported)
+    {
+        LOG_info << "io_uring lacks support for reads and writes";
+        delete ring;
+        return NULL;
+    }
+
+    ring->entries = params.sq_entries;
+    ring->cqentries = params.cq_entries;
+    ring->sqringsize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqringsize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqessize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cqringsize > ring->sqringsize)
+        {
+            ring->sqringsize = ring->cqringsize;
+        }
+
+        ring->cqringsize = ring->sqringsize;
+    }
+
+    ring->sqring = mmap(NULL, ring->sqringsize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+
+    if (ring->sqring != MAP_FAILED)
+    {
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            ring->cqring = ring->sqring;
+        }
+        else
+        {
+            ring->cqring = mmap(NULL, ring->cqringsize, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        }
+    }
+
+    if (ring->cqring != MAP_FAILED)
+    {
+        ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqessize, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    }
+
+    if (ring->sqring == MAP_FAILED || ring->cqring == MAP_FAILED || ring->sqes == MAP_FAILED)
+    {
+        LOG_warn << "Unable to map the io_uring queues: " << errno;
+        delete ring;
+        return NULL;
+    }
+
+    char* sq = (char*)ring->sqring;
+    ring->sqhead = (unsigned*)(sq + params.sq_off.head);
+    ring->sqtail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sqarray = (unsigned*)(sq + params.sq_off.array);
+    ring->sqmask = *(unsigned*)(sq + params.sq_off.ring_mask);
+
+    char* cq = (char*)ring->cqring;
+    ring->cqhead = (unsigned*)(cq + params.cq_off.head);
+    ring->cqtail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    ring->cqmask = *(unsigned*)(cq + params.cq_off.ring_mask);
+
+    LOG_debug << "Using io_uring for asynchronous file I/O (" << ring->entries << " entries)";
+
+    return ring;
+}
+
+int PosixIoUring::enter(unsigned tosubmit, unsigned mincomplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, tosubmit, mincomplete, flags, NULL, 0);
+}
+
+bool PosixIoUring::busy() const
+{
+    return pending || inflight;
+}
+
+bool PosixIoUring::queue(PosixAsyncIOContext* context)
+{
+    if (*sqtail - RING_LOAD(sqhead) >= entries || pending + inflight >= cqentries)
+    {
+        // make room
+        reap();
+        submit();
+
+        if (*sqtail - RING_LOAD(sqhead) >= entries || pending + inflight >= cqentries)
+        {
+            return false;
+        }
+    }
+
+    unsigned tail = *sqtail;
+
+    checkpool();
+
+    if (buffersdirty && !inflightfixed)
+    {
+        updatebuffers();
+    }
+
+    unsigned index = tail & sqmask;
+    struct io_uring_sqe* sqe = sqes + index;
+    unsigned done = context->done;
+    int buffer = findbuffer(context->buffer + done, context->len - done);
+
+    memset(sqe, 0, sizeof *sqe);
+
+    if (buffer >= 0)
+    {
+        sqe->opcode = context->op == AsyncIOContext::READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+        sqe->buf_index = (unsigned short)buffer;
+        inflightfixed++;
+    }
+    else
+    {
+        sqe->opcode = context->op == AsyncIOContext::READ ? IORING_OP_READ : IORING_OP_WRITE;
+    }
+
+    context->fixed = buffer >= 0;
+
+    sqe->fd = context->fd;
+    sqe->off = context->pos + done;
+    sqe->addr = (uint64_t)(uintptr_t)(context->buffer + done);
+    sqe->len = context->len - done;
+    sqe->user_data = (uint64_t)(uintptr_t)context;
+
+    sqarray[index] = index;
+    RING_STORE(sqtail, tail + 1);
+
+    pending++;
+    context->ring = this;
+
+    return true;
+}
+
+void PosixIoUring::submit()
+{
+    while (pending)
+    {
+        int r = enter(pending, 0, 0);
+
+        if (r < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // EAGAIN/EBUSY: retried with the next submission
+            LOG_warn << "io_uring submission failed: " << errno;
+            return;
+        }
+
+        if (!r)
+        {
+            return;
+        }
+
+        pending -= r;
+        inflight += r;
+    }
+}
+
+void PosixIoUring::waitone()
+{
+    unsigned head = *cqhead;
+
+    if (head == RING_LOAD(cqtail))
+    {
+        int r;
+
+        while ((r = enter(pending, 1, IORING_ENTER_GETEVENTS)) < 0 && errno == EINTR);
+
+        if (r > 0)
+        {
+            pending -= r;
+            inflight += r;
+        }
+        else if (r < 0)
+        {
+            LOG_err << "Error waiting for io_uring completions: " << errno;
+        }
+    }
+
+    reap();
+}
+
+int PosixIoUring::reap()
+{
+    int count = 0;
+    unsigned head;
+
+    // (completing an operation may reap recursively to queue its remainder)
+    while ((head = *cqhead) != RING_LOAD(cqtail))
+    {
+        struct io_uring_cqe* cqe = cqes + (head & cqmask);
+        PosixAsyncIOContext* context = (PosixAsyncIOContext*)(uintptr_t)cqe->user_data;
+        int res = cqe->res;
+
+        // the entry can be reused by the kernel once the head has moved
+        RING_STORE(cqhead, ++head);
+
+        inflight--;
+        complete(context, res);
+        count++;
+    }
+
+    checkpool();
+
+    if (buffersdirty && !inflightfixed)
+    {
+        updatebuffers();
+    }
+
+    // remainders of short reads and writes
+    submit();
+
+    return count;
+}
+
+void PosixIoUring::complete(PosixAsyncIOContext* context, int res)
+{
+    if (context->fixed)
+    {
+        inflightfixed--;
+        context->fixed = false;
+    }
+
+    if (res > 0)
+    {
+        context->done += res;
+
+        if (context->done < context->len && queue(context))
+        {
+            return;
+        }
+    }
+
+    context->failed = context->done < context->len;
+
+    if (context->failed)
+    {
+        // a read past the end of the file does not resolve itself
+        context->retry = res == -EAGAIN || res == -EINTR || res == -EBUSY || (res > 0);
+        LOG_warn << "Async operation finished with error: " << res;
+    }
+    else if (context->op == AsyncIOContext::READ)
+    {
+        if (context->pad)
+        {
+            memset(context->buffer + context->len, 0, context->pad);
+        }
+
+        LOG_verbose << "Async read finished OK";
+    }
+    else
+    {
+        LOG_verbose << "Async write finished OK";
+    }
+
+    context->ring = NULL;
+    context->finished = true;
+
+    if (context->userCallback)
+    {
+        context->userCallback(context->userData);
+    }
+}
+
+int PosixIoUring::findbuffer(const byte* data, unsigned len) const
+{
+    if (!buffersregistered || buffersdirty)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < table.size(); i++)
+    {
+        const byte* base = (const byte*)table[i].iov_base;
+
+        if (data >= base && data + len <= base + table[i].iov_len)
+        {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+void PosixIoUring::checkpool()
+{
+    if (TransferBufferPool::generation() != poolgeneration)
+    {
+        buffersdirty = true;
+    }
+}
+
+bool PosixIoUring::registerbuffer(byte* data, size_t len)
+{
+    struct iovec iov;
+
+    iov.iov_base = data;
+    iov.iov_len = len;
+
+    buffers.push_back(iov);
+    buffersdirty = true;
+
+    if (!inflightfixed)
+    {
+        updatebuffers();
+    }
+
+    return true;
+}
+
+void PosixIoUring::unregisterbuffer(byte* data)
+{
+    for (vector<struct iovec>::iterator it = buffers.begin(); it != buffers.end(); it++)
+    {
+        if (it->iov_base == data)
+        {
+            buffers.erase(it);
+            buffersdirty = true;
+            break;
+        }
+    }
+
+    if (buffersdirty && !inflightfixed)
+    {
+        updatebuffers();
+    }
+}
+
+// replace the kernel's table of registered buffers
+void PosixIoUring::updatebuffers()
+{
+    if (buffersregistered)
+    {
+        syscall(__NR_io_uring_register, fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+        buffersregistered = false;
+    }
+
+    buffersdirty = false;
+
+    // a freed pool buffer must not be used through a stale registration,
+    // its address may be reused
+    vector<pair<byte*, size_t> > poolbuffers;
+    poolgeneration = TransferBufferPool::buffers(&poolbuffers);
+
+    table = buffers;
+
+    for (size_t i = 0; i < poolbuffers.size() && table.size() < MAXBUFFERS; i++)
+    {
+        struct iovec iov;
+
+        iov.iov_base = poolbuffers[i].first;
+        iov.iov_len = poolbuffers[i].second;
+        table.push_back(iov);
+    }
+
+    if (table.size())
+    {
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, &table[0], (unsigned)table.size()) < 0)
+        {
+            // e.g. over RLIMIT_MEMLOCK - plain reads/writes work as well
+            LOG_warn << "Unable to register " << table.size() << " I/O buffers: " << errno;
+        }
+        else
+        {
+            buffersregistered = true;
+        }
+    }
+}
+} // namespace
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * @file searchindex.cpp
+ * @brief Node name search index
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/searchindex.h"
+
+namespace mega {
+const size_t SearchIndex::MINSTALE;
+
+SearchIndex::SearchIndex()
+{
+    live = 0;
+    removed = 0;
+}
+
+// ASCII-only case folding, matching strcasestr() in the C locale
+static inline unsigned char foldcase(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+void SearchIndex::trigrams(const char* name, vector<uint32_t>* result)
+{
+    result->clear();
+
+    const unsigned char* p = (const unsigned char*)name;
+
+    if (!p[0] || !p[1])
+    {
+        return;
+    }
+
+    uint32_t t = (foldcase(p[0]) << 8) | foldcase(p[1]);
+
+    for (p += 2; *p; p++)
+    {
+        t = ((t << 8) | foldcase(*p)) & 0xffffff;
+        result->push_back(t);
+    }
+
+    sort(result->begin(), result->end());
+    result->erase(unique(result->begin(), result->end()), result->end());
+}
+
+void SearchIndex::PostingList::normalize()
+{
+    if (sorted < handles.size())
+    {
+        sort(handles.begin(), handles.end());
+        handles.erase(unique(handles.begin(), handles.end()), handles.end());
+        sorted = handles.size();
+    }
+}
+
+void SearchIndex::add(handle h, const char* name)
+{
+    vector<uint32_t> t;
+
+    trigrams(name, &t);
+
+    for (vector<uint32_t>::iterator it = t.begin(); it != t.end(); it++)
+    {
+        postings[*it].handles.push_back(h);
+    }
+
+    live++;
+}
+
+void SearchIndex::remove(handle)
+{
+    if (live)
+    {
+        live--;
+    }
+
+    removed++;
+}
+
+bool SearchIndex::candidates(const char* query, vector<handle>* result)
+{
+    vector<uint32_t> t;
+
+    result->clear();
+    trigrams(query, &t);
+
+    if (t.empty())
+    {
+        return false;
+    }
+
+    vector<PostingList*> lists;
+
+    for (vector<uint32_t>::iterator it = t.begin(); it != t.end(); it++)
+    {
+        posting_map::iterator pit = postings.find(*it);
+
+        if (pit == postings.end())
+        {
+            // a trigram that no name contains: no matches at all
+            return true;
+        }
+
+        pit->second.normalize();
+        lists.push_back(&pit->second);
+    }
+
+    // start with the shortest posting list, so that the candidate set
+    // only shrinks from there
+    size_t shortest = 0;
+
+    for (size_t i = 1; i < lists.size(); i++)
+    {
+        if (lists[i]->handles.size() < lists[shortest]->handles.size())
+        {
+            shortest = i;
+        }
+    }
+
+    *result = lists[shortest]->handles;
+
+    for (size_t i = 0; i < lists.size() && !result->empty(); i++)
+    {
+        if (i == shortest)
+        {
+            continue;
+        }
+
+        const vector<handle>& other = lists[i]->handles;
+        vector<handle>::const_iterator pos = other.begin();
+        size_t kept = 0;
+
+        for (size_t j = 0; j < result->size(); j++)
+        {
+            pos = lower_bound(pos, other.end(), (*result)[j]);
+
+            if (pos == other.end())
+            {
+                break;
+            }
+
+            if (*pos == (*result)[j])
+            {
+                (*result)[kept++] = (*result)[j];
+            }
+        }
+
+        result->resize(kept);
+    }
+
+    return true;
+}
+
+bool SearchIndex::needsrebuild() const
+{
+    return removed > MINSTALE && removed > live;
+}
+
+size_t SearchIndex::size() const
+{
+    return live;
+}
+
+void SearchIndex::clear()
+{
+    postings.clear();
+    live = 0;
+    removed = 0;
+}
+} // namespace
@@ -46,10 +46,26 @@ void Share::serialize(string* d)
 
 bool Share::unserialize(MegaClient* client, int direction, handle h,
                         const byte* key, const char** ptr, const char* end)
+{
+    NewShare* s = unserialize(direction, h, key, ptr, end);
+
+    if (!s)
+    {
+        return false;
+    }
+
+    client->newshares.push_back(s);
+
+    return true;
+}
+
+// decode a serialized share without queueing it (thread-safe)
+NewShare* Share::unserialize(int direction, handle h, const byte* key,
+                             const char** ptr, const char* end)
 {
     if (*ptr + sizeof(handle) + sizeof(m_time_t) + 2 > end)
     {
-        return 0;
+        return NULL;
     }
 
     char version_flag =  (*ptr)[sizeof(handle) + sizeof(m_time_t) + 1];
@@ -59,9 +75,9 @@ bool Share::unserialize(MegaClient* client, int direction, handle h,
         // Pending flag exists
         ph = MemAccess::get<handle>(*ptr + sizeof(handle) + sizeof(m_time_t) + 2);       
     }
-    client->newshares.push_back(new NewShare(h, direction, MemAccess::get<handle>(*ptr),
-                                             (accesslevel_t)(*ptr)[sizeof(handle) + sizeof(m_time_t)],
-                                             MemAccess::get<m_time_t>(*ptr + sizeof(handle)), key, NULL, ph));
+    NewShare* s = new NewShare(h, direction, MemAccess::get<handle>(*ptr),
+                               (accesslevel_t)(*ptr)[sizeof(handle) + sizeof(m_time_t)],
+                               MemAccess::get<m_time_t>(*ptr + sizeof(handle)), key, NULL, ph);
 
     *ptr += sizeof(handle) + sizeof(m_time_t) + 2;
     if (version_flag >= 1)
@@ -69,7 +85,7 @@ bool Share::unserialize(MegaClient* client, int direction, handle h,
         *ptr += sizeof(handle);
     }
 
-    return true;
+    return s;
 }
 
 void Share::update(accesslevel_t a, m_time_t t, PendingContactRequest* pending)
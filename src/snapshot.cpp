@@ -0,0 +1,642 @@
+/**
+ * @file snapshot.cpp
+ * @brief Binary snapshot of a local cache table
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/snapshot.h"
+#include "mega/utils.h"
+#include "mega/logging.h"
+
+namespace mega {
+const size_t SnapshotDbTable::MINJOURNAL;
+const unsigned SnapshotDbTable::READCHUNK;
+const uint32_t SnapshotDbTable::VERSION;
+const char SnapshotDbTable::MAGIC[8] = { 'M', 'E', 'G', 'A', 'S', 'N', 'A', 'P' };
+
+// magic, version, number of records, generation, offset of the entry table
+static const unsigned HEADERSIZE = 8 + 4 + 4 + 8 + 8;
+
+SnapshotDbTable::SnapshotDbTable(DbTable* ctable, FileSystemAccess* cfsaccess, string* localpath)
+{
+    table = ctable;
+    fsaccess = cfsaccess;
+
+    string suffix, localsuffix;
+
+    suffix = ".snapshot";
+    fsaccess->path2local(&suffix, &localsuffix);
+    snapshotpath = *localpath + localsuffix;
+
+    suffix = ".journal";
+    fsaccess->path2local(&suffix, &localsuffix);
+    journalpath = *localpath + localsuffix;
+
+    suffix = ".snapshot.tmp";
+    fsaccess->path2local(&suffix, &localsuffix);
+    tmppath = *localpath + localsuffix;
+
+    snapshotrecords = 0;
+    journaled = 0;
+    checkpointrequested = false;
+    reading = false;
+    reader = NULL;
+
+    if (!table->getgeneration(&generation))
+    {
+        generation = 0;
+    }
+
+    if (!(usable = validate()))
+    {
+        discard();
+    }
+}
+
+SnapshotDbTable::~SnapshotDbTable()
+{
+    endread();
+    delete table;
+}
+
+bool SnapshotDbTable::readheader(FileAccess* fa, uint32_t* count, uint64_t* gen, m_off_t* tableoffset)
+{
+    string header;
+
+    if (fa->size < HEADERSIZE || !fa->fread(&header, HEADERSIZE, 0, 0)
+            || memcmp(header.data(), MAGIC, sizeof MAGIC)
+            || MemAccess::get<uint32_t>(header.data() + 8) != VERSION)
+    {
+        return false;
+    }
+
+    *count = MemAccess::get<uint32_t>(header.data() + 12);
+    *gen = MemAccess::get<uint64_t>(header.data() + 16);
+    *tableoffset = MemAccess::get<uint64_t>(header.data() + 24);
+
+    return *tableoffset >= HEADERSIZE
+        && *tableoffset + (m_off_t)*count * (m_off_t)sizeof(Entry) == fa->size;
+}
+
+bool SnapshotDbTable::readjournal(vector<uint32_t>* ids, size_t* numids, uint64_t* lastgen)
+{
+    FileAccess* fa = fsaccess->newfileaccess();
+    string journal;
+
+    *numids = 0;
+    *lastgen = 0;
+
+    if (!fa->fopen(&journalpath, true, false))
+    {
+        // no changes since the snapshot
+        delete fa;
+        return true;
+    }
+
+    bool ok = !fa->size || fa->fread(&journal, fa->size, 0, 0);
+    delete fa;
+
+    const char* ptr = journal.data();
+    const char* end = ptr + journal.size();
+
+    while (ok && ptr < end)
+    {
+        if (ptr + sizeof(uint32_t) > end)
+        {
+            ok = false;
+            break;
+        }
+
+        uint32_t n = MemAccess::get<uint32_t>(ptr);
+        ptr += sizeof n;
+
+        if ((size_t)(end - ptr) < (size_t)n * sizeof(uint32_t) + sizeof(uint64_t))
+        {
+            // incomplete entry
+            ok = false;
+            break;
+        }
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (ids)
+            {
+                ids->push_back(MemAccess::get<uint32_t>(ptr));
+            }
+
+            ptr += sizeof(uint32_t);
+        }
+
+        uint64_t gen = MemAccess::get<uint64_t>(ptr);
+        ptr += sizeof gen;
+
+        if (gen <= *lastgen)
+        {
+            ok = false;
+            break;
+        }
+
+        *lastgen = gen;
+        *numids += n;
+    }
+
+    return ok;
+}
+
+bool SnapshotDbTable::validate()
+{
+    FileAccess* fa = fsaccess->newfileaccess();
+    uint32_t count;
+    uint64_t gen;
+    m_off_t tableoffset;
+
+    bool ok = fa->fopen(&snapshotpath, true, false) && readheader(fa, &count, &gen, &tableoffset);
+    delete fa;
+
+    if (!ok)
+    {
+        return false;
+    }
+
+    uint64_t lastgen;
+
+    if (!readjournal(NULL, &journaled, &lastgen))
+    {
+        LOG_warn << "Corrupt cache journal";
+        return false;
+    }
+
+    // the journal must continue the snapshot and reach the generation of the
+    // last committed transaction
+    if (lastgen ? (lastgen <= gen || lastgen != generation) : gen != generation)
+    {
+        LOG_debug << "Outdated cache snapshot";
+        return false;
+    }
+
+    snapshotrecords = count;
+
+    return true;
+}
+
+bool SnapshotDbTable::load()
+{
+    uint32_t count;
+    uint64_t gen;
+    size_t numids;
+    uint64_t lastgen;
+    string table;
+
+    reader = fsaccess->newfileaccess();
+
+    if (!reader->fopen(&snapshotpath, true, false)
+            || !readheader(reader, &count, &gen, &heapend)
+            || (count && !reader->fread(&table, count * sizeof(Entry), 0, heapend)))
+    {
+        endread();
+        return false;
+    }
+
+    entries.resize(count);
+
+    m_off_t total = HEADERSIZE;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        entries[i].id = MemAccess::get<uint32_t>(table.data() + i * sizeof(Entry));
+        entries[i].length = MemAccess::get<uint32_t>(table.data() + i * sizeof(Entry) + sizeof(uint32_t));
+
+        if (i && entries[i].id <= entries[i - 1].id)
+        {
+            endread();
+            return false;
+        }
+
+        total += entries[i].length;
+    }
+
+    if (total != heapend || !readjournal(&changed, &numids, &lastgen))
+    {
+        endread();
+        return false;
+    }
+
+    sort(changed.begin(), changed.end());
+    changed.erase(unique(changed.begin(), changed.end()), changed.end());
+
+    nextentry = 0;
+    nextoffset = HEADERSIZE;
+    nextchanged = 0;
+    buffer.clear();
+    bufferoffset = 0;
+
+    LOG_debug << "Reading cache snapshot with " << count << " records and " << changed.size() << " changed records";
+
+    return true;
+}
+
+void SnapshotDbTable::endread()
+{
+    delete reader;
+    reader = NULL;
+    reading = false;
+
+    entries.clear();
+    changed.clear();
+    buffer.clear();
+}
+
+void SnapshotDbTable::rewind()
+{
+    endread();
+
+    if (usable && load())
+    {
+        reading = true;
+        return;
+    }
+
+    if (usable)
+    {
+        LOG_err << "Unable to read the cache snapshot";
+        usable = false;
+        discard();
+    }
+
+    table->rewind();
+}
+
+bool SnapshotDbTable::readsnapshot(m_off_t offset, unsigned len, string* data)
+{
+    if (offset < bufferoffset || offset + len > bufferoffset + (m_off_t)buffer.size())
+    {
+        m_off_t n = heapend - offset;
+
+        if (n > READCHUNK)
+        {
+            n = (len > READCHUNK) ? len : READCHUNK;
+        }
+
+        if (!reader->fread(&buffer, (unsigned)n, 0, offset))
+        {
+            buffer.clear();
+            return false;
+        }
+
+        bufferoffset = offset;
+    }
+
+    data->assign(buffer.data() + (offset - bufferoffset), len);
+
+    return true;
+}
+
+// records in ascending id order: those from the snapshot, unless they were
+// changed since, and the current version of the changed ones
+bool SnapshotDbTable::next(uint32_t* id, string* data)
+{
+    if (!reading)
+    {
+        return table->next(id, data);
+    }
+
+    for (;;)
+    {
+        bool insnapshot = nextentry < entries.size();
+        bool inchanged = nextchanged < changed.size();
+
+        if (!insnapshot && !inchanged)
+        {
+            endread();
+            return false;
+        }
+
+        if (inchanged && (!insnapshot || changed[nextchanged] <= entries[nextentry].id))
+        {
+            *id = changed[nextchanged++];
+
+            if (insnapshot && entries[nextentry].id == *id)
+            {
+                // superseded
+                nextoffset += entries[nextentry++].length;
+            }
+
+            if (table->get(*id, data))
+            {
+                return true;
+            }
+
+            // deleted since the snapshot was taken
+            continue;
+        }
+
+        const Entry& e = entries[nextentry++];
+
+        *id = e.id;
+
+        if (!readsnapshot(nextoffset, e.length, data))
+        {
+            LOG_err << "Cache snapshot read error";
+            endread();
+            usable = false;
+            discard();
+            return false;
+        }
+
+        nextoffset += e.length;
+
+        return true;
+    }
+}
+
+bool SnapshotDbTable::get(uint32_t id, string* data)
+{
+    return table->get(id, data);
+}
+
+void SnapshotDbTable::markdirty(uint32_t id)
+{
+    if (dirty.empty())
+    {
+        // first change of the transaction: store the generation it will have
+        table->setgeneration(generation + 1);
+    }
+
+    dirty.insert(id);
+}
+
+bool SnapshotDbTable::put(uint32_t id, char* data, unsigned len)
+{
+    markdirty(id);
+    return table->put(id, data, len);
+}
+
+bool SnapshotDbTable::del(uint32_t id)
+{
+    markdirty(id);
+    return table->del(id);
+}
+
+void SnapshotDbTable::truncate()
+{
+    table->truncate();
+
+    usable = false;
+    discard();
+}
+
+void SnapshotDbTable::begin()
+{
+    table->begin();
+}
+
+void SnapshotDbTable::commit()
+{
+    table->commit();
+
+    if (dirty.size())
+    {
+        generation++;
+
+        if (usable && !appendjournal())
+        {
+            LOG_warn << "Unable to update the cache journal";
+            usable = false;
+            discard();
+        }
+
+        dirty.clear();
+    }
+
+    if (checkpointrequested)
+    {
+        checkpointrequested = false;
+
+        size_t maxjournal = snapshotrecords / 4;
+
+        if (maxjournal < MINJOURNAL)
+        {
+            maxjournal = MINJOURNAL;
+        }
+
+        // outside of any transaction, the table holds the committed state
+        if ((!usable || journaled > maxjournal) && !(usable = writesnapshot()))
+        {
+            discard();
+        }
+    }
+}
+
+void SnapshotDbTable::abort()
+{
+    table->abort();
+    dirty.clear();
+}
+
+void SnapshotDbTable::remove()
+{
+    endread();
+    usable = false;
+    discard();
+    table->remove();
+}
+
+void SnapshotDbTable::checkpoint()
+{
+    checkpointrequested = true;
+}
+
+bool SnapshotDbTable::localpath(string* path)
+{
+    return table->localpath(path);
+}
+
+// the node index is not part of the snapshot
+bool SnapshotDbTable::hasnodeindex()
+{
+    return table->hasnodeindex();
+}
+
+void SnapshotDbTable::createnodeindex()
+{
+    table->createnodeindex();
+}
+
+bool SnapshotDbTable::indexnode(uint32_t id, const DbNodeColumns* columns)
+{
+    return table->indexnode(id, columns);
+}
+
+bool SnapshotDbTable::getnode(handle h, uint32_t* id)
+{
+    return table->getnode(h, id);
+}
+
+bool SnapshotDbTable::getchildnodes(handle ph, handle_vector* handles)
+{
+    return table->getchildnodes(ph, handles);
+}
+
+bool SnapshotDbTable::getchildnodesbyname(handle ph, uint64_t namehash, handle_vector* handles)
+{
+    return table->getchildnodesbyname(ph, namehash, handles);
+}
+
+bool SnapshotDbTable::getnodesbyfingerprint(m_off_t size, m_time_t mtime, uint64_t fingerprint, handle_vector* handles)
+{
+    return table->getnodesbyfingerprint(size, mtime, fingerprint, handles);
+}
+
+bool SnapshotDbTable::appendjournal()
+{
+    string entry;
+    uint32_t n = dirty.size();
+
+    entry.append((char*)&n, sizeof n);
+
+    for (set<uint32_t>::iterator it = dirty.begin(); it != dirty.end(); it++)
+    {
+        entry.append((char*)&*it, sizeof *it);
+    }
+
+    entry.append((char*)&generation, sizeof generation);
+
+    FileAccess* fa = fsaccess->newfileaccess();
+    bool ok = fa->fopen(&journalpath, false, true)
+           && fa->fwrite((const byte*)entry.data(), entry.size(), fa->size);
+    delete fa;
+
+    if (ok)
+    {
+        journaled += n;
+    }
+
+    return ok;
+}
+
+bool SnapshotDbTable::writesnapshot()
+{
+    FileAccess* fa = fsaccess->newfileaccess();
+
+    fsaccess->unlinklocal(&tmppath);
+
+    if (!fa->fopen(&tmppath, false, true))
+    {
+        delete fa;
+        return false;
+    }
+
+    string chunk, entrytable;
+    uint32_t id, count = 0, lastid = 0;
+    string data;
+    m_off_t offset = HEADERSIZE;
+    bool ok = true;
+
+    table->rewind();
+
+    while (table->next(&id, &data))
+    {
+        if (!ok)
+        {
+            continue;
+        }
+
+        // the read path relies on ascending ids
+        if (count && id <= lastid)
+        {
+            LOG_warn << "Cache records out of order - no snapshot taken";
+            ok = false;
+            continue;
+        }
+
+        uint32_t len = data.size();
+
+        entrytable.append((char*)&id, sizeof id);
+        entrytable.append((char*)&len, sizeof len);
+        chunk.append(data);
+        lastid = id;
+        count++;
+
+        if (chunk.size() >= READCHUNK)
+        {
+            ok = fa->fwrite((const byte*)chunk.data(), chunk.size(), offset);
+            offset += chunk.size();
+            chunk.clear();
+        }
+    }
+
+    if (ok && chunk.size())
+    {
+        ok = fa->fwrite((const byte*)chunk.data(), chunk.size(), offset);
+        offset += chunk.size();
+    }
+
+    if (ok && entrytable.size())
+    {
+        ok = fa->fwrite((const byte*)entrytable.data(), entrytable.size(), offset);
+    }
+
+    if (ok)
+    {
+        // written last, so that an incomplete file never has a valid header
+        string header(MAGIC, sizeof MAGIC);
+        uint32_t version = VERSION;
+        uint64_t tableoffset = offset;
+
+        header.append((char*)&version, sizeof version);
+        header.append((char*)&count, sizeof count);
+        header.append((char*)&generation, sizeof generation);
+        header.append((char*)&tableoffset, sizeof tableoffset);
+
+        ok = fa->fwrite((const byte*)header.data(), header.size(), 0);
+    }
+
+    delete fa;
+
+    if (ok)
+    {
+        // the journal only applies to the previous snapshot
+        fsaccess->unlinklocal(&journalpath);
+        ok = fsaccess->renamelocal(&tmppath, &snapshotpath, true);
+    }
+
+    if (!ok)
+    {
+        LOG_warn << "Unable to write the cache snapshot";
+        fsaccess->unlinklocal(&tmppath);
+        return false;
+    }
+
+    snapshotrecords = count;
+    journaled = 0;
+
+    LOG_debug << "Cache snapshot written with " << count << " records";
+
+    return true;
+}
+
+void SnapshotDbTable::discard()
+{
+    fsaccess->unlinklocal(&snapshotpath);
+    fsaccess->unlinklocal(&journalpath);
+    fsaccess->unlinklocal(&tmppath);
+
+    snapshotrecords = 0;
+    journaled = 0;
+}
+} // namespace
@@ -22,6 +22,7 @@
 #include "mega/transfer.h"
 #include "mega/megaclient.h"
 #include "mega/transferslot.h"
+#include "mega/bufferpool.h"
 #include "mega/megaapp.h"
 #include "mega/sync.h"
 #include "mega/logging.h"
@@ -50,6 +51,7 @@ Transfer::Transfer(MegaClient* cclient, direction_t ctype)
     finished = false;
     lastaccesstime = 0;
     ultoken = NULL;
+    checkpointmacs = 0;
 
     priority = 0;
     state = TRANSFERSTATE_NONE;
@@ -125,13 +127,7 @@ bool Transfer::serialize(string *d)
     d->append((const char*)&metamac, sizeof(metamac));
     d->append((const char*)transferkey, sizeof (transferkey));
 
-    ll = (unsigned short)chunkmacs.size();
-    d->append((char*)&ll, sizeof(ll));
-    for (chunkmac_map::iterator it = chunkmacs.begin(); it != chunkmacs.end(); it++)
-    {
-        d->append((char*)&it->first, sizeof(it->first));
-        d->append((char*)&it->second, sizeof(it->second));
-    }
+    chunkmacs.serialize(d);
 
     if (!FileFingerprint::serialize(d))
     {
@@ -180,7 +176,7 @@ bool Transfer::serialize(string *d)
     return true;
 }
 
-Transfer *Transfer::unserialize(MegaClient *client, string *d, transfer_map* transfers)
+Transfer *Transfer::unserialize(MegaClient *client, string *d, transfer_map* transfers, string_vector* checkpoints)
 {
     unsigned short ll;
     const char* ptr = d->data();
@@ -226,25 +222,13 @@ Transfer *Transfer::unserialize(MegaClient *client, string *d, transfer_map* tra
 
     t->localfilename.assign(filepath, ll);
 
-    ll = MemAccess::get<unsigned short>(ptr);
-    ptr += sizeof(ll);
-
-    if (ptr + ll * (sizeof(m_off_t) + sizeof(ChunkMAC)) + sizeof(ll) > end)
+    if (!t->chunkmacs.unserialize(&ptr, end) || ptr + sizeof(ll) > end)
     {
         LOG_err << "Transfer unserialization failed - chunkmacs too long";
         delete t;
         return NULL;
     }
 
-    for (int i = 0; i < ll; i++)
-    {
-        m_off_t pos = MemAccess::get<m_off_t>(ptr);
-        ptr += sizeof(m_off_t);
-
-        memcpy(&(t->chunkmacs[pos]), ptr, sizeof(ChunkMAC));
-        ptr += sizeof(ChunkMAC);
-    }
-
     d->erase(0, ptr - d->data());
 
     FileFingerprint *fp = FileFingerprint::unserialize(d);
@@ -327,30 +311,103 @@ Transfer *Transfer::unserialize(MegaClient *client, string *d, transfer_map* tra
     }
     ptr++;
 
-    for (chunkmac_map::iterator it = t->chunkmacs.begin(); it != t->chunkmacs.end(); it++)
+    // chunk MACs completed after the Transfer was cached
+    if (checkpoints)
     {
-        m_off_t chunkceil = ChunkedHash::chunkceil(it->first, t->size);
-
-        if (t->pos == it->first && it->second.finished)
-        {
-            t->pos = chunkceil;
-            t->progresscompleted = chunkceil;
-        }
-        else if (it->second.finished)
+        for (string_vector::iterator it = checkpoints->begin(); it != checkpoints->end(); it++)
         {
-            m_off_t chunksize = chunkceil - ChunkedHash::chunkfloor(it->first);
-            t->progresscompleted += chunksize;
-        }
-        else
-        {
-            t->progresscompleted += it->second.offset;
+            if (!TransferCheckpoint::replay(&*it, &t->chunkmacs))
+            {
+                LOG_err << "Transfer unserialization failed - invalid checkpoint";
+                delete t;
+                return NULL;
+            }
         }
     }
 
+    t->chunkmacs.calcprogress(t->size, &t->pos, &t->progresscompleted);
+
     transfers[type].insert(pair<FileFingerprint*, Transfer*>(t, t));
     return t;
 }
 
+TransferCheckpoint::TransferCheckpoint()
+{
+    transferid = 0;
+}
+
+bool TransferCheckpoint::serialize(string *d)
+{
+    unsigned short ll = (unsigned short)chunkmacs.size();
+
+    if (ll != chunkmacs.size())
+    {
+        LOG_err << "Error serializing TransferCheckpoint: too many chunk MACs";
+        return false;
+    }
+
+    d->append((const char*)&transferid, sizeof(transferid));
+    d->append((char*)&ll, sizeof(ll));
+
+    for (size_t i = chunkmacs.begin(); i < chunkmacs.end(); i++)
+    {
+        if (chunkmacs.has(i))
+        {
+            m_off_t pos = chunkmac_map::chunkpos(i);
+
+            d->append((char*)&pos, sizeof(pos));
+            d->append((char*)&chunkmacs.at(i), sizeof(ChunkMAC));
+        }
+    }
+
+    d->append("", 1);
+    return true;
+}
+
+bool TransferCheckpoint::unserializeid(const string *d, uint32_t *id)
+{
+    if (d->size() < sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    *id = MemAccess::get<uint32_t>(d->data());
+    return true;
+}
+
+bool TransferCheckpoint::replay(const string *d, chunkmac_map *macs)
+{
+    unsigned short ll;
+    const char* ptr = d->data();
+    const char* end = ptr + d->size();
+
+    if (ptr + sizeof(uint32_t) + sizeof(ll) > end)
+    {
+        return false;
+    }
+
+    ptr += sizeof(uint32_t);
+
+    ll = MemAccess::get<unsigned short>(ptr);
+    ptr += sizeof(ll);
+
+    if (ptr + ll * (sizeof(m_off_t) + sizeof(ChunkMAC)) + 1 > end || ptr[ll * (sizeof(m_off_t) + sizeof(ChunkMAC))])
+    {
+        return false;
+    }
+
+    for (int i = 0; i < ll; i++)
+    {
+        m_off_t pos = MemAccess::get<m_off_t>(ptr);
+        ptr += sizeof(m_off_t);
+
+        memcpy(&((*macs)[pos]), ptr, sizeof(ChunkMAC));
+        ptr += sizeof(ChunkMAC);
+    }
+
+    return true;
+}
+
 SymmCipher *Transfer::transfercipher()
 {
     client->tmptransfercipher.setkey(transferkey);
@@ -614,7 +671,7 @@ void Transfer::complete()
                             LOG_debug << "Fixing fingerprint";
                             *(FileFingerprint*)n = fingerprint;
 
-                            n->serializefingerprint(&n->attrs.map['c']);
+                            n->serializefingerprint(&n->attrs().map['c']);
                             client->setattr(n);
                         }
                     }
@@ -797,7 +854,7 @@ void Transfer::complete()
                             keys.insert(n->nodekey);
 
                             // check if restoration of missing attributes failed in the past (no access)
-                            if (n->attrs.map.find('f') == n->attrs.map.end() || n->attrs.map['f'] != me64)
+                            if (n->attrs().map.find('f') == n->attrs().map.end() || n->attrs().map['f'] != me64)
                             {
                                 // check for missing imagery
                                 int missingattr = 0;
@@ -1004,15 +1061,17 @@ void Transfer::completefiles()
 
 m_off_t Transfer::nextpos()
 {
-    while (chunkmacs.find(ChunkedHash::chunkfloor(pos)) != chunkmacs.end())
+    ChunkMAC* chunkmac;
+
+    while ((chunkmac = chunkmacs.find(pos)))
     {    
-        if (chunkmacs[ChunkedHash::chunkfloor(pos)].finished)
+        if (chunkmac->finished)
         {
             pos = ChunkedHash::chunkceil(pos);
         }
         else
         {
-            pos += chunkmacs[ChunkedHash::chunkfloor(pos)].offset;
+            pos += chunkmac->offset;
             break;
         }
     }
@@ -1194,6 +1253,15 @@ void DirectReadNode::enqueue(m_off_t offset, m_off_t count, int reqtag, void* ap
 
 bool DirectReadSlot::doio()
 {
+    // the data has been received already - the pool hands out no further
+    // buffers while it is held
+    if ((m_off_t)req->in.capacity() != charged)
+    {
+        TransferBufferPool::uncharge(charged);
+        charged = req->in.capacity();
+        TransferBufferPool::charge(charged, true);
+    }
+
     if (req->status == REQ_INFLIGHT || req->status == REQ_SUCCESS)
     {
         if (req->in.size())
@@ -1383,6 +1451,11 @@ DirectReadSlot::DirectReadSlot(DirectRead* cdr)
     pos = dr->offset + dr->progress;
 
     speed = meanSpeed = 0;
+    charged = 0;
+
+    // streamed data is buffered too - take a share of the transfer memory
+    // budget
+    TransferBufferPool::addconnections(1);
 
     req = new HttpReq(true);
 
@@ -1437,6 +1510,9 @@ DirectReadSlot::~DirectReadSlot()
 
     LOG_debug << "Deleting DirectReadSlot";
     delete req;
+
+    TransferBufferPool::uncharge(charged);
+    TransferBufferPool::addconnections(-1);
 }
 
 bool priority_comparator(Transfer* i, Transfer *j)
@@ -19,6 +19,7 @@
  * program.
  */
 
+#include "mega.h"
 #include "mega/transferslot.h"
 #include "mega/node.h"
 #include "mega/transfer.h"
@@ -47,6 +48,89 @@ const dstime TransferSlot::PROGRESSTIMEOUT = 10;
     const m_off_t TransferSlot::MAX_DOWNLOAD_REQ_SIZE = 4194304; // 4 MB
 #endif
 
+#ifdef THREAD_CLASS
+// en-/decryption of a request on a worker thread
+struct TransferCryptJob : public WorkerJob
+{
+    HttpReqXfer* req;
+
+    void run()
+    {
+        req->crypt();
+    }
+
+    TransferCryptJob(HttpReqXfer* creq) : req(creq) { }
+};
+#endif
+
+DownloadReorderBuffer::DownloadReorderBuffer()
+{
+    size = 0;
+    maxsize = 0;
+    writesize = 0;
+}
+
+DownloadReorderBuffer::~DownloadReorderBuffer()
+{
+    clear();
+}
+
+void DownloadReorderBuffer::add(m_off_t pos, const byte* data, unsigned len, chunkmac_map* macs)
+{
+    range_map::iterator it = ranges.lower_bound(pos);
+
+    assert(it == ranges.end() || it->first >= (m_off_t)(pos + len));
+
+    // extend the preceding range if the data follows it
+    if (it != ranges.begin())
+    {
+        range_map::iterator prev = it;
+        prev--;
+
+        assert(end(prev) <= pos);
+
+        it = (!prev->second.asyncio && end(prev) == pos) ? prev : ranges.end();
+    }
+    else
+    {
+        it = ranges.end();
+    }
+
+    if (it == ranges.end())
+    {
+        it = ranges.insert(range_map::value_type(pos, Range())).first;
+    }
+
+    it->second.data.append((const char*)data, len);
+    it->second.chunkmacs.merge(macs);
+    macs->clear();
+    size += len;
+
+    // absorb the following range
+    range_map::iterator next = ranges.find(end(it));
+    if (next != ranges.end() && !next->second.asyncio)
+    {
+        it->second.data.append(next->second.data);
+        it->second.chunkmacs.merge(&next->second.chunkmacs);
+        ranges.erase(next);
+    }
+}
+
+void DownloadReorderBuffer::erase(range_map::iterator it)
+{
+    delete it->second.asyncio;
+    size -= it->second.data.size();
+    ranges.erase(it);
+}
+
+void DownloadReorderBuffer::clear()
+{
+    while (ranges.size())
+    {
+        erase(ranges.begin());
+    }
+}
+
 TransferSlot::TransferSlot(Transfer* ctransfer)
 {
     starttime = 0;
@@ -60,6 +144,7 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
 
     failure = false;
     retrying = false;
+    checkpointed = false;
     
     fileattrsmutable = 0;
 
@@ -75,87 +160,83 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
 
     reqs = new HttpReqXfer*[connections]();
     asyncIO = new AsyncIOContext*[connections]();
+    cryptjobs = new WorkerJob*[connections]();
 
     fa = transfer->client->fsaccess->newfileaccess();
 
     slots_it = transfer->client->tslots.end();
 
-    maxDownloadRequestSize = MAX_DOWNLOAD_REQ_SIZE;
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-    MEMORYSTATUSEX statex;
-    memset(&statex, 0, sizeof (statex));
-    statex.dwLength = sizeof (statex);
-    if (GlobalMemoryStatusEx(&statex))
-    {
-        LOG_debug << "RAM stats. Free physical: " << statex.ullAvailPhys << "   Free virtual: " << statex.ullAvailVirtual;
-        if (statex.ullAvailPhys < 536870912 // 512 MB
-                || statex.ullAvailVirtual < 536870912)
-        {
-            if (statex.ullAvailPhys < 268435456 // 256 MB
-                    || statex.ullAvailVirtual < 268435456)
-            {
-                if (statex.ullAvailPhys < 134217728 // 128 MB
-                        || statex.ullAvailVirtual < 134217728)
-                {
-                    maxDownloadRequestSize = 2097152; // 2 MB
-                }
-                else
-                {
-                    maxDownloadRequestSize = 4194304; // 4 MB
-                }
-            }
-            else
-            {
-                maxDownloadRequestSize = 8388608; // 8 MB
-            }
-        }
-        else
-        {
-            maxDownloadRequestSize = 16777216; // 16 MB
-        }
-    }
-    else
-    {
-        LOG_warn << "Error getting RAM usage info";
-    }
-#endif
+    // every connection, and the reorder buffer of a download, gets a share
+    // of the transfer memory budget
+    poolconnections = connections + (transfer->type == GET ? 1 : 0);
+    TransferBufferPool::addconnections(poolconnections);
+
+    updatebuffersizes();
+}
+
+void TransferSlot::updatebuffersizes()
+{
+    m_off_t share = TransferBufferPool::share();
+
+    maxDownloadRequestSize = share < MAX_DOWNLOAD_REQ_SIZE ? share : MAX_DOWNLOAD_REQ_SIZE;
+
+    downloadbuffer.maxsize = maxDownloadRequestSize;
+    downloadbuffer.writesize = maxDownloadRequestSize / 2;
 }
 
 // delete slot and associated resources, but keep transfer intact (can be
 // reused on a new slot)
 TransferSlot::~TransferSlot()
 {
+#ifdef THREAD_CLASS
+    // the workers must be done with the requests before they are touched
+    // (data decrypted in the background but not saved yet is dropped along
+    // with the completed requests)
+    for (int i = 0; i < connections; i++)
+    {
+        if (cryptjobs[i])
+        {
+            transfer->client->getworkerpool()->cancel(cryptjobs[i]);
+            delete cryptjobs[i];
+        }
+    }
+#endif
+
     if (transfer->type == GET && !transfer->finished
             && transfer->progresscompleted != transfer->size
             && !transfer->asyncopencontext)
     {
         bool cachetransfer = false; // need to save in cache
+        DownloadReorderBuffer::range_map::iterator it, next;
 
-        if (fa && fa->asyncavailable())
+        // complete the writes in progress
+        for (it = downloadbuffer.ranges.begin(); it != downloadbuffer.ranges.end(); it = next)
         {
-            for (int i = 0; i < connections; i++)
+            next = it;
+            next++;
+
+            if (it->second.asyncio)
             {
-                if (reqs[i] && reqs[i]->status == REQ_ASYNCIO && asyncIO[i])
+                it->second.asyncio->finish();
+                if (!it->second.asyncio->failed)
                 {
-                    asyncIO[i]->finish();
-                    if (!asyncIO[i]->failed)
-                    {
-                        LOG_verbose << "Async write succeeded";
-                        HttpReqDL *downloadRequest = (HttpReqDL *)reqs[i];
-                        for (chunkmac_map::iterator it = downloadRequest->chunkmacs.begin(); it != downloadRequest->chunkmacs.end(); it++)
-                        {
-                            transfer->chunkmacs[it->first] = it->second;
-                        }
-                        downloadRequest->chunkmacs.clear();
-                        transfer->progresscompleted += downloadRequest->bufpos;
-                        LOG_debug << "Cached async data at: " << downloadRequest->dlpos << "   Size: " << downloadRequest->bufpos;
-                        cachetransfer = true;
-                    }
+                    LOG_verbose << "Async write succeeded";
+                    transfer->chunkmacs.merge(&it->second.chunkmacs);
+                    transfer->progresscompleted += it->second.data.size();
+                    LOG_debug << "Cached async data at: " << it->first << "   Size: " << it->second.data.size();
+                    cachetransfer = true;
+                    downloadbuffer.erase(it);
+                }
+                else
+                {
+                    delete it->second.asyncio;
+                    it->second.asyncio = NULL;
                 }
-                delete asyncIO[i];
-                asyncIO[i] = NULL;
             }
+        }
 
+        if (fa && fa->asyncavailable())
+        {
             // Open the file in synchonous mode
             delete fa;
             fa = transfer->client->fsaccess->newfileaccess();
@@ -179,10 +260,7 @@ TransferSlot::~TransferSlot()
                 if (fa->fwrite(downloadRequest->buf, bufsize, dlpos))
                 {
                     LOG_verbose << "Sync write succeeded";
-                    for (chunkmac_map::iterator it = downloadRequest->chunkmacs.begin(); it != downloadRequest->chunkmacs.end(); it++)
-                    {
-                        transfer->chunkmacs[it->first] = it->second;
-                    }
+                    transfer->chunkmacs.merge(&downloadRequest->chunkmacs);
                     downloadRequest->chunkmacs.clear();
                     transfer->progresscompleted += bufsize;
                     LOG_debug << "Cached data at: " << dlpos << "   Size: " << bufsize;
@@ -195,6 +273,28 @@ TransferSlot::~TransferSlot()
             }
         }
 
+        // write the data that was waiting in the reorder buffer
+        for (it = downloadbuffer.ranges.begin(); fa && it != downloadbuffer.ranges.end(); it = next)
+        {
+            next = it;
+            next++;
+
+            m_off_t bufsize = it->second.data.size();
+            if (fa->fwrite((const byte*)it->second.data.data(), (unsigned)bufsize, it->first))
+            {
+                LOG_verbose << "Sync write succeeded";
+                transfer->chunkmacs.merge(&it->second.chunkmacs);
+                transfer->progresscompleted += bufsize;
+                LOG_debug << "Cached data at: " << it->first << "   Size: " << bufsize;
+                cachetransfer = true;
+                downloadbuffer.erase(it);
+            }
+            else
+            {
+                LOG_err << "Error caching data at: " << it->first;
+            }
+        }
+
         if (cachetransfer)
         {
             transfer->client->transfercacheadd(transfer);
@@ -227,12 +327,18 @@ TransferSlot::~TransferSlot()
         transfer->client->asyncfopens--;
     }
 
+    // the writes must be done before the file is closed
+    downloadbuffer.clear();
+
+    TransferBufferPool::addconnections(-poolconnections);
+
     while (connections--)
     {
         delete asyncIO[connections];
         delete reqs[connections];
     }
 
+    delete[] cryptjobs;
     delete[] asyncIO;
     delete[] reqs;
 
@@ -277,16 +383,226 @@ void TransferSlot::disconnect()
     }
 }
 
+bool TransferSlot::queuecrypt(MegaClient* client, int i)
+{
+#ifdef THREAD_CLASS
+    WorkerPool* pool = client->getworkerpool();
+
+    if (pool && pool->size())
+    {
+        if (!cryptjobs[i])
+        {
+            cryptjobs[i] = new TransferCryptJob(reqs[i]);
+        }
+
+        // picked up by doio() once the waiter has been notified
+        reqs[i]->status = REQ_CRYPTO;
+        pool->queue(cryptjobs[i], client->waiter);
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+void TransferSlot::prepareupload(MegaClient* client, int i, const char* url, m_off_t pos, m_off_t npos)
+{
+    HttpReqUL* uploadRequest = (HttpReqUL*)reqs[i];
+
+    uploadRequest->beginprepare(url, transfer->transfercipher(), transfer->ctriv, pos, npos);
+    uploadRequest->pos = ChunkedHash::chunkfloor(pos);
+
+    if (!queuecrypt(client, i))
+    {
+        uploadRequest->crypt();
+        uploadRequest->endprepare(&transfer->chunkmacs);
+        uploadRequest->status = REQ_PREPARED;
+    }
+}
+
+bool TransferSlot::finalizedownload(MegaClient* client, int i)
+{
+    HttpReqDL* downloadRequest = (HttpReqDL*)reqs[i];
+
+    downloadRequest->beginfinalize(transfer);
+
+    if (queuecrypt(client, i))
+    {
+        return false;
+    }
+
+    downloadRequest->crypt();
+    return true;
+}
+
+bool TransferSlot::pendingat(m_off_t pos)
+{
+    if (pos >= transfer->size)
+    {
+        return false;
+    }
+
+    for (int i = connections; i--; )
+    {
+        if (reqs[i] && reqs[i]->status != REQ_READY && reqs[i]->status != REQ_DONE
+                && ((HttpReqDL*)reqs[i])->dlpos == pos)
+        {
+            return true;
+        }
+    }
+
+    // the next request starts there unless the data is already present
+    ChunkMAC* chunkmac = transfer->chunkmacs.find(pos);
+    return pos == transfer->pos && (!chunkmac || !chunkmac->finished);
+}
+
+// ranges are written once they are large enough or can't grow anymore - if
+// the data must be written in order, only the range at the write position
+bool TransferSlot::writedownload(MegaClient* client, bool flush, dstime* backoff)
+{
+    DownloadReorderBuffer::range_map::iterator it, next;
+    bool written = false;
+
+    if (downloadbuffer.size > downloadbuffer.maxsize)
+    {
+        flush = true;
+    }
+
+    for (it = downloadbuffer.ranges.begin(); it != downloadbuffer.ranges.end(); it = next)
+    {
+        next = it;
+        next++;
+
+        DownloadReorderBuffer::Range* range = &it->second;
+        m_off_t pos = it->first;
+        unsigned len = (unsigned)range->data.size();
+
+        if (range->asyncio)
+        {
+            if (!range->asyncio->finished)
+            {
+                continue;
+            }
+
+            if (range->asyncio->failed)
+            {
+                LOG_warn << "Async write failed: " << range->asyncio->retry;
+                if (!range->asyncio->retry)
+                {
+                    transfer->failed(API_EWRITE);
+                    return false;
+                }
+
+                // retry shortly
+                delete range->asyncio;
+                range->asyncio = NULL;
+                lasterror = API_EWRITE;
+                *backoff = 2;
+                continue;
+            }
+
+            LOG_verbose << "Async write succeeded";
+        }
+        else
+        {
+            if ((client->orderdownloadedchunks && pos != transfer->progresscompleted)
+                    || (!flush && len < downloadbuffer.writesize && pendingat(DownloadReorderBuffer::end(it))))
+            {
+                continue;
+            }
+
+            if (fa->asyncavailable())
+            {
+                LOG_debug << "Writing data asynchronously at " << pos << "   Size: " << len;
+                range->asyncio = fa->asyncfwrite((const byte*)range->data.data(), len, pos);
+                continue;
+            }
+
+            if (!fa->fwrite((const byte*)range->data.data(), len, pos))
+            {
+                LOG_err << "Error saving finished chunk";
+                if (!fa->retry)
+                {
+                    transfer->failed(API_EWRITE);
+                    return false;
+                }
+
+                lasterror = API_EWRITE;
+                *backoff = 2;
+                break;
+            }
+
+            LOG_verbose << "Sync write succeeded";
+        }
+
+        transfer->chunkmacs.merge(&range->chunkmacs, &transfer->pendingmacs);
+        transfer->progresscompleted += len;
+        LOG_debug << "Saved data at: " << pos << "   Size: " << len;
+        errorcount = 0;
+        transfer->failcount = 0;
+        downloadbuffer.erase(it);
+        written = true;
+    }
+
+    if (!written)
+    {
+        return true;
+    }
+
+    if (transfer->progresscompleted == transfer->size)
+    {
+        if (transfer->progresscompleted)
+        {
+            transfer->currentmetamac = macsmac(&transfer->chunkmacs);
+            transfer->hascurrentmetamac = true;
+        }
+
+        // verify meta MAC
+        if (!transfer->progresscompleted
+                || (transfer->currentmetamac == transfer->metamac))
+        {
+            client->transfercacheadd(transfer);
+            if (transfer->progresscompleted != progressreported)
+            {
+                progressreported = transfer->progresscompleted;
+                lastdata = Waiter::ds;
+
+                progress();
+            }
+
+            transfer->complete();
+        }
+        else
+        {
+            int creqtag = client->reqtag;
+            client->reqtag = 0;
+            client->sendevent(99431, "MAC verification failed");
+            client->reqtag = creqtag;
+
+            transfer->chunkmacs.clear();
+            transfer->failed(API_EKEY);
+        }
+
+        return false;
+    }
+
+    client->transfercheckpoint(transfer);
+    return true;
+}
+
 // coalesce block macs into file mac
 int64_t TransferSlot::macsmac(chunkmac_map* macs)
 {
     byte mac[SymmCipher::BLOCKSIZE] = { 0 };
 
     SymmCipher *cipher = transfer->transfercipher();
-    for (chunkmac_map::iterator it = macs->begin(); it != macs->end(); it++)
+    for (size_t i = macs->begin(); i < macs->end(); i++)
     {
-        SymmCipher::xorblock(it->second.mac, mac);
-        cipher->ecb_encrypt(mac);
+        if (macs->has(i))
+        {
+            SymmCipher::xorblock(macs->at(i).mac, mac);
+            cipher->ecb_encrypt(mac);
+        }
     }
 
     uint32_t* m = (uint32_t*)mac;
@@ -355,6 +671,12 @@ void TransferSlot::doio(MegaClient* client)
     dstime backoff = 0;
     m_off_t p = 0;
 
+    if (transfer->type == GET)
+    {
+        // the share changes with the number of active transfers
+        updatebuffersizes();
+    }
+
     if (errorcount > 4)
     {
         LOG_warn << "Failed transfer: too many errors";
@@ -371,13 +693,49 @@ void TransferSlot::doio(MegaClient* client)
                     p += reqs[i]->transferred(client);
                     break;
 
-                case REQ_SUCCESS:
-                    if (client->orderdownloadedchunks && transfer->type == GET && transfer->progresscompleted != ((HttpReqDL *)reqs[i])->dlpos)
+                case REQ_CRYPTO:
+#ifdef THREAD_CLASS
+                    if (!client->getworkerpool()->finished(cryptjobs[i]))
                     {
-                        // postponing unsorted chunk
-                        p += reqs[i]->size;
+                        if (transfer->type == GET)
+                        {
+                            p += reqs[i]->size;
+                        }
                         break;
                     }
+#endif
+
+                    if (transfer->type == PUT)
+                    {
+                        ((HttpReqUL*)reqs[i])->endprepare(&transfer->chunkmacs);
+                        reqs[i]->status = REQ_PREPARED;
+                        break;
+                    }
+
+                    // downloaded data decrypted, save it
+                    reqs[i]->status = REQ_SUCCESS;
+                    // fall through
+
+                case REQ_SUCCESS:
+                    // the reorder buffer is bounded: make room, or postpone
+                    // the chunk until the writes are done (if the data must
+                    // be written in order, the chunk at the write position
+                    // is always taken)
+                    if (transfer->type == GET && downloadbuffer.full(reqs[i]->size)
+                            && !(client->orderdownloadedchunks && transfer->progresscompleted == ((HttpReqDL *)reqs[i])->dlpos))
+                    {
+                        if (!writedownload(client, true, &backoff))
+                        {
+                            return;
+                        }
+
+                        if (downloadbuffer.full(reqs[i]->size))
+                        {
+                            // postponing chunk
+                            p += reqs[i]->size;
+                            break;
+                        }
+                    }
 
                     lastdata = Waiter::ds;
                     transfer->lastaccesstime = time(NULL);
@@ -477,6 +835,7 @@ void TransferSlot::doio(MegaClient* client)
                         }
 
                         transfer->chunkmacs[reqs[i]->pos].finished = true;
+                        transfer->pendingmacs.push_back(reqs[i]->pos);
                         transfer->progresscompleted += reqs[i]->size;
 
                         if (transfer->progresscompleted == transfer->size)
@@ -491,7 +850,7 @@ void TransferSlot::doio(MegaClient* client)
 
                         errorcount = 0;
                         transfer->failcount = 0;
-                        client->transfercacheadd(transfer);
+                        client->transfercheckpoint(transfer);
                         reqs[i]->status = REQ_READY;
                     }
                     else
@@ -499,91 +858,16 @@ void TransferSlot::doio(MegaClient* client)
                         if (reqs[i]->size == reqs[i]->bufpos)
                         {
                             HttpReqDL *downloadRequest = (HttpReqDL *)reqs[i];
-                            if (fa->asyncavailable())
+                            if (!downloadRequest->decrypted && !finalizedownload(client, i))
                             {
-                                if (!asyncIO[i])
-                                { 
-                                    downloadRequest->finalize(transfer);
-                                }
-                                else
-                                {
-                                    LOG_warn << "Retrying failed async write";
-                                    delete asyncIO[i];
-                                    asyncIO[i] = NULL;
-                                }
-
+                                // being decrypted on a worker thread
                                 p += reqs[i]->size;
-
-                                LOG_debug << "Writting data asynchronously at " << downloadRequest->dlpos;
-                                asyncIO[i] = fa->asyncfwrite(downloadRequest->buf, downloadRequest->bufpos, downloadRequest->dlpos);
-                                reqs[i]->status = REQ_ASYNCIO;
+                                break;
                             }
-                            else
-                            {
-                                downloadRequest->finalize(transfer);
-                                if (fa->fwrite(downloadRequest->buf, downloadRequest->bufpos, downloadRequest->dlpos))
-                                {
-                                    LOG_verbose << "Sync write succeeded";
-                                    for (chunkmac_map::iterator it = downloadRequest->chunkmacs.begin(); it != downloadRequest->chunkmacs.end(); it++)
-                                    {
-                                        transfer->chunkmacs[it->first] = it->second;
-                                        assert (transfer->chunkmacs[it->first].finished);
-                                    }
-                                    downloadRequest->chunkmacs.clear();
-                                    transfer->progresscompleted += downloadRequest->bufpos;
-                                    LOG_debug << "Saved data at: " << downloadRequest->dlpos << "   Size: " << downloadRequest->bufpos;
-                                    errorcount = 0;
-                                    transfer->failcount = 0;
-                                }
-                                else
-                                {
-                                    LOG_err << "Error saving finished chunk";
-                                    if (!fa->retry)
-                                    {
-                                        return transfer->failed(API_EWRITE);
-                                    }
-                                    lasterror = API_EWRITE;
-                                    backoff = 2;
-                                    break;
-                                }
 
-                                if (transfer->progresscompleted == transfer->size)
-                                {
-                                    if (transfer->progresscompleted)
-                                    {
-                                        transfer->currentmetamac = macsmac(&transfer->chunkmacs);
-                                        transfer->hascurrentmetamac = true;
-                                    }
-
-                                    // verify meta MAC
-                                    if (!transfer->progresscompleted
-                                            || (transfer->currentmetamac == transfer->metamac))
-                                    {
-                                        client->transfercacheadd(transfer);
-                                        if (transfer->progresscompleted != progressreported)
-                                        {
-                                            progressreported = transfer->progresscompleted;
-                                            lastdata = Waiter::ds;
-
-                                            progress();
-                                        }
-
-                                        return transfer->complete();
-                                    }
-                                    else
-                                    {
-                                        int creqtag = client->reqtag;
-                                        client->reqtag = 0;
-                                        client->sendevent(99431, "MAC verification failed");
-                                        client->reqtag = creqtag;
-
-                                        transfer->chunkmacs.clear();
-                                        return transfer->failed(API_EKEY);
-                                    }
-                                }
-                                client->transfercacheadd(transfer);
-                                reqs[i]->status = REQ_READY;
-                            }
+                            downloadbuffer.add(downloadRequest->dlpos, downloadRequest->buf,
+                                               downloadRequest->bufpos, &downloadRequest->chunkmacs);
+                            reqs[i]->status = REQ_READY;
                         }
                         else
                         {
@@ -617,94 +901,27 @@ void TransferSlot::doio(MegaClient* client)
                     break;
 
                 case REQ_ASYNCIO:
+                    // file read of an upload (downloads are written from
+                    // the reorder buffer)
                     if (asyncIO[i]->finished)
                     {
                         LOG_verbose << "Processing finished async fs operation";
                         if (!asyncIO[i]->failed)
                         {
-                            if (transfer->type == PUT)
-                            {
-                                LOG_verbose << "Async read succeeded";
-                                m_off_t npos = ChunkedHash::chunkceil(asyncIO[i]->pos, transfer->size);
+                            LOG_verbose << "Async read succeeded";
+                            m_off_t npos = ChunkedHash::chunkceil(asyncIO[i]->pos, transfer->size);
 
-                                string finaltempurl = tempurl;
-                                if (client->usealtupport && !memcmp(tempurl.c_str(), "http:", 5))
-                                {
-                                    size_t index = tempurl.find("/", 8);
-                                    if(index != string::npos && tempurl.find(":", 8) == string::npos)
-                                    {
-                                        finaltempurl.insert(index, ":8080");
-                                    }
-                                }
-
-                                reqs[i]->prepare(finaltempurl.c_str(), transfer->transfercipher(),
-                                         &transfer->chunkmacs, transfer->ctriv,
-                                         asyncIO[i]->pos, npos);
-
-                                reqs[i]->pos = ChunkedHash::chunkfloor(asyncIO[i]->pos);
-                                reqs[i]->status = REQ_PREPARED;
-                            }
-                            else
+                            string finaltempurl = tempurl;
+                            if (client->usealtupport && !memcmp(tempurl.c_str(), "http:", 5))
                             {
-                                LOG_verbose << "Async write succeeded";
-                                HttpReqDL *downloadRequest = (HttpReqDL *)reqs[i];
-                                for (chunkmac_map::iterator it = downloadRequest->chunkmacs.begin(); it != downloadRequest->chunkmacs.end(); it++)
+                                size_t index = tempurl.find("/", 8);
+                                if(index != string::npos && tempurl.find(":", 8) == string::npos)
                                 {
-                                    transfer->chunkmacs[it->first] = it->second;
-                                }
-                                downloadRequest->chunkmacs.clear();
-                                transfer->progresscompleted += downloadRequest->bufpos;
-                                LOG_debug << "Saved data at: " << downloadRequest->dlpos << "   Size: " << downloadRequest->bufpos;
-                                errorcount = 0;
-                                transfer->failcount = 0;
-
-                                if (transfer->progresscompleted == transfer->size)
-                                {
-                                    if (transfer->progresscompleted)
-                                    {
-                                        transfer->currentmetamac = macsmac(&transfer->chunkmacs);
-                                        transfer->hascurrentmetamac = true;
-                                    }
-
-                                    // verify meta MAC
-                                    if (!transfer->progresscompleted
-                                            || (transfer->currentmetamac == transfer->metamac))
-                                    {
-                                        client->transfercacheadd(transfer);
-                                        if (transfer->progresscompleted != progressreported)
-                                        {
-                                            progressreported = transfer->progresscompleted;
-                                            lastdata = Waiter::ds;
-
-                                            progress();
-                                        }
-
-                                        return transfer->complete();
-                                    }
-                                    else
-                                    {
-                                        int creqtag = client->reqtag;
-                                        client->reqtag = 0;
-                                        client->sendevent(99431, "MAC verification failed");
-                                        client->reqtag = creqtag;
-
-                                        transfer->chunkmacs.clear();
-                                        return transfer->failed(API_EKEY);
-                                    }
-                                }
-
-                                client->transfercacheadd(transfer);
-                                reqs[i]->status = REQ_READY;
-
-                                if (client->orderdownloadedchunks)
-                                {
-                                    // Check connections again looking for postponed chunks
-                                    delete asyncIO[i];
-                                    asyncIO[i] = NULL;
-                                    i = connections;
-                                    continue;
+                                    finaltempurl.insert(index, ":8080");
                                 }
                             }
+
+                            prepareupload(client, i, finaltempurl.c_str(), asyncIO[i]->pos, npos);
                             delete asyncIO[i];
                             asyncIO[i] = NULL;
                         }
@@ -715,27 +932,15 @@ void TransferSlot::doio(MegaClient* client)
                             {
                                 delete asyncIO[i];
                                 asyncIO[i] = NULL;
-                                return transfer->failed(transfer->type == PUT ? API_EREAD : API_EWRITE);
+                                return transfer->failed(API_EREAD);
                             }
 
                             // retry shortly
-                            if (transfer->type == PUT)
-                            {
-                                lasterror = API_EREAD;
-                                reqs[i]->status = REQ_READY;
-                            }
-                            else
-                            {
-                                lasterror = API_EWRITE;
-                                reqs[i]->status = REQ_SUCCESS;
-                            }
+                            lasterror = API_EREAD;
+                            reqs[i]->status = REQ_READY;
                             backoff = 2;
                         }
                     }
-                    else if (transfer->type == GET)
-                    {
-                        p += asyncIO[i]->len;
-                    }
                     break;
 
                 case REQ_FAILURE:
@@ -853,16 +1058,15 @@ void TransferSlot::doio(MegaClient* client)
                             maxReqSize = 0;
                         }
 
-                        chunkmac_map::iterator it = transfer->chunkmacs.find(npos);
+                        ChunkMAC* chunkmac = transfer->chunkmacs.find(npos);
                         m_off_t reqSize = npos - transfer->pos;
                         while (npos < transfer->size
                                && reqSize <= maxReqSize
-                               && (it == transfer->chunkmacs.end()
-                                   || (!it->second.finished && !it->second.offset)))
+                               && (!chunkmac || (!chunkmac->finished && !chunkmac->offset)))
                         {
                             npos = ChunkedHash::chunkceil(npos, transfer->size);
                             reqSize = npos - transfer->pos;
-                            it = transfer->chunkmacs.find(npos);
+                            chunkmac = transfer->chunkmacs.find(npos);
                         }
                         LOG_debug << "Downloading chunk of size " << reqSize;
                     }
@@ -875,10 +1079,27 @@ void TransferSlot::doio(MegaClient* client)
                     bool prepare = true;
                     if (transfer->type == PUT)
                     {
+                        HttpReqUL* uploadRequest = (HttpReqUL*)reqs[i];
                         m_off_t pos = transfer->pos;
                         unsigned size = (unsigned)(npos - pos);
+                        unsigned pad = (-(int)size) & (SymmCipher::BLOCKSIZE - 1);
 
-                        if (fa->asyncavailable())
+                        if (asyncIO[i])
+                        {
+                            size = asyncIO[i]->len;
+                            pad = (-(int)size) & (SymmCipher::BLOCKSIZE - 1);
+                        }
+
+                        if (!uploadRequest->allocbuf(size + pad))
+                        {
+                            // retry when other transfers have given their
+                            // buffers back to the pool
+                            LOG_debug << "Transfer memory budget exhausted";
+                            backoff = 2;
+                            npos = transfer->pos;
+                            prepare = false;
+                        }
+                        else if (fa->asyncavailable())
                         {
                             if (asyncIO[i])
                             {
@@ -890,13 +1111,17 @@ void TransferSlot::doio(MegaClient* client)
                                 asyncIO[i] = NULL;
                             }
 
-                            asyncIO[i] = fa->asyncfread(reqs[i]->out, size, (-(int)size) & (SymmCipher::BLOCKSIZE - 1), pos);
+                            asyncIO[i] = fa->asyncfread(uploadRequest->chunk, size, pad, pos);
                             reqs[i]->status = REQ_ASYNCIO;
                             prepare = false;
                         }
                         else
                         {
-                            if (!fa->fread(reqs[i]->out, size, (-(int)size) & (SymmCipher::BLOCKSIZE - 1), transfer->pos))
+                            if (fa->frawread(uploadRequest->chunk, size, transfer->pos))
+                            {
+                                memset(uploadRequest->chunk + size, 0, pad);
+                            }
+                            else
                             {
                                 LOG_warn << "Error preparing transfer: " << fa->retry;
                                 if (!fa->retry)
@@ -947,11 +1172,30 @@ void TransferSlot::doio(MegaClient* client)
                             return transfer->failed(API_EINTERNAL);
                         }
 
-                        reqs[i]->prepare(finaltempurl.c_str(), transfer->transfercipher(),
-                                                                 &transfer->chunkmacs, transfer->ctriv,
-                                                                 transfer->pos, npos);
-                        reqs[i]->pos = ChunkedHash::chunkfloor(transfer->pos);
-                        reqs[i]->status = REQ_PREPARED;
+                        if (transfer->type == PUT)
+                        {
+                            prepareupload(client, i, finaltempurl.c_str(), transfer->pos, npos);
+                        }
+                        else
+                        {
+                            reqs[i]->prepare(finaltempurl.c_str(), transfer->transfercipher(),
+                                                                     &transfer->chunkmacs, transfer->ctriv,
+                                                                     transfer->pos, npos);
+
+                            if (!reqs[i]->buf && reqs[i]->size)
+                            {
+                                // retry when other transfers have given
+                                // their buffers back to the pool
+                                LOG_debug << "Transfer memory budget exhausted";
+                                backoff = 2;
+                                npos = transfer->pos;
+                            }
+                            else
+                            {
+                                reqs[i]->pos = ChunkedHash::chunkfloor(transfer->pos);
+                                reqs[i]->status = REQ_PREPARED;
+                            }
+                        }
                     }
 
                     if (transfer->pos < npos)
@@ -962,16 +1206,34 @@ void TransferSlot::doio(MegaClient* client)
                 else if (reqs[i])
                 {
                     reqs[i]->status = REQ_DONE;
+                    reqs[i]->releasebuf();
                 }
             }
 
             if (reqs[i] && (reqs[i]->status == REQ_PREPARED))
             {
-                reqs[i]->post(client);
+                if (transfer->type == PUT)
+                {
+                    ((HttpReqUL*)reqs[i])->postchunk(client);
+                }
+                else
+                {
+                    reqs[i]->post(client);
+                }
             }
         }
     }
 
+    if (transfer->type == GET)
+    {
+        if (!writedownload(client, false, &backoff))
+        {
+            return;
+        }
+
+        p += downloadbuffer.size;
+    }
+
     p += transfer->progresscompleted;
 
     if (p != progressreported || (Waiter::ds - lastprogressreport) > PROGRESSTIMEOUT)
@@ -51,6 +51,7 @@ void TreeProcForeignKeys::proc(MegaClient* client, Node* n)
 }
 
 // total disk space / node count
+// (Node::counter provides the same totals without a tree walk)
 TreeProcDU::TreeProcDU()
 {
     numbytes = 0;
@@ -79,16 +80,11 @@ void TreeProcDel::proc(MegaClient* client, Node* n)
     client->notifynode(n);
 }
 
-void TreeProcApplyKey::proc(MegaClient *client, Node *n)
+void TreeProcApplyKey::proc(MegaClient*, Node *n)
 {
     if (n->attrstring)
     {
-        n->applykey();
-        if (!n->attrstring)
-        {
-            n->changed.attrs = true;
-            client->notifynode(n);
-        }
+        nodes.push_back(n);
     }
 }
 
@@ -494,6 +494,258 @@ m_off_t ChunkedHash::chunkceil(m_off_t p, m_off_t limit)
     return (limit < 0 || np < limit) ? np : limit;
 }
 
+// chunk count of the former serialization, introducing the block format
+static const unsigned short CHUNKMACBLOCK = 0xFFFF;
+
+chunkmac_map::chunkmac_map()
+{
+    base = 0;
+    count = 0;
+}
+
+size_t chunkmac_map::chunkindex(m_off_t p)
+{
+    m_off_t cp = 0;
+
+    for (unsigned i = 1; i <= 8; i++)
+    {
+        cp += i * ChunkedHash::SEGSIZE;
+
+        if (p < cp)
+        {
+            return i - 1;
+        }
+    }
+
+    return (size_t)(8 + (p - cp) / (8 * ChunkedHash::SEGSIZE));
+}
+
+m_off_t chunkmac_map::chunkpos(size_t i)
+{
+    if (i <= 8)
+    {
+        return (m_off_t)ChunkedHash::SEGSIZE * (i * (i + 1) / 2);
+    }
+
+    return (m_off_t)ChunkedHash::SEGSIZE * (36 + 8 * (i - 8));
+}
+
+ChunkMAC& chunkmac_map::operator[](m_off_t p)
+{
+    size_t i = chunkindex(p);
+
+    if (i < base || i - base >= macs.size())
+    {
+        ChunkMAC zero;
+        memset(zero.mac, 0, sizeof zero.mac);
+
+        if (macs.empty())
+        {
+            base = i;
+        }
+        else if (i < base)
+        {
+            macs.insert(macs.begin(), base - i, zero);
+            present.insert(present.begin(), base - i, false);
+            base = i;
+        }
+
+        if (i - base >= macs.size())
+        {
+            macs.resize(i - base + 1, zero);
+            present.resize(i - base + 1, false);
+        }
+    }
+
+    if (!present[i - base])
+    {
+        present[i - base] = true;
+        count++;
+    }
+
+    return macs[i - base];
+}
+
+ChunkMAC* chunkmac_map::find(m_off_t p)
+{
+    size_t i = chunkindex(p);
+
+    return has(i) ? &macs[i - base] : NULL;
+}
+
+void chunkmac_map::clear()
+{
+    macs.clear();
+    present.clear();
+    base = 0;
+    count = 0;
+}
+
+void chunkmac_map::merge(chunkmac_map* other, vector<m_off_t>* changed)
+{
+    for (size_t i = other->begin(); i < other->end(); i++)
+    {
+        if (other->has(i))
+        {
+            m_off_t p = chunkpos(i);
+
+            (*this)[p] = other->at(i);
+
+            if (changed)
+            {
+                changed->push_back(p);
+            }
+        }
+    }
+}
+
+void chunkmac_map::calcprogress(m_off_t size, m_off_t* pos, m_off_t* progress, m_off_t* partial)
+{
+    *pos = 0;
+    *progress = 0;
+
+    if (partial)
+    {
+        *partial = 0;
+    }
+
+    for (size_t i = begin(); i < end(); i++)
+    {
+        if (!has(i))
+        {
+            continue;
+        }
+
+        ChunkMAC* chunkmac = &at(i);
+        m_off_t chunkstart = chunkpos(i);
+        m_off_t chunkceil = ChunkedHash::chunkceil(chunkstart, size);
+
+        if (*pos == chunkstart && chunkmac->finished)
+        {
+            *pos = chunkceil;
+            *progress = chunkceil;
+        }
+        else if (chunkmac->finished)
+        {
+            *progress += chunkceil - chunkstart;
+        }
+        else
+        {
+            *progress += chunkmac->offset;
+
+            if (partial)
+            {
+                *partial += chunkmac->offset;
+            }
+        }
+    }
+}
+
+void chunkmac_map::serialize(string* d)
+{
+    unsigned short ll = CHUNKMACBLOCK;
+    uint32_t first = (uint32_t)base;
+    uint32_t n = (uint32_t)macs.size();
+
+    d->append((char*)&ll, sizeof(ll));
+    d->append((char*)&first, sizeof(first));
+    d->append((char*)&n, sizeof(n));
+
+    size_t bitmap = d->size();
+    d->resize(bitmap + (n + 7) / 8);
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (present[i])
+        {
+            (*d)[bitmap + i / 8] |= (char)(1 << (i & 7));
+        }
+    }
+
+    if (n)
+    {
+        d->append((const char*)&macs[0], n * sizeof(ChunkMAC));
+    }
+}
+
+bool chunkmac_map::unserialize(const char** ptr, const char* end)
+{
+    unsigned short ll;
+
+    clear();
+
+    if (*ptr + sizeof(ll) > end)
+    {
+        return false;
+    }
+
+    ll = MemAccess::get<unsigned short>(*ptr);
+    *ptr += sizeof(ll);
+
+    if (ll != CHUNKMACBLOCK)
+    {
+        // former format: (position, MAC) pairs
+        if (*ptr + ll * (sizeof(m_off_t) + sizeof(ChunkMAC)) > end)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < ll; i++)
+        {
+            m_off_t pos = MemAccess::get<m_off_t>(*ptr);
+            *ptr += sizeof(m_off_t);
+
+            memcpy(&(*this)[pos], *ptr, sizeof(ChunkMAC));
+            *ptr += sizeof(ChunkMAC);
+        }
+
+        return true;
+    }
+
+    if (*ptr + 2 * sizeof(uint32_t) > end)
+    {
+        return false;
+    }
+
+    uint32_t first = MemAccess::get<uint32_t>(*ptr);
+    *ptr += sizeof(first);
+
+    uint32_t n = MemAccess::get<uint32_t>(*ptr);
+    *ptr += sizeof(n);
+
+    size_t bitmapsize = (n + 7) / 8;
+
+    if (n > (size_t)(end - *ptr) / sizeof(ChunkMAC)
+            || *ptr + bitmapsize + n * sizeof(ChunkMAC) > end)
+    {
+        return false;
+    }
+
+    const char* bitmap = *ptr;
+    *ptr += bitmapsize;
+
+    base = first;
+    macs.resize(n);
+    present.resize(n);
+
+    if (n)
+    {
+        memcpy(&macs[0], *ptr, n * sizeof(ChunkMAC));
+        *ptr += n * sizeof(ChunkMAC);
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if ((bitmap[i / 8] >> (i & 7)) & 1)
+        {
+            present[i] = true;
+            count++;
+        }
+    }
+
+    return true;
+}
+
 
 // cryptographic signature generation/verification
 HashSignature::HashSignature(Hash* h)
@@ -0,0 +1,282 @@
+/**
+ * @file workerpool.cpp
+ * @brief Worker threads for CPU-bound engine tasks
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+
+#ifdef THREAD_CLASS
+
+namespace mega {
+const size_t WorkerPool::SLICE;
+
+WorkerJob::WorkerJob()
+{
+    state = JOB_IDLE;
+    waiter = NULL;
+}
+
+WorkerPool::WorkerPool(int numthreads)
+{
+    func = NULL;
+    context = NULL;
+    count = 0;
+    next = 0;
+    active = 0;
+    runwaiting = false;
+    cancelwaiting = NULL;
+    terminating = false;
+
+    mutex.init(false);
+
+    for (int i = numthreads; i-- > 0; )
+    {
+        threads.push_back(new THREAD_CLASS());
+        threads.back()->start(threadentry, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    mutex.lock();
+    terminating = true;
+    mutex.unlock();
+
+    for (size_t i = threads.size(); i--; )
+    {
+        work.release();
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+}
+
+int WorkerPool::size() const
+{
+    return threads.size();
+}
+
+void* WorkerPool::threadentry(void* param)
+{
+    ((WorkerPool*)param)->loop();
+    return NULL;
+}
+
+void WorkerPool::loop()
+{
+    for (;;)
+    {
+        work.wait();
+
+        mutex.lock();
+
+        if (terminating)
+        {
+            mutex.unlock();
+            return;
+        }
+
+        if (!jobs.empty())
+        {
+            WorkerJob* job = jobs.front();
+            jobs.pop_front();
+            job->state = WorkerJob::JOB_RUNNING;
+            mutex.unlock();
+
+            runjob(job);
+            continue;
+        }
+
+        if (next >= count)
+        {
+            // the batch or job of this wakeup was taken by another worker
+            mutex.unlock();
+            continue;
+        }
+
+        active++;
+        mutex.unlock();
+
+        process();
+
+        mutex.lock();
+
+        if (!--active && runwaiting)
+        {
+            runwaiting = false;
+            done.release();
+        }
+
+        mutex.unlock();
+    }
+}
+
+void WorkerPool::runjob(WorkerJob* job)
+{
+    job->run();
+
+    mutex.lock();
+
+    // the job may be deleted by its owner as soon as the state changes
+    Waiter* waiter = job->waiter;
+    job->state = WorkerJob::JOB_FINISHED;
+
+    if (cancelwaiting == job)
+    {
+        cancelwaiting = NULL;
+        jobdone.release();
+    }
+
+    mutex.unlock();
+
+    waiter->notify();
+}
+
+void WorkerPool::process()
+{
+    for (;;)
+    {
+        mutex.lock();
+
+        if (next >= count)
+        {
+            mutex.unlock();
+            return;
+        }
+
+        size_t first = next;
+        size_t last = (count - next > SLICE) ? next + SLICE : count;
+        next = last;
+
+        mutex.unlock();
+
+        for (size_t i = first; i < last; i++)
+        {
+            func(context, i);
+        }
+    }
+}
+
+void WorkerPool::run(job_func f, void* c, size_t n)
+{
+    if (n <= SLICE || threads.empty())
+    {
+        // not worth waking up the workers
+        for (size_t i = 0; i < n; i++)
+        {
+            f(c, i);
+        }
+
+        return;
+    }
+
+    mutex.lock();
+    func = f;
+    context = c;
+    count = n;
+    next = 0;
+    mutex.unlock();
+
+    for (size_t i = threads.size(); i--; )
+    {
+        work.release();
+    }
+
+    process();
+
+    // all workers must be done with the batch before it goes out of scope
+    // (no worker joins it any more once all slices have been handed out)
+    mutex.lock();
+    bool wait = active > 0;
+    runwaiting = wait;
+    mutex.unlock();
+
+    if (wait)
+    {
+        done.wait();
+    }
+}
+
+void WorkerPool::queue(WorkerJob* job, Waiter* waiter)
+{
+    job->waiter = waiter;
+
+    if (threads.empty())
+    {
+        job->run();
+        job->state = WorkerJob::JOB_FINISHED;
+        return;
+    }
+
+    mutex.lock();
+    job->state = WorkerJob::JOB_QUEUED;
+    jobs.push_back(job);
+    mutex.unlock();
+
+    work.release();
+}
+
+bool WorkerPool::finished(WorkerJob* job)
+{
+    mutex.lock();
+    bool result = job->state == WorkerJob::JOB_FINISHED;
+    mutex.unlock();
+
+    return result;
+}
+
+void WorkerPool::cancel(WorkerJob* job)
+{
+    mutex.lock();
+
+    if (job->state == WorkerJob::JOB_QUEUED)
+    {
+        // its wakeup of a worker is left without effect
+        for (deque<WorkerJob*>::iterator it = jobs.begin(); it != jobs.end(); it++)
+        {
+            if (*it == job)
+            {
+                jobs.erase(it);
+                break;
+            }
+        }
+
+        job->state = WorkerJob::JOB_IDLE;
+        mutex.unlock();
+        return;
+    }
+
+    if (job->state == WorkerJob::JOB_RUNNING)
+    {
+        cancelwaiting = job;
+        mutex.unlock();
+
+        jobdone.wait();
+        return;
+    }
+
+    mutex.unlock();
+}
+
+} // namespace
+
+#endif
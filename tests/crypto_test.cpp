@@ -163,6 +163,132 @@ TEST(Crypto, AES_CCM)
     ASSERT_STREQ(result.data(), plainText.data()) << "CCM decryption: plain text doesn't match the expected value";
 }
 
+// CTR en-/decryption with CBC-MAC, block by block (reference for ctr_crypt())
+static void ctrCryptReference(SymmCipher* key, byte* data, unsigned len, m_off_t pos, SymmCipher::ctr_iv ctriv,
+                              byte* mac, bool encrypt, bool initmac)
+{
+    byte ctr[SymmCipher::BLOCKSIZE], tmp[SymmCipher::BLOCKSIZE];
+
+    memcpy(ctr, &ctriv, sizeof ctriv);
+    SymmCipher::setint64(pos / SymmCipher::BLOCKSIZE, ctr + sizeof ctriv);
+
+    if (mac && initmac)
+    {
+        memcpy(mac, ctr, sizeof ctriv);
+        memcpy(mac + sizeof ctriv, ctr, sizeof ctriv);
+    }
+
+    while ((int)len > 0)
+    {
+        if (encrypt && mac)
+        {
+            SymmCipher::xorblock(data, mac);
+            key->ecb_encrypt(mac);
+        }
+
+        key->ecb_encrypt(ctr, tmp);
+        SymmCipher::xorblock(tmp, data);
+
+        if (!encrypt && mac)
+        {
+            SymmCipher::xorblock(data, mac, len < (unsigned)SymmCipher::BLOCKSIZE ? len : SymmCipher::BLOCKSIZE);
+            key->ecb_encrypt(mac);
+        }
+
+        len -= SymmCipher::BLOCKSIZE;
+        data += SymmCipher::BLOCKSIZE;
+        SymmCipher::incblock(ctr);
+    }
+}
+
+// Test CTR en-/decryption with CBC-MAC against the block by block reference
+TEST(Crypto, AES_CTR_MAC)
+{
+    byte keyBytes[SymmCipher::KEYLENGTH];
+    PrnGen::genblock(keyBytes, sizeof keyBytes);
+
+    SymmCipher key;
+    key.setkey(keyBytes);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        unsigned len = PrnGen::genuint32(i < 500 ? 300 : 5000);
+        m_off_t pos = (m_off_t)PrnGen::genuint32(1 << 20) * SymmCipher::BLOCKSIZE;
+        SymmCipher::ctr_iv ctriv;
+        PrnGen::genblock((byte*)&ctriv, sizeof ctriv);
+        bool encrypt = i & 1;
+        bool initmac = i & 2;
+        bool withmac = i & 4;
+
+        string data;
+        data.resize((len + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE);
+        PrnGen::genblock((byte*)data.data(), data.size());
+        string expected = data;
+
+        byte mac[SymmCipher::BLOCKSIZE], expectedmac[SymmCipher::BLOCKSIZE];
+        PrnGen::genblock(mac, sizeof mac);
+        memcpy(expectedmac, mac, sizeof mac);
+
+        ctrCryptReference(&key, (byte*)expected.data(), len, pos, ctriv, withmac ? expectedmac : NULL, encrypt, initmac);
+        key.ctr_crypt((byte*)data.data(), len, pos, ctriv, withmac ? mac : NULL, encrypt, initmac);
+
+        ASSERT_EQ(expected, data) << "CTR output differs for length " << len;
+        ASSERT_EQ(0, memcmp(mac, expectedmac, sizeof mac)) << "CBC-MAC differs for length " << len;
+    }
+}
+
+// Test the CTR en-/decryption of several chunks with their CBC-MACs
+TEST(Crypto, AES_CTR_MAC_chunks)
+{
+    byte keyBytes[SymmCipher::KEYLENGTH];
+    PrnGen::genblock(keyBytes, sizeof keyBytes);
+
+    SymmCipher key;
+    key.setkey(keyBytes);
+
+    for (int i = 0; i < 200; i++)
+    {
+        unsigned n = 1 + PrnGen::genuint32(12);
+        SymmCipher::ctr_iv ctriv;
+        PrnGen::genblock((byte*)&ctriv, sizeof ctriv);
+        bool encrypt = i & 1;
+
+        vector<string> data(n), expected(n);
+        vector<CtrChunk> chunks(n);
+        string macs, expectedmacs;
+        macs.resize(n * SymmCipher::BLOCKSIZE);
+        PrnGen::genblock((byte*)macs.data(), macs.size());
+        expectedmacs = macs;
+
+        for (unsigned j = 0; j < n; j++)
+        {
+            unsigned len = PrnGen::genuint32(4) ? PrnGen::genuint32(20000) : PrnGen::genuint32(40);
+
+            data[j].resize((len + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE);
+            PrnGen::genblock((byte*)data[j].data(), data[j].size());
+            expected[j] = data[j];
+
+            chunks[j].data = (byte*)data[j].data();
+            chunks[j].len = len;
+            chunks[j].pos = (m_off_t)PrnGen::genuint32(1 << 20) * SymmCipher::BLOCKSIZE;
+            chunks[j].mac = (byte*)macs.data() + j * SymmCipher::BLOCKSIZE;
+            chunks[j].initmac = PrnGen::genuint32(2);
+
+            ctrCryptReference(&key, (byte*)expected[j].data(), len, chunks[j].pos, ctriv,
+                              (byte*)expectedmacs.data() + j * SymmCipher::BLOCKSIZE, encrypt, chunks[j].initmac);
+        }
+
+        key.ctr_crypt_chunks(&chunks[0], n, ctriv, encrypt);
+
+        for (unsigned j = 0; j < n; j++)
+        {
+            ASSERT_EQ(expected[j], data[j]) << "CTR output differs for chunk " << j << " of " << n;
+        }
+
+        ASSERT_EQ(expectedmacs, macs) << "CBC-MACs differ";
+    }
+}
+
 #ifdef ENABLE_CHAT
 // Test functions of Ed25519:
 // - Binary & Hex fingerprints of public key
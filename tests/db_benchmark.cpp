@@ -0,0 +1,268 @@
+/**
+ * @file tests/db_benchmark.cpp
+ * @brief Session resume benchmark of the DB access layer
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Fills a local cache with node-sized records and reads it back the way a
+// session resume does (open, full scan, decryption), once right after
+// the page cache was dropped for the database files (cold) and once more
+// with the files cached (warm). The DB access layer is the one the SDK was
+// configured with: build once each --with-sqlite, --with-db and
+// --with-lmdb to compare them. Tables that support it are also read through
+// a SnapshotDbTable.
+
+#include "mega.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace mega;
+
+#ifdef DBACCESS_CLASS
+
+static const char* BENCHMARKDIR = "dbbenchmark";
+
+// record of a typical node size
+struct BenchmarkRecord : public Cachable
+{
+    string data;
+
+    bool serialize(string* d)
+    {
+        d->append(data);
+        return true;
+    }
+};
+
+static double now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// drop the database files from the page cache
+static void evict()
+{
+    DIR* dir = opendir(BENCHMARKDIR);
+    struct dirent* entry;
+
+    if (!dir)
+    {
+        return;
+    }
+
+    sync();
+
+    while ((entry = readdir(dir)))
+    {
+        string path = string(BENCHMARKDIR) + "/" + entry->d_name;
+        int fd = open(path.c_str(), O_RDONLY);
+
+        if (fd >= 0)
+        {
+#ifdef POSIX_FADV_DONTNEED
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+            close(fd);
+        }
+    }
+
+    closedir(dir);
+}
+
+// the table, read through a snapshot if requested and supported
+static DbTable* opentable(DbAccess* dbaccess, FileSystemAccess* fsaccess, string* name, bool snapshot)
+{
+    DbTable* table = dbaccess->open(fsaccess, name);
+    string localpath;
+    uint64_t generation;
+
+    if (table && snapshot && table->localpath(&localpath) && table->getgeneration(&generation))
+    {
+        table = new SnapshotDbTable(table, fsaccess, &localpath);
+    }
+
+    return table;
+}
+
+// the snapshot is taken by the same transaction
+static void fill(FileSystemAccess* fsaccess, string* dbpath, string* name, SymmCipher* key, unsigned records)
+{
+    DBACCESS_CLASS dbaccess(dbpath);
+    DbTable* table = opentable(&dbaccess, fsaccess, name, true);
+    BenchmarkRecord r;
+    byte buf[256];
+
+    if (!table)
+    {
+        return;
+    }
+
+    table->begin();
+    table->truncate();
+
+    for (unsigned i = 0; i < records; i++)
+    {
+        PrnGen::genblock(buf, sizeof buf);
+        r.data.assign((char*)buf, 64 + buf[0] % (sizeof buf - 64));
+        r.dbid = (i << 4) | 1;
+
+        table->put(r.dbid, &r, key);
+    }
+
+    table->checkpoint();
+    table->commit();
+
+    delete table;
+}
+
+// open the table and decrypt all of its records
+static bool resume(FileSystemAccess* fsaccess, string* dbpath, string* name, SymmCipher* key,
+                   bool snapshot, unsigned* records, size_t* bytes, double* seconds)
+{
+    double start = now();
+    DBACCESS_CLASS dbaccess(dbpath);
+    DbTable* table = opentable(&dbaccess, fsaccess, name, snapshot);
+    bool mapped;
+    uint32_t id;
+    const char* data;
+    unsigned len;
+    string record;
+
+    if (!table)
+    {
+        return false;
+    }
+
+    *records = 0;
+    *bytes = 0;
+
+    mapped = table->mapped();
+    table->rewind();
+
+    while (mapped ? table->nextencrypted(&id, &data, &len) : table->nextencrypted(&id, &record))
+    {
+        if (mapped)
+        {
+            record.assign(data, len);
+        }
+
+        if (!DbTable::decrypt(id, &record, key))
+        {
+            delete table;
+            return false;
+        }
+
+        (*records)++;
+        *bytes += record.size();
+    }
+
+    if (mapped)
+    {
+        table->unmap();
+    }
+
+    delete table;
+
+    *seconds = now() - start;
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned records = argc > 1 ? atoi(argv[1]) : 500000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 3;
+    FSACCESS_CLASS fsaccess;
+    SymmCipher key;
+    byte keydata[SymmCipher::KEYLENGTH];
+    string path = string(BENCHMARKDIR) + "/", dbpath;
+    string name = "benchmark";
+
+    mkdir(BENCHMARKDIR, 0700);
+    fsaccess.path2local(&path, &dbpath);
+
+    PrnGen::genblock(keydata, sizeof keydata);
+    key.setkey(keydata);
+
+    printf("DB access layer: %s\n", TOSTRING(DBACCESS_CLASS));
+    printf("Filling %u records...\n", records);
+
+    fill(&fsaccess, &dbpath, &name, &key, records);
+
+    for (int i = 0; i < rounds; i++)
+    {
+        for (int snapshot = 0; snapshot < 2; snapshot++)
+        {
+            for (int warm = 0; warm < 2; warm++)
+            {
+                unsigned count;
+                size_t bytes;
+                double seconds;
+
+                if (!warm)
+                {
+                    evict();
+                }
+
+                if (!resume(&fsaccess, &dbpath, &name, &key, snapshot, &count, &bytes, &seconds))
+                {
+                    printf("Resume failed\n");
+                    return 1;
+                }
+
+                printf("%s resume%s: %u records, %.1f MB in %.3f s (%.0f records/s)\n",
+                       warm ? "Warm" : "Cold", snapshot ? " (snapshot)" : "", count,
+                       bytes / 1048576.0, seconds, seconds > 0 ? count / seconds : 0);
+            }
+        }
+    }
+
+    {
+        DBACCESS_CLASS dbaccess(&dbpath);
+        DbTable* table = opentable(&dbaccess, &fsaccess, &name, true);
+
+        if (table)
+        {
+            table->remove();
+            delete table;
+        }
+    }
+
+    rmdir(BENCHMARKDIR);
+
+    return 0;
+}
+
+#else
+
+int main()
+{
+    printf("No DB access layer configured\n");
+    return 1;
+}
+
+#endif
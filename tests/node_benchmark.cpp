@@ -0,0 +1,589 @@
+/**
+ * @file tests/node_benchmark.cpp
+ * @brief Benchmark of the in-memory node structures
+ *
+ * (c) 2013-2017 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Compares the node structures of MegaClient with the ones they replaced,
+// using synthetic accounts of the given number of nodes. Every measurement
+// runs in a child process of its own, so that the resident memory it
+// reports is not distorted by memory freed by a previous measurement.
+
+#include "mega.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace mega;
+
+// no network access
+struct BenchmarkHttpIO : public HttpIO
+{
+    void post(HttpReq*, const char*, unsigned) { }
+    void cancel(HttpReq*) { }
+    m_off_t postpos(void*) { return 0; }
+    bool doio() { return false; }
+    void addevents(Waiter*, int) { }
+    void setuseragent(string*) { }
+};
+
+static double now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// resident memory of the process in KB (0 if unknown)
+static long residentkb()
+{
+    FILE* fp = fopen("/proc/self/statm", "r");
+    long size, resident = 0;
+
+    if (fp)
+    {
+        if (fscanf(fp, "%ld %ld", &size, &resident) != 2)
+        {
+            resident = 0;
+        }
+
+        fclose(fp);
+    }
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// fast deterministic pseudo-random numbers (xorshift64*)
+static uint64_t randomstate = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t nextrandom()
+{
+    randomstate ^= randomstate >> 12;
+    randomstate ^= randomstate << 25;
+    randomstate ^= randomstate >> 27;
+
+    return randomstate * 2685821657736338717ULL;
+}
+
+// random 48-bit node handle
+static handle randomhandle()
+{
+    return nextrandom() & 0xFFFFFFFFFFFFULL;
+}
+
+// keeps the results of lookups alive
+static volatile uint64_t sink;
+
+// run a measurement in a child process
+static void isolated(void (*measure)(unsigned), unsigned count)
+{
+    pid_t pid;
+
+    fflush(stdout);
+
+    if (!(pid = fork()))
+    {
+        measure(count);
+        fflush(stdout);
+        _exit(0);
+    }
+
+    if (pid > 0)
+    {
+        waitpid(pid, NULL, 0);
+    }
+}
+
+// insertion, lookups of present and absent handles and resident memory of
+// an index with one allocated Node-sized block per entry
+template <class INDEX>
+static void nodeindex(const char* name, bool slab, unsigned count)
+{
+    vector<handle> handles, absent;
+    SlabAllocator allocator(Node::ALLOCSIZE);
+    INDEX index;
+    uint64_t found = 0;
+    double start, inserted, hits, misses;
+    long base;
+
+    // no memory freed by growing vectors may be reused by the index
+    handles.reserve(count);
+    absent.reserve(count);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        handles.push_back(randomhandle());
+        absent.push_back(randomhandle());
+    }
+
+    base = residentkb();
+    start = now();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        void* block = slab ? allocator.alloc() : ::operator new(Node::ALLOCSIZE);
+
+        memset(block, 0, Node::ALLOCSIZE);
+        index[handles[i]] = (Node*)block;
+    }
+
+    inserted = now() - start;
+    base = residentkb() - base;
+
+    // look the handles up in a different order than they were inserted
+    for (unsigned i = count; i > 1; i--)
+    {
+        std::swap(handles[i - 1], handles[nextrandom() % i]);
+    }
+
+    start = now();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        typename INDEX::iterator it = index.find(handles[i]);
+
+        if (it != index.end())
+        {
+            found += (uint64_t)it->second;
+        }
+    }
+
+    hits = now() - start;
+    start = now();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        found += index.find(absent[i]) != index.end();
+    }
+
+    misses = now() - start;
+
+    sink = found;
+
+    printf("%-28s insert %6.0f ns, hit %5.0f ns, miss %5.0f ns, %6.1f bytes/node\n",
+           name, inserted * 1e9 / count, hits * 1e9 / count, misses * 1e9 / count,
+           base * 1024.0 / count);
+}
+
+static void mapindex(unsigned count)
+{
+    nodeindex<std::map<handle, Node*> >("std::map + heap blocks", false, count);
+}
+
+static void flatindex(unsigned count)
+{
+    nodeindex<NodeIndex>("NodeIndex + SlabAllocator", true, count);
+}
+
+// the nodes of a synthetic account created the way fetchsc() does (one
+// folder per 32 files) - reports the resident memory of the client
+static void clientnodes(unsigned count)
+{
+    MegaApp app;
+    WAIT_CLASS waiter;
+    BenchmarkHttpIO httpio;
+    FSACCESS_CLASS fsaccess;
+    MegaClient client(&app, &waiter, &httpio, &fsaccess, NULL, NULL, "", "node_benchmark");
+    node_vector dp;
+    vector<handle> folders;
+    double start;
+    long base;
+    handle root = randomhandle();
+
+    base = residentkb();
+    start = now();
+
+    new (&client) Node(&client, &dp, root, UNDEF, ROOTNODE, -1, UNDEF, NULL, 0);
+    folders.push_back(root);
+
+    for (unsigned i = 1; i < count; i++)
+    {
+        handle h = randomhandle();
+        handle ph = folders[nextrandom() % folders.size()];
+
+        if (i % 33)
+        {
+            new (&client) Node(&client, &dp, h, ph, FILENODE, nextrandom() % 100000000, UNDEF, NULL, i);
+        }
+        else
+        {
+            new (&client) Node(&client, &dp, h, ph, FOLDERNODE, -1, UNDEF, NULL, i);
+            folders.push_back(h);
+        }
+    }
+
+    printf("%-28s %u nodes in %.3f s, %6.1f bytes/node\n", "MegaClient",
+           (unsigned)client.nodes.size(), now() - start, (residentkb() - base) * 1024.0 / count);
+}
+
+// file nodes with fingerprints (one in ten a copy of another file) put in
+// a std::multiset<FileFingerprint*, FileFingerprintCmp> (as before
+// FingerprintIndex) or a FingerprintIndex, then looked up by fingerprints
+// of present and absent files
+static void fingerprintindex(bool hashed, unsigned count)
+{
+    MegaApp app;
+    WAIT_CLASS waiter;
+    BenchmarkHttpIO httpio;
+    FSACCESS_CLASS fsaccess;
+    MegaClient client(&app, &waiter, &httpio, &fsaccess, NULL, NULL, "", "node_benchmark");
+    multiset<FileFingerprint*, FileFingerprintCmp> fingerprints;
+    FingerprintIndex index;
+    node_vector dp, files;
+    vector<FileFingerprint> present, absent;
+    uint64_t found = 0;
+    double start, inserted, hits, misses;
+    long base;
+    handle root = randomhandle();
+
+    // no memory freed by growing tables may be reused by the index
+    client.nodes.reserve(count + 1);
+    files.reserve(count);
+    present.reserve(count);
+    absent.reserve(count);
+
+    new (&client) Node(&client, &dp, root, UNDEF, ROOTNODE, -1, UNDEF, NULL, 0);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        Node* n = new (&client) Node(&client, &dp, randomhandle(), root, FILENODE, 0, UNDEF, NULL, i);
+        FileFingerprint fp;
+
+        if (i && !(nextrandom() % 10))
+        {
+            fp = *files[nextrandom() % files.size()];
+        }
+        else
+        {
+            fp.size = nextrandom() % 100000000;
+            fp.mtime = 1400000000 + nextrandom() % 100000000;
+            for (int j = 0; j < 4; j++)
+            {
+                fp.crc[j] = (int32_t)nextrandom();
+            }
+            fp.isvalid = true;
+        }
+
+        *(FileFingerprint*)n = fp;
+        files.push_back(n);
+    }
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        FileFingerprint fp = *files[nextrandom() % count];
+
+        present.push_back(fp);
+        fp.crc[0]++;
+        absent.push_back(fp);
+    }
+
+    base = residentkb();
+    start = now();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (hashed)
+        {
+            index.add(files[i]);
+        }
+        else
+        {
+            fingerprints.insert(files[i]);
+        }
+    }
+
+    inserted = now() - start;
+    base = residentkb() - base;
+    start = now();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        found += (uint64_t)(hashed ? (FileFingerprint*)index.find(&present[i]) : *fingerprints.find(&present[i]));
+    }
+
+    hits = now() - start;
+    start = now();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        found += hashed ? index.find(&absent[i]) != NULL : fingerprints.find(&absent[i]) != fingerprints.end();
+    }
+
+    misses = now() - start;
+
+    sink = found;
+
+    printf("%-28s build %.3f s, hit %5.0f ns, miss %5.0f ns, %6.1f bytes/node\n",
+           hashed ? "FingerprintIndex" : "std::multiset", inserted, hits * 1e9 / count,
+           misses * 1e9 / count, base * 1024.0 / count);
+
+    // the nodes must not be linked to the index when they are deleted
+    index.clear();
+}
+
+static void fingerprintset(unsigned count)
+{
+    fingerprintindex(false, count);
+}
+
+static void fingerprinthash(unsigned count)
+{
+    fingerprintindex(true, count);
+}
+
+// synthetic file name: two made-up words, a number and an extension
+static string randomname()
+{
+    static const char* syllables[] = { "ka", "to", "mi", "re", "su", "lo", "na", "pe", "di", "bo",
+                                       "Gra", "Ve", "Shu", "Ar", "Ton", "Ly" };
+    static const char* extensions[] = { ".jpg", ".pdf", ".mp4", ".docx", ".txt", "" };
+    string name;
+    char number[16];
+
+    for (int word = 0; word < 2; word++)
+    {
+        for (int i = 2 + nextrandom() % 3; i--; )
+        {
+            name.append(syllables[nextrandom() % (sizeof syllables / sizeof *syllables)]);
+        }
+
+        name.append(word ? "_" : " ");
+    }
+
+    snprintf(number, sizeof number, "%u", (unsigned)(nextrandom() % 100000));
+    name.append(number);
+    name.append(extensions[nextrandom() % (sizeof extensions / sizeof *extensions)]);
+
+    return name;
+}
+
+// substring search over the names of the nodes: strcasestr() on every
+// name (the tree walk of SearchTreeProcessor) against SearchIndex
+// candidates verified with strcasestr()
+static void search(unsigned count)
+{
+    vector<string> names;
+    vector<string> queries;
+    SearchIndex index;
+    double start;
+    long base;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        names.push_back(randomname());
+    }
+
+    // a short, a medium and a long substring of an existing name, a
+    // case-folded one and one that matches nothing
+    queries.push_back(names[count / 2].substr(2, 3));
+    queries.push_back(names[count / 3].substr(1, 6));
+    queries.push_back(names[count / 4].substr(0, 12));
+    queries.push_back(names[count / 5].substr(0, 5));
+    for (size_t i = 0; i < queries.back().size(); i++)
+    {
+        queries.back()[i] = (char)toupper((unsigned char)queries.back()[i]);
+    }
+    queries.push_back("qqqxyz");
+
+    base = residentkb();
+    start = now();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        index.add(i, names[i].c_str());
+    }
+
+    printf("SearchIndex built in %.3f s, %.1f bytes/name\n",
+           now() - start, (residentkb() - base) * 1024.0 / count);
+
+    for (size_t q = 0; q < queries.size(); q++)
+    {
+        const char* query = queries[q].c_str();
+        vector<handle> candidates;
+        unsigned scanned = 0, indexed = 0;
+        double scan, lookup;
+
+        start = now();
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            scanned += strcasestr(names[i].c_str(), query) != NULL;
+        }
+
+        scan = now() - start;
+        start = now();
+
+        if (index.candidates(query, &candidates))
+        {
+            for (size_t i = 0; i < candidates.size(); i++)
+            {
+                indexed += strcasestr(names[candidates[i]].c_str(), query) != NULL;
+            }
+        }
+
+        lookup = now() - start;
+
+        printf("  \"%s\": %u matches, scan %.2f ms, index %.2f ms (%u candidates)%s\n",
+               query, scanned, scan * 1000, lookup * 1000, (unsigned)candidates.size(),
+               scanned == indexed ? "" : " MISMATCH");
+    }
+}
+
+// file nodes loaded from serialized cache records the way fetchsc() does,
+// with their attributes either decoded right away (as before lazy
+// decoding) or left serialized, then all names accessed once
+static void cachedattrs(bool lazy, unsigned count)
+{
+    MegaApp app;
+    WAIT_CLASS waiter;
+    BenchmarkHttpIO httpio;
+    FSACCESS_CLASS fsaccess;
+    MegaClient client(&app, &waiter, &httpio, &fsaccess, NULL, NULL, "", "node_benchmark");
+    MegaClient source(&app, &waiter, &httpio, &fsaccess, NULL, NULL, "", "node_benchmark");
+    node_vector dp;
+    vector<string> records;
+    vector<Node*> loaded;
+    size_t namebytes = 0;
+    double start, load, access;
+    long base, loadkb;
+    handle root = randomhandle();
+
+    client.nodes.reserve(count + 1);
+    source.nodes.reserve(count + 1);
+    dp.reserve(2 * count);
+    records.reserve(count);
+    loaded.reserve(count);
+
+    Node* rootnode = new (&client) Node(&client, &dp, root, UNDEF, ROOTNODE, -1, UNDEF, NULL, 0);
+    Node* sourceroot = new (&source) Node(&source, &dp, root, UNDEF, ROOTNODE, -1, UNDEF, NULL, 0);
+
+    // the source nodes are kept so that their memory is not reused
+    for (unsigned i = 0; i < count; i++)
+    {
+        Node* n = new (&source) Node(&source, &dp, randomhandle(), UNDEF, FILENODE,
+                                     nextrandom() % 100000000, UNDEF, NULL, i);
+        byte key[FILENODEKEYLENGTH];
+        FileFingerprint fp;
+        string fingerprint;
+
+        for (unsigned j = 0; j < sizeof key; j++)
+        {
+            key[j] = (byte)nextrandom();
+        }
+
+        n->nodekey.assign((const char*)key, sizeof key);
+        n->setparent(sourceroot);
+
+        fp.size = n->size;
+        fp.mtime = 1400000000 + nextrandom() % 100000000;
+        for (int j = 0; j < 4; j++)
+        {
+            fp.crc[j] = (int32_t)nextrandom();
+        }
+        fp.isvalid = true;
+        fp.serializefingerprint(&fingerprint);
+
+        n->attrs().map['n'] = randomname();
+        n->attrs().map['c'] = fingerprint;
+
+        records.push_back(string());
+        n->serialize(&records.back());
+    }
+
+    base = residentkb();
+    start = now();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        NodeRecord r;
+
+        if (Node::parse(&fsaccess, &records[i], &r))
+        {
+            Node* n = Node::unserialize(&client, &r, &dp);
+
+            if (!lazy)
+            {
+                n->attrs();
+            }
+
+            n->setparent(rootnode);
+            loaded.push_back(n);
+        }
+    }
+
+    load = now() - start;
+    loadkb = residentkb() - base;
+    start = now();
+
+    for (unsigned i = 0; i < loaded.size(); i++)
+    {
+        namebytes += strlen(loaded[i]->displayname());
+    }
+
+    access = now() - start;
+    sink = namebytes;
+
+    printf("%-28s load %.3f s, %6.1f bytes/node, first access %.3f s, then %6.1f bytes/node\n",
+           lazy ? "Serialized until accessed" : "Decoded while loading", load,
+           loadkb * 1024.0 / count, access, (residentkb() - base) * 1024.0 / count);
+}
+
+static void eagerattrs(unsigned count)
+{
+    cachedattrs(false, count);
+}
+
+static void lazyattrs(unsigned count)
+{
+    cachedattrs(true, count);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned count = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    if (!count)
+    {
+        printf("Usage: %s [nodes]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Node index (%u nodes):\n", count);
+    isolated(mapindex, count);
+    isolated(flatindex, count);
+    isolated(clientnodes, count);
+
+    printf("Name search (%u nodes):\n", count);
+    isolated(search, count);
+
+    printf("Fingerprint lookup (%u files):\n", count);
+    isolated(fingerprintset, count);
+    isolated(fingerprinthash, count);
+
+    printf("Cached attributes (%u files):\n", count);
+    isolated(eagerattrs, count);
+    isolated(lazyattrs, count);
+
+    return 0;
+}
@@ -50,6 +50,1098 @@ TEST(Serialize64, serialize)
     ASSERT_EQ(in, out);
 }
 
+// single attributes are looked up in serialized attributes as if decoded
+TEST(AttrMap, find)
+{
+    AttrMap attrs;
+    string d, value;
+
+    attrs.map['n'] = "name.txt";
+    attrs.map['c'] = "fingerprint";
+    attrs.map[MAKENAMEID2('e', 'x')] = "";
+    attrs.serialize(&d);
+
+    ASSERT_TRUE(AttrMap::skip(d.data(), d.data() + d.size()) == d.data() + d.size());
+    ASSERT_TRUE(AttrMap::skip(d.data(), d.data() + d.size() - 4) == NULL);
+
+    ASSERT_TRUE(AttrMap::find(&d, 'n', &value));
+    ASSERT_EQ(value, "name.txt");
+    ASSERT_TRUE(AttrMap::find(&d, 'c', &value));
+    ASSERT_EQ(value, "fingerprint");
+    ASSERT_TRUE(AttrMap::find(&d, MAKENAMEID2('e', 'x'), &value));
+    ASSERT_EQ(value, "");
+    ASSERT_FALSE(AttrMap::find(&d, 'x', &value));
+
+    AttrMap decoded;
+    decoded.unserialize(d.data(), d.data() + d.size());
+    ASSERT_TRUE(decoded.map == attrs.map);
+}
+
+TEST(NodeIndex, insertfinderase)
+{
+    NodeIndex index;
+    const int num = 10000;
+    handle h;
+
+    ASSERT_TRUE(index.empty());
+    ASSERT_TRUE(index.find(1) == index.end());
+
+    for (int i = 0; i < num; i++)
+    {
+        h = (handle)i * 0x10001;
+        index[h] = (Node*)(uintptr_t)(i + 1);
+    }
+
+    ASSERT_EQ(index.size(), (size_t)num);
+
+    for (int i = 0; i < num; i++)
+    {
+        h = (handle)i * 0x10001;
+        NodeIndex::iterator it = index.find(h);
+        ASSERT_TRUE(it != index.end());
+        ASSERT_EQ(it->first, h);
+        ASSERT_EQ(it->second, (Node*)(uintptr_t)(i + 1));
+    }
+
+    // remove every other entry
+    for (int i = 0; i < num; i += 2)
+    {
+        ASSERT_EQ(index.erase((handle)i * 0x10001), (size_t)1);
+    }
+
+    ASSERT_EQ(index.erase((handle)0), (size_t)0);
+    ASSERT_EQ(index.size(), (size_t)num / 2);
+
+    size_t count = 0;
+    for (NodeIndex::iterator it = index.begin(); it != index.end(); it++)
+    {
+        ASSERT_EQ((it->first / 0x10001) % 2, (handle)1);
+        count++;
+    }
+
+    ASSERT_EQ(count, (size_t)num / 2);
+
+    for (int i = 0; i < num; i++)
+    {
+        ASSERT_EQ(index.find((handle)i * 0x10001) != index.end(), i % 2 == 1);
+    }
+
+    index.clear();
+    ASSERT_TRUE(index.empty());
+    ASSERT_TRUE(index.begin() == index.end());
+}
+
+TEST(SlabAllocator, reuse)
+{
+    SlabAllocator slab(40, 4);
+    void* blocks[10];
+
+    for (int i = 0; i < 10; i++)
+    {
+        blocks[i] = slab.alloc();
+        memset(blocks[i], i, 40);
+    }
+
+    ASSERT_EQ(slab.inuse(), (size_t)10);
+    ASSERT_EQ(slab.reserved(), (size_t)3 * 4 * 40);
+
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(((unsigned char*)blocks[i])[39], (unsigned char)i);
+    }
+
+    void* p = blocks[3];
+    slab.release(p);
+    ASSERT_EQ(slab.alloc(), p);
+
+    for (int i = 0; i < 10; i++)
+    {
+        slab.release(blocks[i]);
+    }
+
+    ASSERT_EQ(slab.inuse(), (size_t)0);
+    ASSERT_EQ(slab.reserved(), (size_t)0);
+}
+
+TEST(SearchIndex, candidates)
+{
+    SearchIndex index;
+    handle_vector result;
+
+    index.add(1, "Holiday Photos");
+    index.add(2, "photo.JPG");
+    index.add(3, "notes.txt");
+
+    ASSERT_FALSE(index.candidates("ph", &result));
+
+    ASSERT_TRUE(index.candidates("PHOTO", &result));
+    ASSERT_EQ(result.size(), (size_t)2);
+    ASSERT_EQ(result[0], (handle)1);
+    ASSERT_EQ(result[1], (handle)2);
+
+    ASSERT_TRUE(index.candidates(".jpg", &result));
+    ASSERT_EQ(result.size(), (size_t)1);
+    ASSERT_EQ(result[0], (handle)2);
+
+    ASSERT_TRUE(index.candidates("xyz", &result));
+    ASSERT_TRUE(result.empty());
+
+    // removed entries remain as (stale) candidates until the index is rebuilt
+    index.remove(3);
+    index.add(3, "photos.txt");
+    ASSERT_TRUE(index.candidates("photo", &result));
+    ASSERT_EQ(result.size(), (size_t)3);
+    ASSERT_EQ(index.size(), (size_t)3);
+}
+
+#ifdef THREAD_CLASS
+static void square(void* context, size_t i)
+{
+    ((uint64_t*)context)[i] = (uint64_t)i * i;
+}
+
+TEST(WorkerPool, run)
+{
+    WorkerPool pool(3);
+    vector<uint64_t> results;
+
+    // small and large batches, the latter spread over the workers
+    for (size_t n = 1; n <= 10000; n *= 10)
+    {
+        results.assign(n, 0);
+        pool.run(square, &results[0], n);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            ASSERT_EQ(results[i], (uint64_t)i * i);
+        }
+    }
+}
+
+// counts the wakeups of the engine thread
+struct CountingWaiter : public Waiter
+{
+    SEMAPHORE_CLASS notified;
+
+    int wait()
+    {
+        notified.wait();
+        return NEEDEXEC;
+    }
+
+    void notify()
+    {
+        notified.release();
+    }
+};
+
+struct SquareJob : public WorkerJob
+{
+    uint64_t value;
+    int runs;
+
+    void run()
+    {
+        value *= value;
+        runs++;
+    }
+
+    SquareJob() : value(0), runs(0) { }
+};
+
+TEST(WorkerPool, queue)
+{
+    WorkerPool pool(3);
+    CountingWaiter waiter;
+    SquareJob jobs[16];
+
+    for (int i = 0; i < 16; i++)
+    {
+        jobs[i].value = i;
+        pool.queue(&jobs[i], &waiter);
+    }
+
+    // a dropped job is either not run at all or completed
+    pool.cancel(&jobs[15]);
+    ASSERT_LE(jobs[15].runs, 1);
+
+    for (int i = 0; i < 15; i++)
+    {
+        while (!pool.finished(&jobs[i]))
+        {
+            waiter.wait();
+        }
+
+        ASSERT_EQ(jobs[i].value, (uint64_t)i * i);
+        ASSERT_EQ(jobs[i].runs, 1);
+    }
+
+    // batches keep working while jobs are queued
+    vector<uint64_t> results(1000);
+    jobs[0].value = 7;
+    pool.queue(&jobs[0], &waiter);
+    pool.run(square, &results[0], results.size());
+    pool.cancel(&jobs[0]);
+
+    ASSERT_EQ(results[999], (uint64_t)999 * 999);
+    ASSERT_TRUE(jobs[0].runs == 1 || (jobs[0].runs == 2 && jobs[0].value == 49));
+}
+#endif
+
+// in-memory DbTable with transactions (and a generation counter, if given
+// one to store it in)
+class MemDbTable : public DbTable
+{
+    map<uint32_t, string>* committed;
+    map<uint32_t, string> current;
+    map<uint32_t, string>::iterator it;
+    uint64_t* committedgeneration;
+    uint64_t generation;
+
+public:
+    int rewinds;
+
+    using DbTable::put;
+    using DbTable::next;
+
+    void rewind() { rewinds++; current = *committed; it = current.begin(); }
+    bool next(uint32_t* id, string* data)
+    {
+        if (it == current.end()) return false;
+        *id = it->first;
+        *data = (it++)->second;
+        return true;
+    }
+    bool get(uint32_t id, string* data)
+    {
+        map<uint32_t, string>::iterator i = current.find(id);
+        if (i == current.end()) return false;
+        *data = i->second;
+        return true;
+    }
+    bool put(uint32_t id, char* data, unsigned len) { current[id].assign(data, len); return true; }
+    bool del(uint32_t id) { current.erase(id); return true; }
+    void truncate() { current.clear(); }
+    void begin() { current = *committed; }
+    void commit() { *committed = current; if (committedgeneration) *committedgeneration = generation; }
+    void abort() { current = *committed; if (committedgeneration) generation = *committedgeneration; }
+    void remove() { committed->clear(); }
+    bool getgeneration(uint64_t* g) { if (!committedgeneration) return false; *g = generation; return true; }
+    bool setgeneration(uint64_t g) { if (!committedgeneration) return false; generation = g; return true; }
+
+    MemDbTable(map<uint32_t, string>* c, uint64_t* g = NULL) : committed(c), committedgeneration(g), rewinds(0)
+    {
+        current = *c;
+        generation = g ? *g : 0;
+    }
+};
+
+static map<uint32_t, string> readtable(DbTable* table)
+{
+    map<uint32_t, string> result;
+    uint32_t id;
+    string data;
+
+    table->rewind();
+    while (table->next(&id, &data))
+    {
+        result[id] = data;
+    }
+
+    return result;
+}
+
+TEST(SnapshotDbTable, reload)
+{
+    FSACCESS_CLASS fsaccess;
+    map<uint32_t, string> store, expected;
+    uint64_t generation = 0;
+    string path = "snapshottest", localpath;
+    string value = "changed";
+    SymmCipher key;
+    byte keydata[SymmCipher::KEYLENGTH] = { 1, 2, 3 };
+
+    key.setkey(keydata);
+    PaddedCBC::encrypt(&value, &key);
+    fsaccess.path2local(&path, &localpath);
+
+    {
+        SnapshotDbTable table(new MemDbTable(&store, &generation), &fsaccess, &localpath);
+
+        table.begin();
+        table.truncate();
+        for (uint32_t i = 1; i < 1000; i++)
+        {
+            string data(i % 50, 'a' + i % 26);
+            PaddedCBC::encrypt(&data, &key);
+            table.put(i * 16 + 1, (char*)data.data(), data.size());
+            expected[i * 16 + 1] = data;
+        }
+        table.checkpoint();
+        table.commit();
+
+        // journaled changes
+        table.begin();
+        table.put(33, (char*)value.data(), value.size());
+        table.del(49);
+        table.put(100001, (char*)value.data(), value.size());
+        table.commit();
+        expected[33] = value;
+        expected.erase(49);
+        expected[100001] = value;
+    }
+
+    {
+        MemDbTable* mem = new MemDbTable(&store, &generation);
+        SnapshotDbTable table(mem, &fsaccess, &localpath);
+
+        // served from snapshot and journal
+        ASSERT_TRUE(readtable(&table) == expected);
+        ASSERT_EQ(mem->rewinds, 0);
+    }
+
+    // the table holds nothing but the records, which all decrypt when read
+    // without a snapshot
+    {
+        MemDbTable table(&store);
+        uint32_t id;
+        string data;
+        size_t count = 0;
+
+        table.rewind();
+        while (table.next(&id, &data, &key))
+        {
+            count++;
+        }
+
+        ASSERT_EQ(count, expected.size());
+        ASSERT_TRUE(store == expected);
+    }
+
+    // a change the journal doesn't know about invalidates the snapshot
+    store[65] = value;
+    generation++;
+    expected[65] = value;
+
+    {
+        MemDbTable* mem = new MemDbTable(&store, &generation);
+        SnapshotDbTable table(mem, &fsaccess, &localpath);
+
+        ASSERT_TRUE(readtable(&table) == expected);
+        ASSERT_EQ(mem->rewinds, 1);
+        table.remove();
+    }
+}
+
+#ifdef THREAD_CLASS
+TEST(AsyncDbTable, transactions)
+{
+    map<uint32_t, string> store;
+    string value = "value", other = "other", data;
+
+    {
+        AsyncDbTable table(new MemDbTable(&store));
+
+        table.begin();
+        for (uint32_t i = 1; i <= 1000; i++)
+        {
+            table.put(i * 16, (char*)value.data(), value.size());
+
+            if (!(i % 100))
+            {
+                table.commit();
+                table.begin();
+            }
+        }
+
+        // reads wait for the queued writes
+        ASSERT_TRUE(table.get(16, &data));
+        ASSERT_EQ(data, value);
+
+        // aborted writes do not affect the merged commits before them
+        table.put(16, (char*)other.data(), other.size());
+        table.del(32);
+        table.abort();
+        table.begin();
+
+        table.flush();
+        ASSERT_EQ(store.size(), 1000u);
+        ASSERT_EQ(store[16], value);
+        ASSERT_EQ(store[32], value);
+
+        // uncommitted writes are visible, but not persisted
+        table.put(48, (char*)other.data(), other.size());
+        ASSERT_TRUE(table.get(48, &data));
+        ASSERT_EQ(data, other);
+    }
+
+    ASSERT_EQ(store[48], value);
+}
+
+// cache record of a fixed content
+struct TestRecord : public Cachable
+{
+    string data;
+
+    bool serialize(string* d)
+    {
+        d->append(data);
+        return true;
+    }
+};
+
+TEST(CacheLoader, order)
+{
+    map<uint32_t, string> store;
+    MemDbTable table(&store);
+    FSACCESS_CLASS fsaccess;
+    WorkerPool pool(3);
+    SymmCipher key;
+    byte keydata[SymmCipher::KEYLENGTH] = { 1, 2, 3 };
+    TestRecord r;
+
+    key.setkey(keydata);
+
+    for (uint32_t i = 1; i <= 5000; i++)
+    {
+        r.data = string(i % 300, 'a' + i % 26);
+        r.dbid = i * 16 + MegaClient::CACHEDUSER;
+        table.put(r.dbid, &r, &key);
+    }
+
+    table.commit();
+    table.rewind();
+
+    CacheLoader loader(&table, &key, &fsaccess, &pool);
+    CacheLoader::Batch* batch;
+    uint32_t i = 0;
+
+    // decrypted and handed out in cache order
+    while ((batch = loader.next()))
+    {
+        for (size_t j = 0; j < batch->records.size(); j++)
+        {
+            CacheLoader::Record& rec = batch->records[j];
+
+            i++;
+            ASSERT_EQ(rec.id, i * 16 + MegaClient::CACHEDUSER);
+            ASSERT_TRUE(rec.decrypted);
+            ASSERT_EQ(rec.data, string(i % 300, 'a' + i % 26));
+            ASSERT_TRUE(rec.node == NULL);
+        }
+
+        delete batch;
+    }
+
+    ASSERT_EQ(i, 5000u);
+    ASSERT_TRUE(loader.readdone() && loader.decodedone());
+}
+#endif
+
+// MemDbTable with a node index (the index is shared like the records)
+class IndexedMemDbTable : public MemDbTable
+{
+    map<uint32_t, DbNodeColumns>* index;
+
+public:
+    bool hasnodeindex() { return true; }
+    bool indexnode(uint32_t id, const DbNodeColumns* columns) { (*index)[id] = *columns; return true; }
+    bool del(uint32_t id) { index->erase(id); return MemDbTable::del(id); }
+
+    bool getnode(handle h, uint32_t* id)
+    {
+        for (map<uint32_t, DbNodeColumns>::iterator it = index->begin(); it != index->end(); it++)
+        {
+            if (it->second.h == h)
+            {
+                *id = it->first;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool getchildnodes(handle ph, handle_vector* handles)
+    {
+        for (map<uint32_t, DbNodeColumns>::iterator it = index->begin(); it != index->end(); it++)
+        {
+            if (it->second.ph == ph)
+            {
+                handles->push_back(it->second.h);
+            }
+        }
+
+        return true;
+    }
+
+    IndexedMemDbTable(map<uint32_t, string>* c, map<uint32_t, DbNodeColumns>* i) : MemDbTable(c), index(i) { }
+};
+
+// no network access
+struct TestHttpIO : public HttpIO
+{
+    void post(HttpReq*, const char*, unsigned) { }
+    void cancel(HttpReq*) { }
+    m_off_t postpos(void*) { return 0; }
+    bool doio() { return false; }
+    void addevents(Waiter*, int) { }
+    void setuseragent(string*) { }
+};
+
+static void expectcounter(const NodeCounter& c, const NodeCounter& expected)
+{
+    EXPECT_EQ(c.files, expected.files);
+    EXPECT_EQ(c.folders, expected.folders);
+    EXPECT_EQ(c.versions, expected.versions);
+    EXPECT_EQ(c.storage, expected.storage);
+    EXPECT_EQ(c.versionstorage, expected.versionstorage);
+}
+
+// feed a single action packet to the client
+static void actionpacket(MegaClient* client, string* packet)
+{
+    client->insca = false;
+    client->jsonsc.begin(packet->c_str());
+    client->jsonsc.enterobject();
+    client->procsc();
+}
+
+TEST(MegaClient, pagednodes)
+{
+    map<uint32_t, string> store;
+    map<uint32_t, DbNodeColumns> index;
+    MegaApp app;
+    WAIT_CLASS waiter;
+    TestHttpIO httpio;
+    FSACCESS_CLASS fsaccess;
+    MegaClient source(&app, &waiter, &httpio, &fsaccess, NULL, NULL, "", "tests");
+    MegaClient client(&app, &waiter, &httpio, &fsaccess, NULL, NULL, "", "tests");
+    byte keydata[SymmCipher::KEYLENGTH] = { 1, 2, 3 };
+    byte nodekey[FILENODEKEYLENGTH] = { 4, 5, 6 };
+    node_vector dp;
+
+    // root - F (f1, f2, f3, V with versions v1 and v2) - G (empty); v1 has
+    // the lower handle, so that it is loaded before its parent
+    const handle r = 0x10, f = 0x20, g = 0x30, f1 = 0x41, f2 = 0x42, f3 = 0x43, v = 0x60, v1 = 0x50, v2 = 0x70;
+    struct { handle h, ph; nodetype_t type; m_off_t size; const char* name; } tree[] = {
+        { r, UNDEF, ROOTNODE, -1, NULL },
+        { f, r, FOLDERNODE, -1, "F" },
+        { g, r, FOLDERNODE, -1, "G" },
+        { f1, f, FILENODE, 100, "f1" },
+        { f2, f, FILENODE, 200, "f2" },
+        { f3, f, FILENODE, 300, "f3" },
+        { v, f, FILENODE, 1000, "v" },
+        { v1, v, FILENODE, 500, "v" },
+        { v2, v1, FILENODE, 250, "v" }
+    };
+
+    source.key.setkey(keydata);
+    client.key.setkey(keydata);
+    source.sctable = new IndexedMemDbTable(&store, &index);
+
+    for (unsigned i = 0; i < sizeof tree / sizeof *tree; i++)
+    {
+        Node* n = new (&source) Node(&source, &dp, tree[i].h, tree[i].ph, tree[i].type, tree[i].size, UNDEF, NULL, 0);
+
+        if (tree[i].name)
+        {
+            n->nodekey.assign((const char*)nodekey, (n->type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+            n->attrs().map['n'] = tree[i].name;
+        }
+
+        ASSERT_TRUE(source.cachenode(n));
+    }
+
+    source.sctable->commit();
+
+    // plain files are left in the cache, their totals folded into the parent
+    client.maxresidentnodes = 100;
+    client.sctable = new IndexedMemDbTable(&store, &index);
+    ASSERT_TRUE(client.fetchsc(client.sctable));
+    ASSERT_TRUE(client.nodepaging);
+
+    Node* nf = client.nodebyhandle(f);
+    ASSERT_TRUE(nf != NULL);
+    EXPECT_TRUE(client.nodes.find(f1) == client.nodes.end());
+    EXPECT_TRUE(client.nodes.find(v2) == client.nodes.end());
+    EXPECT_FALSE(nf->childrenloaded);
+    EXPECT_EQ(nf->numchildfiles, 4);
+
+    // files with versions are loaded, v1 faulting in its parent v
+    ASSERT_EQ(client.nodes.size(), 5u);
+    ASSERT_TRUE(client.nodes.find(v) != client.nodes.end());
+    ASSERT_TRUE(client.nodes.find(v1) != client.nodes.end());
+    EXPECT_EQ(client.nodes[v1]->parent, client.nodes[v]);
+    EXPECT_EQ(client.nodes[v]->parent, nf);
+    EXPECT_EQ(nf->children.size(), 1u);
+
+    for (unsigned i = 0; i < sizeof tree / sizeof *tree; i++)
+    {
+        node_map::iterator it = client.nodes.find(tree[i].h);
+
+        if (it != client.nodes.end())
+        {
+            expectcounter(it->second->counter, source.nodes[tree[i].h]->counter);
+        }
+    }
+
+    // non-resident nodes are loaded with their names
+    Node* n = client.nodebyhandle(f2);
+    ASSERT_TRUE(n != NULL);
+    EXPECT_EQ(n->parent, nf);
+    EXPECT_EQ(n->attrs().map['n'], "f2");
+    EXPECT_FALSE(nf->childrenloaded);
+
+    client.loadchildren(nf);
+    EXPECT_TRUE(nf->childrenloaded);
+    EXPECT_EQ(nf->children.size(), 4u);
+    EXPECT_EQ(client.nodes.size(), 8u);
+    expectcounter(nf->counter, source.nodes[f]->counter);
+
+    // roots, folders with children and files with paged versions stay
+    client.maxresidentnodes = 1;
+    client.evictnodes();
+    EXPECT_EQ(client.nodes.size(), 4u);
+    EXPECT_TRUE(client.nodes.find(r) != client.nodes.end());
+    EXPECT_TRUE(client.nodes.find(f) != client.nodes.end());
+    EXPECT_TRUE(client.nodes.find(v) != client.nodes.end());
+    EXPECT_TRUE(client.nodes.find(v1) != client.nodes.end());
+    EXPECT_FALSE(client.nodes[r]->childrenloaded);
+    EXPECT_FALSE(nf->childrenloaded);
+    EXPECT_EQ(nf->numchildfiles, 4);
+    expectcounter(nf->counter, source.nodes[f]->counter);
+    expectcounter(client.nodes[r]->counter, source.nodes[r]->counter);
+
+    // evicted nodes are loaded again
+    n = client.nodebyhandle(g);
+    ASSERT_TRUE(n != NULL);
+    EXPECT_EQ(n->parent, client.nodes[r]);
+    expectcounter(client.nodes[r]->counter, source.nodes[r]->counter);
+
+    // an update of a non-resident node loads it and keeps it until it has
+    // been written back
+    char base64[12];
+    handle sn = 1;
+    Base64::btoa((byte*)&sn, sizeof sn, client.scsn);
+    client.cachedscsn = sn;
+
+    string packet = "{\"a\":[{\"a\":\"u\",\"n\":\"";
+    Base64::btoa((byte*)&f1, MegaClient::NODEHANDLE, base64);
+    packet.append(base64);
+    packet.append("\",\"ts\":12345}]}");
+    actionpacket(&client, &packet);
+
+    ASSERT_TRUE(client.nodes.find(f1) != client.nodes.end());
+    n = client.nodes[f1];
+    EXPECT_EQ(n->ctime, 12345);
+    EXPECT_TRUE(n->notified);
+    EXPECT_EQ(n->parent, nf);
+    expectcounter(nf->counter, source.nodes[f]->counter);
+
+    client.evictnodes();
+    ASSERT_TRUE(client.nodes.find(f1) != client.nodes.end());
+
+    client.notifypurge();
+    client.evictnodes();
+    ASSERT_TRUE(client.nodes.find(f1) == client.nodes.end());
+
+    n = client.nodebyhandle(f1);
+    ASSERT_TRUE(n != NULL);
+    EXPECT_EQ(n->ctime, 12345);
+
+    // a deletion of a non-resident node updates the totals and the cache
+    packet = "{\"a\":[{\"a\":\"d\",\"n\":\"";
+    Base64::btoa((byte*)&f3, MegaClient::NODEHANDLE, base64);
+    packet.append(base64);
+    packet.append("\"}]}");
+    ASSERT_TRUE(client.nodes.find(f3) == client.nodes.end());
+    actionpacket(&client, &packet);
+    client.notifypurge();
+
+    EXPECT_TRUE(client.nodebyhandle(f3) == NULL);
+    EXPECT_EQ(nf->numchildfiles, 3);
+    EXPECT_EQ(nf->counter.files, source.nodes[f]->counter.files - 1);
+    EXPECT_EQ(nf->counter.storage, source.nodes[f]->counter.storage - 300);
+    EXPECT_EQ(client.nodes[r]->counter.files, source.nodes[r]->counter.files - 1);
+
+    client.loadchildren(nf);
+    EXPECT_EQ(nf->children.size(), 3u);
+}
+
+#ifdef USE_SQLITE
+static DbNodeColumns nodecolumns(handle h, handle ph, uint64_t namehash, uint64_t fingerprint)
+{
+    DbNodeColumns columns;
+
+    columns.h = h;
+    columns.ph = ph;
+    columns.namehash = namehash;
+    columns.size = fingerprint ? 1000 : -1;
+    columns.mtime = 1500000000;
+    columns.fingerprint = fingerprint;
+
+    return columns;
+}
+
+TEST(SqliteDbTable, nodeindex)
+{
+    FSACCESS_CLASS fsaccess;
+    SqliteDbAccess access;
+    string name = "nodeindextest", localpath, path;
+    handle_vector handles;
+    uint32_t id;
+    uint64_t generation;
+
+    DbTable* table = access.open(&fsaccess, &name);
+    ASSERT_TRUE(table != NULL);
+    ASSERT_TRUE(table->localpath(&localpath));
+    fsaccess.local2path(&localpath, &path);
+
+    // a table of a schema without the node columns
+    delete table;
+
+    sqlite3* db;
+    ASSERT_EQ(sqlite3_open(path.c_str(), &db), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(db, "CREATE TABLE nodes (id INTEGER PRIMARY KEY ASC NOT NULL, nodehandle INTEGER NOT NULL, parenthandle INTEGER NOT NULL)", NULL, NULL, NULL), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(db, "INSERT INTO statecache (id, content) VALUES (17, x'0102')", NULL, NULL, NULL), SQLITE_OK);
+    ASSERT_EQ(sqlite3_exec(db, "PRAGMA user_version = 0", NULL, NULL, NULL), SQLITE_OK);
+    sqlite3_close(db);
+
+    // the old index is dropped, the records are kept
+    table = access.open(&fsaccess, &name);
+    ASSERT_TRUE(table != NULL);
+    EXPECT_FALSE(table->hasnodeindex());
+    EXPECT_FALSE(table->getnode(1, &id));
+    ASSERT_EQ(readtable(table).size(), 1u);
+
+    table->begin();
+    table->createnodeindex();
+    ASSERT_TRUE(table->hasnodeindex());
+
+    DbNodeColumns columns[] = {
+        nodecolumns(1, UNDEF, 0, 0),
+        nodecolumns(2, 1, 100, 0),
+        nodecolumns(3, 2, 200, 5),
+        nodecolumns(4, 2, 200, 6),
+        nodecolumns(5, 2, 300, 5),
+        nodecolumns(6, 2, 0, 0)
+    };
+
+    for (unsigned i = 0; i < sizeof columns / sizeof *columns; i++)
+    {
+        ASSERT_TRUE(table->put((i + 1) * 16, (char*)"x", 1));
+        ASSERT_TRUE(table->indexnode((i + 1) * 16, &columns[i]));
+    }
+
+    ASSERT_TRUE(table->setgeneration(7));
+    table->commit();
+    delete table;
+
+    // the current schema is kept
+    table = access.open(&fsaccess, &name);
+    ASSERT_TRUE(table != NULL);
+    ASSERT_TRUE(table->hasnodeindex());
+    ASSERT_TRUE(table->getgeneration(&generation));
+    EXPECT_EQ(generation, 7u);
+
+    ASSERT_TRUE(table->getnode(3, &id));
+    EXPECT_EQ(id, 48u);
+    EXPECT_FALSE(table->getnode(7, &id));
+
+    ASSERT_TRUE(table->getchildnodes(2, &handles));
+    sort(handles.begin(), handles.end());
+    ASSERT_EQ(handles.size(), 4u);
+    EXPECT_EQ(handles[0], 3u);
+    EXPECT_EQ(handles[3], 6u);
+
+    // children without a name hash match any name
+    handles.clear();
+    ASSERT_TRUE(table->getchildnodesbyname(2, 200, &handles));
+    sort(handles.begin(), handles.end());
+    ASSERT_EQ(handles.size(), 3u);
+    EXPECT_EQ(handles[0], 3u);
+    EXPECT_EQ(handles[1], 4u);
+    EXPECT_EQ(handles[2], 6u);
+
+    handles.clear();
+    ASSERT_TRUE(table->getchildnodesbyname(2, 400, &handles));
+    ASSERT_EQ(handles.size(), 1u);
+    EXPECT_EQ(handles[0], 6u);
+
+    handles.clear();
+    ASSERT_TRUE(table->getnodesbyfingerprint(1000, 1500000000, 5, &handles));
+    sort(handles.begin(), handles.end());
+    ASSERT_EQ(handles.size(), 2u);
+    EXPECT_EQ(handles[0], 3u);
+    EXPECT_EQ(handles[1], 5u);
+
+    handles.clear();
+    ASSERT_TRUE(table->getnodesbyfingerprint(1001, 1500000000, 5, &handles));
+    EXPECT_TRUE(handles.empty());
+
+    // index entries are deleted along with their records
+    table->begin();
+    ASSERT_TRUE(table->del(48));
+    table->commit();
+    EXPECT_FALSE(table->getnode(3, &id));
+
+    handles.clear();
+    ASSERT_TRUE(table->getnodesbyfingerprint(1000, 1500000000, 5, &handles));
+    ASSERT_EQ(handles.size(), 1u);
+    EXPECT_EQ(handles[0], 5u);
+
+    table->remove();
+    delete table;
+}
+#endif
+
+TEST(ChunkMacMap, indexserialize)
+{
+    chunkmac_map macs, copy;
+    string data;
+
+    // chunk indexes follow the chunk boundaries
+    for (m_off_t p = 0; p < 64 * 1048576; p += 65536)
+    {
+        size_t i = chunkmac_map::chunkindex(p);
+        ASSERT_EQ(chunkmac_map::chunkpos(i), ChunkedHash::chunkfloor(p));
+        ASSERT_EQ(chunkmac_map::chunkpos(i + 1), ChunkedHash::chunkceil(p));
+    }
+
+    macs[5 * 1048576].finished = true;
+    macs[0].offset = 16;
+    ASSERT_EQ(macs.size(), 2u);
+    ASSERT_TRUE(macs.find(131072) == NULL);
+
+    macs.serialize(&data);
+
+    const char* ptr = data.data();
+    ASSERT_TRUE(copy.unserialize(&ptr, data.data() + data.size()));
+    ASSERT_TRUE(ptr == data.data() + data.size());
+    ASSERT_EQ(copy.size(), 2u);
+    ASSERT_EQ(copy.find(0)->offset, 16u);
+    ASSERT_TRUE(copy.find(5 * 1048576)->finished);
+
+    m_off_t pos, progress, partial;
+    copy.calcprogress(10 * 1048576, &pos, &progress, &partial);
+    ASSERT_EQ(pos, 0);
+    ASSERT_EQ(progress, 1048576 + 16);
+    ASSERT_EQ(partial, 16);
+
+    // (position, MAC) pairs of the former format
+    unsigned short ll = 1;
+    m_off_t chunkpos = 393216;
+    ChunkMAC chunkmac;
+    chunkmac.finished = true;
+
+    data.assign((char*)&ll, sizeof ll);
+    data.append((char*)&chunkpos, sizeof chunkpos);
+    data.append((char*)&chunkmac, sizeof chunkmac);
+
+    ptr = data.data();
+    ASSERT_TRUE(copy.unserialize(&ptr, data.data() + data.size()));
+    ASSERT_EQ(copy.size(), 1u);
+    ASSERT_TRUE(copy.find(chunkpos)->finished);
+}
+
+TEST(TransferCheckpoint, replay)
+{
+    TransferCheckpoint checkpoint;
+    chunkmac_map macs;
+    string data;
+    uint32_t id;
+
+    macs[0].finished = true;
+    macs[0].mac[0] = 1;
+    macs[131072].finished = false;
+    macs[131072].offset = 16;
+
+    checkpoint.transferid = 0x25;
+    checkpoint.chunkmacs[131072].finished = true;
+    checkpoint.chunkmacs[131072].mac[0] = 2;
+    checkpoint.chunkmacs[393216].finished = true;
+    ASSERT_TRUE(checkpoint.serialize(&data));
+
+    ASSERT_TRUE(TransferCheckpoint::unserializeid(&data, &id));
+    ASSERT_EQ(id, 0x25u);
+
+    ASSERT_TRUE(TransferCheckpoint::replay(&data, &macs));
+    ASSERT_EQ(macs.size(), 3u);
+    ASSERT_TRUE(macs[0].finished);
+    ASSERT_EQ(macs[0].mac[0], 1);
+    ASSERT_TRUE(macs[131072].finished);
+    ASSERT_EQ(macs[131072].mac[0], 2);
+    ASSERT_TRUE(macs[393216].finished);
+
+    // truncated records are rejected
+    data.resize(data.size() - 1);
+    ASSERT_FALSE(TransferCheckpoint::replay(&data, &macs));
+}
+
+TEST(DownloadReorderBuffer, coalesce)
+{
+    DownloadReorderBuffer buffer;
+    chunkmac_map macs;
+    string a(131072, 'a'), b(262144, 'b'), c(393216, 'c');
+
+    macs[393216].finished = true;
+    buffer.add(393216, (const byte*)c.data(), (unsigned)c.size(), &macs);
+    ASSERT_TRUE(macs.empty());
+
+    macs[0].finished = true;
+    buffer.add(0, (const byte*)a.data(), (unsigned)a.size(), &macs);
+    ASSERT_EQ(buffer.ranges.size(), 2u);
+
+    // the missing range joins both neighbours
+    macs[131072].finished = true;
+    buffer.add(131072, (const byte*)b.data(), (unsigned)b.size(), &macs);
+    ASSERT_EQ(buffer.ranges.size(), 1u);
+    ASSERT_EQ(buffer.size, 786432);
+
+    // the data is kept in the TransferBufferPool
+    ASSERT_GE(TransferBufferPool::allocated(), 786432);
+
+    DownloadReorderBuffer::range_map::iterator it = buffer.ranges.begin();
+    ASSERT_EQ(it->first, 0);
+    ASSERT_EQ(DownloadReorderBuffer::end(it), 786432);
+    ASSERT_TRUE(string(it->second.data.data(), it->second.data.size()) == a + b + c);
+    ASSERT_EQ(it->second.chunkmacs.size(), 3u);
+
+    buffer.maxsize = 1048576;
+    ASSERT_FALSE(buffer.full(262144));
+    ASSERT_TRUE(buffer.full(262145));
+
+    buffer.erase(it);
+    ASSERT_EQ(buffer.size, 0);
+    ASSERT_EQ(TransferBufferPool::allocated(), 0);
+
+    // an empty buffer always takes data
+    ASSERT_FALSE(buffer.full(2097152));
+}
+
+TEST(TransferBufferPool, budget)
+{
+    size_t size;
+
+    TransferBufferPool::setbudget(4194304);
+    TransferBufferPool::addconnections(4);
+    ASSERT_EQ(TransferBufferPool::share(), 1048576);
+
+    byte* a = TransferBufferPool::alloc(1000000, &size);
+    ASSERT_TRUE(a != NULL);
+    ASSERT_EQ((uintptr_t)a % TransferBufferPool::ALIGNMENT, 0u);
+    ASSERT_EQ(size, 1048576u);
+
+    byte* b = TransferBufferPool::alloc(3145728, &size);
+    ASSERT_TRUE(b != NULL);
+
+    // the budget is exhausted
+    ASSERT_TRUE(TransferBufferPool::alloc(131072, &size) == NULL);
+
+    // an idle buffer is reused
+    TransferBufferPool::release(a);
+    ASSERT_TRUE(TransferBufferPool::alloc(600000, &size) == a);
+    ASSERT_EQ(TransferBufferPool::allocated(), 4194304);
+
+    // data held outside of the pool counts against the budget, and idle
+    // buffers are freed for it
+    ASSERT_FALSE(TransferBufferPool::charge(1));
+    ASSERT_TRUE(TransferBufferPool::charge(1048576, true));
+    ASSERT_EQ(TransferBufferPool::allocated(), 5242880);
+    TransferBufferPool::release(a);
+    ASSERT_TRUE(TransferBufferPool::alloc(131072, &size) == NULL);
+    ASSERT_EQ(TransferBufferPool::allocated(), 4194304);
+
+    TransferBufferPool::uncharge(1048576);
+    ASSERT_TRUE(TransferBufferPool::charge(1048576));
+    TransferBufferPool::uncharge(1048576);
+
+    TransferBufferPool::release(b);
+    TransferBufferPool::addconnections(-4);
+    ASSERT_EQ(TransferBufferPool::allocated(), 0);
+
+    TransferBufferPool::setbudget(0);
+}
+
+#ifdef HAVE_IO_URING
+TEST(PosixIoUring, readwrite)
+{
+    PosixFileSystemAccess fsaccess;
+
+    // set by the client otherwise - completions notify it
+    fsaccess.waiter = NULL;
+
+    // kernel without io_uring support
+    if (!fsaccess.getring())
+    {
+        return;
+    }
+
+    string name = "iouringtest.bin", localname;
+    fsaccess.path2local(&name, &localname);
+
+    string data(300000, 0);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = (char)(i * 7);
+    }
+
+    FileAccess* fa = fsaccess.newfileaccess();
+    ASSERT_TRUE(fa->fopen(&localname, false, true));
+
+    AsyncIOContext* context = fa->asyncfwrite((const byte*)data.data(), (unsigned)data.size(), 0);
+    context->finish();
+    ASSERT_FALSE(context->failed);
+    delete context;
+    delete fa;
+
+    fa = fsaccess.newfileaccess();
+    ASSERT_TRUE(fa->fopen(&localname, true, false));
+
+    string out;
+    context = fa->asyncfread(&out, (unsigned)data.size(), 0, 0);
+    context->finish();
+    ASSERT_FALSE(context->failed);
+    ASSERT_EQ(out, data);
+    delete context;
+
+    // buffers of the TransferBufferPool are registered with the ring (read
+    // and written with the fixed-buffer opcodes, unless registration fails)
+    size_t size;
+    byte* buf = TransferBufferPool::alloc(data.size() + 16, &size);
+    ASSERT_TRUE(buf != NULL);
+
+    context = fa->asyncfread(buf, 1000, 16, 5000);
+    context->finish();
+    ASSERT_FALSE(context->failed);
+    ASSERT_TRUE(!memcmp(buf, data.data() + 5000, 1000));
+    ASSERT_EQ(buf[1015], 0);
+    delete context;
+    delete fa;
+
+    fa = fsaccess.newfileaccess();
+    ASSERT_TRUE(fa->fopen(&localname, false, true));
+
+    memset(buf, 'x', 4096);
+    context = fa->asyncfwrite(buf, 4096, 8192);
+    context->finish();
+    ASSERT_FALSE(context->failed);
+    delete context;
+    delete fa;
+
+    fa = fsaccess.newfileaccess();
+    ASSERT_TRUE(fa->fopen(&localname, true, false));
+    ASSERT_TRUE(fa->fread(&out, (unsigned)data.size(), 0, 0));
+    data.replace(8192, 4096, 4096, 'x');
+    ASSERT_EQ(out, data);
+    delete fa;
+
+    TransferBufferPool::release(buf);
+    fsaccess.unlinklocal(&localname);
+}
+#endif
+
 int main (int argc, char *argv[])
 {
     InitGoogleTest(&argc, argv);